@@ -502,6 +502,18 @@ void SE_Thread::Start(void(*func_ptr)(void*), void *arg)
 }
 
 
+int SE_Thread::GetNumberOfCores()
+{
+#if (defined WINVER && WINVER == _WIN32_WINNT_WIN7)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+#else
+	unsigned int n = std::thread::hardware_concurrency();  // 0 if not known
+	return n > 0 ? (int)n : 1;
+#endif
+}
+
 void SE_Thread::Wait()
 {
 #if (defined WINVER && WINVER == _WIN32_WINNT_WIN7)
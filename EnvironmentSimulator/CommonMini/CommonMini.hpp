@@ -165,6 +165,7 @@ public:
 
 	void Wait();
 	void Start(void(*func_ptr)(void*), void *arg);
+	static int GetNumberOfCores();
 
 private:
 #if (defined WINVER && WINVER == _WIN32_WINNT_WIN7)
@@ -0,0 +1,319 @@
+/*
+ * esmini - Environment Simulator Minimalistic
+ * https://github.com/esmini/esmini
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Copyright (c) partners of Simulation Scenarios
+ * https://sites.google.com/view/simulationscenarios
+ */
+
+ /*
+  * This application measures road manager performance with and without the compiled road network.
+  *
+  * For each given OpenDRIVE file, random points around the lanes are mapped to road coordinates
+  * (XYZH2TrackPos) and random lane positions are mapped to world coordinates (SetLanePos), first using the
+  * compiled road network and then using the object model only. Best time of the iterations is printed per
+  * point, with a checksum of the results, which is the same for both forms. On Linux, cache misses per point
+  * are read from the hardware counters when available. Use --compiled or --objects to run only one form,
+  * e.g. under valgrind --tool=cachegrind or perf stat.
+  */
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include "RoadManager.hpp"
+#include "CommonMini.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace roadmanager;
+
+#define N_BENCH_POINTS 10000
+#define BENCH_NOISE 2.0  // max distance of projected points from the lane center, in x and y
+#define BENCH_ITERATIONS 5
+
+typedef struct
+{
+	double x;
+	double y;
+	double h;
+} BenchPoint;
+
+typedef struct
+{
+	int road_id;
+	int lane_id;
+	double s;
+} BenchLanePos;
+
+typedef struct
+{
+	double projection_time;  // best of the iterations, seconds
+	double road_to_world_time;
+	double checksum;
+	long long projection_cache_misses;  // sum over all iterations, -1 if not available
+	long long road_to_world_cache_misses;
+} BenchResult;
+
+/**
+Open a counter of the hardware cache misses of this thread, initially stopped
+@return File descriptor, -1 if not available
+*/
+static int OpenCacheMissCounter()
+{
+#ifdef __linux__
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	return -1;
+#endif
+}
+
+static void StartCounter(int fd)
+{
+#ifdef __linux__
+	if (fd >= 0)
+	{
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+}
+
+/**
+Stop a counter started by StartCounter()
+@return Count since started, -1 if not available
+*/
+static long long StopCounter(int fd)
+{
+#ifdef __linux__
+	long long count = 0;
+
+	if (fd >= 0)
+	{
+		ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(fd, &count, sizeof(count)) == sizeof(count))
+		{
+			return count;
+		}
+	}
+#endif
+	return -1;
+}
+
+/**
+Create random lane positions, and points at random distance from the lane centers, same for each run
+*/
+static void CreateBenchPoints(OpenDrive *od, std::vector<BenchPoint> &points, std::vector<BenchLanePos> &lane_positions)
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<double> unit(0.0, 1.0);
+	Position pos(od);
+
+	while ((int)points.size() < N_BENCH_POINTS)
+	{
+		Road *road = od->GetRoadByIdx((int)(rng() % od->GetNumOfRoads()));
+		double s = road->GetLength() * unit(rng);
+		LaneSection *lane_section = road->GetLaneSectionByS(s);
+
+		if (lane_section == 0 || lane_section->GetNumberOfLanes() < 2)
+		{
+			continue;
+		}
+
+		int lane_id = lane_section->GetLaneIdByIdx((int)(rng() % lane_section->GetNumberOfLanes()));
+		if (lane_id == 0)
+		{
+			continue;
+		}
+
+		BenchLanePos lane_pos = { road->GetId(), lane_id, s };
+		lane_positions.push_back(lane_pos);
+
+		pos.SetLanePos(road->GetId(), lane_id, s, 0.0);
+		BenchPoint point =
+		{
+			pos.GetX() + BENCH_NOISE * (2 * unit(rng) - 1),
+			pos.GetY() + BENCH_NOISE * (2 * unit(rng) - 1),
+			pos.GetH()
+		};
+		points.push_back(point);
+	}
+}
+
+static double GetTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+Time world to road and road to world mapping with the current form of the road network
+*/
+static void RunBench(OpenDrive *od, std::vector<BenchPoint> &points, std::vector<BenchLanePos> &lane_positions,
+	int iterations, int counter, BenchResult &result)
+{
+	Position pos(od);
+
+	result.projection_time = LARGE_NUMBER;
+	result.road_to_world_time = LARGE_NUMBER;
+	result.checksum = 0.0;
+	result.projection_cache_misses = 0;
+	result.road_to_world_cache_misses = 0;
+
+	for (int i = 0; i < iterations; i++)
+	{
+		double checksum = 0.0;
+
+		StartCounter(counter);
+		double start_time = GetTime();
+		for (size_t j = 0; j < points.size(); j++)
+		{
+			pos.XYZH2TrackPos(points[j].x, points[j].y, 0.0, points[j].h);
+			checksum += pos.GetS() + pos.GetT();
+		}
+		result.projection_time = MIN(result.projection_time, GetTime() - start_time);
+		long long cache_misses = StopCounter(counter);
+		result.projection_cache_misses = cache_misses < 0 ? -1 : result.projection_cache_misses + cache_misses;
+
+		StartCounter(counter);
+		start_time = GetTime();
+		for (size_t j = 0; j < lane_positions.size(); j++)
+		{
+			pos.SetLanePos(lane_positions[j].road_id, lane_positions[j].lane_id, lane_positions[j].s, 0.0);
+			checksum += pos.GetX() + pos.GetY() + pos.GetZ();
+		}
+		result.road_to_world_time = MIN(result.road_to_world_time, GetTime() - start_time);
+		cache_misses = StopCounter(counter);
+		result.road_to_world_cache_misses = cache_misses < 0 ? -1 : result.road_to_world_cache_misses + cache_misses;
+
+		result.checksum = checksum;
+	}
+}
+
+static void PrintResult(const char *form, BenchResult &result, int n_points, int iterations)
+{
+	printf("  %-8s projection %8.1f ns/point, road to world %8.1f ns/point, checksum %.6f\n", form,
+		1e9 * result.projection_time / n_points, 1e9 * result.road_to_world_time / n_points, result.checksum);
+
+	if (result.projection_cache_misses >= 0 && result.road_to_world_cache_misses >= 0)
+	{
+		printf("  %-8s cache misses projection %.2f /point, road to world %.2f /point\n", form,
+			(double)result.projection_cache_misses / ((double)n_points * iterations),
+			(double)result.road_to_world_cache_misses / ((double)n_points * iterations));
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	bool run_compiled = true;
+	bool run_objects = true;
+	int iterations = BENCH_ITERATIONS;
+	int n_failed = 0;
+	int n_files = 0;
+
+	if (argc < 2)
+	{
+		printf("Usage: OdrBench [--compiled | --objects] [--iterations <n>] <OpenDRIVE filename> [<OpenDRIVE filename> ...]\n");
+		return -1;
+	}
+
+	int counter = OpenCacheMissCounter();
+	if (counter < 0)
+	{
+		printf("Hardware cache miss counter not available, timing only\n");
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--compiled"))
+		{
+			run_objects = false;
+			continue;
+		}
+		else if (!strcmp(argv[i], "--objects"))
+		{
+			run_compiled = false;
+			continue;
+		}
+		else if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+		{
+			iterations = atoi(argv[++i]);
+			if (iterations < 1)
+			{
+				printf("Invalid number of iterations: %s\n", argv[i]);
+				return -1;
+			}
+			continue;
+		}
+
+		OpenDrive od;
+		std::vector<BenchPoint> points;
+		std::vector<BenchLanePos> lane_positions;
+		BenchResult result;
+
+		n_files++;
+		try
+		{
+			if (!od.LoadOpenDriveFile(argv[i]) || od.GetCompiled() == 0)
+			{
+				printf("%s: failed to load\n", argv[i]);
+				n_failed++;
+				continue;
+			}
+		}
+		catch (std::exception& e)
+		{
+			LOG("exception: %s", e.what());
+			printf("%s: failed to load\n", argv[i]);
+			n_failed++;
+			continue;
+		}
+
+		printf("%s: %d roads, compiled form %d bytes\n", argv[i], od.GetNumOfRoads(), (int)od.GetCompiled()->GetMemoryUsage());
+		CreateBenchPoints(&od, points, lane_positions);
+
+		if (run_compiled)
+		{
+			RunBench(&od, points, lane_positions, iterations, counter, result);
+			PrintResult("compiled", result, (int)points.size(), iterations);
+		}
+
+		if (run_objects)
+		{
+			od.GetCompiled()->Clear();
+			RunBench(&od, points, lane_positions, iterations, counter, result);
+			PrintResult("objects", result, (int)points.size(), iterations);
+		}
+	}
+
+#ifdef __linux__
+	if (counter >= 0)
+	{
+		close(counter);
+	}
+#endif
+
+	if (n_files == 0)
+	{
+		printf("No OpenDRIVE file given\n");
+	}
+
+	return n_failed > 0 || n_files == 0 ? -1 : 0;
+}
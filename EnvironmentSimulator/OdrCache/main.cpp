@@ -0,0 +1,84 @@
+/* 
+ * esmini - Environment Simulator Minimalistic 
+ * https://github.com/esmini/esmini
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * 
+ * Copyright (c) partners of Simulation Scenarios
+ * https://sites.google.com/view/simulationscenarios
+ */
+
+ /*
+  * This application prebuilds binary caches of OpenDRIVE files.
+  *
+  * For each given OpenDRIVE file the road network is loaded and saved in binary form next to it, 
+  * as <filename>.bin. Later loads of the same, unchanged, OpenDRIVE file will read the cache instead 
+  * of parsing the XML. Caches that are already up to date are left as is, unless --force is given.
+  */
+
+#include <iostream>
+#include "RoadManager.hpp"
+#include "CommonMini.hpp"
+
+using namespace roadmanager;
+
+int main(int argc, char *argv[])
+{
+	bool force = false;
+	int n_failed = 0;
+
+	if (argc < 2)
+	{
+		printf("Usage: OdrCache [--force] <OpenDRIVE filename> [<OpenDRIVE filename> ...]\n");
+		return -1;
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--force"))
+		{
+			force = true;
+			continue;
+		}
+
+		OpenDrive od;
+		std::string cache_filename = OpenDrive::GetBinaryCacheFilename(argv[i]);
+
+		od.SetBinaryCacheEnabled(!force);
+
+		try
+		{
+			if (!od.LoadOpenDriveFile(argv[i]))
+			{
+				printf("%s: failed to load\n", argv[i]);
+				n_failed++;
+				continue;
+			}
+		}
+		catch (std::exception& e)
+		{
+			LOG("exception: %s", e.what());
+			printf("%s: failed to load\n", argv[i]);
+			n_failed++;
+			continue;
+		}
+
+		if (od.IsLoadedFromBinaryCache())
+		{
+			printf("%s: up to date\n", cache_filename.c_str());
+		}
+		else if (od.SaveBinaryCache(cache_filename.c_str()) == 0)
+		{
+			printf("%s: created\n", cache_filename.c_str());
+		}
+		else
+		{
+			printf("%s: failed to create\n", cache_filename.c_str());
+			n_failed++;
+		}
+	}
+
+	return n_failed > 0 ? -1 : 0;
+}
@@ -0,0 +1,1504 @@
+/* 
+ * esmini - Environment Simulator Minimalistic 
+ * https://github.com/esmini/esmini
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * 
+ * Copyright (c) partners of Simulation Scenarios
+ * https://sites.google.com/view/simulationscenarios
+ */
+
+ /*
+  * This application checks that the fast evaluation paths of the road manager agree with the reference ones.
+  *
+  * The batch evaluation of geometries and polynomials is compared to the scalar evaluation, point by point,
+  * and spiral tables are compared to odrSpiral(). This is done for synthetic roads and for each given
+  * OpenDRIVE file. For the files, road paths of all road pairs are also compared to a Floyd-Warshall
+  * reference, batch projection is checked for any number of threads and compared to XYZH2TrackPos(), and
+  * lane segments found in random circles and boxes are compared to sampled lanes. Multi-distance probes are
+  * compared to probing each distance from the pivot point, and the route segment table to walking the
+  * waypoints. Finally the compiled road network is compared to the object model, which in a build with
+  * RM_COMPACT_STORAGE gives the accuracy of single precision storage. Max differences are printed.
+  * Exit code is non zero if any difference exceeds the tolerance.
+  * Registered as a test, run on the bundled road networks.
+  */
+
+#include <cmath>
+#include <map>
+#include <random>
+#include <vector>
+#include "RoadManager.hpp"
+#include "CommonMini.hpp"
+#include "odrSpiral.h"
+
+using namespace roadmanager;
+
+#define N_SAMPLES 500  // per geometry or polynomial, half evenly spaced, half random
+#define BATCH_TOLERANCE 1e-9  // batch and scalar math is the same, allow for compiler contraction only
+#define N_SPIRAL_SAMPLES 2000  // per spiral table
+#define N_RANDOM_SPIRALS 200
+#define SPIRAL_TABLE_CHECK_TOLERANCE 1e-9  // tables are built for max 1e-10 m position error
+#define ROAD_PATH_TOLERANCE 1e-6  // same sums in other order
+#define ROAD_PATH_CHECK_LANDMARKS 8
+#define N_PROJECTION_POINTS 10000  // enough for 8 threads, batch blocks are 1024 points
+#define PROJECTION_CHECK_STEP 1.0
+#define PROJECTION_CHECK_TRAJECTORY_POINTS 200
+#define PROJECTION_CHECK_NOISE 0.1  // max lateral and longitudinal noise of trajectory points
+#define PROJECTION_CHECK_TOLERANCE 1e-3  // max extra distance to world point of batch result mapped back
+#define N_LANE_REGION_QUERIES 50  // each of circles and boxes
+#define LANE_REGION_CHECK_STEP 0.1  // distance between lane samples along s
+#define LANE_REGION_CHECK_MIN_SIZE 0.5  // region radius, or box side
+#define LANE_REGION_CHECK_MAX_SIZE 40.0
+#define LANE_REGION_CHECK_CELL_SIZE 10.0  // grid for finding samples close to a region
+#define LANE_REGION_CHECK_END_ACCURACY 0.02  // lane segment ends are refined to within this distance along s
+#define N_PROBE_START_POSITIONS 200
+#define N_PROBE_DISTANCES 20
+#define PROBE_CHECK_FIRST_DISTANCE 2.0
+#define PROBE_CHECK_DISTANCE_STEP 5.0
+#define PROBE_CHECK_LANE_OFFSET 0.3
+#ifdef RM_COMPACT_STORAGE
+#define PROBE_CHECK_TOLERANCE 1e-6  // as below, and single precision roads are evaluated at other s values
+#else
+#define PROBE_CHECK_TOLERANCE 1e-9  // probes are moved from one point to the next instead of from start
+#endif
+#define N_RANDOM_ROUTES 100
+#define ROUTE_CHECK_WAYPOINTS 10
+#define ROUTE_CHECK_DRIVE_STEP 2.0  // when driving to find the next road of a route
+#define ROUTE_CHECK_MAX_STEPS 10000
+#define ROUTE_CHECK_STEP 0.37  // between checked route s values, not a divisor of typical road lengths
+#define ROUTE_CHECK_OUTSIDE 10.0  // route s values checked before and after the route
+#define ROUTE_CHECK_TOLERANCE 1e-9  // same sums in other order
+#define COMPILED_CHECK_STEP 0.5  // along each road
+#ifdef RM_COMPACT_STORAGE
+#define COMPILED_CHECK_TOLERANCE 1e-3  // single precision, coordinates relative to the start of the road
+#else
+#define COMPILED_CHECK_TOLERANCE 1e-9  // same values, allow for compiler contraction only
+#endif
+
+static std::mt19937 rng(1);
+
+static void GetSamples(double length, std::vector<double> &s)
+{
+	std::uniform_real_distribution<double> random_s(0.0, length);
+
+	s.resize(N_SAMPLES);
+	for (int i = 0; i < N_SAMPLES / 2; i++)
+	{
+		s[i] = length * i / (N_SAMPLES / 2 - 1);
+	}
+	for (int i = N_SAMPLES / 2; i < N_SAMPLES; i++)
+	{
+		s[i] = random_s(rng);
+	}
+}
+
+static double CheckPolynomial(Polynomial &poly, double length)
+{
+	std::vector<double> s;
+	std::vector<double> value(N_SAMPLES);
+	std::vector<double> prim(N_SAMPLES);
+	double max_diff = 0.0;
+
+	GetSamples(length, s);
+	poly.EvaluateBatch(s.data(), N_SAMPLES, value.data());
+	poly.EvaluatePrimBatch(s.data(), N_SAMPLES, prim.data());
+
+	for (int i = 0; i < N_SAMPLES; i++)
+	{
+		max_diff = MAX(max_diff, fabs(value[i] - poly.Evaluate(s[i])));
+		max_diff = MAX(max_diff, fabs(prim[i] - poly.EvaluatePrim(s[i])));
+	}
+
+	return max_diff;
+}
+
+static double CheckGeometry(Geometry *geom, double *max_heading_diff)
+{
+	std::vector<double> ds;
+	std::vector<double> x(N_SAMPLES);
+	std::vector<double> y(N_SAMPLES);
+	std::vector<double> h(N_SAMPLES);
+	double max_diff = 0.0;
+
+	GetSamples(geom->GetLength(), ds);
+	geom->EvaluateDSBatch(ds.data(), N_SAMPLES, x.data(), y.data(), h.data());
+
+	for (int i = 0; i < N_SAMPLES; i++)
+	{
+		double x_ref, y_ref, h_ref;
+		geom->EvaluateDS(ds[i], &x_ref, &y_ref, &h_ref);
+		max_diff = MAX(max_diff, sqrt((x[i] - x_ref) * (x[i] - x_ref) + (y[i] - y_ref) * (y[i] - y_ref)));
+		*max_heading_diff = MAX(*max_heading_diff, GetAbsAngleDifference(h[i], h_ref));
+	}
+
+	return max_diff;
+}
+
+typedef struct
+{
+	int n_geometries[6];
+	double max_pos_diff[6];
+	double max_heading_diff[6];
+	double max_poly_diff;
+} BatchCheckResult;
+
+static void CheckRoadBatchEvaluation(Road *road, BatchCheckResult &result)
+{
+	for (int j = 0; j < road->GetNumberOfGeometries(); j++)
+	{
+		Geometry *geom = road->GetGeometry(j);
+		int type = (int)geom->GetType();
+
+		if (type < 0 || type > 5)
+		{
+			type = 0;
+		}
+		result.n_geometries[type]++;
+		result.max_pos_diff[type] = MAX(result.max_pos_diff[type], CheckGeometry(geom, &result.max_heading_diff[type]));
+
+		if (type == Geometry::GEOMETRY_TYPE_POLY3)
+		{
+			result.max_poly_diff = MAX(result.max_poly_diff, CheckPolynomial(((Poly3*)geom)->poly3_, geom->GetLength()));
+		}
+		else if (type == Geometry::GEOMETRY_TYPE_PARAM_POLY3)
+		{
+			result.max_poly_diff = MAX(result.max_poly_diff, CheckPolynomial(((ParamPoly3*)geom)->poly3U_, geom->GetLength()));
+			result.max_poly_diff = MAX(result.max_poly_diff, CheckPolynomial(((ParamPoly3*)geom)->poly3V_, geom->GetLength()));
+		}
+	}
+
+	for (int j = 0; j < road->GetNumberOfElevations(); j++)
+	{
+		Elevation *elevation = road->GetElevation(j);
+		result.max_poly_diff = MAX(result.max_poly_diff, CheckPolynomial(elevation->poly3_, elevation->GetLength()));
+	}
+}
+
+/**
+Compare batch evaluation of geometries, their polynomials and elevation profiles to scalar evaluation
+@param od Road network to check, or 0 for a synthetic road with all geometry types
+@return 0 if all differences are within tolerance, else -1
+*/
+static int CheckBatchEvaluation(OpenDrive *od)
+{
+	const char *type_name[] = { "unknown", "line", "arc", "spiral", "poly3", "paramPoly3" };
+	BatchCheckResult result = { { 0 }, { 0 }, { 0 }, 0.0 };
+	int ret = 0;
+
+	if (od)
+	{
+		for (int i = 0; i < od->GetNumOfRoads(); i++)
+		{
+			CheckRoadBatchEvaluation(od->GetRoadByIdx(i), result);
+		}
+	}
+	else
+	{
+		// Not all types are found in the bundled road networks, and spirals and arcs have special cases for
+		// curvature sign and start curvature
+		Arena arena;
+		Road road(0, "synthetic");
+
+		road.AddLine(new (arena) Line(0.0, 10.0, -5.0, 0.3, 50.0));
+		road.AddArc(new (arena) Arc(50.0, 20.0, 5.0, 1.2, 40.0, 0.02));
+		road.AddArc(new (arena) Arc(90.0, -20.0, 5.0, -2.5, 40.0, -0.05));
+		road.AddSpiral(new (arena) Spiral(130.0, 3.0, 4.0, 0.5, 80.0, 0.0, 0.04));
+		road.AddSpiral(new (arena) Spiral(210.0, 3.0, 4.0, -1.5, 60.0, -0.01, -0.06));
+		road.AddSpiral(new (arena) Spiral(270.0, 3.0, 4.0, 2.5, 60.0, 0.05, 0.005));
+		road.AddPoly3(new (arena) Poly3(330.0, 7.0, 1.0, 0.7, 30.0, 0.5, 0.1, -0.01, 0.0002));
+		road.AddParamPoly3(new (arena) ParamPoly3(360.0, 1.0, 2.0, -0.4, 45.0,
+			0.0, 45.0, -2.0, 1.0, 0.0, 0.0, 8.0, -3.0, ParamPoly3::P_RANGE_NORMALIZED));
+		road.AddParamPoly3(new (arena) ParamPoly3(405.0, 1.0, 2.0, 1.9, 35.0,
+			0.0, 1.0, 0.001, -0.00002, 0.0, 0.0, 0.01, -0.0001, ParamPoly3::P_RANGE_ARC_LENGTH));
+
+		CheckRoadBatchEvaluation(&road, result);
+	}
+
+	for (int i = 1; i < 6; i++)
+	{
+		if (result.n_geometries[i] == 0)
+		{
+			continue;
+		}
+		printf("  batch %-10s %5d geometries, max diff position %.2e m heading %.2e rad\n",
+			type_name[i], result.n_geometries[i], result.max_pos_diff[i], result.max_heading_diff[i]);
+		if (result.max_pos_diff[i] > BATCH_TOLERANCE || result.max_heading_diff[i] > BATCH_TOLERANCE)
+		{
+			printf("  FAILED: batch %s evaluation differs from scalar\n", type_name[i]);
+			ret = -1;
+		}
+	}
+
+	printf("  batch polynomials, max diff %.2e\n", result.max_poly_diff);
+	if (result.max_poly_diff > BATCH_TOLERANCE)
+	{
+		printf("  FAILED: batch polynomial evaluation differs from scalar\n");
+		ret = -1;
+	}
+
+	return ret;
+}
+
+static double CheckSpiralTable(SpiralTable *table, double c_dot, double *max_heading_diff)
+{
+	double s_end = table->GetSStart() + (table->GetNumberOfNodes() - 1) * table->GetStep();
+	double max_diff = 0.0;
+
+	for (int i = 0; i < N_SPIRAL_SAMPLES; i++)
+	{
+		double s = table->GetSStart() + (s_end - table->GetSStart()) * i / (N_SPIRAL_SAMPLES - 1);
+		double x, y, t, x_ref, y_ref, t_ref;
+
+		table->Evaluate(s, &x, &y, &t);
+		odrSpiral(s, c_dot, &x_ref, &y_ref, &t_ref);
+		max_diff = MAX(max_diff, sqrt((x - x_ref) * (x - x_ref) + (y - y_ref) * (y - y_ref)));
+		*max_heading_diff = MAX(*max_heading_diff, GetAbsAngleDifference(t, t_ref));
+	}
+
+	return max_diff;
+}
+
+static void CheckRoadSpiralTables(Road *road, int &n_tables, double &max_pos_diff, double &max_heading_diff)
+{
+	for (int j = 0; j < road->GetNumberOfGeometries(); j++)
+	{
+		Geometry *geom = road->GetGeometry(j);
+
+		if (geom->GetType() == Geometry::GEOMETRY_TYPE_SPIRAL && !((Spiral*)geom)->GetTable()->IsEmpty())
+		{
+			n_tables++;
+			max_pos_diff = MAX(max_pos_diff, CheckSpiralTable(((Spiral*)geom)->GetTable(), ((Spiral*)geom)->GetCDot(), &max_heading_diff));
+		}
+	}
+}
+
+/**
+Compare spiral tables to odrSpiral() over the whole table range. Tables are built by Road::AddSpiral(), with
+the node spacing used when loading road networks.
+@param od Road network to check, or 0 for a synthetic road with random spirals
+@return 0 if all differences are within tolerance, else -1
+*/
+static int CheckSpiralTables(OpenDrive *od)
+{
+	int n_tables = 0;
+	double max_pos_diff = 0.0;
+	double max_heading_diff = 0.0;
+
+	if (od)
+	{
+		for (int i = 0; i < od->GetNumOfRoads(); i++)
+		{
+			CheckRoadSpiralTables(od->GetRoadByIdx(i), n_tables, max_pos_diff, max_heading_diff);
+		}
+	}
+	else
+	{
+		Arena arena;
+		Road road(0, "synthetic");
+		std::uniform_real_distribution<double> random_length(1.0, 300.0);
+		std::uniform_real_distribution<double> random_curvature(-0.1, 0.1);
+
+		for (int i = 0; i < N_RANDOM_SPIRALS; i++)
+		{
+			// Every fourth spiral starts from a straight line, the common case
+			double curv_start = i % 4 == 0 ? 0.0 : random_curvature(rng);
+			road.AddSpiral(new (arena) Spiral(0.0, 0.0, 0.0, 0.0, random_length(rng), curv_start, random_curvature(rng)));
+		}
+		CheckRoadSpiralTables(&road, n_tables, max_pos_diff, max_heading_diff);
+	}
+
+	if (n_tables == 0)
+	{
+		return 0;
+	}
+
+	printf("  spiral table %5d tables, max error position %.2e m heading %.2e rad\n", n_tables, max_pos_diff, max_heading_diff);
+	if (max_pos_diff > SPIRAL_TABLE_CHECK_TOLERANCE || max_heading_diff > SPIRAL_TABLE_CHECK_TOLERANCE)
+	{
+		printf("  FAILED: spiral table differs from odrSpiral\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void AddEnteredRoad(OpenDrive *od, int road_id, ContactPointType contact_point, std::vector<std::pair<int, int> > &entered)
+{
+	int road_idx = od->GetTrackIdxById(road_id);
+
+	if (road_idx >= 0 && (contact_point == CONTACT_POINT_START || contact_point == CONTACT_POINT_END))
+	{
+		entered.push_back(std::make_pair(road_idx, contact_point == CONTACT_POINT_START ? 0 : 1));
+	}
+}
+
+/**
+Find roads entered when leaving each road end, from the road links and junction connections. Reference for the
+road manager functions under test, so built without them. Node road_idx * 2 + end is leaving the road from that
+end, 0 = start and 1 = end.
+@param od Road network
+@param entered Receives for each node the roads entered, and the end (0 start, 1 end) where they are entered
+*/
+static void FindEnteredRoads(OpenDrive *od, std::vector<std::vector<std::pair<int, int> > > &entered)
+{
+	entered.assign(2 * od->GetNumOfRoads(), std::vector<std::pair<int, int> >());
+
+	for (int i = 0; i < od->GetNumOfRoads(); i++)
+	{
+		Road *road = od->GetRoadByIdx(i);
+
+		for (int end = 0; end < 2; end++)
+		{
+			RoadLink *link = road->GetLink(end == 0 ? PREDECESSOR : SUCCESSOR);
+
+			if (link == 0)
+			{
+				continue;
+			}
+			if (link->GetElementType() == RoadLink::ELEMENT_TYPE_ROAD)
+			{
+				AddEnteredRoad(od, link->GetElementId(), link->GetContactPointType(), entered[2 * i + end]);
+			}
+			else if (link->GetElementType() == RoadLink::ELEMENT_TYPE_JUNCTION)
+			{
+				Junction *junction = od->GetJunctionById(link->GetElementId());
+
+				for (int j = 0; junction && j < junction->GetNumberOfConnections(); j++)
+				{
+					Connection *connection = junction->GetConnectionByIdx(j);
+					if (connection->GetIncomingRoad() == road && connection->GetConnectingRoad())
+					{
+						AddEnteredRoad(od, connection->GetConnectingRoad()->GetId(), connection->GetContactPoint(), entered[2 * i + end]);
+					}
+				}
+			}
+		}
+	}
+}
+
+/**
+Shortest distances from each road end to either end of a target road by Floyd-Warshall, as reference for the
+path search. Like OpenDrive::GetRoadPath(), paths end where the target road is first entered, i.e. they don't
+pass it. Lengths of start and target roads are not included.
+@param od Road network
+@param entered Roads entered from each node, see FindEnteredRoads()
+@param target_road_idx Index of the target road
+@param dist Receives the distance for each node and end of the target road, [node * 2 + target_end], LARGE_NUMBER if no path
+*/
+static void CalcRoadEndDistances(OpenDrive *od, std::vector<std::vector<std::pair<int, int> > > &entered, int target_road_idx,
+	std::vector<double> &dist)
+{
+	int n_nodes = 2 * od->GetNumOfRoads();
+	std::vector<double> node_dist((size_t)n_nodes * n_nodes, LARGE_NUMBER);
+
+	for (int i = 0; i < n_nodes; i++)
+	{
+		node_dist[(size_t)i * n_nodes + i] = 0.0;
+		for (size_t j = 0; j < entered[i].size() && i / 2 != target_road_idx; j++)
+		{
+			// Entering a road at one end means leaving it from the other
+			int node = 2 * entered[i][j].first + 1 - entered[i][j].second;
+			double length = od->GetRoadByIdx(entered[i][j].first)->GetLength();
+			node_dist[(size_t)i * n_nodes + node] = MIN(node_dist[(size_t)i * n_nodes + node], length);
+		}
+	}
+
+	for (int k = 0; k < n_nodes; k++)
+	{
+		for (int i = 0; i < n_nodes; i++)
+		{
+			double dist_ik = node_dist[(size_t)i * n_nodes + k];
+			if (dist_ik >= LARGE_NUMBER)
+			{
+				continue;
+			}
+			for (int j = 0; j < n_nodes; j++)
+			{
+				if (dist_ik + node_dist[(size_t)k * n_nodes + j] < node_dist[(size_t)i * n_nodes + j])
+				{
+					node_dist[(size_t)i * n_nodes + j] = dist_ik + node_dist[(size_t)k * n_nodes + j];
+				}
+			}
+		}
+	}
+
+	// Shortest way to any node from which the target road is entered at either end
+	dist.assign(2 * n_nodes, LARGE_NUMBER);
+	for (int i = 0; i < n_nodes; i++)
+	{
+		for (int node = 0; node < n_nodes; node++)
+		{
+			for (size_t k = 0; k < entered[node].size() && node / 2 != target_road_idx; k++)
+			{
+				if (entered[node][k].first == target_road_idx)
+				{
+					double *d = &dist[2 * i + entered[node][k].second];
+					*d = MIN(*d, node_dist[(size_t)i * n_nodes + node]);
+				}
+			}
+		}
+	}
+}
+
+static bool IsSameRoadPath(RoadPathEntry &a, RoadPathEntry &b)
+{
+	for (int i = 0; i < 2; i++)
+	{
+		for (int j = 0; j < 2; j++)
+		{
+			if (a.dist[i][j] != b.dist[i][j] || a.road[i][j] != b.road[i][j])
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+Compare road paths of all road pairs to Floyd-Warshall distances: OpenDrive::GetRoadPath() without and with
+landmarks, Position::Delta() and the landmark lower bound. Also check that cached paths equal uncached ones.
+@param od Road network to check
+@return 0 if all paths are shortest and cached ones are unchanged, else -1
+*/
+static int CheckRoadPaths(OpenDrive *od)
+{
+	int n_roads = od->GetNumOfRoads();
+	std::vector<std::vector<std::pair<int, int> > > entered;
+	std::vector<double> dist;
+	std::vector<double> expected((size_t)n_roads * n_roads * 4);  // [(start * n_roads + target) * 4 + start_end * 2 + target_end]
+	std::vector<RoadPathEntry> uncached((size_t)n_roads * n_roads);
+	int n_path_diff[2] = { 0, 0 };  // without and with landmarks
+	int n_delta_diff = 0;
+	int n_bound_fail = 0;
+	int n_cache_diff = 0;
+	int n_unreachable = 0;
+
+	FindEnteredRoads(od, entered);
+	for (int j = 0; j < n_roads; j++)
+	{
+		CalcRoadEndDistances(od, entered, j, dist);
+		for (int i = 0; i < n_roads; i++)
+		{
+			for (int k = 0; k < 4; k++)
+			{
+				expected[((size_t)i * n_roads + j) * 4 + k] = dist[4 * i + k];
+			}
+		}
+	}
+
+	od->SetRoadPathCacheSize(0);
+
+	for (int landmarks = 0; landmarks < 2; landmarks++)
+	{
+		od->ComputeLandmarks(landmarks ? ROAD_PATH_CHECK_LANDMARKS : 0);
+
+		for (int i = 0; i < n_roads; i++)
+		{
+			for (int j = 0; j < n_roads; j++)
+			{
+				RoadPathEntry &entry = uncached[(size_t)i * n_roads + j];
+				double s_start = od->GetRoadByIdx(i)->GetLength() / 2;
+				double s_target = od->GetRoadByIdx(j)->GetLength() / 3;
+				double best = i == j ? fabs(s_target - s_start) : LARGE_NUMBER;
+
+				if (i != j)
+				{
+					od->GetRoadPath(i, j, entry);
+
+					for (int start_end = 0; start_end < 2; start_end++)
+					{
+						for (int target_end = 0; target_end < 2; target_end++)
+						{
+							double road_dist = expected[((size_t)i * n_roads + j) * 4 + start_end * 2 + target_end];
+
+							if (fabs(entry.dist[start_end][target_end] - road_dist) > ROAD_PATH_TOLERANCE)
+							{
+								n_path_diff[landmarks]++;
+							}
+							if (road_dist < LARGE_NUMBER)
+							{
+								best = MIN(best, (start_end == 0 ? s_start : od->GetRoadByIdx(i)->GetLength() - s_start) + road_dist +
+									(target_end == 0 ? s_target : od->GetRoadByIdx(j)->GetLength() - s_target));
+							}
+						}
+					}
+				}
+
+				if (landmarks == 0)
+				{
+					if (best >= LARGE_NUMBER)
+					{
+						n_unreachable++;
+					}
+					continue;
+				}
+
+				Position pos_a(od);
+				Position pos_b(od);
+				PositionDiff diff;
+
+				pos_a.SetTrackPos(od->GetRoadByIdx(i)->GetId(), s_start, 0.5);
+				pos_b.SetTrackPos(od->GetRoadByIdx(j)->GetId(), s_target, 0.5);
+
+				double delta = pos_a.Delta(pos_b, diff) ? fabs(diff.ds) : LARGE_NUMBER;
+				if (fabs(delta - best) > ROAD_PATH_TOLERANCE)
+				{
+					n_delta_diff++;
+				}
+
+				double bound = pos_a.GetRoadDistanceLowerBound(pos_b);
+				if (bound > best + ROAD_PATH_TOLERANCE || (best < LARGE_NUMBER && bound >= LARGE_NUMBER))
+				{
+					n_bound_fail++;
+				}
+			}
+		}
+	}
+
+	// Fill the cache, then read back from it
+	od->SetRoadPathCacheSize(n_roads * n_roads);
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (int i = 0; i < n_roads; i++)
+		{
+			for (int j = 0; j < n_roads; j++)
+			{
+				RoadPathEntry entry;
+				if (i != j && (od->GetRoadPath(i, j, entry) != 0 || !IsSameRoadPath(entry, uncached[(size_t)i * n_roads + j])))
+				{
+					n_cache_diff++;
+				}
+			}
+		}
+	}
+
+	printf("  road paths %5d pairs, %d unreachable, differing from Floyd-Warshall: %d without landmarks, %d with, %d Delta, "
+		"%d bad lower bounds, %d cached paths differ\n", n_roads * n_roads, n_unreachable, n_path_diff[0], n_path_diff[1],
+		n_delta_diff, n_bound_fail, n_cache_diff);
+	if (n_path_diff[0] + n_path_diff[1] + n_delta_diff + n_bound_fail + n_cache_diff > 0)
+	{
+		printf("  FAILED: road paths are not the shortest or cache changes them\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+Sample trajectories along the driving lanes of a road network, with some lateral noise, as input to batch
+projection. Each trajectory starts on a road and continues into random connected roads.
+@param od Road network
+@param n_points Number of points wanted
+@param x Receives x coordinate per point
+@param y Receives y coordinate per point
+@param h Receives heading per point
+*/
+static void GetLaneTrajectories(OpenDrive *od, int n_points, std::vector<double> &x, std::vector<double> &y, std::vector<double> &h)
+{
+	std::uniform_real_distribution<double> random_noise(-PROJECTION_CHECK_NOISE, PROJECTION_CHECK_NOISE);
+	int n_added = 0;
+
+	x.clear();
+	y.clear();
+	h.clear();
+
+	for (int rep = 0; (int)x.size() < n_points && (rep == 0 || n_added > 0); rep++)
+	{
+		n_added = 0;
+		for (int i = 0; i < od->GetNumOfRoads() && (int)x.size() < n_points; i++)
+		{
+			Road *road = od->GetRoadByIdx(i);
+			LaneSection *lane_section = road->GetLaneSectionByIdx(0);
+
+			for (int j = 0; lane_section && j < lane_section->GetNumberOfLanes() && (int)x.size() < n_points; j++)
+			{
+				if (!lane_section->GetLaneByIdx(j)->IsDriving())
+				{
+					continue;
+				}
+
+				Position pos(od);
+				pos.SetRandomSeed(rep * 1000 + i * 10 + j);
+				pos.SetLanePos(road->GetId(), lane_section->GetLaneIdByIdx(j), 0.5, 0.0);
+
+				for (int k = 0; k < PROJECTION_CHECK_TRAJECTORY_POINTS && (int)x.size() < n_points; k++)
+				{
+					if (pos.MoveAlongS(PROJECTION_CHECK_STEP) != 0)
+					{
+						break;
+					}
+					x.push_back(pos.GetX() + random_noise(rng));
+					y.push_back(pos.GetY() + random_noise(rng));
+					h.push_back(pos.GetH());
+					n_added++;
+				}
+			}
+		}
+	}
+}
+
+/**
+Check that batch projection gives the same result for any number of threads, and compare it point by point to
+Position::XYZH2TrackPos() along the same trajectories. Each batch result, mapped back to world coordinates, must
+be as close to the world point as the XYZH2TrackPos() result, within tolerance.
+@param od Road network to check
+@return 0 if thread results are identical and no point is worse than by XYZH2TrackPos(), else -1
+*/
+static int CheckBatchProjection(OpenDrive *od)
+{
+	const int n_threads[] = { 1, 2, 4, 8 };
+	std::vector<double> x, y, h;
+	int n_thread_diff = 0;
+	int n_other_road = 0;
+	int n_fail = 0;
+	double max_diff = 0.0;
+	double max_error[2] = { 0.0, 0.0 };  // batch and XYZH2TrackPos(), distance to world point when mapped back
+
+	GetLaneTrajectories(od, N_PROJECTION_POINTS, x, y, h);
+	int n = (int)x.size();
+	if (n == 0)
+	{
+		return 0;
+	}
+
+	std::vector<int> road_id[2], lane_id[2];
+	std::vector<double> s[2], t[2], offset[2];
+
+	for (int i = 0; i < 2; i++)
+	{
+		road_id[i].resize(n);
+		lane_id[i].resize(n);
+		s[i].resize(n);
+		t[i].resize(n);
+		offset[i].resize(n);
+	}
+
+	for (size_t i = 0; i < sizeof(n_threads) / sizeof(n_threads[0]); i++)
+	{
+		// First run is kept for reference, later ones are compared to it
+		int k = i == 0 ? 0 : 1;
+
+		if (od->XYZH2TrackPosBatch(n, x.data(), y.data(), 0, h.data(), road_id[k].data(), lane_id[k].data(), s[k].data(),
+			t[k].data(), offset[k].data(), n_threads[i]) != 0)
+		{
+			printf("  FAILED: batch projection returned error\n");
+			return -1;
+		}
+
+		if (k == 1 && (road_id[1] != road_id[0] || lane_id[1] != lane_id[0] || s[1] != s[0] || t[1] != t[0] || offset[1] != offset[0]))
+		{
+			n_thread_diff++;
+		}
+	}
+
+	// Same trajectories mapped point by point. XYZH2TrackPos() is not exact, e.g. where the lane offset changes, so
+	// compare how well each result maps back to the world point rather than road coordinates.
+	Position pos(od);
+	for (int i = 0; i < n; i++)
+	{
+		pos.XYZH2TrackPos(x[i], y[i], pos.GetZ(), h[i]);
+
+		Position batch_pos(od);
+		batch_pos.SetTrackPos(road_id[0][i], s[0][i], t[0][i]);
+		Position scalar_pos(od);
+		scalar_pos.SetTrackPos(pos.GetTrackId(), pos.GetS(), pos.GetT());
+
+		double error_batch = sqrt((batch_pos.GetX() - x[i]) * (batch_pos.GetX() - x[i]) + (batch_pos.GetY() - y[i]) * (batch_pos.GetY() - y[i]));
+		double error_scalar = sqrt((scalar_pos.GetX() - x[i]) * (scalar_pos.GetX() - x[i]) + (scalar_pos.GetY() - y[i]) * (scalar_pos.GetY() - y[i]));
+
+		max_error[0] = MAX(max_error[0], error_batch);
+		max_error[1] = MAX(max_error[1], error_scalar);
+
+		if (pos.GetTrackId() == road_id[0][i] && pos.GetLaneId() == lane_id[0][i])
+		{
+			max_diff = MAX(max_diff, MAX(fabs(pos.GetS() - s[0][i]), fabs(pos.GetT() - t[0][i])));
+		}
+		else
+		{
+			// Overlapping roads, e.g. in junctions, either may be picked
+			n_other_road++;
+		}
+
+		if (road_id[0][i] < 0 || error_batch > error_scalar + PROJECTION_CHECK_TOLERANCE)
+		{
+			n_fail++;
+		}
+	}
+
+	printf("  projection %5d points, %d thread counts differ, max error batch %.2e m XYZH2TrackPos %.2e m, max diff s, t %.2e m, "
+		"%d on other road, %d worse\n", n, n_thread_diff, max_error[0], max_error[1], max_diff, n_other_road, n_fail);
+	if (n_thread_diff > 0 || n_fail > 0)
+	{
+		printf("  FAILED: batch projection depends on thread count or is worse than XYZH2TrackPos\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+// Lane cross section at one s, from the right border to the left border of the lane
+typedef struct
+{
+	int road_id;
+	int lane_id;
+	double s;
+	bool driving;
+	double x[2];
+	double y[2];
+} LaneBorderSample;
+
+static double DistToLineSegment(double px, double py, double x0, double y0, double x1, double y1)
+{
+	double dx = x1 - x0;
+	double dy = y1 - y0;
+	double length2 = dx * dx + dy * dy;
+	double u = length2 > 0 ? ((px - x0) * dx + (py - y0) * dy) / length2 : 0.0;
+
+	u = MAX(u, 0.0);
+	u = MIN(u, 1.0);
+
+	return sqrt((x0 + u * dx - px) * (x0 + u * dx - px) + (y0 + u * dy - py) * (y0 + u * dy - py));
+}
+
+static bool LineSegmentInBox(double x0, double y0, double x1, double y1, double x_min, double y_min, double x_max, double y_max)
+{
+	// Clip parameter range of the segment to the box, one pair of box sides at a time (Liang-Barsky)
+	double p[4] = { x0 - x1, x1 - x0, y0 - y1, y1 - y0 };
+	double q[4] = { x0 - x_min, x_max - x0, y0 - y_min, y_max - y0 };
+	double u_min = 0.0;
+	double u_max = 1.0;
+
+	for (int i = 0; i < 4; i++)
+	{
+		if (p[i] == 0.0)
+		{
+			if (q[i] < 0.0)
+			{
+				return false;
+			}
+		}
+		else if (p[i] < 0.0)
+		{
+			u_min = MAX(u_min, q[i] / p[i]);
+		}
+		else
+		{
+			u_max = MIN(u_max, q[i] / p[i]);
+		}
+	}
+
+	return u_min <= u_max;
+}
+
+/**
+Sample lane cross sections of all lanes of a road network, evenly spaced along s, using Position::SetLanePos()
+@param od Road network
+@param samples Receives the samples, ordered by road and s
+@param lane_samples Receives for each road and lane id the indices of its samples, in order of s
+*/
+static void GetLaneBorderSamples(OpenDrive *od, std::vector<LaneBorderSample> &samples,
+	std::map<std::pair<int, int>, std::vector<int> > &lane_samples)
+{
+	Position pos(od);
+
+	samples.clear();
+	lane_samples.clear();
+
+	for (int i = 0; i < od->GetNumOfRoads(); i++)
+	{
+		Road *road = od->GetRoadByIdx(i);
+
+		for (int j = 0; j < road->GetNumberOfLaneSections(); j++)
+		{
+			LaneSection *lane_section = road->GetLaneSectionByIdx(j);
+
+			for (int k = 0; k < lane_section->GetNumberOfLanes(); k++)
+			{
+				Lane *lane = lane_section->GetLaneByIdx(k);
+
+				for (double s = lane_section->GetS() + LANE_REGION_CHECK_STEP / 2; s < lane_section->GetS() + lane_section->GetLength() &&
+					lane->GetId() != 0; s += LANE_REGION_CHECK_STEP)
+				{
+					double width = lane_section->GetWidth(s, lane->GetId());
+					LaneBorderSample sample;
+
+					if (width < SMALL_NUMBER)
+					{
+						continue;
+					}
+
+					sample.road_id = road->GetId();
+					sample.lane_id = lane->GetId();
+					sample.s = s;
+					sample.driving = lane->IsDriving();
+					for (int side = 0; side < 2; side++)
+					{
+						pos.SetLanePos(road->GetId(), lane->GetId(), s, side == 0 ? -width / 2 : width / 2);
+						sample.x[side] = pos.GetX();
+						sample.y[side] = pos.GetY();
+					}
+					lane_samples[std::make_pair(sample.road_id, sample.lane_id)].push_back((int)samples.size());
+					samples.push_back(sample);
+				}
+			}
+		}
+	}
+}
+
+/**
+Compare lane segments found in random circles and boxes to sampled lane cross sections. A sample inside the
+region must be covered by a segment, and a sample covered by a segment must be inside, except within the end
+accuracy of the segment ends.
+@param od Road network to check
+@return 0 if no sample is missed or falsely covered, else -1
+*/
+static int CheckLaneSegmentQueries(OpenDrive *od)
+{
+	std::vector<LaneBorderSample> samples;
+	std::map<std::pair<int, int>, std::vector<int> > lane_samples;
+	std::map<std::pair<int, int>, std::vector<int> > cell_samples;  // samples by grid cell of their first point
+	std::vector<RoadLaneSegment> segments;
+	double x_min = LARGE_NUMBER, y_min = LARGE_NUMBER, x_max = -LARGE_NUMBER, y_max = -LARGE_NUMBER;
+	double max_sample_length = 0.0;
+	long long n_inside = 0;
+	long long n_segments = 0;
+	int n_missed = 0;
+	int n_false = 0;
+
+	GetLaneBorderSamples(od, samples, lane_samples);
+	if (samples.size() == 0)
+	{
+		return 0;
+	}
+
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		x_min = MIN(x_min, MIN(samples[i].x[0], samples[i].x[1]));
+		y_min = MIN(y_min, MIN(samples[i].y[0], samples[i].y[1]));
+		x_max = MAX(x_max, MAX(samples[i].x[0], samples[i].x[1]));
+		y_max = MAX(y_max, MAX(samples[i].y[0], samples[i].y[1]));
+		max_sample_length = MAX(max_sample_length, sqrt((samples[i].x[1] - samples[i].x[0]) * (samples[i].x[1] - samples[i].x[0]) +
+			(samples[i].y[1] - samples[i].y[0]) * (samples[i].y[1] - samples[i].y[0])));
+		cell_samples[std::make_pair((int)floor(samples[i].x[0] / LANE_REGION_CHECK_CELL_SIZE),
+			(int)floor(samples[i].y[0] / LANE_REGION_CHECK_CELL_SIZE))].push_back((int)i);
+	}
+
+	std::uniform_real_distribution<double> random_x(x_min, x_max);
+	std::uniform_real_distribution<double> random_y(y_min, y_max);
+	std::uniform_real_distribution<double> random_size(LANE_REGION_CHECK_MIN_SIZE, LANE_REGION_CHECK_MAX_SIZE);
+
+	for (int i = 0; i < 2 * N_LANE_REGION_QUERIES; i++)
+	{
+		// Every other query is a box
+		bool circle = i % 2 == 0;
+		bool include_non_driving = i % 4 < 2;
+		double x = random_x(rng);
+		double y = random_y(rng);
+		double size[2] = { random_size(rng), random_size(rng) };
+		double region_x_min = circle ? x - size[0] : x;
+		double region_y_min = circle ? y - size[0] : y;
+		double region_x_max = x + size[0];
+		double region_y_max = y + (circle ? size[0] : size[1]);
+
+		if (circle)
+		{
+			n_segments += od->GetLaneSegmentsInCircle(x, y, size[0], segments, include_non_driving);
+		}
+		else
+		{
+			n_segments += od->GetLaneSegmentsInBox(x, y, region_x_max, region_y_max, segments, include_non_driving);
+		}
+
+		// Samples inside the region must be covered. Look in cells the region reaches, widened by the sample length.
+		std::vector<int> candidates;
+		for (int cell_x = (int)floor((region_x_min - max_sample_length) / LANE_REGION_CHECK_CELL_SIZE);
+			cell_x <= (int)floor((region_x_max + max_sample_length) / LANE_REGION_CHECK_CELL_SIZE); cell_x++)
+		{
+			for (int cell_y = (int)floor((region_y_min - max_sample_length) / LANE_REGION_CHECK_CELL_SIZE);
+				cell_y <= (int)floor((region_y_max + max_sample_length) / LANE_REGION_CHECK_CELL_SIZE); cell_y++)
+			{
+				std::map<std::pair<int, int>, std::vector<int> >::iterator it = cell_samples.find(std::make_pair(cell_x, cell_y));
+				if (it != cell_samples.end())
+				{
+					candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+				}
+			}
+		}
+
+		for (size_t j = 0; j < candidates.size(); j++)
+		{
+			LaneBorderSample &sample = samples[candidates[j]];
+
+			if ((!include_non_driving && !sample.driving) ||
+				MAX(sample.x[0], sample.x[1]) < region_x_min || MIN(sample.x[0], sample.x[1]) > region_x_max ||
+				MAX(sample.y[0], sample.y[1]) < region_y_min || MIN(sample.y[0], sample.y[1]) > region_y_max)
+			{
+				continue;
+			}
+
+			bool inside = circle ? DistToLineSegment(x, y, sample.x[0], sample.y[0], sample.x[1], sample.y[1]) <= size[0] :
+				LineSegmentInBox(sample.x[0], sample.y[0], sample.x[1], sample.y[1], region_x_min, region_y_min, region_x_max, region_y_max);
+
+			if (!inside)
+			{
+				continue;
+			}
+
+			bool covered = false;
+			for (size_t k = 0; k < segments.size() && !covered; k++)
+			{
+				covered = segments[k].road_id == sample.road_id && segments[k].lane_id == sample.lane_id &&
+					sample.s > segments[k].s_start - LANE_REGION_CHECK_END_ACCURACY && sample.s < segments[k].s_end + LANE_REGION_CHECK_END_ACCURACY;
+			}
+
+			n_inside++;
+			if (!covered)
+			{
+				n_missed++;
+			}
+		}
+
+		// Samples covered by a segment must be inside the region
+		for (size_t j = 0; j < segments.size(); j++)
+		{
+			std::vector<int> &lane = lane_samples[std::make_pair(segments[j].road_id, segments[j].lane_id)];
+
+			for (size_t k = 0; k < lane.size(); k++)
+			{
+				LaneBorderSample &sample = samples[lane[k]];
+
+				if (sample.s <= segments[j].s_start + LANE_REGION_CHECK_END_ACCURACY || sample.s >= segments[j].s_end - LANE_REGION_CHECK_END_ACCURACY)
+				{
+					continue;
+				}
+
+				bool inside = circle ? DistToLineSegment(x, y, sample.x[0], sample.y[0], sample.x[1], sample.y[1]) <= size[0] :
+					LineSegmentInBox(sample.x[0], sample.y[0], sample.x[1], sample.y[1], region_x_min, region_y_min, region_x_max, region_y_max);
+
+				if (!inside || (!include_non_driving && !sample.driving))
+				{
+					n_false++;
+				}
+			}
+		}
+	}
+
+	printf("  lane regions %3d circles %3d boxes, %lld segments, %lld samples inside, %d missed, %d falsely covered\n",
+		N_LANE_REGION_QUERIES, N_LANE_REGION_QUERIES, n_segments, n_inside, n_missed, n_false);
+	if (n_missed > 0 || n_false > 0)
+	{
+		printf("  FAILED: lane segments in region differ from sampled lanes\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+// Max difference of all values filled in by the probe. Lane width is not, neither by single nor multi-distance probes.
+static double GetProbeInfoDiff(RoadProbeInfo &a, RoadProbeInfo &b)
+{
+	RoadLaneInfo &info_a = a.road_lane_info;
+	RoadLaneInfo &info_b = b.road_lane_info;
+	double diff = 0.0;
+
+	for (int i = 0; i < 3; i++)
+	{
+		diff = MAX(diff, fabs(info_a.pos[i] - info_b.pos[i]));
+		diff = MAX(diff, fabs(a.relative_pos[i] - b.relative_pos[i]));
+	}
+	diff = MAX(diff, GetAbsAngleDifference(info_a.heading, info_b.heading));
+	diff = MAX(diff, GetAbsAngleDifference(info_a.pitch, info_b.pitch));
+	diff = MAX(diff, GetAbsAngleDifference(info_a.roll, info_b.roll));
+	diff = MAX(diff, fabs(info_a.curvature - info_b.curvature));
+	diff = MAX(diff, fabs(info_a.speed_limit - info_b.speed_limit));
+	diff = MAX(diff, GetAbsAngleDifference(a.relative_h, b.relative_h));
+
+	return diff;
+}
+
+/**
+Compare the multi-distance Position::GetProbeInfo() and repeated single-distance calls to probing each distance
+on its own, moving a copy of the position from the pivot point as single-distance probes did before. Done from
+random positions in driving lanes, for each look ahead mode.
+@param od Road network to check
+@return 0 if the same points are found with the same values, else -1
+*/
+static int CheckProbeInfo(OpenDrive *od)
+{
+	std::uniform_real_distribution<double> random_01(0.0, 1.0);
+	double distance[N_PROBE_DISTANCES];
+	RoadProbeInfo reference[N_PROBE_DISTANCES];
+	RoadProbeInfo single[N_PROBE_DISTANCES];
+	RoadProbeInfo multi[N_PROBE_DISTANCES];
+	int n_probes = 0;
+	int n_count_diff = 0;
+	int n_partial = 0;
+	double max_diff = 0.0;
+
+	for (int i = 0; i < N_PROBE_DISTANCES; i++)
+	{
+		distance[i] = PROBE_CHECK_FIRST_DISTANCE + i * PROBE_CHECK_DISTANCE_STEP;
+	}
+
+	for (int i = 0; i < N_PROBE_START_POSITIONS; i++)
+	{
+		Road *road = od->GetRoadByIdx((int)(random_01(rng) * od->GetNumOfRoads()) % od->GetNumOfRoads());
+		double s = random_01(rng) * road->GetLength();
+		LaneSection *lane_section = road->GetLaneSectionByS(s);
+		int lane_idx = (int)(random_01(rng) * lane_section->GetNumberOfLanes()) % lane_section->GetNumberOfLanes();
+		int lane_id = lane_section->GetLaneIdByIdx(lane_idx);
+
+		if (lane_id == 0 || !lane_section->GetLaneByIdx(lane_idx)->IsDriving())
+		{
+			i--;
+			continue;
+		}
+
+		Position pos(od);
+		pos.SetLanePos(road->GetId(), lane_id, s, PROBE_CHECK_LANE_OFFSET);
+
+		for (int mode = 0; mode <= (int)Position::LOOKAHEADMODE_AT_CURRENT_LATERAL_OFFSET; mode++)
+		{
+			int n_reference = 0;
+			for (int j = 0; j < N_PROBE_DISTANCES; j++)
+			{
+				Position target(pos);
+
+				// Pivot point of the look ahead mode, see Position::GetProbeInfo()
+				if (mode == Position::LOOKAHEADMODE_AT_ROAD_CENTER)
+				{
+					target.SetTrackPos(target.GetTrackId(), target.GetS(), SMALL_NUMBER * SIGN(pos.GetLaneId()));
+				}
+				else if (mode == Position::LOOKAHEADMODE_AT_LANE_CENTER)
+				{
+					target.SetLanePos(target.GetTrackId(), target.GetLaneId(), target.GetS(), 0.0);
+				}
+
+				if (target.MoveAlongS(distance[j], 0.0, Junction::STRAIGHT) != 0)
+				{
+					break;
+				}
+				pos.GetProbeInfo(&target, &reference[j]);
+				n_reference++;
+			}
+
+			int n_single = 0;
+			while (n_single < N_PROBE_DISTANCES && pos.GetProbeInfo(distance[n_single], &single[n_single], (Position::LookAheadMode)mode) == 0)
+			{
+				n_single++;
+			}
+
+			int n_multi = pos.GetProbeInfo(distance, N_PROBE_DISTANCES, multi, (Position::LookAheadMode)mode);
+
+			n_probes += N_PROBE_DISTANCES;
+			if (n_multi != n_reference || n_single != n_reference)
+			{
+				n_count_diff++;
+				continue;
+			}
+			if (n_multi < N_PROBE_DISTANCES)
+			{
+				n_partial++;
+			}
+			for (int j = 0; j < n_multi; j++)
+			{
+				max_diff = MAX(max_diff, GetProbeInfoDiff(reference[j], multi[j]));
+				max_diff = MAX(max_diff, GetProbeInfoDiff(reference[j], single[j]));
+			}
+		}
+	}
+
+	printf("  probe %6d points, %d reaching road end, %d with other number of points, max diff %.2e\n",
+		n_probes, n_partial, n_count_diff, max_diff);
+	if (n_count_diff > 0 || max_diff > PROBE_CHECK_TOLERANCE)
+	{
+		printf("  FAILED: probe differs from probing each distance from the pivot point\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+Find road and road s at a distance along a route by walking the waypoints from the start, as Position::SetRouteS()
+did before the route segment table
+@return 0 on success, -1 if route_s is beyond the route or the route is broken
+*/
+static int WalkRouteS(Route *route, double route_s, int &road_id, double &road_s)
+{
+	OpenDrive *od = route->waypoint_[0]->GetRoadNetwork();
+	double initial_s_offset = route->GetWayPointDirection(0) > 0 ? route->waypoint_[0]->GetS() :
+		od->GetRoadById(route->waypoint_[0]->GetTrackId())->GetLength() - route->waypoint_[0]->GetS();
+	double route_length = 0.0;
+
+	for (size_t i = 0; i < route->waypoint_.size(); i++)
+	{
+		int direction = route->GetWayPointDirection((int)i);
+		double road_length = od->GetRoadById(route->waypoint_[i]->GetTrackId())->GetLength();
+
+		if (route_s < route_length + road_length - initial_s_offset)
+		{
+			if (direction == 0)
+			{
+				return -1;
+			}
+			road_id = route->waypoint_[i]->GetTrackId();
+			road_s = route_s - route_length + initial_s_offset;
+			if (direction < 0)
+			{
+				road_s = road_length - road_s;
+			}
+			return 0;
+		}
+		route_length += road_length - initial_s_offset;
+		initial_s_offset = 0.0;
+	}
+
+	return -1;
+}
+
+/**
+Find distance along a route of a road position by walking the waypoints from the start, as
+Position::CalcRoutePosition() did before the route segment table
+@return Distance along the route, LARGE_NUMBER if the road is not part of the route or the route is broken
+*/
+static double WalkRoutePosition(Route *route, int road_id, double road_s)
+{
+	OpenDrive *od = route->waypoint_[0]->GetRoadNetwork();
+	double dist = 0.0;
+
+	for (size_t i = 0; i < route->waypoint_.size(); i++)
+	{
+		int direction = route->GetWayPointDirection((int)i);
+		double road_length = od->GetRoadById(route->waypoint_[i]->GetTrackId())->GetLength();
+
+		if (direction == 0)
+		{
+			return LARGE_NUMBER;
+		}
+		if (i == 0)
+		{
+			dist = direction > 0 ? road_length - route->waypoint_[i]->GetS() : route->waypoint_[i]->GetS();
+		}
+		else
+		{
+			dist += road_length;
+		}
+		if (road_id == route->waypoint_[i]->GetTrackId())
+		{
+			return dist - (direction > 0 ? road_length - road_s : road_s);
+		}
+	}
+
+	return LARGE_NUMBER;
+}
+
+/**
+Build a route by driving from a random road, taking random turns in junctions
+@return Number of waypoints
+*/
+static int BuildRandomRoute(OpenDrive *od, Route &route, unsigned int seed)
+{
+	Road *road = od->GetRoadByIdx((int)(rng() % od->GetNumOfRoads()));
+	LaneSection *lane_section = road->GetLaneSectionByIdx(0);
+	int lane_id = 0;
+
+	if (road->GetJunction() != -1 || lane_section == 0)
+	{
+		return 0;
+	}
+
+	for (int i = 0; i < lane_section->GetNumberOfLanes() && lane_id == 0; i++)
+	{
+		if (lane_section->GetLaneByIdx(i)->IsDriving())
+		{
+			lane_id = lane_section->GetLaneIdByIdx(i);
+		}
+	}
+	if (lane_id == 0)
+	{
+		return 0;
+	}
+
+	Position pos(od);
+	pos.SetRandomSeed(seed);
+	pos.SetLanePos(road->GetId(), lane_id, road->GetLength() * 0.3, 0.0);
+	route.AddWaypoint(new Position(pos));
+
+	int road_id = road->GetId();
+	for (int i = 0; i < ROUTE_CHECK_MAX_STEPS && (int)route.waypoint_.size() < ROUTE_CHECK_WAYPOINTS; i++)
+	{
+		// Drive in the direction of the lane
+		if (pos.MoveAlongS(lane_id < 0 ? ROUTE_CHECK_DRIVE_STEP : -ROUTE_CHECK_DRIVE_STEP) != 0)
+		{
+			break;
+		}
+		if (pos.GetTrackId() != road_id && od->GetRoadById(pos.GetTrackId())->GetJunction() == -1)
+		{
+			Position *waypoint = new Position(od);
+			waypoint->SetLanePos(pos.GetTrackId(), pos.GetLaneId(), pos.GetS(), 0.0);
+			if (route.AddWaypoint(waypoint) != 0)
+			{
+				delete waypoint;
+				break;
+			}
+			road_id = pos.GetTrackId();
+			lane_id = pos.GetLaneId();
+		}
+	}
+
+	return (int)route.waypoint_.size();
+}
+
+/**
+Compare the route segment table to walking the waypoints from the start: SetRouteS(), GetSegmentIdxByRouteS() with
+and without hint, route s of road positions (see SetRoute()), and curvature and speed limit along random routes
+@param od Road network to check
+@return 0 if all agree, else -1
+*/
+static int CheckRouteTable(OpenDrive *od)
+{
+	int n_routes = 0;
+	int n_checks = 0;
+	int n_fail = 0;
+	double max_diff = 0.0;
+
+	for (int i = 0; i < N_RANDOM_ROUTES; i++)
+	{
+		Route route;
+
+		if (BuildRandomRoute(od, route, (unsigned int)i) > 1)
+		{
+			double length = route.GetLength();
+			int hint = -1;
+			n_routes++;
+
+			// Curvature is clamped to the route ends
+			if (route.GetCurvatureByRouteS(-ROUTE_CHECK_OUTSIDE) != route.GetCurvatureByRouteS(0.0) ||
+				route.GetCurvatureByRouteS(length + ROUTE_CHECK_OUTSIDE) != route.GetCurvatureByRouteS(length))
+			{
+				n_fail++;
+			}
+
+			for (double route_s = -ROUTE_CHECK_OUTSIDE; route_s < length + ROUTE_CHECK_OUTSIDE; route_s += ROUTE_CHECK_STEP)
+			{
+				Position pos(od);
+				int road_id = 0;
+				double road_s = 0.0;
+				int ret = pos.SetRouteS(&route, route_s);
+
+				n_checks++;
+
+				// Segment search without hint, with last found as hint, and with a bad hint. Like the waypoint walk,
+				// route s before the start is on the first segment.
+				int segment_idx = -1;
+				for (int j = 0; j < route.GetNumberOfSegments() && route_s < length; j++)
+				{
+					RouteSegment *segment = route.GetSegmentByIdx(j);
+					if (route_s < segment->route_s + segment->length)
+					{
+						segment_idx = j;
+						break;
+					}
+				}
+				if (route.GetSegmentIdxByRouteS(route_s) != segment_idx || route.GetSegmentIdxByRouteS(route_s, hint) != segment_idx ||
+					route.GetSegmentIdxByRouteS(route_s, route.GetNumberOfSegments() - 1) != segment_idx)
+				{
+					n_fail++;
+				}
+				hint = segment_idx;
+
+				if (ret != WalkRouteS(&route, route_s, road_id, road_s))
+				{
+					n_fail++;
+					continue;
+				}
+				if (ret != 0)
+				{
+					continue;
+				}
+				if (pos.GetTrackId() != road_id || segment_idx < 0)
+				{
+					n_fail++;
+					continue;
+				}
+				max_diff = MAX(max_diff, fabs(pos.GetS() - road_s));
+
+				// And back again
+				pos.SetRoute(&route);
+				max_diff = MAX(max_diff, fabs(pos.GetRouteS() - WalkRoutePosition(&route, pos.GetTrackId(), pos.GetS())));
+
+				// Curvature in route direction and speed limit of the road just ahead, clamped before the route (see above)
+				if (route_s < 0.0)
+				{
+					continue;
+				}
+				RouteSegment *segment = route.GetSegmentByIdx(segment_idx);
+				Road *road = od->GetRoadById(pos.GetTrackId());
+				max_diff = MAX(max_diff, fabs(route.GetCurvatureByRouteS(route_s) - segment->direction * pos.GetCurvature()));
+				max_diff = MAX(max_diff, fabs(route.GetSpeedLimitByRouteS(route_s) - road->GetSpeedByS(pos.GetS() + segment->direction * SMALL_NUMBER)));
+			}
+		}
+
+		for (size_t j = 0; j < route.waypoint_.size(); j++)
+		{
+			delete route.waypoint_[j];
+		}
+	}
+
+	printf("  route %3d routes %6d route s values, max diff %.2e, %d failed\n", n_routes, n_checks, max_diff, n_fail);
+	if (n_fail > 0 || max_diff > ROUTE_CHECK_TOLERANCE)
+	{
+		printf("  FAILED: route segment table differs from walking the waypoints\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+Compare the compiled road network to the object model it was built from: geometries, lane offset, elevation and
+center offset of each lane, sampled along each road. With RM_COMPACT_STORAGE the compiled values are single
+precision, which gives the accuracy lost by compact storage.
+@param od Road network to check
+@return 0 if all differences are within tolerance, else -1
+*/
+static int CheckCompiledStorage(OpenDrive *od)
+{
+	CompiledOpenDrive *compiled = od->GetCompiled();
+	double max_pos_diff = 0.0;
+	double max_heading_diff = 0.0;
+	double max_offset_diff = 0.0;
+	double max_z_diff = 0.0;
+	int n_samples = 0;
+
+	if (compiled == 0)
+	{
+		printf("  FAILED: road network not compiled\n");
+		return -1;
+	}
+
+	for (int i = 0; i < od->GetNumOfRoads(); i++)
+	{
+		Road *road = od->GetRoadByIdx(i);
+		CompiledOpenDrive::RoadRecord *road_record = compiled->GetRoad(i);
+
+		for (int j = 0; j < road->GetNumberOfGeometries(); j++)
+		{
+			Geometry *geom = road->GetGeometry(j);
+			CompiledOpenDrive::GeometryRecord *geom_record = compiled->GetGeometry(i, j);
+
+			for (int k = 0; k < N_SAMPLES; k++)
+			{
+				double ds = geom->GetLength() * k / (N_SAMPLES - 1);
+				double x, y, h, x_ref, y_ref, h_ref;
+
+				compiled->EvaluateGeometryDS(road_record, geom_record, ds, &x, &y, &h);
+				geom->EvaluateDS(ds, &x_ref, &y_ref, &h_ref);
+				max_pos_diff = MAX(max_pos_diff, sqrt((x - x_ref) * (x - x_ref) + (y - y_ref) * (y - y_ref)));
+				max_heading_diff = MAX(max_heading_diff, GetAbsAngleDifference(h, h_ref));
+			}
+		}
+
+		for (double s = 0.0; s < road->GetLength(); s += COMPILED_CHECK_STEP)
+		{
+			double z, pitch, z_ref, pitch_ref;
+			int index = 0;
+			int index_ref = 0;
+
+			n_samples++;
+
+			max_offset_diff = MAX(max_offset_diff, fabs(compiled->GetLaneOffset(i, s) - road->GetLaneOffset(s)));
+			max_heading_diff = MAX(max_heading_diff, fabs(compiled->GetLaneOffsetPrim(i, s) - road->GetLaneOffsetPrim(s)));
+
+			bool found = compiled->GetZAndPitchByS(i, s, &z, &pitch, &index);
+			if (found != road->GetZAndPitchByS(s, &z_ref, &pitch_ref, &index_ref))
+			{
+				printf("  FAILED: road %d s %.2f elevation found in only one of compiled and object model\n", road->GetId(), s);
+				return -1;
+			}
+			if (found)
+			{
+				max_z_diff = MAX(max_z_diff, fabs(z - z_ref));
+				max_heading_diff = MAX(max_heading_diff, fabs(pitch - pitch_ref));
+			}
+
+			int lane_section_idx = road->GetLaneSectionIdxByS(s);
+			LaneSection *lane_section = road->GetLaneSectionByIdx(lane_section_idx);
+			if (lane_section == 0 || compiled->GetLaneSectionIdxByS(i, s) != lane_section_idx)
+			{
+				printf("  FAILED: road %d s %.2f lane section differs between compiled and object model\n", road->GetId(), s);
+				return -1;
+			}
+
+			CompiledOpenDrive::LaneSectionRecord *lane_section_record = compiled->GetLaneSection(i, lane_section_idx);
+			for (int k = 0; k < lane_section->GetNumberOfLanes(); k++)
+			{
+				int lane_id = lane_section->GetLaneIdByIdx(k);
+
+				max_offset_diff = MAX(max_offset_diff,
+					fabs(compiled->GetCenterOffset(lane_section_record, s, lane_id) - lane_section->GetCenterOffset(s, lane_id)));
+				max_heading_diff = MAX(max_heading_diff,
+					fabs(compiled->GetCenterOffsetHeading(lane_section_record, s, lane_id) - lane_section->GetCenterOffsetHeading(s, lane_id)));
+			}
+		}
+	}
+
+	printf("  compiled %7d samples, max diff position %.2e m heading %.2e rad lane offset %.2e m z %.2e m\n",
+		n_samples, max_pos_diff, max_heading_diff, max_offset_diff, max_z_diff);
+	if (max_pos_diff > COMPILED_CHECK_TOLERANCE || max_heading_diff > COMPILED_CHECK_TOLERANCE ||
+		max_offset_diff > COMPILED_CHECK_TOLERANCE || max_z_diff > COMPILED_CHECK_TOLERANCE)
+	{
+		printf("  FAILED: compiled road network differs from object model\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int n_failed = 0;
+
+	if (argc < 2)
+	{
+		printf("Usage: OdrCheck <OpenDRIVE filename> [<OpenDRIVE filename> ...]\n");
+		return -1;
+	}
+
+	printf("synthetic geometries:\n");
+	if (CheckBatchEvaluation(0) != 0 || CheckSpiralTables(0) != 0)
+	{
+		n_failed++;
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		OpenDrive od;
+
+		// Check the parsed network, not a binary cache of it
+		od.SetBinaryCacheEnabled(false);
+
+		if (!od.LoadOpenDriveFile(argv[i]))
+		{
+			printf("%s: failed to load\n", argv[i]);
+			n_failed++;
+			continue;
+		}
+
+		printf("%s:\n", argv[i]);
+		if (CheckBatchEvaluation(&od) != 0 || CheckSpiralTables(&od) != 0 || CheckRoadPaths(&od) != 0 ||
+			CheckBatchProjection(&od) != 0 || CheckLaneSegmentQueries(&od) != 0 ||
+			CheckProbeInfo(&od) != 0 || CheckRouteTable(&od) != 0 ||
+			CheckCompiledStorage(&od) != 0)
+		{
+			n_failed++;
+		}
+	}
+
+	return n_failed > 0 ? -1 : 0;
+}
@@ -21,6 +21,7 @@
 #include <cmath>
 #include <iostream>
 #include <fstream>
+#include <vector>
 #include "RoadManager.hpp"
 #include "CommonMini.hpp"
 
@@ -28,6 +29,38 @@ using namespace roadmanager;
 
 //#define REF_ONLY
 
+/**
+Evaluate the reference line of a road at a number of s values, one batch call per geometry
+@param road The road
+@param s Distances along the road, in increasing order
+@param n Number of values
+@param x Receives X coordinate per value
+@param y Receives Y coordinate per value
+@param h Receives heading per value
+*/
+static void EvaluateReferenceLine(Road *road, const double *s, int n, double *x, double *y, double *h)
+{
+	std::vector<double> ds(n);
+	int geom_idx = 0;
+
+	for (int i = 0; i < n;)
+	{
+		// Same geometry as chosen by Position, for the whole run of values on it
+		geom_idx = road->GetGeometryIdxByS(s[i], geom_idx);
+		Geometry *geom = road->GetGeometry(geom_idx);
+		int n_run = 0;
+
+		while (i + n_run < n && road->GetGeometryIdxByS(s[i + n_run], geom_idx) == geom_idx)
+		{
+			ds[n_run] = s[i + n_run] - geom->GetS();
+			n_run++;
+		}
+
+		geom->EvaluateDSBatch(ds.data(), n_run, &x[i], &y[i], &h[i]);
+		i += n_run;
+	}
+}
+
 int main(int argc, char *argv[])
 {
 	if (argc < 2)
@@ -46,9 +79,9 @@ int main(int argc, char *argv[])
 	std::ofstream file;
 	file.open("track.csv");
 
-	Position* pos = new Position();
 	double step_length_target = 1;
 	OpenDrive *od = Position::GetOpenDrive();
+	std::vector<double> s, x, y, h, z, lane_offset, lane_offset_prim;
 
 	for (int r = 0; r < od->GetNumOfRoads(); r++)
 	{
@@ -58,9 +91,39 @@ int main(int argc, char *argv[])
 		{
 			LaneSection *lane_section = road->GetLaneSectionByIdx(i);
 			double s_start = lane_section->GetS();
-			double s_end = s_start + lane_section->GetLength();
+			double s_end = MIN(s_start + lane_section->GetLength(), road->GetLength());
 			int steps = (int)((s_end - s_start) / step_length_target);
 			double step_length = steps > 0 ? (s_end - s_start) / steps : s_end - s_start;
+			int n = steps + 1;
+
+			// Reference line, lane offset and elevation are the same for all lanes of the section
+			s.resize(n);
+			x.resize(n);
+			y.resize(n);
+			h.resize(n);
+			z.resize(n);
+			lane_offset.resize(n);
+			lane_offset_prim.resize(n);
+
+			for (int k = 0; k < n; k++)
+			{
+				s[k] = MIN(s_end, s_start + k * step_length);
+			}
+
+			EvaluateReferenceLine(road, s.data(), n, x.data(), y.data(), h.data());
+
+			int elevation_idx = 0;
+			for (int k = 0; k < n; k++)
+			{
+				double pitch;
+
+				lane_offset[k] = road->GetLaneOffset(s[k]);
+				lane_offset_prim[k] = road->GetLaneOffsetPrim(s[k]);
+				if (!road->GetZAndPitchByS(s[k], &z[k], &pitch, &elevation_idx))
+				{
+					z[k] = 0.0;
+				}
+			}
 
 #ifdef REF_ONLY
 			Lane *lane = lane_section->GetLaneById(0);
@@ -73,12 +136,17 @@ int main(int argc, char *argv[])
 					continue;
 				}
 #endif
+				int sign = lane->GetId() < 0 ? -1 : 1;
 
 				file << "lane, " << road->GetId() << ", " << i << ", " << lane->GetId() << std::endl;
-				for (int k = 0; k < steps + 1; k++)
+				for (int k = 0; k < n; k++)
 				{
-					pos->SetLanePos(road->GetId(), lane->GetId(), MIN(s_end, s_start + k * step_length), 0, i);
-					file << pos->GetX() << ", " << pos->GetY() << ", " << pos->GetZ() << ", " << pos->GetH() << std::endl;
+					// Lane center, as in Position::Lane2Track() and Track2XYZ()
+					double t = lane_section->GetCenterOffset(s[k], lane->GetId()) * sign;
+					double heading = h[k] + atan(lane_offset_prim[k]) + lane_section->GetCenterOffsetHeading(s[k], lane->GetId()) * sign;
+
+					file << x[k] + (t + lane_offset[k]) * cos(h[k] + M_PI_2) << ", " << y[k] + (t + lane_offset[k]) * sin(h[k] + M_PI_2) <<
+						", " << z[k] << ", " << heading << std::endl;
 				}
 #ifndef REF_ONLY
 			}
@@ -89,7 +157,5 @@ int main(int argc, char *argv[])
 	file.close();
 //	od->Print();
 
-	delete pos;
-
 	return 0;
-}
\ No newline at end of file
+}
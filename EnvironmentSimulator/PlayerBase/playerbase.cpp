@@ -409,6 +409,9 @@ int ScenarioPlayer::Init()
 	opt.AddOption("server", "Launch server to receive state of external Ego simulator");
 	opt.AddOption("fixed_timestep", "Run simulation decoupled from realtime, with specified timesteps", "timestep");
 	opt.AddOption("ghost_headstart", "Launch Ego ghost at specified headstart time", "time");
+	opt.AddOption("road_memory_budget", "Load road data on demand, keeping roads in memory up to approximately this size (MB)", "size");
+	opt.AddOption("road_landmarks", "Precompute road distance tables from this many landmark roads, speeds up road distance queries on large road networks", "number");
+	opt.AddOption("seed", "Seed for random number streams, e.g. random junction selection (default 0)", "number");
 
 	if (argc_ < 3)
 	{
@@ -469,6 +472,12 @@ int ScenarioPlayer::Init()
 		LOG("Any ghosts will be launched with headstart %.2f seconds (default)", ghost_headstart);
 	}
 
+	if ((arg_str = opt.GetOptionArg("road_memory_budget")) != "")
+	{
+		roadmanager::Position::GetOpenDrive()->SetTiledLoading((size_t)(atof(arg_str.c_str()) * 1024 * 1024));
+		LOG("Tiled road loading, memory budget %s MB", arg_str.c_str());
+	}
+
 	// Create scenario engine
 	try
 	{
@@ -486,9 +495,27 @@ int ScenarioPlayer::Init()
 		return -1;
 	}
 
+	if ((arg_str = opt.GetOptionArg("seed")) != "")
+	{
+		scenarioEngine->SetRandomSeed((unsigned int)strtoul(arg_str.c_str(), 0, 10));
+		LOG("Random seed %u", scenarioEngine->GetRandomSeed());
+	}
+
 	// Fetch scenario gateway and OpenDRIVE manager objects
 	scenarioGateway = scenarioEngine->getScenarioGateway();
 	odr_manager = scenarioEngine->getRoadManager();
+
+	if ((arg_str = opt.GetOptionArg("road_landmarks")) != "")
+	{
+		if (odr_manager->ComputeLandmarks(atoi(arg_str.c_str())) != 0)
+		{
+			LOG("Failed to compute road distance tables");
+		}
+		else
+		{
+			LOG("Road distance tables computed for %d landmarks", odr_manager->GetNumberOfLandmarks());
+		}
+	}
 	
 	// Create a data file for later replay?
 	if ((arg_str = opt.GetOptionArg("record")) != "")
@@ -47,17 +47,27 @@
 #include <iostream>
 #include <cstring>
 #include <random>
-#include <time.h>
 #include <limits>
-
+#include <algorithm>
+#include <queue>
+#include <cstdio>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
 
 #include "RoadManager.hpp"
 #include "odrSpiral.h"
 #include "pugixml.hpp"
 #include "CommonMini.hpp"
 
-static std::mt19937 mt_rand;
-
 using namespace std;
 using namespace roadmanager;
 
@@ -66,8 +76,79 @@ using namespace roadmanager;
 #define MIN(x, y) (y < x ? y : x)
 #define CLAMP(x, a, b) (MIN(MAX(x, a), b))
 #define MAX_TRACK_DIST 10
+#define GEOMETRY_BBOX_SAMPLE_DIST 2.0  // max distance between geometry samples when calculating bounding boxes
+#define GEOMETRY_BBOX_MARGIN 0.5  // covers curve deviation from straight line in between samples
+#define XYZ_SEARCH_RADIUS 25.0  // initial search radius for world to road coordinate mapping
+#define PROJECTION_MAX_ITERATIONS 10  // max Newton iterations when projecting a point on a road geometry
+#define PROJECTION_TOLERANCE 1e-6  // max longitudinal distance between a point and its projection
+#define PROJECTION_MIN_DERIVATIVE 0.1  // give up projection close to the center of curvature, where it is ambiguous
+#define PROJECTION_MAX_GEOMETRY_STEPS 4  // geometries visited per road in incremental world to road mapping
+#define PROJECTION_BATCH_BLOCK_SIZE 1024  // consecutive points mapped incrementally by one thread in batch mapping
+#define SPIRAL_TABLE_TOLERANCE 1e-10  // max position error of interpolated spiral points
+#define SPIRAL_TABLE_MAX_NODES 10000
+#define TESSELLATION_HEADING_ARM 10.0  // lateral distance at which heading errors are converted into position errors
+#define TESSELLATION_MAX_STEP 50.0  // max distance between road samples
+#define TESSELLATION_MAX_DEPTH 20  // max number of times a sample interval is halved
+#define TESSELLATION_CHECK_POINTS 8  // number of sub intervals checked per sample interval when measuring the error
+#define HEIGHT_GRID_BLOCK_SIZE 16  // nodes per side of the memory blocks of the height grid
+#define HEIGHT_GRID_MARGIN 1.5  // height grid nodes within this many cells outside the road edges are included
+#define HEIGHT_GRID_MAX_HEIGHT_DIFF 0.5  // roads overlapping with a larger height difference are left out of the height grid
+#define TILE_KEEP_DIST 200.0  // in tiled mode, roads closer than this to any entity are never unloaded
+#define ROAD_PATH_CACHE_SIZE 1000  // default max number of road pairs in the path cache
+#define LANE_VALUE_BUFFER_SIZE 64  // lanes per lane section handled without heap allocation
+#define REGION_QUERY_MAX_STEP 1.0  // max distance between lane samples in region queries
+#define REGION_QUERY_MIN_STEP 0.1  // min distance between lane samples, limits the effort for tiny regions
+#define REGION_QUERY_REFINE_STEPS 10  // number of times the interval containing a lane part end is halved
+#define REGION_QUERY_MAX_BORDER_SPEED 3.0  // max lateral displacement of a lane border per meter along the road
+#define REGION_QUERY_END_ACCURACY 0.02  // smallest step close to a region, lane parts shorter than this might be missed
+#define ARENA_ALIGNMENT 16  // alignment of arena allocations, enough for any type used in the road network
+#define ARENA_MIN_BLOCK_SIZE 4096  // first block of an arena, following blocks double in size...
+#define ARENA_MAX_BLOCK_SIZE 262144  // ...up to this size
+#define BINARY_CACHE_MAGIC "ODRCACHE"
+#define BINARY_CACHE_VERSION 2  // increase whenever the cache layout or the loaded object model changes
+
+
+
+void *Arena::Allocate(size_t size)
+{
+	size = (size + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1);
+	used_ += size;
+
+	if (size > ARENA_MAX_BLOCK_SIZE / 4)
+	{
+		// Big allocation, give it a block of its own and keep filling the current one
+		char *block = new char[size];
+		block_.insert(block_size_ > 0 ? block_.end() - 1 : block_.end(), block);
+		reserved_ += size;
+		return block;
+	}
+
+	if (block_used_ + size > block_size_)
+	{
+		block_size_ = MIN(MAX(2 * block_size_, ARENA_MIN_BLOCK_SIZE), ARENA_MAX_BLOCK_SIZE);
+		block_.push_back(new char[block_size_]);
+		block_used_ = 0;
+		reserved_ += block_size_;
+	}
+
+	void *ptr = block_.back() + block_used_;
+	block_used_ += size;
 
+	return ptr;
+}
 
+void Arena::Clear()
+{
+	for (size_t i = 0; i < block_.size(); i++)
+	{
+		delete[] block_[i];
+	}
+	block_.clear();
+	block_used_ = 0;
+	block_size_ = 0;
+	reserved_ = 0;
+	used_ = 0;
+}
 
 double Polynomial::Evaluate(double s)
 {
@@ -90,6 +171,24 @@ double Polynomial::EvaluatePrimPrim(double s)
 	return (2 * c_ + 6 * p*d_);
 }
 
+void Polynomial::EvaluateBatch(const double *s, int n, double *result)
+{
+	for (int i = 0; i < n; i++)
+	{
+		double p = s[i] * p_scale_;
+		result[i] = (a_ + p * b_ + p * p*c_ + p * p*p*d_);
+	}
+}
+
+void Polynomial::EvaluatePrimBatch(const double *s, int n, double *result)
+{
+	for (int i = 0; i < n; i++)
+	{
+		double p = s[i] * p_scale_;
+		result[i] = (b_ + 2 * p*c_ + 3 * p*p*d_);
+	}
+}
+
 void Polynomial::Set(double a, double b, double c, double d, double p_scale)
 {
 	a_ = a;
@@ -110,6 +209,14 @@ void Geometry::EvaluateDS(double ds, double *x, double *y, double *h)
 	LOG("Geometry virtual Evaluate\n");
 }
 
+void Geometry::EvaluateDSBatch(const double *ds, int n, double *x, double *y, double *h)
+{
+	for (int i = 0; i < n; i++)
+	{
+		EvaluateDS(ds[i], &x[i], &y[i], &h[i]);
+	}
+}
+
 void Line::Print()
 {
 	LOG("Line x: %.2f, y: %.2f, h: %.2f length: %.2f\n", GetX(), GetY(), GetHdg(), GetLength());
@@ -122,6 +229,22 @@ void Line::EvaluateDS(double ds, double *x, double *y, double *h)
 	*y = GetY() + ds * sin(*h);
 }
 
+void Line::EvaluateDSBatch(const double *ds, int n, double *x, double *y, double *h)
+{
+	double x0 = GetX();
+	double y0 = GetY();
+	double hdg = GetHdg();
+	double cos_h = cos(hdg);
+	double sin_h = sin(hdg);
+
+	for (int i = 0; i < n; i++)
+	{
+		x[i] = x0 + ds[i] * cos_h;
+		y[i] = y0 + ds[i] * sin_h;
+		h[i] = hdg;
+	}
+}
+
 void Arc::Print()
 {
 	LOG("Arc x: %.2f, y: %.2f, h: %.2f curvature: %.2f length: %.2f\n", GetX(), GetY(), GetHdg(), curvature_, GetLength());
@@ -155,12 +278,137 @@ void Arc::EvaluateDS(double ds, double *x, double *y, double *h)
 	*h = GetHdg() + angle;
 }
 
+void Arc::EvaluateDSBatch(const double *ds, int n, double *x, double *y, double *h)
+{
+	double x0 = GetX();
+	double y0 = GetY();
+	double hdg = GetHdg();
+	double cos_h = cos(hdg);
+	double sin_h = sin(hdg);
+	double radius = GetRadius();
+	// See EvaluateDS(), start at 90 degrees going clockwise or at -90 degrees going counter clockwise
+	double angle_start = curvature_ < 0 ? M_PI / 2.0 : 3.0 * M_PI / 2.0;
+	double y_shift = curvature_ < 0 ? -1 : 1;
+
+	// cos() and sin() per point, not vectorized. An angle addition recurrence would avoid them, but only for
+	// evenly spaced ds and at the cost of drifting from EvaluateDS().
+	for (int i = 0; i < n; i++)
+	{
+		double angle = ds[i] * curvature_;
+		double x_local = cos(angle + angle_start);
+		double y_local = sin(angle + angle_start) + y_shift;
+
+		x[i] = x0 + radius * (x_local * cos_h - y_local * sin_h);
+		y[i] = y0 + radius * (x_local * sin_h + y_local * cos_h);
+		h[i] = hdg + angle;
+	}
+}
+
 void Spiral::Print()
 {
 	LOG("Spiral x: %.2f, y: %.2f, h: %.2f start curvature: %.4f end curvature: %.4f length: %.2f\n",
 		GetX(), GetY(), GetHdg(), GetCurvStart(), GetCurvEnd(), GetLength());
 }
 
+void SpiralTable::Set(double s_start, double step, double c_dot, const double *node, int n_nodes)
+{
+	s_start_ = s_start;
+	step_ = step;
+	c_dot_ = c_dot;
+	node_.assign(node, node + 4 * n_nodes);
+}
+
+int SpiralTable::Build(double s_start, double s_end, double c_dot, double tolerance, int max_nodes)
+{
+	node_.clear();
+
+	if (s_end - s_start < SMALL_NUMBER)
+	{
+		return -1;
+	}
+
+	// Max magnitude of the 6th derivative of x(s) and y(s), given curvature k = c_dot * s
+	// d5/ds5 cos(t(s)), with t' = k, t'' = c_dot and higher derivatives 0
+	double c = fabs(c_dot);
+	double k = c * MAX(fabs(s_start), fabs(s_end));
+	double d6 = k * k * k * k * k + 10 * k * k * k * c + 15 * k * c * c;
+
+	// Error of quintic Hermite interpolation is at most d6 * step^6 / 46080
+	int n_intervals = 1;
+	if (d6 > 0)
+	{
+		n_intervals = MAX(1, (int)ceil((s_end - s_start) / pow(46080 * tolerance / d6, 1.0 / 6)));
+	}
+	if (n_intervals + 1 > max_nodes)
+	{
+		return -1;
+	}
+
+	s_start_ = s_start;
+	step_ = (s_end - s_start) / n_intervals;
+	c_dot_ = c_dot;
+	node_.reserve(4 * (n_intervals + 1));
+
+	for (int i = 0; i < n_intervals + 1; i++)
+	{
+		double x, y, t;
+
+		odrSpiral(s_start_ + i * step_, c_dot_, &x, &y, &t);
+		node_.push_back(x);
+		node_.push_back(y);
+		node_.push_back(cos(t));
+		node_.push_back(sin(t));
+	}
+
+	return 0;
+}
+
+void SpiralTable::Interpolate(const double *node, int n_nodes, double s_start, double step, double c_dot, double s, double *x, double *y, double *t)
+{
+	double u = (s - s_start) / step;
+	int i = u < 0 ? 0 : MIN((int)u, n_nodes - 2);
+	double tau = u - i;
+	const double *n0 = &node[4 * i];
+	const double *n1 = n0 + 4;
+
+	// Derivatives at the nodes, scaled by step: tangent (cos t, sin t) and curvature times normal (-sin t, cos t)
+	double k0 = c_dot * (s_start + i * step) * step;
+	double k1 = c_dot * (s_start + (i + 1) * step) * step;
+
+	// Quintic Hermite basis functions
+	double tau2 = tau * tau;
+	double tau3 = tau2 * tau;
+	double tau4 = tau3 * tau;
+	double tau5 = tau4 * tau;
+	double h0 = 1 - 10 * tau3 + 15 * tau4 - 6 * tau5;
+	double h1 = (tau - 6 * tau3 + 8 * tau4 - 3 * tau5) * step;
+	double h2 = 0.5 * (tau2 - 3 * tau3 + 3 * tau4 - tau5) * step;
+	double h3 = 0.5 * (tau3 - 2 * tau4 + tau5) * step;
+	double h4 = (-4 * tau3 + 7 * tau4 - 3 * tau5) * step;
+	double h5 = 10 * tau3 - 15 * tau4 + 6 * tau5;
+
+	*x = h0 * n0[0] + h1 * n0[2] - h2 * k0 * n0[3] - h3 * k1 * n1[3] + h4 * n1[2] + h5 * n1[0];
+	*y = h0 * n0[1] + h1 * n0[3] + h2 * k0 * n0[2] + h3 * k1 * n1[2] + h4 * n1[3] + h5 * n1[1];
+	*t = s * s * c_dot * 0.5;
+}
+
+void Spiral::BuildTable()
+{
+	table_.Build(s0_, s0_ + GetLength(), c_dot_, SPIRAL_TABLE_TOLERANCE, SPIRAL_TABLE_MAX_NODES);
+}
+
+void Spiral::EvaluateStandardSpiral(double s, double *x, double *y, double *t)
+{
+	if (table_.IsEmpty())
+	{
+		odrSpiral(s, GetCDot(), x, y, t);
+	}
+	else
+	{
+		table_.Evaluate(s, x, y, t);
+	}
+}
+
 void Spiral::EvaluateDS(double ds, double *x, double *y, double *h)
 {
 	double xTmp, yTmp, t, curv_a, curv_b, h_start;
@@ -171,15 +419,15 @@ void Spiral::EvaluateDS(double ds, double *x, double *y, double *h)
 
 	if (abs(curv_b) > abs(curv_a))
 	{
-		odrSpiral(ds + GetS0(), GetCDot(), &xTmp, &yTmp, &t);
+		EvaluateStandardSpiral(ds + GetS0(), &xTmp, &yTmp, &t);
 		*h = t;
 	}
 	else  // backwards, starting from sharper curve - ending with lower curvature
 	{
 		double x0, y0, t0, x1, y1, t1;
 
-		odrSpiral(GetS0() + GetLength(), GetCDot(), &x0, &y0, &t0);
-		odrSpiral(GetS0() + GetLength() - ds, GetCDot(), &x1, &y1, &t1);
+		EvaluateStandardSpiral(GetS0() + GetLength(), &x0, &y0, &t0);
+		EvaluateStandardSpiral(GetS0() + GetLength() - ds, &x1, &y1, &t1);
 
 		xTmp = x0 - x1;
 		yTmp = y0 - y1;
@@ -204,6 +452,55 @@ void Spiral::EvaluateDS(double ds, double *x, double *y, double *h)
 	*y = GetY() + x2 * sin(h_start) + y2 * cos(h_start);
 }
 
+void Spiral::EvaluateDSBatch(const double *ds, int n, double *x, double *y, double *h)
+{
+	bool forward = abs(GetCurvEnd()) > abs(GetCurvStart());
+	double x_end = 0, y_end = 0, t_end = 0;
+	double h_start = GetHdg();
+
+	// Same calculations as EvaluateDS(), but with the spiral end point and all rotations evaluated once
+	if (!forward)
+	{
+		EvaluateStandardSpiral(GetS0() + GetLength(), &x_end, &y_end, &t_end);
+		h_start -= t_end;
+	}
+
+	double cos_h0 = cos(-GetH0());
+	double sin_h0 = sin(-GetH0());
+	double cos_h_start = cos(h_start);
+	double sin_h_start = sin(h_start);
+
+	for (int i = 0; i < n; i++)
+	{
+		double xTmp, yTmp, t;
+
+		if (forward)
+		{
+			EvaluateStandardSpiral(ds[i] + GetS0(), &xTmp, &yTmp, &t);
+			h[i] = t;
+		}
+		else
+		{
+			double x1, y1, t1;
+
+			EvaluateStandardSpiral(GetS0() + GetLength() - ds[i], &x1, &y1, &t1);
+			xTmp = x_end - x1;
+			yTmp = y_end - y1;
+			h[i] = t1 - t_end;
+		}
+
+		h[i] += GetHdg() - GetH0();
+
+		double x1 = xTmp - GetX0();
+		double y1 = yTmp - GetY0();
+		double x2 = x1 * cos_h0 - y1 * sin_h0;
+		double y2 = x1 * sin_h0 + y1 * cos_h0;
+
+		x[i] = GetX() + x2 * cos_h_start - y2 * sin_h_start;
+		y[i] = GetY() + x2 * sin_h_start + y2 * cos_h_start;
+	}
+}
+
 double Spiral::EvaluateCurvatureDS(double ds)
 {
 	return (curv_start_ + (ds / GetLength())* (curv_end_ - curv_start_));
@@ -227,6 +524,31 @@ void Poly3::EvaluateDS(double ds, double *x, double *y, double *h)
 	*h = GetHdg() + poly3_.EvaluatePrim(p);
 }
 
+void Poly3::EvaluateDSBatch(const double *ds, int n, double *x, double *y, double *h)
+{
+	double x0 = GetX();
+	double y0 = GetY();
+	double hdg = GetHdg();
+	double cos_h = cos(hdg);
+	double sin_h = sin(hdg);
+	double length = GetLength();
+	double umax = GetUMax();
+	double a = poly3_.GetA();
+	double b = poly3_.GetB();
+	double c = poly3_.GetC();
+	double d = poly3_.GetD();
+
+	for (int i = 0; i < n; i++)
+	{
+		double p = (ds[i] / length) * umax;
+		double v_local = (a + p * b + p * p*c + p * p*p*d);
+
+		x[i] = x0 + p * cos_h - v_local * sin_h;
+		y[i] = y0 + p * sin_h + v_local * cos_h;
+		h[i] = hdg + (b + 2 * p*c + 3 * p*p*d);
+	}
+}
+
 double Poly3::EvaluateCurvatureDS(double ds)
 {
 	return poly3_.EvaluatePrimPrim(ds);
@@ -251,6 +573,37 @@ void ParamPoly3::EvaluateDS(double ds, double *x, double *y, double *h)
 	*h = GetHdg() + atan2(poly3V_.EvaluatePrim(ds), poly3U_.EvaluatePrim(ds));
 }
 
+void ParamPoly3::EvaluateDSBatch(const double *ds, int n, double *x, double *y, double *h)
+{
+	double x0 = GetX();
+	double y0 = GetY();
+	double hdg = GetHdg();
+	double cos_h = cos(hdg);
+	double sin_h = sin(hdg);
+
+	// Polynomials straight into output arrays, u and v in x and y, their derivatives in h and a temporary array
+	std::vector<double> v_prim(n);
+	poly3U_.EvaluateBatch(ds, n, x);
+	poly3V_.EvaluateBatch(ds, n, y);
+	poly3U_.EvaluatePrimBatch(ds, n, h);
+	poly3V_.EvaluatePrimBatch(ds, n, v_prim.data());
+
+	for (int i = 0; i < n; i++)
+	{
+		double u_local = x[i];
+		double v_local = y[i];
+
+		x[i] = x0 + u_local * cos_h - v_local * sin_h;
+		y[i] = y0 + u_local * sin_h + v_local * cos_h;
+	}
+
+	// atan2 is the only part not vectorized
+	for (int i = 0; i < n; i++)
+	{
+		h[i] = hdg + atan2(v_prim[i], h[i]);
+	}
+}
+
 double ParamPoly3::EvaluateCurvatureDS(double ds)
 {
 	return poly3V_.EvaluatePrimPrim(ds) / poly3U_.EvaluatePrim(ds);
@@ -267,20 +620,37 @@ void LaneLink::Print()
 	LOG("LaneLink type: %d id: %d\n", type_, id_);
 }
 
-LaneWidth *Lane::GetWidthByS(double s)
+int SIndex::Find(double s, int hint)
 {
-	if (lane_width_.size() == 0)
+	int n = (int)s_.size();
+
+	if (n == 0)
 	{
-		return 0;  // No lanewidth defined
+		return -1;
 	}
-	for (int i=0; i+1<(int)lane_width_.size(); i++)
+
+	// Fast path: hint still valid, or we just moved into the next record
+	for (int i = hint; i >= 0 && i < n && i < hint + 2; i++)
 	{
-		if (s < lane_width_[i + 1]->GetSOffset())
+		if ((i == 0 || s >= s_[i]) && (i == n - 1 || s < s_[i + 1]))
 		{
-			return lane_width_[i];
+			return i;
 		}
 	}
-	return lane_width_.back();
+
+	int idx = (int)(std::upper_bound(s_.begin(), s_.end(), s) - s_.begin()) - 1;
+
+	return idx < 0 ? 0 : idx;
+}
+
+LaneWidth *Lane::GetWidthByS(double s)
+{
+	if (lane_width_.size() == 0)
+	{
+		return 0;  // No lanewidth defined
+	}
+
+	return lane_width_[width_index_.Find(s)];
 }
 
 LaneLink *Lane::GetLink(LinkType type)
@@ -372,40 +742,12 @@ LaneSection* Road::GetLaneSectionByIdx(int idx)
 
 int Road::GetLaneSectionIdxByS(double s, int start_at)
 {
-	if (start_at < 0 || start_at > lane_section_.size() - 1)
+	if (start_at < 0 || start_at > (int)lane_section_.size() - 1)
 	{
 		return -1;
 	}
 
-	LaneSection *lane_section = lane_section_[start_at];
-	size_t i = start_at;
-
-	if (s < lane_section->GetS() && start_at > 0)  
-	{
-		// Look backwards
-		for (i = start_at - 1; i > 0; i--)  // No need to check the first one
-		{
-			lane_section = GetLaneSectionByIdx((int)i);
-			if (s > lane_section->GetS())
-			{
-				break;
-			}
-		}
-	}
-	else  
-	{
-		// look forward
-		for (i = start_at; i < GetNumberOfLaneSections()-1; i++) // No need to check the last one 
-		{
-			lane_section = GetLaneSectionByIdx((int)i);
-			if (s < lane_section->GetS() + lane_section->GetLength())
-			{
-				break;
-			}
-		}
-	}
-
-	return (int)i;
+	return lane_section_index_.Find(s, start_at);
 }
 
 LaneInfo Road::GetLaneInfoByS(double s, int start_lane_section_idx, int start_lane_id)
@@ -485,10 +827,7 @@ double Road::GetSpeedByS(double s)
 {
 	if (type_.size() > 0)
 	{
-		size_t i;
-		for (i = 0; i < type_.size() - 1 && s > type_[i + 1]->s_; i++);
-
-		return type_[i]->speed_;
+		return type_[type_index_.Find(s)]->speed_;
 	}
 
 	// No type entries, fall back to a speed based on nr of lanes
@@ -665,6 +1004,73 @@ double LaneSection::GetWidth(double s, int lane_id)
 	return lane_width->poly3_.Evaluate(ds);
 }
 
+// Scratch space for per lane values, on the stack unless the lane section is very wide
+class LaneValueBuffer
+{
+public:
+	LaneValueBuffer(int size) : data_(stack_)
+	{
+		if (size > LANE_VALUE_BUFFER_SIZE)
+		{
+			heap_.resize(size);
+			data_ = heap_.data();
+		}
+	}
+	double &operator[](int i) { return data_[i]; }
+	double *Data() { return data_; }
+
+private:
+	double stack_[LANE_VALUE_BUFFER_SIZE];
+	std::vector<double> heap_;
+	double *data_;
+};
+
+static void AccumulateLaneOffsets(double *offset, int min_lane_id, int max_lane_id)
+{
+	// offset holds the width of each lane by (lane_id - min_lane_id), 0 for missing lanes. Turn it into
+	// outer offsets by summing outwards from the reference lane, same order as LaneSection::GetOuterOffset()
+	for (int id = 2; id <= max_lane_id; id++)
+	{
+		offset[id - min_lane_id] = offset[id - min_lane_id] + offset[id - 1 - min_lane_id];
+	}
+	for (int id = -2; id >= min_lane_id; id--)
+	{
+		offset[id - min_lane_id] = offset[id - min_lane_id] + offset[id + 1 - min_lane_id];
+	}
+}
+
+void LaneSection::GetLaneOffsets(double s, double *outer_offset, double *width)
+{
+	int min_lane_id = 0;
+	int max_lane_id = 0;
+
+	for (size_t i = 0; i < lane_.size(); i++)
+	{
+		LaneWidth *lane_width = lane_[i]->GetId() == 0 ? 0 : lane_[i]->GetWidthByS(s - s_);
+
+		width[i] = lane_width ? lane_width->poly3_.Evaluate(s - (s_ + lane_width->GetSOffset())) : 0.0;
+		min_lane_id = MIN(min_lane_id, lane_[i]->GetId());
+		max_lane_id = MAX(max_lane_id, lane_[i]->GetId());
+	}
+
+	LaneValueBuffer offset(max_lane_id - min_lane_id + 1);
+	for (int i = 0; i < max_lane_id - min_lane_id + 1; i++)
+	{
+		offset[i] = 0.0;
+	}
+	for (size_t i = 0; i < lane_.size(); i++)
+	{
+		offset[lane_[i]->GetId() - min_lane_id] = width[i];
+	}
+
+	AccumulateLaneOffsets(offset.Data(), min_lane_id, max_lane_id);
+
+	for (size_t i = 0; i < lane_.size(); i++)
+	{
+		outer_offset[i] = offset[lane_[i]->GetId() - min_lane_id];
+	}
+}
+
 double LaneSection::GetOuterOffset(double s, int lane_id)
 {
 	double width = GetWidth(s, lane_id);
@@ -839,19 +1245,113 @@ void RoadLink::Print()
 }
 
 Road::~Road()
+{
+	ClearContent();
+	for (size_t i=0; i<link_.size(); i++)
+	{
+		delete(link_[i]);
+	}
+	for (size_t i=0; i<type_.size(); i++)
+	{
+		delete(type_[i]);
+	}
+}
+
+void Road::ClearContent()
 {
 	for (size_t i=0; i<geometry_.size(); i++)
 	{
 		delete(geometry_[i]);
 	}
+	geometry_.clear();
+	geometry_index_.Clear();
+
 	for (size_t i=0; i<elevation_profile_.size(); i++)
 	{
 		delete(elevation_profile_[i]);
 	}
+	elevation_profile_.clear();
+	elevation_index_.Clear();
+
+	for (size_t i=0; i<lane_section_.size(); i++)
+	{
+		delete(lane_section_[i]);
+	}
+	lane_section_.clear();
+	lane_section_index_.Clear();
+
+	for (size_t i=0; i<lane_offset_.size(); i++)
+	{
+		delete(lane_offset_[i]);
+	}
+	lane_offset_.clear();
+	lane_offset_index_.Clear();
+}
+
+size_t Road::GetMemoryUsage()
+{
+	size_t size = sizeof(Road) + name_.capacity() + link_.size() * (sizeof(RoadLink) + sizeof(RoadLink*)) +
+		type_.size() * (sizeof(RoadTypeEntry) + sizeof(RoadTypeEntry*) + sizeof(double));
+
+	for (size_t i = 0; i < geometry_.size(); i++)
+	{
+		switch (geometry_[i]->GetType())
+		{
+		case Geometry::GEOMETRY_TYPE_LINE:
+			size += sizeof(Line);
+			break;
+		case Geometry::GEOMETRY_TYPE_ARC:
+			size += sizeof(Arc);
+			break;
+		case Geometry::GEOMETRY_TYPE_SPIRAL:
+			size += sizeof(Spiral) + 4 * ((Spiral*)geometry_[i])->GetTable()->GetNumberOfNodes() * sizeof(double);
+			break;
+		case Geometry::GEOMETRY_TYPE_POLY3:
+			size += sizeof(Poly3);
+			break;
+		case Geometry::GEOMETRY_TYPE_PARAM_POLY3:
+			size += sizeof(ParamPoly3);
+			break;
+		default:
+			size += sizeof(Geometry);
+		}
+	}
+	size += geometry_.size() * (sizeof(Geometry*) + sizeof(double));
+	size += elevation_profile_.size() * (sizeof(Elevation) + sizeof(Elevation*) + sizeof(double));
+	size += lane_offset_.size() * (sizeof(LaneOffset) + sizeof(LaneOffset*) + sizeof(double));
+
+	for (size_t i = 0; i < lane_section_.size(); i++)
+	{
+		size += sizeof(LaneSection) + sizeof(LaneSection*) + sizeof(double);
+		for (int j = 0; j < lane_section_[i]->GetNumberOfLanes(); j++)
+		{
+			Lane *lane = lane_section_[i]->GetLaneByIdx(j);
+			size += sizeof(Lane) + sizeof(Lane*) + lane->GetNumberOfLinks() * (sizeof(LaneLink) + sizeof(LaneLink*)) +
+				lane->GetNumberOfWidths() * (sizeof(LaneWidth) + sizeof(LaneWidth*) + sizeof(double));
+		}
+	}
+
+	return size;
+}
+
+Lane::~Lane()
+{
 	for (size_t i=0; i<link_.size(); i++)
 	{
 		delete(link_[i]);
 	}
+	for (size_t i=0; i<lane_width_.size(); i++)
+	{
+		delete(lane_width_[i]);
+	}
+}
+
+LaneSection::~LaneSection()
+{
+	for (size_t i=0; i<lane_.size(); i++)
+	{
+		delete(lane_[i]);
+	}
 }
 
 void Road::Print()
@@ -883,11 +1383,13 @@ void Road::Print()
 void Road::AddLine(Line *line)
 {
 	geometry_.push_back((Geometry*)line);
+	geometry_index_.Add(line->GetS());
 }
 
 void Road::AddArc(Arc *arc)
 {
 	geometry_.push_back((Geometry*)arc);
+	geometry_index_.Add(arc->GetS());
 }
 
 void Road::AddSpiral(Spiral *spiral)
@@ -926,12 +1428,15 @@ void Road::AddSpiral(Spiral *spiral)
 	{
 		spiral->SetCDot((spiral->GetCurvEnd() - spiral->GetCurvStart()) / spiral->GetLength());
 	}
+	spiral->BuildTable();
 	geometry_.push_back((Geometry*)spiral);
+	geometry_index_.Add(spiral->GetS());
 }
 
 void Road::AddPoly3(Poly3 *poly3)
 {
 	geometry_.push_back((Geometry*)poly3);
+	geometry_index_.Add(poly3->GetS());
 	Poly3 *p3 = (Poly3*)geometry_.back();
 	
 	// Calculate umax (valid interval)
@@ -956,6 +1461,13 @@ void Road::AddPoly3(Poly3 *poly3)
 void Road::AddParamPoly3(ParamPoly3 *param_poly3)
 {
 	geometry_.push_back((Geometry*)param_poly3);
+	geometry_index_.Add(param_poly3->GetS());
+}
+
+void Road::AddGeometry(Geometry *geometry)
+{
+	geometry_.push_back(geometry);
+	geometry_index_.Add(geometry->GetS());
 }
 
 void Road::AddElevation(Elevation *elevation)
@@ -969,6 +1481,7 @@ void Road::AddElevation(Elevation *elevation)
 	elevation->SetLength(length_ - elevation->GetS());
 
 	elevation_profile_.push_back((Elevation*)elevation);
+	elevation_index_.Add(elevation->GetS());
 }
 
 Elevation* Road::GetElevation(int idx)
@@ -983,40 +1496,22 @@ Elevation* Road::GetElevation(int idx)
 
 double Road::GetLaneOffset(double s)
 {
-	int i = 0;
-
 	if (lane_offset_.size() == 0)
 	{
 		return 0;
 	}
 
-	for (; i + 1 < (int)lane_offset_.size(); i++)
-	{
-		if (s < lane_offset_[i + 1]->GetS())
-		{
-			break;
-		}
-	}
-	return (lane_offset_[i]->GetLaneOffset(s));
+	return (lane_offset_[lane_offset_index_.Find(s)]->GetLaneOffset(s));
 }
 
 double Road::GetLaneOffsetPrim(double s)
 {
-	int i = 0;
-
 	if (lane_offset_.size() == 0)
 	{
 		return 0;
 	}
 
-	for (; i + 1 < (int)lane_offset_.size(); i++)
-	{
-		if (s < lane_offset_[i + 1]->GetS())
-		{
-			break;
-		}
-	}
-	return (lane_offset_[i]->GetLaneOffsetPrim(s));
+	return (lane_offset_[lane_offset_index_.Find(s)]->GetLaneOffsetPrim(s));
 }
 
 int Road::GetNumberOfLanes(double s)
@@ -1094,6 +1589,11 @@ double Road::GetDrivableWidth(double s, int side)
 
 	if (i < GetNumberOfLaneSections())
 	{
+		LaneValueBuffer outer_offset(lane_section_[i]->GetNumberOfLanes());
+		LaneValueBuffer width(lane_section_[i]->GetNumberOfLanes());
+
+		lane_section_[i]->GetLaneOffsets(s, outer_offset.Data(), width.Data());
+
 		for (size_t j = 0; j < lane_section_[i]->GetNumberOfLanes(); j++)
 		{
 			if (lane_section_[i]->GetLaneByIdx((int)j)->IsDriving())
@@ -1104,7 +1604,7 @@ double Road::GetDrivableWidth(double s, int side)
 				{
 					continue;  // do not measure this side
 				}
-				double offset = SIGN(lane_id) * lane_section_[i]->GetOuterOffset(s, lane_id);
+				double offset = SIGN(lane_id) * outer_offset[(int)j];
 				if (offset < minOffset)
 				{
 					minOffset = offset;
@@ -1131,6 +1631,7 @@ void Road::AddLaneOffset(LaneOffset *lane_offset)
 	lane_offset->SetLength(length_ - lane_offset->GetS());
 	
 	lane_offset_.push_back((LaneOffset*)lane_offset);
+	lane_offset_index_.Add(lane_offset->GetS());
 }
 
 double Road::GetCenterOffset(double s, int lane_id)
@@ -1168,16 +1669,14 @@ void Road::AddLaneSection(LaneSection *lane_section)
 	lane_section->SetLength(length_ - lane_section->GetS());
 
 	lane_section_.push_back((LaneSection*)lane_section);
+	lane_section_index_.Add(lane_section->GetS());
 }
 
 bool Road::GetZAndPitchByS(double s, double *z, double *pitch, int *index)
 {
 	if (GetNumberOfElevations() > 0)
 	{
-		if (*index < 0 || *index >= GetNumberOfElevations())
-		{
-			*index = 0;
-		}
+		*index = elevation_index_.Find(s, *index);
 		Elevation *elevation = GetElevation(*index);
 		if (elevation == NULL)
 		{
@@ -1185,23 +1684,6 @@ bool Road::GetZAndPitchByS(double s, double *z, double *pitch, int *index)
 			return false;
 		}
 
-		if (elevation && s > elevation->GetS() + elevation->GetLength())
-		{
-			while (s > elevation->GetS() + elevation->GetLength() && *index < GetNumberOfElevations() - 1)
-			{
-				// Move to next elevation section
-				elevation = GetElevation(++*index);
-			}
-		}
-		else if (elevation && s < elevation->GetS())
-		{
-			while (s < elevation->GetS() && *index > 0)
-			{
-				// Move to previous elevation section
-				elevation = GetElevation(--*index);
-			}
-		}
-
 		if (elevation)
 		{
 			double p = s - elevation->GetS();
@@ -1217,20 +1699,39 @@ bool Road::GetZAndPitchByS(double s, double *z, double *pitch, int *index)
 
 Road* OpenDrive::GetRoadById(int id)
 {
-	for (size_t i=0; i<road_.size(); i++)
+	std::unordered_map<int, int>::iterator it = road_idx_by_id_.find(id);
+	if (it == road_idx_by_id_.end())
 	{
-		if (road_[i]->GetId() == id)
-		{
-			return road_[i];
-		}
+		return 0;
 	}
-	return 0;
+	return GetRoadByIdx(it->second);
+}
+
+Road* OpenDrive::FindRoadById(int id)
+{
+	// Same as GetRoadById, but never loads road data in tiled mode
+	std::unordered_map<int, int>::iterator it = road_idx_by_id_.find(id);
+	if (it == road_idx_by_id_.end())
+	{
+		return 0;
+	}
+	return road_[it->second];
 }
 
 Road *OpenDrive::GetRoadByIdx(int idx)
 {
 	if (idx >= 0 && idx < (int)road_.size())
 	{
+		if (tiled_)
+		{
+			tile_mutex_.Lock();
+			if (!road_tile_[idx].loaded)
+			{
+				LoadRoadContent(idx);
+			}
+			road_tile_[idx].last_used = ++tile_counter_;
+			tile_mutex_.Unlock();
+		}
 		return road_[idx];
 	}
 	else
@@ -1243,7 +1744,7 @@ Geometry *OpenDrive::GetGeometryByIdx(int road_idx, int geom_idx)
 {
 	if (road_idx >= 0 && road_idx < (int)road_.size())
 	{
-		return road_[road_idx]->GetGeometry(geom_idx);
+		return GetRoadByIdx(road_idx)->GetGeometry(geom_idx);
 	}
 	else
 	{
@@ -1251,538 +1752,3936 @@ Geometry *OpenDrive::GetGeometryByIdx(int road_idx, int geom_idx)
 	}
 }
 
-Junction* OpenDrive::GetJunctionById(int id)
+void OpenDrive::Compile()
 {
-	for (size_t i=0; i<junction_.size(); i++)
+	ClearRoadPathCache();
+
+	if (tiled_)
+	{
+		LOG("Compiled road network not available in tiled mode\n");
+		return;
+	}
+
+	compiled_.Build(this);
+	lane_graph_.Build(this);
+}
+
+int OpenDrive::GetGeometrySAndLength(int road_idx, int geom_idx, double *s, double *length)
+{
+	if (compiled_.IsValid())
+	{
+		if (road_idx < 0 || road_idx >= compiled_.GetNumberOfRoads() ||
+			geom_idx < 0 || geom_idx >= compiled_.GetRoad(road_idx)->n_geometries)
+		{
+			return -1;
+		}
+		CompiledOpenDrive::GeometryRecord *geom = compiled_.GetGeometry(road_idx, geom_idx);
+		*s = geom->s;
+		*length = geom->length;
+	}
+	else
 	{
-		if (junction_[i]->GetId() == id)
+		Geometry *geom = GetGeometryByIdx(road_idx, geom_idx);
+		if (geom == 0)
 		{
-			return junction_[i];
+			return -1;
 		}
+		*s = geom->GetS();
+		*length = geom->GetLength();
 	}
+
 	return 0;
 }
 
-Junction *OpenDrive::GetJunctionByIdx(int idx)
-{	
-	if (idx >= 0 && idx < (int)junction_.size())
+int OpenDrive::EvaluateGeometryDS(int road_idx, int geom_idx, double ds, double *x, double *y, double *h)
+{
+	if (compiled_.IsValid())
 	{
-		return junction_[idx];
+		if (road_idx < 0 || road_idx >= compiled_.GetNumberOfRoads() ||
+			geom_idx < 0 || geom_idx >= compiled_.GetRoad(road_idx)->n_geometries)
+		{
+			return -1;
+		}
+		compiled_.EvaluateGeometryDS(compiled_.GetRoad(road_idx), compiled_.GetGeometry(road_idx, geom_idx), ds, x, y, h);
 	}
 	else
 	{
-		LOG("GetJunctionByIdx error (idx %d, njunctions %d)\n", idx, (int)junction_.size());
-		return 0;
+		Geometry *geom = GetGeometryByIdx(road_idx, geom_idx);
+		if (geom == 0)
+		{
+			return -1;
+		}
+		geom->EvaluateDS(ds, x, y, h);
+	}
+
+	return 0;
+}
+
+double OpenDrive::GetLaneOffset(int road_idx, double s)
+{
+	if (compiled_.IsValid())
+	{
+		return compiled_.GetLaneOffset(road_idx, s);
 	}
+
+	return GetRoadByIdx(road_idx)->GetLaneOffset(s);
 }
 
-OpenDrive::OpenDrive(const char *filename)
+double OpenDrive::GetLaneOffsetPrim(int road_idx, double s)
 {
-	if (!LoadOpenDriveFile(filename))
+	if (compiled_.IsValid())
 	{
-		LOG("Error loading OpenDrive %s\n", filename);
-		throw std::invalid_argument("Failed to load OpenDrive file");
+		return compiled_.GetLaneOffsetPrim(road_idx, s);
 	}
+
+	return GetRoadByIdx(road_idx)->GetLaneOffsetPrim(s);
 }
 
-bool OpenDrive::LoadOpenDriveFile(const char *filename, bool replace)
+bool OpenDrive::GetZAndPitchByS(int road_idx, double s, double *z, double *pitch, int *index)
 {
-	mt_rand.seed((unsigned int)time(0));
+	if (compiled_.IsValid())
+	{
+		return compiled_.GetZAndPitchByS(road_idx, s, z, pitch, index);
+	}
 
-	if (replace)
+	return GetRoadByIdx(road_idx)->GetZAndPitchByS(s, z, pitch, index);
+}
+
+int OpenDrive::GetCenterOffsetAndHeading(int road_idx, int lane_section_idx, double s, int lane_id, double *offset, double *heading)
+{
+	if (road_idx < 0 || road_idx >= (int)road_.size())
 	{
-		for (size_t i=0; i<road_.size(); i++)
+		return -1;
+	}
+
+	if (compiled_.IsValid())
+	{
+		if (lane_section_idx < 0 || lane_section_idx >= compiled_.GetRoad(road_idx)->n_lane_sections)
 		{
-			delete road_[i];
+			return -1;
 		}
-		road_.clear();
-
-		for (size_t i=0; i<junction_.size(); i++)
+		CompiledOpenDrive::LaneSectionRecord *lane_section = compiled_.GetLaneSection(road_idx, lane_section_idx);
+		*offset = compiled_.GetCenterOffset(lane_section, s, lane_id);
+		*heading = compiled_.GetCenterOffsetHeading(lane_section, s, lane_id);
+	}
+	else
+	{
+		LaneSection *lane_section = GetRoadByIdx(road_idx)->GetLaneSectionByIdx(lane_section_idx);
+		if (lane_section == 0)
 		{
-			delete junction_[i];
+			return -1;
 		}
-		junction_.clear();
+		*offset = lane_section->GetCenterOffset(s, lane_id);
+		*heading = lane_section->GetCenterOffsetHeading(s, lane_id);
 	}
 
-	odr_filename_ = filename;
+	return 0;
+}
 
-	if (odr_filename_ == "")
+double OpenDrive::SetTessellationTolerance(double tolerance)
+{
+	tessellation_tolerance_ = tolerance;
+
+	return BuildTessellation();
+}
+
+double OpenDrive::BuildTessellation()
+{
+	double max_error = 0;
+	int n_samples = 0;
+
+	tessellation_.clear();
+
+	if (tessellation_tolerance_ <= 0 || road_.size() == 0)
 	{
-		return false;
+		return 0;
 	}
 
-	pugi::xml_document doc;
-	pugi::xml_parse_result result = doc.load_file(filename);
-	if (!result)
+	if (tiled_)
 	{
-		// Try current folder
-		std::string path = std::string(filename);
-		std::string base_filename = path.substr(path.find_last_of("/\\") + 1);
-		LOG("Failed to load %s - looking for file %s in current folder", filename, base_filename.c_str());
-		pugi::xml_parse_result result = doc.load_file(base_filename.c_str());
+		LOG("Approximate mode not available in tiled mode\n");
+		return 0;
+	}
 
-		if (!result)
-		{
-			throw std::invalid_argument(std::string("Failed to load OpenDRIVE file ") + std::string(filename));
+	tessellation_.resize(road_.size());
+	for (size_t i = 0; i < road_.size(); i++)
+	{
+		tessellation_[i].Build(road_[i], tessellation_tolerance_);
+		max_error = MAX(max_error, tessellation_[i].GetMaxError());
+		n_samples += tessellation_[i].GetNumberOfSamples();
+	}
 
-			return false;
-		}
+	LOG("Road tessellation: %d samples, max error %.5f m (tolerance %.5f m)\n", n_samples, max_error, tessellation_tolerance_);
+
+	return max_error;
+}
+
+RoadTessellation *OpenDrive::GetTessellation(int road_idx)
+{
+	if (road_idx < 0 || road_idx >= (int)tessellation_.size() || tessellation_[road_idx].GetNumberOfSamples() == 0)
+	{
+		return 0;
 	}
 
-	pugi::xml_node node = doc.child("OpenDRIVE");
-	if (node == NULL)
+	return &tessellation_[road_idx];
+}
+
+double OpenDrive::SetHeightGridResolution(double resolution)
+{
+	height_grid_resolution_ = resolution;
+
+	return BuildHeightGrid();
+}
+
+double OpenDrive::BuildHeightGrid()
+{
+	height_grid_.Clear();
+
+	if (height_grid_resolution_ <= 0 || road_.size() == 0)
 	{
-		cout << "Root null" << endl;
-		throw std::invalid_argument("The file does not seem to be an OpenDRIVE");
+		return 0;
 	}
 
-	for (pugi::xml_node road_node = node.child("road"); road_node; road_node = road_node.next_sibling("road"))
+	if (tiled_)
+	{
+		LOG("Height grid not available in tiled mode\n");
+		return 0;
+	}
+
+	height_grid_.Build(this, height_grid_resolution_);
+
+	LOG("Height grid: %d nodes, %d left out at overlapping roads, max error %.5f m (resolution %.3f m)\n",
+		height_grid_.GetNumberOfNodes(), height_grid_.GetNumberOfAmbiguousNodes(), height_grid_.GetMaxError(), height_grid_resolution_);
+
+	return height_grid_.GetMaxError();
+}
+
+int OpenDrive::GetRoadHeightBatch(int n, const double *x, const double *y, double *z, double *normal_x, double *normal_y,
+	double *normal_z, int *found)
+{
+	if (!height_grid_.IsValid() || n < 0 || (n > 0 && (x == 0 || y == 0 || z == 0)))
+	{
+		LOG("GetRoadHeightBatch: Height grid not enabled or invalid arguments\n");
+		return -1;
+	}
+
+	int n_found = 0;
+	for (int i = 0; i < n; i++)
 	{
-		Road *r = new Road(atoi(road_node.attribute("id").value()), road_node.attribute("name").value());
-		r->SetLength(atof(road_node.attribute("length").value()));
-		r->SetJunction(atoi(road_node.attribute("junction").value()));
+		int ok = height_grid_.GetHeight(x[i], y[i], &z[i], normal_x ? &normal_x[i] : 0, normal_y ? &normal_y[i] : 0,
+			normal_z ? &normal_z[i] : 0) == 0 ? 1 : 0;
 
-		for (pugi::xml_node type_node = road_node.child("type"); type_node; type_node = type_node.next_sibling("type"))
+		if (!ok)
 		{
-			RoadTypeEntry *r_type = new RoadTypeEntry();
-			
-			std::string type = type_node.attribute("type").value();
-			if (type == "unknown")
-			{
-				r_type->road_type_ = roadmanager::RoadType::ROADTYPE_UNKNOWN;
-			}
-			else if (type == "rural")
-			{
-				r_type->road_type_ = roadmanager::RoadType::ROADTYPE_RURAL;
-			}
-			else if (type == "motorway")
-			{
-				r_type->road_type_ = roadmanager::RoadType::ROADTYPE_MOTORWAY;
-			}
-			else if (type == "town")
+			z[i] = 0;
+			if (normal_x)
 			{
-				r_type->road_type_ = roadmanager::RoadType::ROADTYPE_TOWN;
+				normal_x[i] = 0;
 			}
-			else if (type == "lowSpeed")
+			if (normal_y)
 			{
-				r_type->road_type_ = roadmanager::RoadType::ROADTYPE_LOWSPEED;
+				normal_y[i] = 0;
 			}
-			else if (type == "pedestrian")
+			if (normal_z)
 			{
-				r_type->road_type_ = roadmanager::RoadType::ROADTYPE_PEDESTRIAN;
-			}
-			else if (type == "bicycle")
-			{
-				r_type->road_type_ = roadmanager::RoadType::ROADTYPE_BICYCLE;
-			}
-			else if (type == "")
-			{
-				LOG("Missing road type - setting default (rural)");
-				r_type->road_type_ = roadmanager::RoadType::ROADTYPE_RURAL;
-			}
-			else
-			{
-				LOG("Unsupported road type: %s - assuming rural", type.c_str());
-				r_type->road_type_ = roadmanager::RoadType::ROADTYPE_RURAL;
+				normal_z[i] = 1;
 			}
+		}
+		if (found)
+		{
+			found[i] = ok;
+		}
+		n_found += ok;
+	}
 
-			r_type->s_ = atof(type_node.attribute("s").value());
+	return n_found;
+}
 
-			// Check for optional speed record
-			pugi::xml_node speed = type_node.child("speed");
-			if (speed != NULL)
-			{
-				r_type->speed_ = atof(speed.attribute("max").value());
-				std::string unit = speed.attribute("unit").value();
-				if (unit == "km/h")
-				{
-					r_type->speed_ /= 3.6;  // Convert to m/s
-				}
-				else if (unit == "mph")
-				{
-					r_type->speed_ *= 0.44704; // Convert to m/s
-				}
-				else if (unit == "m/s")
-				{
-					// SE unit - do nothing
-				}
-				else 
-				{
-					LOG("Unsupported speed unit: %s - assuming SE unit m/s", unit.c_str());
-				}
-			}
+double OpenDrive::GetDistToClosestDrivingLane(int road_idx, double s, double t)
+{
+	double min_lane_dist = std::numeric_limits<double>::infinity();
 
-			r->AddRoadType(r_type);
+	if (compiled_.IsValid())
+	{
+		int lane_section_idx = compiled_.GetLaneSectionIdxByS(road_idx, s);
+		if (lane_section_idx < 0)
+		{
+			return min_lane_dist;
 		}
 
-		pugi::xml_node link = road_node.child("link");
-		if (link != NULL)
-		{
-			pugi::xml_node successor = link.child("successor");
-			if (successor != NULL)
-			{
-				r->AddLink(new RoadLink(SUCCESSOR, successor));
-			}
+		CompiledOpenDrive::LaneSectionRecord *lane_section = compiled_.GetLaneSection(road_idx, lane_section_idx);
+		LaneValueBuffer outer_offset(lane_section->n_lanes);
+		LaneValueBuffer width(lane_section->n_lanes);
 
-			pugi::xml_node predecessor = link.child("predecessor");
-			if (predecessor != NULL)
-			{
-				r->AddLink(new RoadLink(PREDECESSOR, predecessor));
-			}
-		}
+		compiled_.GetLaneOffsets(lane_section, s, outer_offset.Data(), width.Data());
 
-		pugi::xml_node plan_view = road_node.child("planView");
-		if (plan_view != NULL)
+		for (int i = 0; i < lane_section->n_lanes; i++)
 		{
-			for (pugi::xml_node geometry = plan_view.child("geometry"); geometry; geometry = geometry.next_sibling())
+			CompiledOpenDrive::LaneRecord *lane = compiled_.GetLaneByIdx(lane_section, i);
+			if (lane->driving)
 			{
-				double s = atof(geometry.attribute("s").value());
-				double x = atof(geometry.attribute("x").value());
-				double y = atof(geometry.attribute("y").value());
-				double hdg = atof(geometry.attribute("hdg").value());
-				double length = atof(geometry.attribute("length").value());
-
-				pugi::xml_node type = geometry.last_child();
-				if (type != NULL)
-				{
-					// Find out the type of geometry
-					if (!strcmp(type.name(), "line"))
-					{
-						r->AddLine(new Line(s, x, y, hdg, length));
-					}
-					else if (!strcmp(type.name(), "arc"))
-					{
-						double curvature = atof(type.attribute("curvature").value());
-						r->AddArc(new Arc(s, x, y, hdg, length, curvature));
-					}
-					else if (!strcmp(type.name(), "spiral"))
-					{
-						double curv_start = atof(type.attribute("curvStart").value());
-						double curv_end = atof(type.attribute("curvEnd").value());
-						r->AddSpiral(new Spiral(s, x, y, hdg, length, curv_start, curv_end));
-					}
-					else if (!strcmp(type.name(), "poly3"))
-					{
-						double a = atof(type.attribute("a").value());
-						double b = atof(type.attribute("b").value());
-						double c = atof(type.attribute("c").value());
-						double d = atof(type.attribute("d").value());
-						r->AddPoly3(new Poly3(s, x, y, hdg, length, a, b, c, d));
-					}
-					else if (!strcmp(type.name(), "paramPoly3"))
-					{
-						double aU = atof(type.attribute("aU").value());
-						double bU = atof(type.attribute("bU").value());
-						double cU = atof(type.attribute("cU").value());
-						double dU = atof(type.attribute("dU").value());
-						double aV = atof(type.attribute("aV").value());
-						double bV = atof(type.attribute("bV").value());
-						double cV = atof(type.attribute("cV").value());
-						double dV = atof(type.attribute("dV").value());
-						ParamPoly3::PRangeType p_range = ParamPoly3::P_RANGE_NORMALIZED;
-						
-						pugi::xml_attribute attr = type.attribute("pRange");
-						if (attr && !strcmp(attr.value(), "arcLength"))
-						{
-							p_range = ParamPoly3::P_RANGE_ARC_LENGTH;
-						}
-
-						ParamPoly3 *pp3 = new ParamPoly3(s, x, y, hdg, length, aU, bU, cU, dU, aV, bV, cV, dV, p_range);
-						if (pp3 != NULL)
-						{
-							r->AddParamPoly3(pp3);
-						}
-						else
-						{
-							LOG("ParamPoly3: Major error\n");
-						}
-					}
-					else
-					{
-						cout << "Unknown geometry type: " << type.name() << endl;
-					}
-				}
-				else
+				double lane_dist = t - SIGN(lane->id) * (outer_offset[i] - width[i] / 2);
+				if (fabs(lane_dist) < fabs(min_lane_dist))
 				{
-					cout << "Type == NULL" << endl;
+					min_lane_dist = lane_dist;
 				}
 			}
 		}
-		
-		pugi::xml_node elevation_profile = road_node.child("elevationProfile");
-		if (elevation_profile != NULL)
+	}
+	else
+	{
+		LaneSection *lane_section = GetRoadByIdx(road_idx)->GetLaneSectionByS(s);
+		if (lane_section == 0)
 		{
-			for (pugi::xml_node elevation = elevation_profile.child("elevation"); elevation; elevation = elevation.next_sibling())
-			{
-				double s = atof(elevation.attribute("s").value());
-				double a = atof(elevation.attribute("a").value());
-				double b = atof(elevation.attribute("b").value());
-				double c = atof(elevation.attribute("c").value());
-				double d = atof(elevation.attribute("d").value());
-
-				Elevation *ep = new Elevation(s, a, b, c, d);
-				if (ep != NULL)
-				{
-					r->AddElevation(ep);
-				}
-				else
-				{
-					LOG("Elevation: Major error\n");
-				}
-			}
+			return min_lane_dist;
 		}
-		
-		pugi::xml_node lanes = road_node.child("lanes");
-		if (lanes != NULL)
+
+		LaneValueBuffer outer_offset(lane_section->GetNumberOfLanes());
+		LaneValueBuffer width(lane_section->GetNumberOfLanes());
+
+		lane_section->GetLaneOffsets(s, outer_offset.Data(), width.Data());
+
+		for (int i = 0; i < lane_section->GetNumberOfLanes(); i++)
 		{
-			for (pugi::xml_node_iterator child = lanes.children().begin(); child != lanes.children().end(); child++)
+			if (lane_section->GetLaneByIdx(i)->IsDriving())
 			{
-				if (!strcmp(child->name(), "laneOffset"))
+				int lane_id = lane_section->GetLaneIdByIdx(i);
+				double lane_dist = t - SIGN(lane_id) * (outer_offset[i] - width[i] / 2);
+				if (fabs(lane_dist) < fabs(min_lane_dist))
 				{
-					double s = atof(child->attribute("s").value());
-					double a = atof(child->attribute("a").value());
-					double b = atof(child->attribute("b").value());
-					double c = atof(child->attribute("c").value());
-					double d = atof(child->attribute("d").value());
-					r->AddLaneOffset(new LaneOffset(s, a, b, c, d));
+					min_lane_dist = lane_dist;
 				}
-				else if (!strcmp(child->name(), "laneSection"))
-				{
-					double s = atof(child->attribute("s").value());
-					LaneSection *lane_section = new LaneSection(s);
-					r->AddLaneSection(lane_section);
+			}
+		}
+	}
 
-					for (pugi::xml_node_iterator child2 = child->children().begin(); child2 != child->children().end(); child2++)
-					{
-						if (!strcmp(child2->name(), "left"))
-						{
-							//LOG("Lane left\n");
-						}
-						else if (!strcmp(child2->name(), "right"))
-						{
-							//LOG("Lane right\n");
-						}
-						else if (!strcmp(child2->name(), "center"))
-						{
-							//LOG("Lane center\n");
-						}
-						else
-						{
-							LOG("Unsupported lane side: %s\n", child2->name());
-							continue;
-						}
-						for (pugi::xml_node_iterator lane_node = child2->children().begin(); lane_node != child2->children().end(); lane_node++)
-						{
-							if (strcmp(lane_node->name(), "lane"))
+	return min_lane_dist;
+}
+
+Junction* OpenDrive::GetJunctionById(int id)
+{
+	std::unordered_map<int, int>::iterator it = junction_idx_by_id_.find(id);
+	if (it == junction_idx_by_id_.end())
+	{
+		return 0;
+	}
+	return junction_[it->second];
+}
+
+Junction *OpenDrive::GetJunctionByIdx(int idx)
+{	
+	if (idx >= 0 && idx < (int)junction_.size())
+	{
+		return junction_[idx];
+	}
+	else
+	{
+		LOG("GetJunctionByIdx error (idx %d, njunctions %d)\n", idx, (int)junction_.size());
+		return 0;
+	}
+}
+
+OpenDrive::OpenDrive() : binary_cache_enabled_(true), loaded_from_cache_(false), tiled_(false), tile_memory_budget_(0),
+	tile_memory_(0), tile_counter_(0), road_path_cache_size_(ROAD_PATH_CACHE_SIZE), tessellation_tolerance_(0.0),
+	height_grid_resolution_(0.0)
+{
+}
+
+OpenDrive::OpenDrive(const char *filename) : binary_cache_enabled_(true), loaded_from_cache_(false), tiled_(false),
+	tile_memory_budget_(0), tile_memory_(0), tile_counter_(0), road_path_cache_size_(ROAD_PATH_CACHE_SIZE), tessellation_tolerance_(0.0),
+	height_grid_resolution_(0.0)
+{
+	if (!LoadOpenDriveFile(filename))
+	{
+		LOG("Error loading OpenDrive %s\n", filename);
+		throw std::invalid_argument("Failed to load OpenDrive file");
+	}
+}
+
+void GeometryGrid::Clear()
+{
+	bbox_.clear();
+	road_first_bbox_.clear();
+	cell_.clear();
+}
+
+void GeometryGrid::Add(GeometryBBox &bbox)
+{
+	while ((int)road_first_bbox_.size() <= bbox.road_idx)
+	{
+		road_first_bbox_.push_back((int)bbox_.size());
+	}
+
+	bbox_.push_back(bbox);
+
+	for (int i = GetCellIdx(bbox.x_min); i <= GetCellIdx(bbox.x_max); i++)
+	{
+		for (int j = GetCellIdx(bbox.y_min); j <= GetCellIdx(bbox.y_max); j++)
+		{
+			cell_[GetCellKey(i, j)].push_back((int)bbox_.size() - 1);
+		}
+	}
+}
+
+int GeometryGrid::GetBBoxIdx(int road_idx, int geom_idx)
+{
+	if (road_idx < 0 || road_idx >= (int)road_first_bbox_.size())
+	{
+		return -1;
+	}
+
+	int idx = road_first_bbox_[road_idx] + geom_idx;
+	if (idx < 0 || idx >= (int)bbox_.size() || bbox_[idx].road_idx != road_idx)
+	{
+		return -1;
+	}
+
+	return idx;
+}
+
+static bool BBoxWithinDist(GeometryBBox &bbox, double x, double y, double dist)
+{
+	double dx = MAX(MAX(bbox.x_min - x, x - bbox.x_max), 0.0);
+	double dy = MAX(MAX(bbox.y_min - y, y - bbox.y_max), 0.0);
+
+	return dx * dx + dy * dy <= dist * dist;
+}
+
+void GeometryGrid::Query(double x, double y, double radius, std::vector<int> &result)
+{
+	int i_min = GetCellIdx(x - radius);
+	int i_max = GetCellIdx(x + radius);
+	int j_min = GetCellIdx(y - radius);
+	int j_max = GetCellIdx(y + radius);
+
+	result.clear();
+
+	if ((long long)(i_max - i_min + 1) * (j_max - j_min + 1) > (long long)bbox_.size())
+	{
+		// Search area covers more cells than there are boxes, cheaper to just check all of them
+		for (int i = 0; i < (int)bbox_.size(); i++)
+		{
+			if (BBoxWithinDist(bbox_[i], x, y, radius))
+			{
+				result.push_back(i);
+			}
+		}
+		return;
+	}
+
+	for (int i = i_min; i <= i_max; i++)
+	{
+		for (int j = j_min; j <= j_max; j++)
+		{
+			std::unordered_map<long long, std::vector<int> >::iterator it = cell_.find(GetCellKey(i, j));
+			if (it == cell_.end())
+			{
+				continue;
+			}
+			for (size_t k = 0; k < it->second.size(); k++)
+			{
+				if (BBoxWithinDist(bbox_[it->second[k]], x, y, radius))
+				{
+					result.push_back(it->second[k]);
+				}
+			}
+		}
+	}
+
+	// A box might cover multiple cells, remove duplicates
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+void GeometryGrid::QueryBox(double x_min, double y_min, double x_max, double y_max, std::vector<int> &result)
+{
+	int i_min = GetCellIdx(x_min);
+	int i_max = GetCellIdx(x_max);
+	int j_min = GetCellIdx(y_min);
+	int j_max = GetCellIdx(y_max);
+
+	result.clear();
+
+	if ((long long)(i_max - i_min + 1) * (j_max - j_min + 1) > (long long)bbox_.size())
+	{
+		for (int i = 0; i < (int)bbox_.size(); i++)
+		{
+			if (bbox_[i].x_min <= x_max && bbox_[i].x_max >= x_min && bbox_[i].y_min <= y_max && bbox_[i].y_max >= y_min)
+			{
+				result.push_back(i);
+			}
+		}
+		return;
+	}
+
+	for (int i = i_min; i <= i_max; i++)
+	{
+		for (int j = j_min; j <= j_max; j++)
+		{
+			std::unordered_map<long long, std::vector<int> >::iterator it = cell_.find(GetCellKey(i, j));
+			if (it == cell_.end())
+			{
+				continue;
+			}
+			for (size_t k = 0; k < it->second.size(); k++)
+			{
+				GeometryBBox &bbox = bbox_[it->second[k]];
+				if (bbox.x_min <= x_max && bbox.x_max >= x_min && bbox.y_min <= y_max && bbox.y_max >= y_min)
+				{
+					result.push_back(it->second[k]);
+				}
+			}
+		}
+	}
+
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+// Lateral distance from reference line to the outer border of the widest side of the road
+static double GetMaxLateralExtent(LaneSection *lane_section, double s)
+{
+	int lane_id_min = 0;
+	int lane_id_max = 0;
+
+	for (int i = 0; i < lane_section->GetNumberOfLanes(); i++)
+	{
+		lane_id_min = MIN(lane_id_min, lane_section->GetLaneIdByIdx(i));
+		lane_id_max = MAX(lane_id_max, lane_section->GetLaneIdByIdx(i));
+	}
+
+	double extent = 0;
+	if (lane_id_min < 0)
+	{
+		extent = MAX(extent, fabs(lane_section->GetOuterOffset(s, lane_id_min)));
+	}
+	if (lane_id_max > 0)
+	{
+		extent = MAX(extent, fabs(lane_section->GetOuterOffset(s, lane_id_max)));
+	}
+
+	return extent;
+}
+
+void OpenDrive::CalcRoadBBoxes(Road *road, int road_idx, std::vector<GeometryBBox> &bbox)
+{
+	std::vector<double> ds, x, y, h;
+
+	// Lane offset is not always evaluated at the exact s value of the geometry point (see GetDistToTrackGeom)
+	// so to be on the safe side use the largest lane offset of the road
+	double max_lane_offset = 0;
+	int n_samples = MAX(1, (int)ceil(road->GetLength() / GEOMETRY_BBOX_SAMPLE_DIST));
+	for (int k = 0; k <= n_samples; k++)
+	{
+		max_lane_offset = MAX(max_lane_offset, fabs(road->GetLaneOffset(road->GetLength() * k / n_samples)));
+	}
+
+	for (int j = 0; j < road->GetNumberOfGeometries(); j++)
+	{
+		Geometry *geom = road->GetGeometry(j);
+		GeometryBBox box;
+
+		box.road_idx = road_idx;
+		box.geom_idx = j;
+		box.x_min = box.y_min = std::numeric_limits<double>::infinity();
+		box.x_max = box.y_max = -std::numeric_limits<double>::infinity();
+
+		n_samples = MAX(1, (int)ceil(geom->GetLength() / GEOMETRY_BBOX_SAMPLE_DIST));
+		ds.resize(n_samples + 1);
+		x.resize(n_samples + 1);
+		y.resize(n_samples + 1);
+		h.resize(n_samples + 1);
+		for (int k = 0; k <= n_samples; k++)
+		{
+			ds[k] = geom->GetLength() * k / n_samples;
+		}
+		geom->EvaluateDSBatch(ds.data(), n_samples + 1, x.data(), y.data(), h.data());
+
+		std::vector<double> extent(n_samples + 1);
+		for (int k = 0; k <= n_samples; k++)
+		{
+			extent[k] = max_lane_offset + GEOMETRY_BBOX_MARGIN;
+
+			LaneSection *lane_section = road->GetLaneSectionByS(geom->GetS() + ds[k]);
+			if (lane_section)
+			{
+				extent[k] += GetMaxLateralExtent(lane_section, geom->GetS() + ds[k]);
+			}
+
+			box.x_min = MIN(box.x_min, x[k] - extent[k]);
+			box.y_min = MIN(box.y_min, y[k] - extent[k]);
+			box.x_max = MAX(box.x_max, x[k] + extent[k]);
+			box.y_max = MAX(box.y_max, y[k] + extent[k]);
+		}
+
+		box.x_center = (box.x_min + box.x_max) / 2;
+		box.y_center = (box.y_min + box.y_max) / 2;
+		box.radius = 0;
+		for (int k = 0; k <= n_samples; k++)
+		{
+			box.radius = MAX(box.radius, PointDistance2D(x[k], y[k], box.x_center, box.y_center) + extent[k]);
+		}
+
+		// Endpoints and lane offset exactly as evaluated by Position::GetDistToTrackGeom() before they were cached
+		geom->EvaluateDS(0, &box.x_start, &box.y_start, &box.h_start);
+		geom->EvaluateDS(geom->GetLength(), &box.x_end, &box.y_end, &box.h_end);
+		box.x_start += road->GetLaneOffset(0) * cos(box.h_start + M_PI_2);
+		box.y_start += road->GetLaneOffset(geom->GetLength()) * sin(box.h_start + M_PI_2);
+		box.x_end += road->GetLaneOffset(0) * cos(box.h_end + M_PI_2);
+		box.y_end += road->GetLaneOffset(geom->GetLength()) * sin(box.h_end + M_PI_2);
+
+		box.x_tangent = box.y_tangent = 0;
+		box.tangents_intersect = GetIntersectionOfTwoLineSegments(
+			box.x_start, box.y_start, box.x_start + cos(box.h_start + M_PI_2), box.y_start + sin(box.h_start + M_PI_2),
+			box.x_end, box.y_end, box.x_end + cos(box.h_end + M_PI_2), box.y_end + sin(box.h_end + M_PI_2),
+			box.x_tangent, box.y_tangent) == 0 ? 1 : 0;
+
+		bbox.push_back(box);
+	}
+}
+
+void OpenDrive::BuildGeometryGrid(std::vector<GeometryBBox> *bbox)
+{
+	std::vector<GeometryBBox> road_bbox;
+
+	geometry_grid_.Clear();
+
+	if (bbox)
+	{
+		// Boxes calculated earlier, e.g. restored from a binary cache
+		for (size_t i = 0; i < bbox->size(); i++)
+		{
+			geometry_grid_.Add((*bbox)[i]);
+		}
+		return;
+	}
+
+	for (int i = 0; i < (int)road_.size(); i++)
+	{
+		road_bbox.clear();
+		CalcRoadBBoxes(road_[i], i, road_bbox);
+		for (size_t j = 0; j < road_bbox.size(); j++)
+		{
+			geometry_grid_.Add(road_bbox[j]);
+		}
+	}
+}
+
+// Circle or axis aligned box, see OpenDrive::GetLaneSegmentsInCircle()
+typedef struct
+{
+	bool circle;
+	double x;  // circle center
+	double y;
+	double radius;
+	double x_min;  // bounding box, same as the region itself for a box
+	double y_min;
+	double x_max;
+	double y_max;
+} QueryRegion;
+
+static double GetDistToRegion(QueryRegion &region, double x, double y)
+{
+	if (region.circle)
+	{
+		return MAX(PointDistance2D(x, y, region.x, region.y) - region.radius, 0.0);
+	}
+
+	double dx = MAX(MAX(region.x_min - x, x - region.x_max), 0.0);
+	double dy = MAX(MAX(region.y_min - y, y - region.y_max), 0.0);
+
+	return sqrt(dx * dx + dy * dy);
+}
+
+static double GetSquareDistToLineSegment(double x, double y, double x1, double y1, double x2, double y2)
+{
+	// Closest point of the segment
+	double dx = x2 - x1;
+	double dy = y2 - y1;
+	double len2 = dx * dx + dy * dy;
+	double u = len2 > SMALL_NUMBER ? CLAMP(((x - x1) * dx + (y - y1) * dy) / len2, 0.0, 1.0) : 0.0;
+
+	return PointSquareDistance2D(x1 + u * dx, y1 + u * dy, x, y);
+}
+
+static bool LineSegmentInRegion(QueryRegion &region, double x1, double y1, double x2, double y2)
+{
+	double dx = x2 - x1;
+	double dy = y2 - y1;
+
+	if (region.circle)
+	{
+		return GetSquareDistToLineSegment(region.x, region.y, x1, y1, x2, y2) <= region.radius * region.radius;
+	}
+
+	// Clip the segment against the box, one slab at a time
+	double u_min = 0.0;
+	double u_max = 1.0;
+	double p[4] = { -dx, dx, -dy, dy };
+	double q[4] = { x1 - region.x_min, region.x_max - x1, y1 - region.y_min, region.y_max - y1 };
+
+	for (int i = 0; i < 4; i++)
+	{
+		if (fabs(p[i]) < SMALL_NUMBER)
+		{
+			if (q[i] < 0)
+			{
+				return false;
+			}
+		}
+		else if (p[i] < 0)
+		{
+			u_min = MAX(u_min, q[i] / p[i]);
+		}
+		else
+		{
+			u_max = MIN(u_max, q[i] / p[i]);
+		}
+	}
+
+	return u_min <= u_max;
+}
+
+static double GetLineSegmentDistToRegion(QueryRegion &region, double x1, double y1, double x2, double y2)
+{
+	if (region.circle)
+	{
+		double dist = sqrt(GetSquareDistToLineSegment(region.x, region.y, x1, y1, x2, y2));
+		return MAX(dist - region.radius, 0.0);
+	}
+
+	if (LineSegmentInRegion(region, x1, y1, x2, y2))
+	{
+		return 0.0;
+	}
+
+	// Closest to an end of the segment, or to a corner of the box
+	double dist = MIN(GetDistToRegion(region, x1, y1), GetDistToRegion(region, x2, y2));
+	double corner_x[4] = { region.x_min, region.x_max, region.x_max, region.x_min };
+	double corner_y[4] = { region.y_min, region.y_min, region.y_max, region.y_max };
+
+	for (int i = 0; i < 4; i++)
+	{
+		dist = MIN(dist, sqrt(GetSquareDistToLineSegment(corner_x[i], corner_y[i], x1, y1, x2, y2)));
+	}
+
+	return dist;
+}
+
+// Reference point and lane borders of a road cross section, see OpenDrive::GetLaneSegmentsInCircle()
+class LaneCrossSection
+{
+public:
+	LaneCrossSection(Road *road, LaneSection *lane_section) : road_(road), lane_section_(lane_section), geom_idx_(0),
+		outer_offset_(lane_section->GetNumberOfLanes()), width_(lane_section->GetNumberOfLanes()) {}
+
+	void Evaluate(double s)
+	{
+		while (geom_idx_ < road_->GetNumberOfGeometries() - 1 && s >= road_->GetGeometry(geom_idx_ + 1)->GetS())
+		{
+			geom_idx_++;
+		}
+		while (geom_idx_ > 0 && s < road_->GetGeometry(geom_idx_)->GetS())
+		{
+			geom_idx_--;
+		}
+
+		Geometry *geom = road_->GetGeometry(geom_idx_);
+		geom->EvaluateDS(CLAMP(s - geom->GetS(), 0.0, geom->GetLength()), &x_, &y_, &h_);
+		lane_offset_ = road_->GetLaneOffset(s);
+		lane_section_->GetLaneOffsets(s, outer_offset_.Data(), width_.Data());
+	}
+
+	// Max distance from reference point to any lane border
+	double GetExtent()
+	{
+		double extent = fabs(lane_offset_);
+
+		for (int i = 0; i < lane_section_->GetNumberOfLanes(); i++)
+		{
+			extent = MAX(extent, fabs(lane_offset_) + outer_offset_[i]);
+		}
+
+		return extent;
+	}
+
+	bool LaneInRegion(int lane_idx, QueryRegion &region)
+	{
+		double x1, y1, x2, y2;
+
+		if (!GetLaneBorders(lane_idx, x1, y1, x2, y2))
+		{
+			return false;
+		}
+
+		return LineSegmentInRegion(region, x1, y1, x2, y2);
+	}
+
+	// Distance from the lane to the region, 0 if inside, LARGE_NUMBER if the lane has no width
+	double GetLaneDistToRegion(int lane_idx, QueryRegion &region)
+	{
+		double x1, y1, x2, y2;
+
+		if (!GetLaneBorders(lane_idx, x1, y1, x2, y2))
+		{
+			return LARGE_NUMBER;
+		}
+
+		return GetLineSegmentDistToRegion(region, x1, y1, x2, y2);
+	}
+
+	double GetX() { return x_; }
+	double GetY() { return y_; }
+
+private:
+	// Inner and outer border points of a lane, false if the lane has no width
+	bool GetLaneBorders(int lane_idx, double &x1, double &y1, double &x2, double &y2)
+	{
+		int lane_id = lane_section_->GetLaneIdByIdx(lane_idx);
+
+		if (lane_id == 0 || width_[lane_idx] < SMALL_NUMBER)
+		{
+			return false;
+		}
+
+		double t_outer = lane_offset_ + SIGN(lane_id) * outer_offset_[lane_idx];
+		double t_inner = lane_offset_ + SIGN(lane_id) * (outer_offset_[lane_idx] - width_[lane_idx]);
+		double nx = cos(h_ + M_PI_2);
+		double ny = sin(h_ + M_PI_2);
+
+		x1 = x_ + t_inner * nx;
+		y1 = y_ + t_inner * ny;
+		x2 = x_ + t_outer * nx;
+		y2 = y_ + t_outer * ny;
+
+		return true;
+	}
+
+	Road *road_;
+	LaneSection *lane_section_;
+	int geom_idx_;
+	double x_;
+	double y_;
+	double h_;
+	double lane_offset_;
+	LaneValueBuffer outer_offset_;
+	LaneValueBuffer width_;
+};
+
+// Find s where a lane enters or leaves the region, between s_out (lane outside) and s_in (lane inside)
+static double RefineLaneSegmentEnd(LaneCrossSection &cross_section, int lane_idx, QueryRegion &region, double s_out, double s_in)
+{
+	for (int i = 0; i < REGION_QUERY_REFINE_STEPS; i++)
+	{
+		double s_mid = (s_out + s_in) / 2;
+		cross_section.Evaluate(s_mid);
+		if (cross_section.LaneInRegion(lane_idx, region))
+		{
+			s_in = s_mid;
+		}
+		else
+		{
+			s_out = s_mid;
+		}
+	}
+
+	return s_in;
+}
+
+// Add the parts of the lanes of a lane section within the region, looking at s values from s_start to s_end
+static void AddLaneSegmentsInRegion(Road *road, LaneSection *lane_section, double s_start, double s_end, QueryRegion &region,
+	bool include_non_driving, std::vector<RoadLaneSegment> &segments)
+{
+	int n_lanes = lane_section->GetNumberOfLanes();
+	LaneCrossSection cross_section(road, lane_section);
+	LaneCrossSection refine_cross_section(road, lane_section);
+	std::vector<char> inside(n_lanes, 0);
+	std::vector<double> segment_start(n_lanes, 0.0);
+	double step = region.circle ? region.radius : MIN(region.x_max - region.x_min, region.y_max - region.y_min) / 2;
+	step = CLAMP(step, REGION_QUERY_MIN_STEP, REGION_QUERY_MAX_STEP);
+
+	double s_prev = s_start;
+	for (double s = s_start; ; )
+	{
+		cross_section.Evaluate(s);
+
+		// A lane border moves at most REGION_QUERY_MAX_BORDER_SPEED meters per meter along the road,
+		// so far from the region the next samples can be skipped
+		double dist = GetDistToRegion(region, cross_section.GetX(), cross_section.GetY()) - cross_section.GetExtent();
+		bool far = dist > 0;
+		double lane_dist = LARGE_NUMBER;  // closest lane outside the region
+
+		for (int i = 0; i < n_lanes; i++)
+		{
+			if (!include_non_driving && !lane_section->GetLaneByIdx(i)->IsDriving())
+			{
+				continue;
+			}
+
+			bool lane_inside = false;
+			if (!far)
+			{
+				double d = cross_section.GetLaneDistToRegion(i, region);
+				lane_inside = d <= 0.0;
+				if (!lane_inside)
+				{
+					lane_dist = MIN(lane_dist, d);
+				}
+			}
+			if (lane_inside && !inside[i])
+			{
+				segment_start[i] = s == s_start ? s : RefineLaneSegmentEnd(refine_cross_section, i, region, s_prev, s);
+			}
+			else if (!lane_inside && inside[i])
+			{
+				RoadLaneSegment segment;
+				segment.road_id = road->GetId();
+				segment.lane_id = lane_section->GetLaneIdByIdx(i);
+				segment.s_start = segment_start[i];
+				segment.s_end = RefineLaneSegmentEnd(refine_cross_section, i, region, s, s_prev);
+				segments.push_back(segment);
+			}
+			inside[i] = lane_inside ? 1 : 0;
+		}
+
+		if (s >= s_end)
+		{
+			break;
+		}
+		double next_step = step;
+		if (far)
+		{
+			next_step = MAX(step, dist / REGION_QUERY_MAX_BORDER_SPEED);
+		}
+		else if (lane_dist < LARGE_NUMBER)
+		{
+			// Don't step past a lane part entering the region, down to the end accuracy
+			next_step = CLAMP(lane_dist / REGION_QUERY_MAX_BORDER_SPEED, REGION_QUERY_END_ACCURACY, step);
+		}
+		s_prev = s;
+		s = MIN(s + next_step, s_end);
+	}
+
+	for (int i = 0; i < n_lanes; i++)
+	{
+		if (inside[i])
+		{
+			RoadLaneSegment segment;
+			segment.road_id = road->GetId();
+			segment.lane_id = lane_section->GetLaneIdByIdx(i);
+			segment.s_start = segment_start[i];
+			segment.s_end = s_end;
+			segments.push_back(segment);
+		}
+	}
+}
+
+static bool CompareLaneSegments(const RoadLaneSegment &a, const RoadLaneSegment &b)
+{
+	return a.s_start < b.s_start || (a.s_start == b.s_start && a.lane_id < b.lane_id);
+}
+
+// Scan the road parts covered by the given geometry bounding boxes, sorted by road and geometry index
+static int GetLaneSegmentsInRegion(OpenDrive *od, std::vector<int> &bbox_idx, QueryRegion &region, bool include_non_driving,
+	std::vector<RoadLaneSegment> &segments)
+{
+	GeometryGrid *grid = od->GetGeometryGrid();
+
+	segments.clear();
+
+	for (size_t i = 0; i < bbox_idx.size(); )
+	{
+		int road_idx = grid->GetBBoxByIdx(bbox_idx[i])->road_idx;
+		Road *road = od->GetRoadByIdx(road_idx);
+		size_t first_segment = segments.size();
+
+		// Consecutive geometries of the road make up one s range
+		while (i < bbox_idx.size() && grid->GetBBoxByIdx(bbox_idx[i])->road_idx == road_idx)
+		{
+			int geom_idx = grid->GetBBoxByIdx(bbox_idx[i])->geom_idx;
+			double s_start = road->GetGeometry(geom_idx)->GetS();
+			for (i++; i < bbox_idx.size() && grid->GetBBoxByIdx(bbox_idx[i])->road_idx == road_idx &&
+				grid->GetBBoxByIdx(bbox_idx[i])->geom_idx == geom_idx + 1; i++)
+			{
+				geom_idx++;
+			}
+			Geometry *geom = road->GetGeometry(geom_idx);
+			double s_end = MIN(geom->GetS() + geom->GetLength(), road->GetLength());
+
+			for (int j = road->GetLaneSectionIdxByS(s_start); j >= 0 && j < road->GetNumberOfLaneSections(); j++)
+			{
+				LaneSection *lane_section = road->GetLaneSectionByIdx(j);
+				if (lane_section->GetS() >= s_end)
+				{
+					break;
+				}
+				AddLaneSegmentsInRegion(road, lane_section, MAX(s_start, lane_section->GetS()),
+					MIN(s_end, lane_section->GetS() + lane_section->GetLength()), region, include_non_driving, segments);
+			}
+		}
+
+		std::sort(segments.begin() + first_segment, segments.end(), CompareLaneSegments);
+	}
+
+	return (int)segments.size();
+}
+
+int OpenDrive::GetLaneSegmentsInCircle(double x, double y, double radius, std::vector<RoadLaneSegment> &segments,
+	bool include_non_driving)
+{
+	if (radius < 0)
+	{
+		LOG("GetLaneSegmentsInCircle: Invalid radius %.2f\n", radius);
+		return -1;
+	}
+
+	QueryRegion region;
+	region.circle = true;
+	region.x = x;
+	region.y = y;
+	region.radius = radius;
+	region.x_min = x - radius;
+	region.y_min = y - radius;
+	region.x_max = x + radius;
+	region.y_max = y + radius;
+
+	std::vector<int> bbox_idx;
+	geometry_grid_.Query(x, y, radius, bbox_idx);
+
+	return GetLaneSegmentsInRegion(this, bbox_idx, region, include_non_driving, segments);
+}
+
+int OpenDrive::GetLaneSegmentsInBox(double x_min, double y_min, double x_max, double y_max, std::vector<RoadLaneSegment> &segments,
+	bool include_non_driving)
+{
+	if (x_min > x_max || y_min > y_max)
+	{
+		LOG("GetLaneSegmentsInBox: Invalid box (%.2f, %.2f) - (%.2f, %.2f)\n", x_min, y_min, x_max, y_max);
+		return -1;
+	}
+
+	QueryRegion region;
+	region.circle = false;
+	region.x = (x_min + x_max) / 2;
+	region.y = (y_min + y_max) / 2;
+	region.radius = 0;
+	region.x_min = x_min;
+	region.y_min = y_min;
+	region.x_max = x_max;
+	region.y_max = y_max;
+
+	std::vector<int> bbox_idx;
+	geometry_grid_.QueryBox(x_min, y_min, x_max, y_max, bbox_idx);
+
+	return GetLaneSegmentsInRegion(this, bbox_idx, region, include_non_driving, segments);
+}
+
+// Index of the last record starting at or before s, see SIndex::Find()
+template <class T> static int FindRecordByS(T *record, int n, double s, int hint)
+{
+	if (n == 0)
+	{
+		return -1;
+	}
+
+	for (int i = hint; i >= 0 && i < n && i < hint + 2; i++)
+	{
+		if ((i == 0 || s >= record[i].s) && (i == n - 1 || s < record[i + 1].s))
+		{
+			return i;
+		}
+	}
+
+	int lo = 1;
+	int hi = n;
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (record[mid].s <= s)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	return lo - 1;
+}
+
+static double EvaluatePoly(double a, double b, double c, double d, double p)
+{
+	// Same expression as Polynomial::Evaluate, to get identical results
+	return (a + p * b + p * p*c + p * p*p*d);
+}
+
+static double EvaluatePolyPrim(double b, double c, double d, double p)
+{
+	return (b + 2 * p*c + 3 * p*p*d);
+}
+
+void CompiledOpenDrive::Clear()
+{
+	road_.clear();
+	geometry_.clear();
+	arc_curvature_.clear();
+	spiral_.clear();
+	spiral_node_.clear();
+	poly3_.clear();
+	param_poly3_.clear();
+	elevation_.clear();
+	lane_offset_.clear();
+	lane_section_.clear();
+	lane_.clear();
+	lane_slot_.clear();
+	lane_width_.clear();
+	n_shared_widths_ = 0;
+	valid_ = false;
+}
+
+static CompiledOpenDrive::PolyRecord MakePolyRecord(double s, Polynomial &poly)
+{
+	CompiledOpenDrive::PolyRecord pr;
+
+	pr.s = (CompiledOpenDrive::Real)s;
+	pr.a = (CompiledOpenDrive::Real)poly.GetA();
+	pr.b = (CompiledOpenDrive::Real)poly.GetB();
+	pr.c = (CompiledOpenDrive::Real)poly.GetC();
+	pr.d = (CompiledOpenDrive::Real)poly.GetD();
+
+	return pr;
+}
+
+void CompiledOpenDrive::Build(OpenDrive *od)
+{
+	std::unordered_map<std::string, int> width_sequence;  // lane width records, as raw bytes -> first_width
+
+	Clear();
+
+	road_.reserve(od->GetNumOfRoads());
+
+	for (int i = 0; i < od->GetNumOfRoads(); i++)
+	{
+		Road *road = od->GetRoadByIdx(i);
+		RoadRecord rr;
+
+		rr.length = (Real)road->GetLength();
+#ifdef RM_COMPACT_STORAGE
+		// Keep coordinates small, float precision is ~0.1 m a hundred kilometers from the origin
+		rr.x0 = road->GetNumberOfGeometries() > 0 ? road->GetGeometry(0)->GetX() : 0;
+		rr.y0 = road->GetNumberOfGeometries() > 0 ? road->GetGeometry(0)->GetY() : 0;
+#else
+		rr.x0 = 0;
+		rr.y0 = 0;
+#endif
+
+		rr.first_geometry = (int)geometry_.size();
+		rr.n_geometries = road->GetNumberOfGeometries();
+		for (int j = 0; j < road->GetNumberOfGeometries(); j++)
+		{
+			Geometry *geom = road->GetGeometry(j);
+			GeometryRecord gr;
+
+			gr.s = (Real)geom->GetS();
+			gr.x = (Real)(geom->GetX() - rr.x0);
+			gr.y = (Real)(geom->GetY() - rr.y0);
+			gr.hdg = (Real)geom->GetHdg();
+			gr.length = (Real)geom->GetLength();
+			gr.type = geom->GetType();
+			gr.param_idx = -1;
+
+			if (gr.type == Geometry::GEOMETRY_TYPE_ARC)
+			{
+				gr.param_idx = (int)arc_curvature_.size();
+				arc_curvature_.push_back((Real)((Arc*)geom)->GetCurvature());
+			}
+			else if (gr.type == Geometry::GEOMETRY_TYPE_SPIRAL)
+			{
+				Spiral *spiral = (Spiral*)geom;
+				SpiralParams sp;
+				sp.curv_start = (Real)spiral->GetCurvStart();
+				sp.curv_end = (Real)spiral->GetCurvEnd();
+				sp.c_dot = (Real)spiral->GetCDot();
+				sp.x0 = (Real)spiral->GetX0();
+				sp.y0 = (Real)spiral->GetY0();
+				sp.h0 = (Real)spiral->GetH0();
+				sp.s0 = (Real)spiral->GetS0();
+				sp.first_node = (int)spiral_node_.size() / 4;
+				sp.n_nodes = spiral->GetTable()->GetNumberOfNodes();
+				sp.table_s_start = (Real)spiral->GetTable()->GetSStart();
+				sp.table_step = (Real)spiral->GetTable()->GetStep();
+				spiral_node_.insert(spiral_node_.end(), spiral->GetTable()->GetNodes(), spiral->GetTable()->GetNodes() + 4 * sp.n_nodes);
+				gr.param_idx = (int)spiral_.size();
+				spiral_.push_back(sp);
+			}
+			else if (gr.type == Geometry::GEOMETRY_TYPE_POLY3)
+			{
+				Poly3 *poly3 = (Poly3*)geom;
+				Poly3Params pp;
+				pp.a = (Real)poly3->poly3_.GetA();
+				pp.b = (Real)poly3->poly3_.GetB();
+				pp.c = (Real)poly3->poly3_.GetC();
+				pp.d = (Real)poly3->poly3_.GetD();
+				pp.umax = (Real)poly3->GetUMax();
+				gr.param_idx = (int)poly3_.size();
+				poly3_.push_back(pp);
+			}
+			else if (gr.type == Geometry::GEOMETRY_TYPE_PARAM_POLY3)
+			{
+				ParamPoly3 *param_poly3 = (ParamPoly3*)geom;
+				ParamPoly3Params pp;
+				pp.aU = (Real)param_poly3->poly3U_.GetA();
+				pp.bU = (Real)param_poly3->poly3U_.GetB();
+				pp.cU = (Real)param_poly3->poly3U_.GetC();
+				pp.dU = (Real)param_poly3->poly3U_.GetD();
+				pp.aV = (Real)param_poly3->poly3V_.GetA();
+				pp.bV = (Real)param_poly3->poly3V_.GetB();
+				pp.cV = (Real)param_poly3->poly3V_.GetC();
+				pp.dV = (Real)param_poly3->poly3V_.GetD();
+				pp.p_scale = (Real)param_poly3->poly3U_.GetPScale();
+				gr.param_idx = (int)param_poly3_.size();
+				param_poly3_.push_back(pp);
+			}
+			geometry_.push_back(gr);
+		}
+
+		rr.first_elevation = (int)elevation_.size();
+		rr.n_elevations = road->GetNumberOfElevations();
+		for (int j = 0; j < road->GetNumberOfElevations(); j++)
+		{
+			Elevation *elevation = road->GetElevation(j);
+			elevation_.push_back(MakePolyRecord(elevation->GetS(), elevation->poly3_));
+		}
+
+		rr.first_lane_offset = (int)lane_offset_.size();
+		rr.n_lane_offsets = road->GetNumberOfLaneOffsets();
+		for (int j = 0; j < road->GetNumberOfLaneOffsets(); j++)
+		{
+			LaneOffset *lane_offset = road->GetLaneOffsetByIdx(j);
+			Polynomial poly = lane_offset->GetPolynomial();
+			lane_offset_.push_back(MakePolyRecord(lane_offset->GetS(), poly));
+		}
+
+		rr.first_lane_section = (int)lane_section_.size();
+		rr.n_lane_sections = road->GetNumberOfLaneSections();
+		for (int j = 0; j < road->GetNumberOfLaneSections(); j++)
+		{
+			LaneSection *lane_section = road->GetLaneSectionByIdx(j);
+			LaneSectionRecord lsr;
+			int max_lane_id = 0;
+
+			lsr.s = (Real)lane_section->GetS();
+			lsr.length = (Real)lane_section->GetLength();
+			lsr.first_lane = (int)lane_.size();
+			lsr.n_lanes = lane_section->GetNumberOfLanes();
+			lsr.min_lane_id = 0;
+
+			for (int k = 0; k < lane_section->GetNumberOfLanes(); k++)
+			{
+				Lane *lane = lane_section->GetLaneByIdx(k);
+				LaneRecord lr;
+
+				lr.id = lane->GetId();
+				lr.driving = lane->IsDriving() != 0;
+				lr.first_width = (int)lane_width_.size();
+				lr.n_widths = lane->GetNumberOfWidths();
+				for (int l = 0; l < lane->GetNumberOfWidths(); l++)
+				{
+					LaneWidth *width = lane->GetWidthByIndex(l);
+					lane_width_.push_back(MakePolyRecord(width->GetSOffset(), width->poly3_));
+				}
+
+				// Most lanes of a network share a few width profiles, keep one copy of each
+				if (lr.n_widths > 0)
+				{
+					std::string key((const char*)&lane_width_[lr.first_width], lr.n_widths * sizeof(PolyRecord));
+					std::unordered_map<std::string, int>::iterator it = width_sequence.find(key);
+					if (it != width_sequence.end())
+					{
+						lane_width_.resize(lr.first_width);
+						lr.first_width = it->second;
+						n_shared_widths_ += lr.n_widths;
+					}
+					else
+					{
+						width_sequence.insert(std::make_pair(key, lr.first_width));
+					}
+				}
+				lane_.push_back(lr);
+
+				lsr.min_lane_id = MIN(lsr.min_lane_id, lr.id);
+				max_lane_id = MAX(max_lane_id, lr.id);
+			}
+
+			// Lookup table lane ID -> lane index. In case of duplicate IDs, keep the first one (like LaneSection::GetLaneById)
+			lsr.first_lane_slot = (int)lane_slot_.size();
+			lsr.n_lane_slots = max_lane_id - lsr.min_lane_id + 1;
+			lane_slot_.insert(lane_slot_.end(), lsr.n_lane_slots, -1);
+			for (int k = lsr.n_lanes - 1; k >= 0; k--)
+			{
+				lane_slot_[lsr.first_lane_slot + lane_[lsr.first_lane + k].id - lsr.min_lane_id] = k;
+			}
+
+			lane_section_.push_back(lsr);
+		}
+
+		road_.push_back(rr);
+	}
+
+	valid_ = true;
+}
+
+size_t CompiledOpenDrive::GetMemoryUsage()
+{
+	return road_.size() * sizeof(RoadRecord) +
+		geometry_.size() * sizeof(GeometryRecord) +
+		arc_curvature_.size() * sizeof(Real) +
+		spiral_.size() * sizeof(SpiralParams) +
+		spiral_node_.size() * sizeof(double) +
+		poly3_.size() * sizeof(Poly3Params) +
+		param_poly3_.size() * sizeof(ParamPoly3Params) +
+		(elevation_.size() + lane_offset_.size() + lane_width_.size()) * sizeof(PolyRecord) +
+		lane_section_.size() * sizeof(LaneSectionRecord) +
+		lane_.size() * sizeof(LaneRecord) +
+		lane_slot_.size() * sizeof(int);
+}
+
+CompiledOpenDrive::LaneRecord *CompiledOpenDrive::GetLaneById(LaneSectionRecord *lane_section, int lane_id)
+{
+	int slot = lane_id - lane_section->min_lane_id;
+
+	if (slot < 0 || slot >= lane_section->n_lane_slots || lane_slot_[lane_section->first_lane_slot + slot] < 0)
+	{
+		return 0;
+	}
+
+	return &lane_[lane_section->first_lane + lane_slot_[lane_section->first_lane_slot + slot]];
+}
+
+int CompiledOpenDrive::GetLaneSectionIdxByS(int road_idx, double s)
+{
+	RoadRecord *road = &road_[road_idx];
+
+	return FindRecordByS(lane_section_.data() + road->first_lane_section, road->n_lane_sections, s, 0);
+}
+
+void CompiledOpenDrive::EvaluateStandardSpiral(SpiralParams *sp, double s, double *x, double *y, double *t)
+{
+	if (sp->n_nodes == 0)
+	{
+		odrSpiral(s, sp->c_dot, x, y, t);
+	}
+	else
+	{
+		SpiralTable::Interpolate(&spiral_node_[4 * sp->first_node], sp->n_nodes, sp->table_s_start, sp->table_step, sp->c_dot, s, x, y, t);
+	}
+}
+
+void CompiledOpenDrive::EvaluateGeometryDS(RoadRecord *road, GeometryRecord *geom, double ds, double *x, double *y, double *h)
+{
+	// Same calculations as the EvaluateDS functions of the Geometry classes, but relative to the road origin
+	switch (geom->type)
+	{
+	case Geometry::GEOMETRY_TYPE_LINE:
+	{
+		*h = geom->hdg;
+		*x = road->x0 + (geom->x + ds * cos(*h));
+		*y = road->y0 + (geom->y + ds * sin(*h));
+		break;
+	}
+	case Geometry::GEOMETRY_TYPE_ARC:
+	{
+		double curvature = arc_curvature_[geom->param_idx];
+		double radius = std::fabs(1.0 / curvature);
+		double angle = ds * curvature;
+		double x_local, y_local;
+
+		if (curvature < 0)
+		{
+			x_local = cos(angle + M_PI / 2.0);
+			y_local = sin(angle + M_PI / 2.0) - 1;
+		}
+		else
+		{
+			x_local = cos(angle + 3.0 * M_PI / 2.0);
+			y_local = sin(angle + 3.0 * M_PI / 2.0) + 1;
+		}
+
+		*x = road->x0 + (geom->x + radius * (x_local * cos(geom->hdg) - y_local * sin(geom->hdg)));
+		*y = road->y0 + (geom->y + radius * (x_local * sin(geom->hdg) + y_local * cos(geom->hdg)));
+		*h = geom->hdg + angle;
+		break;
+	}
+	case Geometry::GEOMETRY_TYPE_SPIRAL:
+	{
+		SpiralParams *sp = &spiral_[geom->param_idx];
+		double xTmp, yTmp, t;
+		double h_start = geom->hdg;
+
+		if (abs(sp->curv_end) > abs(sp->curv_start))
+		{
+			EvaluateStandardSpiral(sp, ds + sp->s0, &xTmp, &yTmp, &t);
+			*h = t;
+		}
+		else
+		{
+			double x0, y0, t0, x1, y1, t1;
+
+			EvaluateStandardSpiral(sp, sp->s0 + geom->length, &x0, &y0, &t0);
+			EvaluateStandardSpiral(sp, sp->s0 + geom->length - ds, &x1, &y1, &t1);
+
+			xTmp = x0 - x1;
+			yTmp = y0 - y1;
+			h_start -= t0;
+			*h = t1 - t0;
+		}
+
+		*h += geom->hdg - sp->h0;
+
+		double x1 = xTmp - sp->x0;
+		double y1 = yTmp - sp->y0;
+		double x2 = x1 * cos(-sp->h0) - y1 * sin(-sp->h0);
+		double y2 = x1 * sin(-sp->h0) + y1 * cos(-sp->h0);
+
+		*x = road->x0 + (geom->x + x2 * cos(h_start) - y2 * sin(h_start));
+		*y = road->y0 + (geom->y + x2 * sin(h_start) + y2 * cos(h_start));
+		break;
+	}
+	case Geometry::GEOMETRY_TYPE_POLY3:
+	{
+		Poly3Params *pp = &poly3_[geom->param_idx];
+		double p = (ds / geom->length) * pp->umax;
+		double u_local = p;
+		double v_local = EvaluatePoly(pp->a, pp->b, pp->c, pp->d, p);
+
+		*x = road->x0 + (geom->x + u_local * cos(geom->hdg) - v_local * sin(geom->hdg));
+		*y = road->y0 + (geom->y + u_local * sin(geom->hdg) + v_local * cos(geom->hdg));
+		*h = geom->hdg + EvaluatePolyPrim(pp->b, pp->c, pp->d, p);
+		break;
+	}
+	case Geometry::GEOMETRY_TYPE_PARAM_POLY3:
+	{
+		ParamPoly3Params *pp = &param_poly3_[geom->param_idx];
+		double p = ds * pp->p_scale;
+		double u_local = EvaluatePoly(pp->aU, pp->bU, pp->cU, pp->dU, p);
+		double v_local = EvaluatePoly(pp->aV, pp->bV, pp->cV, pp->dV, p);
+
+		*x = road->x0 + (geom->x + u_local * cos(geom->hdg) - v_local * sin(geom->hdg));
+		*y = road->y0 + (geom->y + u_local * sin(geom->hdg) + v_local * cos(geom->hdg));
+		*h = geom->hdg + atan2(EvaluatePolyPrim(pp->bV, pp->cV, pp->dV, p), EvaluatePolyPrim(pp->bU, pp->cU, pp->dU, p));
+		break;
+	}
+	default:
+		LOG("CompiledOpenDrive::EvaluateGeometryDS Unsupported geometry type %d\n", geom->type);
+		break;
+	}
+}
+
+double CompiledOpenDrive::GetLaneOffset(int road_idx, double s)
+{
+	RoadRecord *road = &road_[road_idx];
+	int i = FindRecordByS(lane_offset_.data() + road->first_lane_offset, road->n_lane_offsets, s, -1);
+
+	if (i < 0)
+	{
+		return 0;
+	}
+
+	PolyRecord *lo = &lane_offset_[road->first_lane_offset + i];
+
+	return EvaluatePoly(lo->a, lo->b, lo->c, lo->d, s - lo->s);
+}
+
+double CompiledOpenDrive::GetLaneOffsetPrim(int road_idx, double s)
+{
+	RoadRecord *road = &road_[road_idx];
+	int i = FindRecordByS(lane_offset_.data() + road->first_lane_offset, road->n_lane_offsets, s, -1);
+
+	if (i < 0)
+	{
+		return 0;
+	}
+
+	PolyRecord *lo = &lane_offset_[road->first_lane_offset + i];
+
+	return EvaluatePolyPrim(lo->b, lo->c, lo->d, s - lo->s);
+}
+
+bool CompiledOpenDrive::GetZAndPitchByS(int road_idx, double s, double *z, double *pitch, int *index)
+{
+	RoadRecord *road = &road_[road_idx];
+	int i = FindRecordByS(elevation_.data() + road->first_elevation, road->n_elevations, s, *index);
+
+	if (i < 0)
+	{
+		return false;
+	}
+
+	PolyRecord *elevation = &elevation_[road->first_elevation + i];
+	double p = s - elevation->s;
+
+	*index = i;
+	*z = EvaluatePoly(elevation->a, elevation->b, elevation->c, elevation->d, p);
+	*pitch = -EvaluatePolyPrim(elevation->b, elevation->c, elevation->d, p);
+
+	return true;
+}
+
+CompiledOpenDrive::PolyRecord *CompiledOpenDrive::GetLaneWidthByS(LaneRecord *lane, double ds)
+{
+	int i = FindRecordByS(lane_width_.data() + lane->first_width, lane->n_widths, ds, -1);
+
+	return i < 0 ? 0 : &lane_width_[lane->first_width + i];
+}
+
+double CompiledOpenDrive::GetWidth(LaneSectionRecord *lane_section, double s, int lane_id)
+{
+	if (lane_id == 0)
+	{
+		return 0.0;  // reference lane has no width
+	}
+
+	LaneRecord *lane = GetLaneById(lane_section, lane_id);
+	if (lane == 0)
+	{
+		LOG("Error (lane id %d)\n", lane_id);
+		return 0.0;
+	}
+
+	PolyRecord *width = GetLaneWidthByS(lane, s - lane_section->s);
+	if (width == 0)
+	{
+		return 0.0;
+	}
+
+	return EvaluatePoly(width->a, width->b, width->c, width->d, s - (lane_section->s + width->s));
+}
+
+double CompiledOpenDrive::GetOuterOffset(LaneSectionRecord *lane_section, double s, int lane_id)
+{
+	int step = lane_id < 0 ? +1 : -1;
+	double offset = 0;
+
+	// Sum in the same order as LaneSection::GetOuterOffset, from inner lane outwards
+	for (int id = SIGN(lane_id); id != lane_id - step; id -= step)
+	{
+		offset = GetWidth(lane_section, s, id) + offset;
+	}
+
+	return offset;
+}
+
+void CompiledOpenDrive::GetLaneOffsets(LaneSectionRecord *lane_section, double s, double *outer_offset, double *width)
+{
+	LaneValueBuffer offset(lane_section->n_lane_slots);
+
+	for (int i = 0; i < lane_section->n_lane_slots; i++)
+	{
+		offset[i] = 0.0;
+	}
+
+	for (int i = 0; i < lane_section->n_lanes; i++)
+	{
+		LaneRecord *lane = GetLaneByIdx(lane_section, i);
+		PolyRecord *lane_width = lane->id == 0 ? 0 : GetLaneWidthByS(lane, s - lane_section->s);
+
+		width[i] = lane_width ? EvaluatePoly(lane_width->a, lane_width->b, lane_width->c, lane_width->d, s - (lane_section->s + lane_width->s)) : 0.0;
+		offset[lane->id - lane_section->min_lane_id] = width[i];
+	}
+
+	AccumulateLaneOffsets(offset.Data(), lane_section->min_lane_id, lane_section->min_lane_id + lane_section->n_lane_slots - 1);
+
+	for (int i = 0; i < lane_section->n_lanes; i++)
+	{
+		outer_offset[i] = offset[GetLaneByIdx(lane_section, i)->id - lane_section->min_lane_id];
+	}
+}
+
+double CompiledOpenDrive::GetCenterOffset(LaneSectionRecord *lane_section, double s, int lane_id)
+{
+	if (lane_id == 0)
+	{
+		return 0.0;
+	}
+
+	return GetOuterOffset(lane_section, s, lane_id) - GetWidth(lane_section, s, lane_id) / 2;
+}
+
+double CompiledOpenDrive::GetOuterOffsetHeading(LaneSectionRecord *lane_section, double s, int lane_id)
+{
+	int step = lane_id < 0 ? +1 : -1;
+	double heading = 0;
+
+	for (int id = SIGN(lane_id); id != lane_id - step; id -= step)
+	{
+		LaneRecord *lane = GetLaneById(lane_section, id);
+		if (lane == 0)
+		{
+			LOG("CompiledOpenDrive::GetOuterOffsetHeading Error (lane id %d)\n", id);
+			heading = 0.0;  // like LaneSection::GetOuterOffsetHeading, ignore any lanes inside this one
+			continue;
+		}
+
+		PolyRecord *width = GetLaneWidthByS(lane, s - lane_section->s);
+		if (width == 0)
+		{
+			heading = 0.0;
+			continue;
+		}
+
+		heading = EvaluatePolyPrim(width->b, width->c, width->d, s - (lane_section->s + width->s)) + heading;
+	}
+
+	return heading;
+}
+
+double CompiledOpenDrive::GetCenterOffsetHeading(LaneSectionRecord *lane_section, double s, int lane_id)
+{
+	int step = lane_id < 0 ? +1 : -1;
+
+	if (lane_id == 0)
+	{
+		return 0.0;
+	}
+
+	return (GetOuterOffsetHeading(lane_section, s, lane_id + step) + GetOuterOffsetHeading(lane_section, s, lane_id)) / 2;
+}
+
+void LaneGraph::Clear()
+{
+	node_.clear();
+	edge_.clear();
+	road_first_lane_section_.clear();
+	lane_section_first_node_.clear();
+	valid_ = false;
+}
+
+int LaneGraph::FindEdges(OpenDrive *od, Road *road, Lane *lane, RoadLink *road_link, std::vector<LaneGraphEdge> &edges)
+{
+	LaneGraphEdge edge;
+	int n = 0;
+
+	edge.node_idx = -1;
+
+	if (road_link == 0 || road_link->GetElementId() == -1)
+	{
+		return 0;
+	}
+
+	if (road_link->GetElementType() == RoadLink::ELEMENT_TYPE_ROAD)
+	{
+		Road *next_road = od->GetRoadById(road_link->GetElementId());
+		LaneLink *lane_link = lane->GetLink(road_link->GetType());
+
+		edge.road_idx = next_road ? od->GetTrackIdxById(next_road->GetId()) : -1;
+		edge.lane_id = lane_link ? lane_link->GetId() : 0;
+		edge.contact_point = road_link->GetContactPointType();
+		edges.push_back(edge);
+		n++;
+	}
+	else if (road_link->GetElementType() == RoadLink::ELEMENT_TYPE_JUNCTION)
+	{
+		Junction *junction = od->GetJunctionById(road_link->GetElementId());
+
+		if (junction == 0)
+		{
+			LOG("Error: junction %d not existing\n", road_link->GetElementId());
+			return 0;
+		}
+
+		// Same order as Junction::GetRoadConnectionByIdx()
+		for (int i = 0; i < junction->GetNumberOfConnections(); i++)
+		{
+			Connection *connection = junction->GetConnectionByIdx(i);
+
+			// Skip connections whose connecting road did not resolve, e.g. a malformed map
+			if (connection->GetIncomingRoadHeader() == 0 || connection->GetIncomingRoadHeader()->GetId() != road->GetId() ||
+				connection->GetConnectingRoadHeader() == 0)
+			{
+				continue;
+			}
+
+			for (int j = 0; j < connection->GetNumberOfLaneLinks(); j++)
+			{
+				JunctionLaneLink *lane_link = connection->GetLaneLink(j);
+				if (lane_link->from_ != lane->GetId())
+				{
+					continue;
+				}
+
+				edge.road_idx = od->GetTrackIdxById(connection->GetConnectingRoadHeader()->GetId());
+				edge.lane_id = lane_link->to_;
+				edge.contact_point = connection->GetContactPoint();
+				edges.push_back(edge);
+				n++;
+			}
+		}
+	}
+
+	return n;
+}
+
+void LaneGraph::Build(OpenDrive *od)
+{
+	LinkType link_type[2] = { SUCCESSOR, PREDECESSOR };
+
+	Clear();
+
+	// Nodes, one per lane, in order of road, lane section and lane index
+	for (int i = 0; i < od->GetNumOfRoads(); i++)
+	{
+		Road *road = od->GetRoadByIdx(i);
+
+		road_first_lane_section_.push_back((int)lane_section_first_node_.size());
+		for (int j = 0; j < road->GetNumberOfLaneSections(); j++)
+		{
+			LaneSection *lane_section = road->GetLaneSectionByIdx(j);
+
+			lane_section_first_node_.push_back((int)node_.size());
+			for (int k = 0; k < lane_section->GetNumberOfLanes(); k++)
+			{
+				LaneGraphNode node;
+				node.road_idx = i;
+				node.lane_section_idx = j;
+				node.lane_id = lane_section->GetLaneByIdx(k)->GetId();
+				node_.push_back(node);
+			}
+		}
+	}
+	road_first_lane_section_.push_back((int)lane_section_first_node_.size());
+	lane_section_first_node_.push_back((int)node_.size());
+
+	// Edges, grouped per node and link type
+	for (int i = 0; i < (int)node_.size(); i++)
+	{
+		Road *road = od->GetRoadByIdx(node_[i].road_idx);
+		LaneSection *lane_section = road->GetLaneSectionByIdx(node_[i].lane_section_idx);
+		Lane *lane = lane_section->GetLaneByIdx(i - lane_section_first_node_[road_first_lane_section_[node_[i].road_idx] + node_[i].lane_section_idx]);
+
+		for (int j = 0; j < 2; j++)
+		{
+			node_[i].first_edge[j] = (int)edge_.size();
+			node_[i].n_edges[j] = FindEdges(od, road, lane, road->GetLink(link_type[j]), edge_);
+		}
+	}
+
+	// Connect edges to the nodes of the lanes they lead to
+	for (size_t i = 0; i < edge_.size(); i++)
+	{
+		LaneGraphEdge *edge = &edge_[i];
+		if (edge->road_idx < 0 || edge->lane_id == 0)
+		{
+			continue;
+		}
+
+		int n_lane_sections = road_first_lane_section_[edge->road_idx + 1] - road_first_lane_section_[edge->road_idx];
+		int lane_section_idx = 0;
+		if (edge->contact_point == CONTACT_POINT_END)
+		{
+			lane_section_idx = n_lane_sections - 1;
+		}
+		else if (edge->contact_point != CONTACT_POINT_START)
+		{
+			continue;
+		}
+
+		for (int j = GetNodeIdx(edge->road_idx, lane_section_idx, 0); j >= 0 && j < (int)node_.size() &&
+			node_[j].road_idx == edge->road_idx && node_[j].lane_section_idx == lane_section_idx; j++)
+		{
+			if (node_[j].lane_id == edge->lane_id)
+			{
+				edge->node_idx = j;
+				break;
+			}
+		}
+	}
+
+	valid_ = true;
+}
+
+int LaneGraph::GetNodeIdx(int road_idx, int lane_section_idx, int lane_idx)
+{
+	if (road_idx < 0 || road_idx >= (int)road_first_lane_section_.size() - 1)
+	{
+		return -1;
+	}
+
+	int ls = road_first_lane_section_[road_idx] + lane_section_idx;
+	if (lane_section_idx < 0 || ls >= road_first_lane_section_[road_idx + 1])
+	{
+		return -1;
+	}
+
+	int node_idx = lane_section_first_node_[ls] + lane_idx;
+	if (lane_idx < 0 || node_idx >= lane_section_first_node_[ls + 1])
+	{
+		return -1;
+	}
+
+	return node_idx;
+}
+
+static void EvaluateRoadSample(Road *road, double s, RoadSample *sample)
+{
+	Geometry *geom = road->GetGeometry(road->GetGeometryIdxByS(s));
+	double pitch = 0;
+	int elevation_idx = 0;
+
+	sample->s = s;
+	geom->EvaluateDS(s - geom->GetS(), &sample->x, &sample->y, &sample->h);
+	sample->cos_h = cos(sample->h);
+	sample->sin_h = sin(sample->h);
+	sample->lane_offset = road->GetLaneOffset(s);
+	sample->lane_offset_prim = road->GetLaneOffsetPrim(s);
+	sample->z = 0;
+	road->GetZAndPitchByS(s, &sample->z, &pitch, &elevation_idx);
+	sample->z_prim = -pitch;
+}
+
+static void InterpolateRoadSample(RoadSample &a, RoadSample &b, double s, RoadSample *sample)
+{
+	double len = b.s - a.s;
+
+	if (len < SMALL_NUMBER)
+	{
+		*sample = a;
+		sample->s = s;
+		return;
+	}
+
+	// Cubic Hermite interpolation, using heading and derivatives at the samples
+	double tau = (s - a.s) / len;
+	double tau2 = tau * tau;
+	double tau3 = tau2 * tau;
+	double h00 = 2 * tau3 - 3 * tau2 + 1;
+	double h10 = (tau3 - 2 * tau2 + tau) * len;
+	double h01 = -2 * tau3 + 3 * tau2;
+	double h11 = (tau3 - tau2) * len;
+	double dh = b.h - a.h;
+
+	if (dh > M_PI)
+	{
+		dh -= 2 * M_PI;
+	}
+	else if (dh < -M_PI)
+	{
+		dh += 2 * M_PI;
+	}
+
+	sample->s = s;
+	sample->x = h00 * a.x + h10 * a.cos_h + h01 * b.x + h11 * b.cos_h;
+	sample->y = h00 * a.y + h10 * a.sin_h + h01 * b.y + h11 * b.sin_h;
+	sample->h = a.h + tau * dh;
+	sample->cos_h = cos(sample->h);
+	sample->sin_h = sin(sample->h);
+	sample->lane_offset = h00 * a.lane_offset + h10 * a.lane_offset_prim + h01 * b.lane_offset + h11 * b.lane_offset_prim;
+	sample->lane_offset_prim = a.lane_offset_prim + tau * (b.lane_offset_prim - a.lane_offset_prim);
+	sample->z = h00 * a.z + h10 * a.z_prim + h01 * b.z + h11 * b.z_prim;
+	sample->z_prim = a.z_prim + tau * (b.z_prim - a.z_prim);
+}
+
+static double RoadSampleError(RoadSample &exact, RoadSample &approx)
+{
+	// Position error of the lane offset reference point, plus heading error at some distance from it
+	double dx = exact.x - exact.lane_offset * exact.sin_h - (approx.x - approx.lane_offset * approx.sin_h);
+	double dy = exact.y + exact.lane_offset * exact.cos_h - (approx.y + approx.lane_offset * approx.cos_h);
+
+	return MAX(sqrt(dx * dx + dy * dy) + fabs(GetAngleDifference(exact.h, approx.h)) * TESSELLATION_HEADING_ARM, fabs(exact.z - approx.z));
+}
+
+void RoadTessellation::Subdivide(Road *road, RoadSample &s0, RoadSample &s1, double tolerance, int depth)
+{
+	RoadSample mid, exact, approx;
+	double max_error = 0;
+
+	EvaluateRoadSample(road, (s0.s + s1.s) / 2, &mid);
+
+	for (int i = 1; i < 4; i++)
+	{
+		if (i == 2)
+		{
+			exact = mid;
+		}
+		else
+		{
+			EvaluateRoadSample(road, s0.s + (s1.s - s0.s) * i / 4, &exact);
+		}
+		InterpolateRoadSample(s0, s1, exact.s, &approx);
+		max_error = MAX(max_error, RoadSampleError(exact, approx));
+	}
+
+	if (max_error > tolerance && depth < TESSELLATION_MAX_DEPTH)
+	{
+		Subdivide(road, s0, mid, tolerance, depth + 1);
+		sample_.push_back(mid);
+		Subdivide(road, mid, s1, tolerance, depth + 1);
+	}
+}
+
+int RoadTessellation::Build(Road *road, double tolerance)
+{
+	std::vector<double> breakpoints;
+	RoadSample sample;
+
+	sample_.clear();
+	max_error_ = 0;
+	elevation_ = road->GetNumberOfElevations() > 0;
+
+	if (road->GetNumberOfGeometries() == 0)
+	{
+		return -1;
+	}
+
+	// Always sample where any road attribute record starts, since the derivatives might not be continuous there
+	for (int i = 0; i < road->GetNumberOfGeometries(); i++)
+	{
+		breakpoints.push_back(road->GetGeometry(i)->GetS());
+	}
+	for (int i = 0; i < road->GetNumberOfElevations(); i++)
+	{
+		breakpoints.push_back(road->GetElevation(i)->GetS());
+	}
+	for (int i = 0; i < road->GetNumberOfLaneOffsets(); i++)
+	{
+		breakpoints.push_back(road->GetLaneOffsetByIdx(i)->GetS());
+	}
+	breakpoints.push_back(0);
+	breakpoints.push_back(road->GetLength());
+	std::sort(breakpoints.begin(), breakpoints.end());
+
+	EvaluateRoadSample(road, 0, &sample);
+	sample_.push_back(sample);
+
+	for (size_t i = 1; i < breakpoints.size(); i++)
+	{
+		double s_end = MIN(breakpoints[i], road->GetLength());
+		double s_start = sample_.back().s;
+
+		if (s_end - s_start < SMALL_NUMBER)
+		{
+			continue;
+		}
+
+		int n_steps = (int)ceil((s_end - s_start) / TESSELLATION_MAX_STEP);
+		for (int j = 1; j <= n_steps; j++)
+		{
+			RoadSample prev = sample_.back();
+
+			EvaluateRoadSample(road, j == n_steps ? s_end : s_start + (s_end - s_start) * j / n_steps, &sample);
+			Subdivide(road, prev, sample, tolerance, 0);
+			sample_.push_back(sample);
+		}
+	}
+
+	// Measure actual error, at points not used when sampling
+	for (size_t i = 0; i + 1 < sample_.size(); i++)
+	{
+		for (int j = 1; j < TESSELLATION_CHECK_POINTS; j++)
+		{
+			max_error_ = MAX(max_error_, GetError(road, sample_[i].s + (sample_[i + 1].s - sample_[i].s) * (j + 0.5) / TESSELLATION_CHECK_POINTS));
+		}
+	}
+
+	return 0;
+}
+
+double RoadTessellation::GetError(Road *road, double s)
+{
+	RoadSample exact, approx;
+
+	EvaluateRoadSample(road, s, &exact);
+	Evaluate(s, &approx);
+
+	return RoadSampleError(exact, approx);
+}
+
+void RoadTessellation::Evaluate(double s, RoadSample *sample)
+{
+	int i = FindRecordByS(sample_.data(), (int)sample_.size(), s, -1);
+
+	if (i < 0)
+	{
+		return;
+	}
+	if (i == (int)sample_.size() - 1)
+	{
+		i = MAX(0, i - 1);
+	}
+
+	InterpolateRoadSample(sample_[i], sample_[i + 1 < (int)sample_.size() ? i + 1 : i], s, sample);
+}
+
+// Lateral position of the outermost lane borders, relative the reference line
+static void GetRoadLateralExtent(Road *road, double s, double lane_offset, double *t_min, double *t_max)
+{
+	LaneSection *lane_section = road->GetLaneSectionByS(s);
+
+	*t_min = *t_max = lane_offset;
+
+	if (lane_section == 0)
+	{
+		return;
+	}
+
+	LaneValueBuffer outer_offset(lane_section->GetNumberOfLanes());
+	LaneValueBuffer width(lane_section->GetNumberOfLanes());
+
+	lane_section->GetLaneOffsets(s, outer_offset.Data(), width.Data());
+
+	for (int i = 0; i < lane_section->GetNumberOfLanes(); i++)
+	{
+		double t = lane_offset + SIGN(lane_section->GetLaneIdByIdx(i)) * outer_offset[i];
+		*t_min = MIN(*t_min, t);
+		*t_max = MAX(*t_max, t);
+	}
+}
+
+void HeightGrid::Clear()
+{
+	block_.clear();
+	resolution_ = 0;
+	max_error_ = 0;
+	n_nodes_ = 0;
+	n_ambiguous_ = 0;
+}
+
+HeightGrid::Block *HeightGrid::GetBlock(int i, int j)
+{
+	int bi = (int)floor((double)i / HEIGHT_GRID_BLOCK_SIZE);
+	int bj = (int)floor((double)j / HEIGHT_GRID_BLOCK_SIZE);
+	std::unordered_map<long long, Block>::iterator it =
+		block_.find(GetBlockKey(bi, bj));
+
+	return it == block_.end() ? 0 : &it->second;
+}
+
+void HeightGrid::SetNode(int i, int j, double z, bool on_road)
+{
+	// Node state: 0 not set, 1 set from outside a road edge, 2 set from a road surface,
+	// 3 road surfaces of different heights. Road surfaces take precedence over the margins.
+	int bi = (int)floor((double)i / HEIGHT_GRID_BLOCK_SIZE);
+	int bj = (int)floor((double)j / HEIGHT_GRID_BLOCK_SIZE);
+	Block &block = block_[GetBlockKey(bi, bj)];
+
+	if (block.z.empty())
+	{
+		block.z.resize(HEIGHT_GRID_BLOCK_SIZE * HEIGHT_GRID_BLOCK_SIZE, 0.0f);
+		block.state.resize(HEIGHT_GRID_BLOCK_SIZE * HEIGHT_GRID_BLOCK_SIZE, 0);
+	}
+
+	int k = (j - bj * HEIGHT_GRID_BLOCK_SIZE) * HEIGHT_GRID_BLOCK_SIZE + (i - bi * HEIGHT_GRID_BLOCK_SIZE);
+
+	if (block.state[k] == 0)
+	{
+		n_nodes_++;
+	}
+
+	if (on_road)
+	{
+		if (block.state[k] < 2)
+		{
+			block.z[k] = (float)z;
+			block.state[k] = 2;
+		}
+		else if (block.state[k] == 2 && fabs(block.z[k] - z) > HEIGHT_GRID_MAX_HEIGHT_DIFF)
+		{
+			block.state[k] = 3;
+			n_ambiguous_++;
+		}
+	}
+	else if (block.state[k] == 0)
+	{
+		block.z[k] = (float)z;
+		block.state[k] = 1;
+	}
+}
+
+void HeightGrid::AddRoad(Road *road)
+{
+	// Step along the road in strips shorter than a cell. Nodes within the lateral extent of a strip are
+	// mapped to road coordinates by the strip start point, heading and curvature.
+	int n_strips = MAX(1, (int)ceil(road->GetLength() / (resolution_ / 2)));
+	double margin = HEIGHT_GRID_MARGIN * resolution_;
+	int elevation_idx = 0;
+	RoadSample sample0;
+	RoadSample sample1;
+
+	EvaluateRoadSample(road, 0, &sample1);
+
+	for (int k = 0; k < n_strips; k++)
+	{
+		double s0 = road->GetLength() * k / n_strips;
+		double s1 = road->GetLength() * (k + 1) / n_strips;
+		double ds = s1 - s0;
+		double t_min, t_max, t_min1, t_max1;
+
+		sample0 = sample1;
+		EvaluateRoadSample(road, s1, &sample1);
+
+		double curvature = GetAngleDifference(sample1.h, sample0.h) / ds;
+		GetRoadLateralExtent(road, s0, sample0.lane_offset, &t_min, &t_max);
+		GetRoadLateralExtent(road, s1, sample1.lane_offset, &t_min1, &t_max1);
+		t_min = MIN(t_min, t_min1);
+		t_max = MAX(t_max, t_max1);
+
+		// Nodes in the strip, extended by the margin also before the start and beyond the end of the road
+		double along_min = k == 0 ? -margin : -ds / 4;
+		double along_max = k == n_strips - 1 ? ds + margin : ds + ds / 4;
+		double x_min = std::numeric_limits<double>::infinity();
+		double y_min = std::numeric_limits<double>::infinity();
+		double x_max = -std::numeric_limits<double>::infinity();
+		double y_max = -std::numeric_limits<double>::infinity();
+		double corner_t[2] = { t_min - margin, t_max + margin };
+		for (int a = 0; a < 2; a++)
+		{
+			double along = a == 0 ? along_min : along_max * (1 + fabs(curvature) * MAX(-corner_t[0], corner_t[1]));
+			for (int b = 0; b < 2; b++)
+			{
+				double x = sample0.x + along * sample0.cos_h - corner_t[b] * sample0.sin_h;
+				double y = sample0.y + along * sample0.sin_h + corner_t[b] * sample0.cos_h;
+				x_min = MIN(x_min, x);
+				y_min = MIN(y_min, y);
+				x_max = MAX(x_max, x);
+				y_max = MAX(y_max, y);
+			}
+		}
+
+		for (int i = (int)floor(x_min / resolution_); i <= (int)ceil(x_max / resolution_); i++)
+		{
+			for (int j = (int)floor(y_min / resolution_); j <= (int)ceil(y_max / resolution_); j++)
+			{
+				double dx = i * resolution_ - sample0.x;
+				double dy = j * resolution_ - sample0.y;
+				double t = -dx * sample0.sin_h + dy * sample0.cos_h;
+				double scale = 1 - curvature * t;
+
+				if (t < t_min - margin || t > t_max + margin || scale < SMALL_NUMBER)
+				{
+					continue;
+				}
+
+				double along = (dx * sample0.cos_h + dy * sample0.sin_h) / scale;
+				if (along < along_min || along > along_max)
+				{
+					continue;
+				}
+
+				double s = CLAMP(s0 + along, 0.0, road->GetLength());
+				double z = 0;
+				double pitch = 0;
+				road->GetZAndPitchByS(s, &z, &pitch, &elevation_idx);
+
+				SetNode(i, j, z, t >= t_min && t <= t_max && s0 + along >= 0 && s0 + along <= road->GetLength());
+			}
+		}
+	}
+}
+
+double HeightGrid::GetRoadError(Road *road)
+{
+	// Compare with exact height in between nodes, across all lanes
+	int n_samples = MAX(1, (int)ceil(road->GetLength() / resolution_));
+	double max_error = 0;
+	RoadSample sample;
+
+	for (int k = 0; k < n_samples; k++)
+	{
+		double t_min, t_max;
+
+		EvaluateRoadSample(road, road->GetLength() * (k + 0.5) / n_samples, &sample);
+		GetRoadLateralExtent(road, sample.s, sample.lane_offset, &t_min, &t_max);
+
+		int n_lateral = (int)ceil((t_max - t_min) / resolution_);
+		for (int i = 0; i < n_lateral; i++)
+		{
+			double t = t_min + (t_max - t_min) * (i + 0.5) / n_lateral;
+			double z = 0;
+
+			if (GetHeight(sample.x - t * sample.sin_h, sample.y + t * sample.cos_h, &z) == 0)
+			{
+				max_error = MAX(max_error, fabs(z - sample.z));
+			}
+		}
+	}
+
+	return max_error;
+}
+
+int HeightGrid::Build(OpenDrive *od, double resolution)
+{
+	Clear();
+
+	if (resolution <= 0)
+	{
+		return -1;
+	}
+
+	resolution_ = resolution;
+
+	for (int i = 0; i < od->GetNumOfRoads(); i++)
+	{
+		Road *road = od->GetRoadByIdx(i);
+		if (road->GetNumberOfGeometries() > 0 && road->GetLength() > SMALL_NUMBER)
+		{
+			AddRoad(road);
+		}
+	}
+
+	for (int i = 0; i < od->GetNumOfRoads(); i++)
+	{
+		Road *road = od->GetRoadByIdx(i);
+		if (road->GetNumberOfGeometries() > 0 && road->GetLength() > SMALL_NUMBER)
+		{
+			max_error_ = MAX(max_error_, GetRoadError(road));
+		}
+	}
+
+	return 0;
+}
+
+int HeightGrid::GetHeight(double x, double y, double *z, double *normal_x, double *normal_y, double *normal_z)
+{
+	if (resolution_ <= 0)
+	{
+		return -1;
+	}
+
+	double u = x / resolution_;
+	double v = y / resolution_;
+	int i = (int)floor(u);
+	int j = (int)floor(v);
+	double node_z[4];  // (i, j), (i + 1, j), (i, j + 1), (i + 1, j + 1)
+
+	u -= i;
+	v -= j;
+
+	// Usually all four nodes are in the same block
+	Block *block = 0;
+	int bi = (int)floor((double)i / HEIGHT_GRID_BLOCK_SIZE);
+	int bj = (int)floor((double)j / HEIGHT_GRID_BLOCK_SIZE);
+	int li = i - bi * HEIGHT_GRID_BLOCK_SIZE;
+	int lj = j - bj * HEIGHT_GRID_BLOCK_SIZE;
+	if (li < HEIGHT_GRID_BLOCK_SIZE - 1 && lj < HEIGHT_GRID_BLOCK_SIZE - 1)
+	{
+		block = GetBlock(i, j);
+		if (block == 0)
+		{
+			return -1;
+		}
+	}
+
+	for (int k = 0; k < 4; k++)
+	{
+		Block *node_block = block;
+		int ni = li + (k & 1);
+		int nj = lj + (k >> 1);
+
+		if (node_block == 0)
+		{
+			node_block = GetBlock(i + (k & 1), j + (k >> 1));
+			ni = (i + (k & 1)) - (int)floor((double)(i + (k & 1)) / HEIGHT_GRID_BLOCK_SIZE) * HEIGHT_GRID_BLOCK_SIZE;
+			nj = (j + (k >> 1)) - (int)floor((double)(j + (k >> 1)) / HEIGHT_GRID_BLOCK_SIZE) * HEIGHT_GRID_BLOCK_SIZE;
+		}
+
+		if (node_block == 0)
+		{
+			return -1;
+		}
+
+		int idx = nj * HEIGHT_GRID_BLOCK_SIZE + ni;
+		if (node_block->state[idx] == 0 || node_block->state[idx] == 3)
+		{
+			return -1;
+		}
+		node_z[k] = node_block->z[idx];
+	}
+
+	// Cell crossing the edge of a road above or below another one, e.g. a bridge
+	if (MAX(MAX(node_z[0], node_z[1]), MAX(node_z[2], node_z[3])) - MIN(MIN(node_z[0], node_z[1]), MIN(node_z[2], node_z[3])) >
+		HEIGHT_GRID_MAX_HEIGHT_DIFF)
+	{
+		return -1;
+	}
+
+	*z = (1 - v) * ((1 - u) * node_z[0] + u * node_z[1]) + v * ((1 - u) * node_z[2] + u * node_z[3]);
+
+	if (normal_x || normal_y || normal_z)
+	{
+		// Gradient of the interpolated surface
+		double dzdx = ((1 - v) * (node_z[1] - node_z[0]) + v * (node_z[3] - node_z[2])) / resolution_;
+		double dzdy = ((1 - u) * (node_z[2] - node_z[0]) + u * (node_z[3] - node_z[1])) / resolution_;
+		double len = sqrt(dzdx * dzdx + dzdy * dzdy + 1);
+
+		if (normal_x)
+		{
+			*normal_x = -dzdx / len;
+		}
+		if (normal_y)
+		{
+			*normal_y = -dzdy / len;
+		}
+		if (normal_z)
+		{
+			*normal_z = 1 / len;
+		}
+	}
+
+	return 0;
+}
+
+static double GetRoadHeadingAtS(Road *road, double s)
+{
+	// Heading of the reference line, including lane offset, i.e. same as a lane 0 position
+	double x, y, h;
+	Geometry *geom = road->GetGeometry(road->GetGeometryIdxByS(s));
+
+	geom->EvaluateDS(s - geom->GetS(), &x, &y, &h);
+
+	return h + atan(road->GetLaneOffsetPrim(s));
+}
+
+bool OpenDrive::LoadOpenDriveFile(const char *filename, bool replace)
+{
+	// Road data is about to change, drop compiled form, lane graph, path cache, landmarks, tessellation and height grid until loading is done
+	compiled_.Clear();
+	lane_graph_.Clear();
+	ClearRoadPathCache();
+	ComputeLandmarks(0);
+	tessellation_.clear();
+	height_grid_.Clear();
+
+	if (replace)
+	{
+		for (size_t i=0; i<road_.size(); i++)
+		{
+			delete road_[i];
+		}
+		road_.clear();
+		road_idx_by_id_.clear();
+
+		for (size_t i=0; i<junction_.size(); i++)
+		{
+			delete junction_[i];
+		}
+		junction_.clear();
+		junction_idx_by_id_.clear();
+
+		// All objects are gone, release their memory in one go
+		arena_.Clear();
+
+		ClearRoadTiles();
+		tiled_ = tile_memory_budget_ > 0;
+	}
+
+	odr_filename_ = filename;
+	loaded_from_cache_ = false;
+
+	if (odr_filename_ == "")
+	{
+		return false;
+	}
+
+	std::vector<GeometryBBox> bbox;
+	bool adding_roads = road_.size() > 0;
+	if (binary_cache_enabled_ && !tiled_ && LoadBinaryCache(GetBinaryCacheFilename(odr_filename_).c_str(), bbox) == 0)
+	{
+		loaded_from_cache_ = true;
+
+		// Cached bounding boxes cover the cached roads only, not valid when adding to an existing network
+		FinishLoading(adding_roads ? 0 : &bbox);
+
+		return true;
+	}
+
+	if (tiled_)
+	{
+		// Road content is dropped while loading, so parse one road at a time instead of the whole document
+		LoadTiledOpenDriveFile(filename);
+
+		return true;
+	}
+
+	pugi::xml_document doc;
+	pugi::xml_parse_result result = doc.load_file(filename);
+	if (!result)
+	{
+		// Try current folder
+		std::string path = std::string(filename);
+		std::string base_filename = path.substr(path.find_last_of("/\\") + 1);
+		LOG("Failed to load %s - looking for file %s in current folder", filename, base_filename.c_str());
+		pugi::xml_parse_result result = doc.load_file(base_filename.c_str());
+
+		if (!result)
+		{
+			throw std::invalid_argument(std::string("Failed to load OpenDRIVE file ") + std::string(filename));
+
+			return false;
+		}
+	}
+
+	pugi::xml_node node = doc.child("OpenDRIVE");
+	if (node == NULL)
+	{
+		cout << "Root null" << endl;
+		throw std::invalid_argument("The file does not seem to be an OpenDRIVE");
+	}
+
+	for (pugi::xml_node road_node = node.child("road"); road_node; road_node = road_node.next_sibling("road"))
+	{
+		Road *r = ParseRoad(road_node, arena_);
+
+		// In case of duplicate IDs, keep the first one
+		road_idx_by_id_.insert(std::make_pair(r->GetId(), (int)road_.size()));
+		road_.push_back(r);
+	}
+
+	for (pugi::xml_node junction_node = node.child("junction"); junction_node; junction_node = junction_node.next_sibling("junction"))
+	{
+		ParseJunction(junction_node);
+	}
+
+	// CheckConnections();
+
+	FinishLoading();
+
+	return true;
+}
+
+Road *OpenDrive::ParseRoad(pugi::xml_node road_node, Arena &content_arena)
+{
+	Road *r = new (arena_) Road(atoi(road_node.attribute("id").value()), road_node.attribute("name").value());
+	r->SetLength(atof(road_node.attribute("length").value()));
+	r->SetJunction(atoi(road_node.attribute("junction").value()));
+
+	for (pugi::xml_node type_node = road_node.child("type"); type_node; type_node = type_node.next_sibling("type"))
+	{
+		RoadTypeEntry *r_type = new (arena_) RoadTypeEntry();
+		
+		std::string type = type_node.attribute("type").value();
+		if (type == "unknown")
+		{
+			r_type->road_type_ = roadmanager::RoadType::ROADTYPE_UNKNOWN;
+		}
+		else if (type == "rural")
+		{
+			r_type->road_type_ = roadmanager::RoadType::ROADTYPE_RURAL;
+		}
+		else if (type == "motorway")
+		{
+			r_type->road_type_ = roadmanager::RoadType::ROADTYPE_MOTORWAY;
+		}
+		else if (type == "town")
+		{
+			r_type->road_type_ = roadmanager::RoadType::ROADTYPE_TOWN;
+		}
+		else if (type == "lowSpeed")
+		{
+			r_type->road_type_ = roadmanager::RoadType::ROADTYPE_LOWSPEED;
+		}
+		else if (type == "pedestrian")
+		{
+			r_type->road_type_ = roadmanager::RoadType::ROADTYPE_PEDESTRIAN;
+		}
+		else if (type == "bicycle")
+		{
+			r_type->road_type_ = roadmanager::RoadType::ROADTYPE_BICYCLE;
+		}
+		else if (type == "")
+		{
+			LOG("Missing road type - setting default (rural)");
+			r_type->road_type_ = roadmanager::RoadType::ROADTYPE_RURAL;
+		}
+		else
+		{
+			LOG("Unsupported road type: %s - assuming rural", type.c_str());
+			r_type->road_type_ = roadmanager::RoadType::ROADTYPE_RURAL;
+		}
+
+		r_type->s_ = atof(type_node.attribute("s").value());
+
+		// Check for optional speed record
+		pugi::xml_node speed = type_node.child("speed");
+		if (speed != NULL)
+		{
+			r_type->speed_ = atof(speed.attribute("max").value());
+			std::string unit = speed.attribute("unit").value();
+			if (unit == "km/h")
+			{
+				r_type->speed_ /= 3.6;  // Convert to m/s
+			}
+			else if (unit == "mph")
+			{
+				r_type->speed_ *= 0.44704; // Convert to m/s
+			}
+			else if (unit == "m/s")
+			{
+				// SE unit - do nothing
+			}
+			else 
+			{
+				LOG("Unsupported speed unit: %s - assuming SE unit m/s", unit.c_str());
+			}
+		}
+
+		r->AddRoadType(r_type);
+	}
+
+	pugi::xml_node link = road_node.child("link");
+	if (link != NULL)
+	{
+		pugi::xml_node successor = link.child("successor");
+		if (successor != NULL)
+		{
+			r->AddLink(new (arena_) RoadLink(SUCCESSOR, successor));
+		}
+
+		pugi::xml_node predecessor = link.child("predecessor");
+		if (predecessor != NULL)
+		{
+			r->AddLink(new (arena_) RoadLink(PREDECESSOR, predecessor));
+		}
+	}
+
+	ParseRoadContent(r, road_node, content_arena);
+
+	return r;
+}
+
+void OpenDrive::ParseJunction(pugi::xml_node junction_node)
+{
+	int id = atoi(junction_node.attribute("id").value());
+	std::string name = junction_node.attribute("name").value();
+
+	Junction *j = new (arena_) Junction(id, name);
+
+	for (pugi::xml_node connection_node = junction_node.child("connection"); connection_node; connection_node = connection_node.next_sibling("connection"))
+	{
+		if (connection_node != NULL)
+		{
+			int id = atoi(connection_node.attribute("id").value());
+			(void)id;
+			int incoming_road_id = atoi(connection_node.attribute("incomingRoad").value());
+			int connecting_road_id = atoi(connection_node.attribute("connectingRoad").value());
+			Road *incoming_road = FindRoadById(incoming_road_id);
+			Road *connecting_road = FindRoadById(connecting_road_id);
+			ContactPointType contact_point = CONTACT_POINT_UNKNOWN;
+			std::string contact_point_str = connection_node.attribute("contactPoint").value();
+			if (contact_point_str == "start")
+			{
+				contact_point = CONTACT_POINT_START;
+			}
+			else if (contact_point_str == "end")
+			{
+				contact_point = CONTACT_POINT_END;
+			}
+			else
+			{
+				LOG("Unsupported contact point: %s\n", contact_point_str.c_str());
+			}
+
+			Connection *connection = new (arena_) Connection(incoming_road, connecting_road, contact_point);
+			if (tiled_)
+			{
+				connection->SetTiledNetwork(this);
+			}
+
+			for (pugi::xml_node lane_link_node = connection_node.child("laneLink"); lane_link_node; lane_link_node = lane_link_node.next_sibling("laneLink"))
+			{
+				int from_id = atoi(lane_link_node.attribute("from").value());
+				int to_id = atoi(lane_link_node.attribute("to").value());
+				connection->AddJunctionLaneLink(new (arena_) JunctionLaneLink(from_id, to_id));
+			}
+			j->AddConnection(connection);
+		}
+	}
+	junction_idx_by_id_.insert(std::make_pair(j->GetId(), (int)junction_.size()));
+	junction_.push_back(j);
+}
+
+void OpenDrive::ParseRoadContent(Road *r, pugi::xml_node road_node, Arena &arena)
+{
+	pugi::xml_node plan_view = road_node.child("planView");
+	if (plan_view != NULL)
+	{
+		for (pugi::xml_node geometry = plan_view.child("geometry"); geometry; geometry = geometry.next_sibling())
+		{
+			double s = atof(geometry.attribute("s").value());
+			double x = atof(geometry.attribute("x").value());
+			double y = atof(geometry.attribute("y").value());
+			double hdg = atof(geometry.attribute("hdg").value());
+			double length = atof(geometry.attribute("length").value());
+
+			pugi::xml_node type = geometry.last_child();
+			if (type != NULL)
+			{
+				// Find out the type of geometry
+				if (!strcmp(type.name(), "line"))
+				{
+					r->AddLine(new (arena) Line(s, x, y, hdg, length));
+				}
+				else if (!strcmp(type.name(), "arc"))
+				{
+					double curvature = atof(type.attribute("curvature").value());
+					r->AddArc(new (arena) Arc(s, x, y, hdg, length, curvature));
+				}
+				else if (!strcmp(type.name(), "spiral"))
+				{
+					double curv_start = atof(type.attribute("curvStart").value());
+					double curv_end = atof(type.attribute("curvEnd").value());
+					r->AddSpiral(new (arena) Spiral(s, x, y, hdg, length, curv_start, curv_end));
+				}
+				else if (!strcmp(type.name(), "poly3"))
+				{
+					double a = atof(type.attribute("a").value());
+					double b = atof(type.attribute("b").value());
+					double c = atof(type.attribute("c").value());
+					double d = atof(type.attribute("d").value());
+					r->AddPoly3(new (arena) Poly3(s, x, y, hdg, length, a, b, c, d));
+				}
+				else if (!strcmp(type.name(), "paramPoly3"))
+				{
+					double aU = atof(type.attribute("aU").value());
+					double bU = atof(type.attribute("bU").value());
+					double cU = atof(type.attribute("cU").value());
+					double dU = atof(type.attribute("dU").value());
+					double aV = atof(type.attribute("aV").value());
+					double bV = atof(type.attribute("bV").value());
+					double cV = atof(type.attribute("cV").value());
+					double dV = atof(type.attribute("dV").value());
+					ParamPoly3::PRangeType p_range = ParamPoly3::P_RANGE_NORMALIZED;
+					
+					pugi::xml_attribute attr = type.attribute("pRange");
+					if (attr && !strcmp(attr.value(), "arcLength"))
+					{
+						p_range = ParamPoly3::P_RANGE_ARC_LENGTH;
+					}
+
+					ParamPoly3 *pp3 = new (arena) ParamPoly3(s, x, y, hdg, length, aU, bU, cU, dU, aV, bV, cV, dV, p_range);
+					if (pp3 != NULL)
+					{
+						r->AddParamPoly3(pp3);
+					}
+					else
+					{
+						LOG("ParamPoly3: Major error\n");
+					}
+				}
+				else
+				{
+					cout << "Unknown geometry type: " << type.name() << endl;
+				}
+			}
+			else
+			{
+				cout << "Type == NULL" << endl;
+			}
+		}
+	}
+	
+	pugi::xml_node elevation_profile = road_node.child("elevationProfile");
+	if (elevation_profile != NULL)
+	{
+		for (pugi::xml_node elevation = elevation_profile.child("elevation"); elevation; elevation = elevation.next_sibling())
+		{
+			double s = atof(elevation.attribute("s").value());
+			double a = atof(elevation.attribute("a").value());
+			double b = atof(elevation.attribute("b").value());
+			double c = atof(elevation.attribute("c").value());
+			double d = atof(elevation.attribute("d").value());
+
+			Elevation *ep = new (arena) Elevation(s, a, b, c, d);
+			if (ep != NULL)
+			{
+				r->AddElevation(ep);
+			}
+			else
+			{
+				LOG("Elevation: Major error\n");
+			}
+		}
+	}
+	
+	pugi::xml_node lanes = road_node.child("lanes");
+	if (lanes != NULL)
+	{
+		for (pugi::xml_node_iterator child = lanes.children().begin(); child != lanes.children().end(); child++)
+		{
+			if (!strcmp(child->name(), "laneOffset"))
+			{
+				double s = atof(child->attribute("s").value());
+				double a = atof(child->attribute("a").value());
+				double b = atof(child->attribute("b").value());
+				double c = atof(child->attribute("c").value());
+				double d = atof(child->attribute("d").value());
+				r->AddLaneOffset(new (arena) LaneOffset(s, a, b, c, d));
+			}
+			else if (!strcmp(child->name(), "laneSection"))
+			{
+				double s = atof(child->attribute("s").value());
+				LaneSection *lane_section = new (arena) LaneSection(s);
+				r->AddLaneSection(lane_section);
+
+				for (pugi::xml_node_iterator child2 = child->children().begin(); child2 != child->children().end(); child2++)
+				{
+					if (!strcmp(child2->name(), "left"))
+					{
+						//LOG("Lane left\n");
+					}
+					else if (!strcmp(child2->name(), "right"))
+					{
+						//LOG("Lane right\n");
+					}
+					else if (!strcmp(child2->name(), "center"))
+					{
+						//LOG("Lane center\n");
+					}
+					else
+					{
+						LOG("Unsupported lane side: %s\n", child2->name());
+						continue;
+					}
+					for (pugi::xml_node_iterator lane_node = child2->children().begin(); lane_node != child2->children().end(); lane_node++)
+					{
+						if (strcmp(lane_node->name(), "lane"))
+						{
+							LOG("Unexpected element: %s, expected \"lane\"\n", lane_node->name());
+							continue;
+						}
+
+						Lane::LaneType lane_type = Lane::LANE_TYPE_NONE;
+						if (lane_node->attribute("type") == 0 || !strcmp(lane_node->attribute("type").value(), ""))
+						{
+							LOG("Lane type error");
+						}
+						if (!strcmp(lane_node->attribute("type").value(), "none"))
+						{
+							lane_type = Lane::LANE_TYPE_NONE;
+						}
+						else  if (!strcmp(lane_node->attribute("type").value(), "driving"))
+						{
+							lane_type = Lane::LANE_TYPE_DRIVING;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "stop"))
+						{
+							lane_type = Lane::LANE_TYPE_STOP;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "shoulder"))
+						{
+							lane_type = Lane::LANE_TYPE_SHOULDER;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "biking"))
+						{
+							lane_type = Lane::LANE_TYPE_BIKING;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "sidewalk"))
+						{
+							lane_type = Lane::LANE_TYPE_SIDEWALK;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "border"))
+						{
+							lane_type = Lane::LANE_TYPE_BORDER;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "restricted"))
+						{
+							lane_type = Lane::LANE_TYPE_RESTRICTED;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "parking"))
+						{
+							lane_type = Lane::LANE_TYPE_PARKING;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "bidirectional"))
+						{
+							lane_type = Lane::LANE_TYPE_BIDIRECTIONAL;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "medcian"))
+						{
+							lane_type = Lane::LANE_TYPE_MEDIAN;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "special1"))
+						{
+							lane_type = Lane::LANE_TYPE_SPECIAL1;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "special2"))
+						{
+							lane_type = Lane::LANE_TYPE_SPECIAL2;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "special3"))
+						{
+							lane_type = Lane::LANE_TYPE_SPECIAL3;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "roadmarks"))
+						{
+							lane_type = Lane::LANE_TYPE_ROADMARKS;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "tram"))
+						{
+							lane_type = Lane::LANE_TYPE_TRAM;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "rail"))
+						{
+							lane_type = Lane::LANE_TYPE_RAIL;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "entry") ||
+							!strcmp(lane_node->attribute("type").value(), "mwyEntry"))
+						{
+							lane_type = Lane::LANE_TYPE_ENTRY;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "exit") ||
+							!strcmp(lane_node->attribute("type").value(), "mwyExit"))
+						{
+							lane_type = Lane::LANE_TYPE_EXIT;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "offRamp"))
+						{
+							lane_type = Lane::LANE_TYPE_OFF_RAMP;
+						}
+						else if (!strcmp(lane_node->attribute("type").value(), "onRamp"))
+						{
+							lane_type = Lane::LANE_TYPE_ON_RAMP;
+						}
+						else
+						{
+							LOG("unknown lane type: %s (road id=%d)\n", lane_node->attribute("type").value(), r->GetId());
+						}
+
+						int lane_id = atoi(lane_node->attribute("id").value());
+						Lane *lane = new (arena) Lane(lane_id, lane_type);
+						if (lane == NULL)
+						{
+							LOG("Error: creating lane\n");
+							return;
+						}
+						lane_section->AddLane(lane);
+
+						// Link
+						pugi::xml_node link = lane_node->child("link");
+						if (link != NULL)
+						{
+							pugi::xml_node successor = link.child("successor");
+							if (successor != NULL)
 							{
-								LOG("Unexpected element: %s, expected \"lane\"\n", lane_node->name());
-								continue;
+								lane->AddLink(new (arena) LaneLink(SUCCESSOR, atoi(successor.attribute("id").value())));
+							}
+							pugi::xml_node predecessor = link.child("predecessor");
+							if (predecessor != NULL)
+							{
+								lane->AddLink(new (arena) LaneLink(PREDECESSOR, atoi(predecessor.attribute("id").value())));
 							}
+						}
+
+						// Width
+						for (pugi::xml_node width = lane_node->child("width"); width; width = width.next_sibling("width"))
+						{
+							double s_offset = atof(width.attribute("sOffset").value());
+							double a = atof(width.attribute("a").value());
+							double b = atof(width.attribute("b").value());
+							double c = atof(width.attribute("c").value());
+							double d = atof(width.attribute("d").value());
+							lane->AddLaneWIdth(new (arena) LaneWidth(s_offset, a, b, c, d));
+						}
+					}
+				}
+			}
+			else
+			{
+				LOG("Unsupported lane type: %s\n", child->name());
+			}
+		}
+	}
+
+	if (r->GetNumberOfLaneSections() == 0)
+	{
+		// Add empty center reference lane
+		LaneSection *lane_section = new (arena) LaneSection(0.0);
+		lane_section->AddLane(new (arena) Lane(0, Lane::LANE_TYPE_NONE));
+		r->AddLaneSection(lane_section);
+	}
+}
+
+void OpenDrive::FinishLoading(std::vector<GeometryBBox> *bbox)
+{
+	BuildGeometryGrid(bbox);
+	BuildConnectivityTable();
+
+	if (tiled_)
+	{
+		LOG("Tiled loading of %d roads, memory budget %d kB\n", (int)road_.size(), (int)(tile_memory_budget_ / 1024));
+		return;
+	}
+
+	Compile();
+
+	if (tessellation_tolerance_ > 0)
+	{
+		BuildTessellation();
+	}
+
+	if (height_grid_resolution_ > 0)
+	{
+		BuildHeightGrid();
+	}
+}
+
+/**
+Read-only memory mapping of a whole file
+*/
+class MappedFile
+{
+public:
+	MappedFile() : data_(0), size_(0)
+	{
+#ifdef _WIN32
+		file_ = INVALID_HANDLE_VALUE;
+		mapping_ = 0;
+#endif
+	}
+	~MappedFile() { Close(); }
+
+	int Open(const char *filename)
+	{
+		Close();
+#ifdef _WIN32
+		file_ = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+		if (file_ == INVALID_HANDLE_VALUE)
+		{
+			return -1;
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0)
+		{
+			Close();
+			return -1;
+		}
+		size_ = (size_t)size.QuadPart;
+		mapping_ = CreateFileMappingA(file_, 0, PAGE_READONLY, 0, 0, 0);
+		if (mapping_ == 0)
+		{
+			Close();
+			return -1;
+		}
+		data_ = (const char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+#else
+		int fd = open(filename, O_RDONLY);
+		if (fd < 0)
+		{
+			return -1;
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0)
+		{
+			close(fd);
+			return -1;
+		}
+		size_ = (size_t)st.st_size;
+		void *data = mmap(0, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		data_ = data == MAP_FAILED ? 0 : (const char*)data;
+#endif
+		if (data_ == 0)
+		{
+			Close();
+			return -1;
+		}
+
+		return 0;
+	}
+
+	void Close()
+	{
+#ifdef _WIN32
+		if (data_)
+		{
+			UnmapViewOfFile(data_);
+		}
+		if (mapping_)
+		{
+			CloseHandle(mapping_);
+		}
+		if (file_ != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(file_);
+		}
+		file_ = INVALID_HANDLE_VALUE;
+		mapping_ = 0;
+#else
+		if (data_)
+		{
+			munmap((void*)data_, size_);
+		}
+#endif
+		data_ = 0;
+		size_ = 0;
+	}
+
+	const char *GetData() { return data_; }
+	size_t GetSize() { return size_; }
+
+private:
+	const char *data_;
+	size_t size_;
+#ifdef _WIN32
+	HANDLE file_;
+	HANDLE mapping_;
+#endif
+};
+
+int OpenDrive::LoadRoadContent(int road_idx)
+{
+	RoadTile *tile = &road_tile_[road_idx];
+	Road *road = road_[road_idx];
+	MappedFile file;
+	pugi::xml_document doc;
+	pugi::xml_node road_node;
+
+	// Whatever happens, don't try again
+	tile->loaded = true;
+	if (tile->arena == 0)
+	{
+		tile->arena = new Arena;
+	}
+
+	if (file.Open(tile_filename_[tile->file_idx].c_str()) != 0 || tile->offset < 0 || tile->size <= 0 ||
+		tile->offset + tile->size > (long)file.GetSize())
+	{
+		LOG("Failed to read road %d from %s\n", road->GetId(), tile_filename_[tile->file_idx].c_str());
+		return -1;
+	}
+
+	if (!doc.load_buffer(file.GetData() + tile->offset, (size_t)tile->size) || !(road_node = doc.child("road")) ||
+		atoi(road_node.attribute("id").value()) != road->GetId())
+	{
+		LOG("Failed to parse road %d from %s\n", road->GetId(), tile_filename_[tile->file_idx].c_str());
+		return -1;
+	}
+
+	ParseRoadContent(road, road_node, *tile->arena);
+	tile->memory = road->GetMemoryUsage();
+	tile_memory_ += tile->memory;
+
+	return 0;
+}
+
+// Child element of the root element of an XML file, see FindXmlChildElements()
+typedef struct
+{
+	std::string name;
+	size_t offset;  // position of the '<' of the start tag
+	size_t size;  // up to and including the '>' of the end tag
+} XmlElementSpan;
+
+static bool MatchAt(const char *data, size_t size, size_t pos, const char *str)
+{
+	size_t len = strlen(str);
+	return pos + len <= size && !strncmp(data + pos, str, len);
+}
+
+/**
+Find the children of the root element in XML text, without building a document. Only markup is
+looked at, so content is not validated. Comments, CDATA sections, processing instructions and
+quoted attribute values are skipped, so that any '<' or '>' in them is not taken for markup.
+@param data XML text
+@param size Length of the text
+@param root_name Receives the name of the root element
+@param elements Receives position and name of each child of the root element, in file order
+@return 0 on success, -1 if the text ends before the root element is closed
+*/
+static int FindXmlChildElements(const char *data, size_t size, std::string &root_name, std::vector<XmlElementSpan> &elements)
+{
+	static const char *skip_start[] = { "<!--", "<![CDATA[", "<?" };
+	static const char *skip_end[] = { "-->", "]]>", "?>" };
+	int depth = 0;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		if (data[i] != '<')
+		{
+			continue;
+		}
+
+		bool skipped = false;
+		for (int k = 0; k < 3 && !skipped; k++)
+		{
+			if (MatchAt(data, size, i, skip_start[k]))
+			{
+				const char *end = std::search(data + i, data + size, skip_end[k], skip_end[k] + strlen(skip_end[k]));
+				if (end == data + size)
+				{
+					return -1;
+				}
+				i = (size_t)(end - data) + strlen(skip_end[k]) - 1;
+				skipped = true;
+			}
+		}
+		if (skipped)
+		{
+			continue;
+		}
+
+		// Find end of the tag. Brackets are only expected in a DOCTYPE internal subset.
+		size_t tag_end = i + 1;
+		char quote = 0;
+		int brackets = 0;
+		for (; tag_end < size; tag_end++)
+		{
+			char c = data[tag_end];
+			if (quote)
+			{
+				quote = c == quote ? 0 : quote;
+			}
+			else if (c == '"' || c == '\'')
+			{
+				quote = c;
+			}
+			else if (c == '[' || c == ']')
+			{
+				brackets += c == '[' ? 1 : -1;
+			}
+			else if (c == '>' && brackets <= 0)
+			{
+				break;
+			}
+		}
+		if (tag_end == size)
+		{
+			return -1;
+		}
+
+		if (data[i + 1] == '/')
+		{
+			if (--depth == 1)
+			{
+				elements.back().size = tag_end + 1 - elements.back().offset;
+			}
+			else if (depth == 0)
+			{
+				return 0;
+			}
+		}
+		else if (data[i + 1] != '!')  // DOCTYPE is ignored
+		{
+			size_t name_end = i + 1;
+			while (name_end < tag_end && !isspace((unsigned char)data[name_end]) && data[name_end] != '/')
+			{
+				name_end++;
+			}
+			bool empty = data[tag_end - 1] == '/';
+			std::string name(data + i + 1, name_end - i - 1);
+
+			if (depth == 0)
+			{
+				root_name = name;
+				if (empty)
+				{
+					return 0;
+				}
+			}
+			else if (depth == 1)
+			{
+				XmlElementSpan element = { name, i, empty ? tag_end + 1 - i : 0 };
+				elements.push_back(element);
+			}
+
+			if (!empty)
+			{
+				depth++;
+			}
+		}
+		i = tag_end;
+	}
+
+	return -1;
+}
+
+void OpenDrive::LoadTiledOpenDriveFile(const char *filename)
+{
+	MappedFile file;
+	std::string loaded_filename = filename;
+	std::string root_name;
+	std::vector<XmlElementSpan> elements;
+	std::vector<GeometryBBox> bbox;
+	Arena tile_arena;  // temporary home of road content
+
+	if (file.Open(filename) != 0)
+	{
+		// Try current folder
+		std::string path = std::string(filename);
+		std::string base_filename = path.substr(path.find_last_of("/\\") + 1);
+		LOG("Failed to load %s - looking for file %s in current folder", filename, base_filename.c_str());
+
+		if (file.Open(base_filename.c_str()) != 0)
+		{
+			throw std::invalid_argument(std::string("Failed to load OpenDRIVE file ") + std::string(filename));
+		}
+		loaded_filename = base_filename;
+	}
+
+	if (FindXmlChildElements(file.GetData(), file.GetSize(), root_name, elements) != 0 || root_name != "OpenDRIVE")
+	{
+		throw std::invalid_argument("The file does not seem to be an OpenDRIVE");
+	}
+
+	// Bounding boxes are calculated on the way, after any earlier ones
+	tile_filename_.push_back(loaded_filename);
+	for (int i = 0; i < geometry_grid_.GetNumberOfBBoxes(); i++)
+	{
+		bbox.push_back(*geometry_grid_.GetBBoxByIdx(i));
+	}
+
+	for (size_t i = 0; i < elements.size(); i++)
+	{
+		pugi::xml_document doc;
+		pugi::xml_node road_node;
+
+		if (elements[i].name != "road")
+		{
+			continue;
+		}
+
+		if (!doc.load_buffer(file.GetData() + elements[i].offset, elements[i].size) || !(road_node = doc.child("road")))
+		{
+			throw std::invalid_argument(std::string("Failed to load OpenDRIVE file ") + std::string(filename));
+		}
+
+		Road *r = ParseRoad(road_node, tile_arena);
+
+		// Keep only what's needed to find and connect the road, load the rest when needed
+		RoadTile tile;
+		tile.file_idx = (int)tile_filename_.size() - 1;
+		tile.offset = (long)elements[i].offset;
+		tile.size = (long)elements[i].size;
+		tile.h_start = r->GetNumberOfGeometries() > 0 ? GetRoadHeadingAtS(r, 0) : 0;
+		tile.h_end = r->GetNumberOfGeometries() > 0 ? GetRoadHeadingAtS(r, r->GetLength()) : 0;
+		tile.memory = 0;
+		tile.loaded = false;
+		tile.last_used = 0;
+		tile.arena = 0;
+		CalcRoadBBoxes(r, (int)road_.size(), bbox);
+		r->ClearContent();
+		tile_arena.Clear();
+		road_tile_.push_back(tile);
+
+		// In case of duplicate IDs, keep the first one
+		road_idx_by_id_.insert(std::make_pair(r->GetId(), (int)road_.size()));
+		road_.push_back(r);
+	}
+
+	// Junctions refer to roads, so parse them when all roads are known
+	for (size_t i = 0; i < elements.size(); i++)
+	{
+		pugi::xml_document doc;
+		pugi::xml_node junction_node;
+
+		if (elements[i].name != "junction")
+		{
+			continue;
+		}
+
+		if (!doc.load_buffer(file.GetData() + elements[i].offset, elements[i].size) || !(junction_node = doc.child("junction")))
+		{
+			throw std::invalid_argument(std::string("Failed to load OpenDRIVE file ") + std::string(filename));
+		}
+
+		ParseJunction(junction_node);
+	}
+
+	FinishLoading(&bbox);
+}
+
+void OpenDrive::LoadRoad(Road *road)
+{
+	std::unordered_map<int, int>::iterator it = road_idx_by_id_.find(road->GetId());
+	if (tiled_ && it != road_idx_by_id_.end() && road_[it->second] == road)
+	{
+		GetRoadByIdx(it->second);
+	}
+}
+
+void OpenDrive::ClearRoadTiles()
+{
+	for (size_t i = 0; i < road_tile_.size(); i++)
+	{
+		delete road_tile_[i].arena;
+	}
+	road_tile_.clear();
+	tile_filename_.clear();
+	tile_memory_ = 0;
+}
+
+int OpenDrive::GetNumberOfLoadedRoads()
+{
+	if (!tiled_)
+	{
+		return (int)road_.size();
+	}
 
-							Lane::LaneType lane_type = Lane::LANE_TYPE_NONE;
-							if (lane_node->attribute("type") == 0 || !strcmp(lane_node->attribute("type").value(), ""))
-							{
-								LOG("Lane type error");
-							}
-							if (!strcmp(lane_node->attribute("type").value(), "none"))
-							{
-								lane_type = Lane::LANE_TYPE_NONE;
-							}
-							else  if (!strcmp(lane_node->attribute("type").value(), "driving"))
-							{
-								lane_type = Lane::LANE_TYPE_DRIVING;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "stop"))
-							{
-								lane_type = Lane::LANE_TYPE_STOP;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "shoulder"))
-							{
-								lane_type = Lane::LANE_TYPE_SHOULDER;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "biking"))
-							{
-								lane_type = Lane::LANE_TYPE_BIKING;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "sidewalk"))
-							{
-								lane_type = Lane::LANE_TYPE_SIDEWALK;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "border"))
-							{
-								lane_type = Lane::LANE_TYPE_BORDER;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "restricted"))
-							{
-								lane_type = Lane::LANE_TYPE_RESTRICTED;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "parking"))
-							{
-								lane_type = Lane::LANE_TYPE_PARKING;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "bidirectional"))
-							{
-								lane_type = Lane::LANE_TYPE_BIDIRECTIONAL;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "medcian"))
-							{
-								lane_type = Lane::LANE_TYPE_MEDIAN;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "special1"))
-							{
-								lane_type = Lane::LANE_TYPE_SPECIAL1;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "special2"))
-							{
-								lane_type = Lane::LANE_TYPE_SPECIAL2;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "special3"))
-							{
-								lane_type = Lane::LANE_TYPE_SPECIAL3;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "roadmarks"))
-							{
-								lane_type = Lane::LANE_TYPE_ROADMARKS;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "tram"))
-							{
-								lane_type = Lane::LANE_TYPE_TRAM;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "rail"))
-							{
-								lane_type = Lane::LANE_TYPE_RAIL;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "entry") ||
-								!strcmp(lane_node->attribute("type").value(), "mwyEntry"))
-							{
-								lane_type = Lane::LANE_TYPE_ENTRY;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "exit") ||
-								!strcmp(lane_node->attribute("type").value(), "mwyExit"))
-							{
-								lane_type = Lane::LANE_TYPE_EXIT;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "offRamp"))
-							{
-								lane_type = Lane::LANE_TYPE_OFF_RAMP;
-							}
-							else if (!strcmp(lane_node->attribute("type").value(), "onRamp"))
-							{
-								lane_type = Lane::LANE_TYPE_ON_RAMP;
-							}
-							else
-							{
-								LOG("unknown lane type: %s (road id=%d)\n", lane_node->attribute("type").value(), r->GetId());
-							}
+	int n = 0;
+	for (size_t i = 0; i < road_tile_.size(); i++)
+	{
+		if (road_tile_[i].loaded)
+		{
+			n++;
+		}
+	}
 
-							int lane_id = atoi(lane_node->attribute("id").value());
-							Lane *lane = new Lane(lane_id, lane_type);
-							if (lane == NULL)
-							{
-								LOG("Error: creating lane\n");
-								return false;
-							}
-							lane_section->AddLane(lane);
+	return n;
+}
 
-							// Link
-							pugi::xml_node link = lane_node->child("link");
-							if (link != NULL)
-							{
-								pugi::xml_node successor = link.child("successor");
-								if (successor != NULL)
-								{
-									lane->AddLink(new LaneLink(SUCCESSOR, atoi(successor.attribute("id").value())));
-								}
-								pugi::xml_node predecessor = link.child("predecessor");
-								if (predecessor != NULL)
-								{
-									lane->AddLink(new LaneLink(PREDECESSOR, atoi(predecessor.attribute("id").value())));
-								}
-							}
+int OpenDrive::EvictRoads(const double *x, const double *y, int n_points)
+{
+	// Sort key (-distance, last used) and road index, so that farthest and then least recently used roads come first
+	std::vector<std::pair<std::pair<double, unsigned long long>, int> > candidate;
+	int n_evicted = 0;
 
-							// Width
-							for (pugi::xml_node width = lane_node->child("width"); width; width = width.next_sibling("width"))
-							{
-								double s_offset = atof(width.attribute("sOffset").value());
-								double a = atof(width.attribute("a").value());
-								double b = atof(width.attribute("b").value());
-								double c = atof(width.attribute("c").value());
-								double d = atof(width.attribute("d").value());
-								lane->AddLaneWIdth(new LaneWidth(s_offset, a, b, c, d));
-							}
-						}
-					}
-				}
-				else
-				{
-					LOG("Unsupported lane type: %s\n", child->name());
-				}
+	if (!tiled_ || tile_memory_ <= tile_memory_budget_)
+	{
+		return 0;
+	}
+
+	for (int i = 0; i < (int)road_tile_.size(); i++)
+	{
+		if (!road_tile_[i].loaded)
+		{
+			continue;
+		}
+
+		// Distance from closest entity to any geometry bounding box of the road
+		double dist = std::numeric_limits<double>::infinity();
+		for (int j = 0, idx; (idx = geometry_grid_.GetBBoxIdx(i, j)) >= 0; j++)
+		{
+			GeometryBBox *bbox = geometry_grid_.GetBBoxByIdx(idx);
+			for (int k = 0; k < n_points; k++)
+			{
+				double dx = MAX(MAX(bbox->x_min - x[k], x[k] - bbox->x_max), 0.0);
+				double dy = MAX(MAX(bbox->y_min - y[k], y[k] - bbox->y_max), 0.0);
+				dist = MIN(dist, sqrt(dx * dx + dy * dy));
 			}
 		}
 
-		if (r->GetNumberOfLaneSections() == 0)
+		if (dist > TILE_KEEP_DIST)
 		{
-			// Add empty center reference lane
-			LaneSection *lane_section = new LaneSection(0.0);
-			lane_section->AddLane(new Lane(0, Lane::LANE_TYPE_NONE));
-			r->AddLaneSection(lane_section);
+			candidate.push_back(std::make_pair(std::make_pair(-dist, road_tile_[i].last_used), i));
 		}
-			
-		road_.push_back(r);
 	}
 
-	for (pugi::xml_node junction_node = node.child("junction"); junction_node; junction_node = junction_node.next_sibling("junction"))
+	std::sort(candidate.begin(), candidate.end());
+
+	tile_mutex_.Lock();
+	for (size_t i = 0; i < candidate.size() && tile_memory_ > tile_memory_budget_; i++)
+	{
+		RoadTile *tile = &road_tile_[candidate[i].second];
+		road_[candidate[i].second]->ClearContent();
+		tile->arena->Clear();
+		tile->loaded = false;
+		tile_memory_ -= tile->memory;
+		tile->memory = 0;
+		n_evicted++;
+	}
+	tile_mutex_.Unlock();
+
+	return n_evicted;
+}
+
+/**
+Identifies the content of an OpenDRIVE file, stored in the binary cache to detect stale caches
+*/
+static int GetFileHash(const char *filename, unsigned long long *hash, unsigned long long *size)
+{
+	MappedFile file;
+
+	if (file.Open(filename) != 0)
+	{
+		return -1;
+	}
+
+	// 64 bit FNV-1a
+	unsigned long long h = 14695981039346656037ULL;
+	const unsigned char *data = (const unsigned char*)file.GetData();
+	for (size_t i = 0; i < file.GetSize(); i++)
+	{
+		h = (h ^ data[i]) * 1099511628211ULL;
+	}
+	*hash = h;
+	*size = (unsigned long long)file.GetSize();
+
+	return 0;
+}
+
+class CacheWriter
+{
+public:
+	void Write(const void *data, size_t size) { buf_.insert(buf_.end(), (const char*)data, (const char*)data + size); }
+	void WriteInt(int value) { Write(&value, sizeof(value)); }
+	void WriteUInt64(unsigned long long value) { Write(&value, sizeof(value)); }
+	void WriteDouble(double value) { Write(&value, sizeof(value)); }
+	void WriteString(std::string str) { WriteInt((int)str.size()); Write(str.data(), str.size()); }
+	void WritePolynomial(Polynomial &poly)
+	{
+		WriteDouble(poly.GetA());
+		WriteDouble(poly.GetB());
+		WriteDouble(poly.GetC());
+		WriteDouble(poly.GetD());
+		WriteDouble(poly.GetPScale());
+	}
+	std::vector<char> &GetBuffer() { return buf_; }
+
+private:
+	std::vector<char> buf_;
+};
+
+/**
+Reads from a memory mapped cache. Any read beyond the end of data sets the error flag and returns 0,
+so that callers can check for errors once per record instead of for each value.
+*/
+class CacheReader
+{
+public:
+	CacheReader(const char *data, size_t size) : data_(data), size_(size), pos_(0), error_(false) {}
+
+	bool Read(void *data, size_t size)
+	{
+		if (error_ || size > size_ - pos_)
+		{
+			error_ = true;
+			memset(data, 0, size);
+			return false;
+		}
+		memcpy(data, data_ + pos_, size);
+		pos_ += size;
+		return true;
+	}
+	int ReadInt() { int value; Read(&value, sizeof(value)); return value; }
+	unsigned long long ReadUInt64() { unsigned long long value; Read(&value, sizeof(value)); return value; }
+	double ReadDouble() { double value; Read(&value, sizeof(value)); return value; }
+	std::string ReadString()
+	{
+		int n = ReadCount(1);
+		std::string str(data_ + pos_, n);
+		pos_ += n;
+		return str;
+	}
+	void ReadPolynomial(Polynomial &poly)
+	{
+		double a = ReadDouble();
+		double b = ReadDouble();
+		double c = ReadDouble();
+		double d = ReadDouble();
+		double p_scale = ReadDouble();
+		poly.Set(a, b, c, d, p_scale);
+	}
+
+	/**
+	Read number of elements, checking that they fit in the remaining data
+	@param min_element_size Smallest possible size of one element, in bytes
+	*/
+	int ReadCount(size_t min_element_size)
+	{
+		int n = ReadInt();
+		if (n < 0 || (size_t)n * min_element_size > size_ - pos_)
+		{
+			error_ = true;
+			return 0;
+		}
+		return n;
+	}
+	bool Error() { return error_; }
+	bool AtEnd() { return pos_ == size_; }
+
+private:
+	const char *data_;
+	size_t size_;
+	size_t pos_;
+	bool error_;
+};
+
+static void WriteCacheHeader(CacheWriter &writer, unsigned long long source_hash, unsigned long long source_size)
+{
+	writer.Write(BINARY_CACHE_MAGIC, strlen(BINARY_CACHE_MAGIC));
+	writer.WriteInt(BINARY_CACHE_VERSION);
+	writer.WriteInt(0x01020304);  // byte order
+	writer.WriteInt((int)sizeof(double));
+	writer.WriteUInt64(source_size);
+	writer.WriteUInt64(source_hash);
+}
+
+int OpenDrive::SaveBinaryCache(const char *filename)
+{
+	CacheWriter writer;
+	unsigned long long source_hash, source_size;
+
+	if (tiled_)
+	{
+		// Road content is loaded on demand, the cache would lack it
+		LOG("SaveBinaryCache: Not supported in tiled mode\n");
+		return -1;
+	}
+
+	if (GetFileHash(odr_filename_.c_str(), &source_hash, &source_size) != 0)
+	{
+		LOG("SaveBinaryCache: Failed to read OpenDRIVE file %s\n", odr_filename_.c_str());
+		return -1;
+	}
+
+	WriteCacheHeader(writer, source_hash, source_size);
+
+	writer.WriteInt((int)road_.size());
+	for (size_t i = 0; i < road_.size(); i++)
 	{
-		int id = atoi(junction_node.attribute("id").value());
-		std::string name = junction_node.attribute("name").value();
+		Road *r = road_[i];
+
+		writer.WriteInt(r->GetId());
+		writer.WriteString(r->GetName());
+		writer.WriteDouble(r->GetLength());
+		writer.WriteInt(r->GetJunction());
+
+		writer.WriteInt(r->GetNumberOfRoadTypes());
+		for (int j = 0; j < r->GetNumberOfRoadTypes(); j++)
+		{
+			RoadTypeEntry *type = r->GetRoadTypeByIdx(j);
+			writer.WriteDouble(type->s_);
+			writer.WriteInt(type->road_type_);
+			writer.WriteDouble(type->speed_);
+		}
 
-		Junction *j = new Junction(id, name);
+		writer.WriteInt(r->GetNumberOfLinks());
+		for (int j = 0; j < r->GetNumberOfLinks(); j++)
+		{
+			RoadLink *link = r->GetLinkByIdx(j);
+			writer.WriteInt(link->GetType());
+			writer.WriteInt(link->GetElementType());
+			writer.WriteInt(link->GetElementId());
+			writer.WriteInt(link->GetContactPointType());
+		}
 
-		for (pugi::xml_node connection_node = junction_node.child("connection"); connection_node; connection_node = connection_node.next_sibling("connection"))
+		writer.WriteInt(r->GetNumberOfGeometries());
+		for (int j = 0; j < r->GetNumberOfGeometries(); j++)
 		{
-			if (connection_node != NULL)
+			Geometry *g = r->GetGeometry(j);
+			writer.WriteInt(g->GetType());
+			writer.WriteDouble(g->GetS());
+			writer.WriteDouble(g->GetX());
+			writer.WriteDouble(g->GetY());
+			writer.WriteDouble(g->GetHdg());
+			writer.WriteDouble(g->GetLength());
+
+			if (g->GetType() == Geometry::GEOMETRY_TYPE_ARC)
 			{
-				int id = atoi(connection_node.attribute("id").value());
-				(void)id;
-				int incoming_road_id = atoi(connection_node.attribute("incomingRoad").value());
-				int connecting_road_id = atoi(connection_node.attribute("connectingRoad").value());
-				Road *incoming_road = GetRoadById(incoming_road_id);
-				Road *connecting_road = GetRoadById(connecting_road_id);
-				ContactPointType contact_point = CONTACT_POINT_UNKNOWN;
-				std::string contact_point_str = connection_node.attribute("contactPoint").value();
-				if (contact_point_str == "start")
-				{
-					contact_point = CONTACT_POINT_START;
-				}
-				else if (contact_point_str == "end")
+				writer.WriteDouble(((Arc*)g)->GetCurvature());
+			}
+			else if (g->GetType() == Geometry::GEOMETRY_TYPE_SPIRAL)
+			{
+				Spiral *spiral = (Spiral*)g;
+				SpiralTable *table = spiral->GetTable();
+				writer.WriteDouble(spiral->GetCurvStart());
+				writer.WriteDouble(spiral->GetCurvEnd());
+				writer.WriteDouble(spiral->GetCDot());
+				writer.WriteDouble(spiral->GetX0());
+				writer.WriteDouble(spiral->GetY0());
+				writer.WriteDouble(spiral->GetH0());
+				writer.WriteDouble(spiral->GetS0());
+				writer.WriteDouble(table->GetSStart());
+				writer.WriteDouble(table->GetStep());
+				writer.WriteInt(table->GetNumberOfNodes());
+				writer.Write(table->GetNodes(), 4 * table->GetNumberOfNodes() * sizeof(double));
+			}
+			else if (g->GetType() == Geometry::GEOMETRY_TYPE_POLY3)
+			{
+				writer.WritePolynomial(((Poly3*)g)->poly3_);
+				writer.WriteDouble(((Poly3*)g)->GetUMax());
+			}
+			else if (g->GetType() == Geometry::GEOMETRY_TYPE_PARAM_POLY3)
+			{
+				writer.WritePolynomial(((ParamPoly3*)g)->poly3U_);
+				writer.WritePolynomial(((ParamPoly3*)g)->poly3V_);
+			}
+		}
+
+		writer.WriteInt(r->GetNumberOfElevations());
+		for (int j = 0; j < r->GetNumberOfElevations(); j++)
+		{
+			writer.WriteDouble(r->GetElevation(j)->GetS());
+			writer.WritePolynomial(r->GetElevation(j)->poly3_);
+		}
+
+		writer.WriteInt(r->GetNumberOfLaneOffsets());
+		for (int j = 0; j < r->GetNumberOfLaneOffsets(); j++)
+		{
+			Polynomial poly = r->GetLaneOffsetByIdx(j)->GetPolynomial();
+			writer.WriteDouble(r->GetLaneOffsetByIdx(j)->GetS());
+			writer.WritePolynomial(poly);
+		}
+
+		writer.WriteInt(r->GetNumberOfLaneSections());
+		for (int j = 0; j < r->GetNumberOfLaneSections(); j++)
+		{
+			LaneSection *lane_section = r->GetLaneSectionByIdx(j);
+			writer.WriteDouble(lane_section->GetS());
+			writer.WriteInt(lane_section->GetNumberOfLanes());
+			for (int k = 0; k < lane_section->GetNumberOfLanes(); k++)
+			{
+				Lane *lane = lane_section->GetLaneByIdx(k);
+				writer.WriteInt(lane->GetId());
+				writer.WriteInt(lane->GetLaneType());
+				writer.WriteInt(lane->GetNumberOfLinks());
+				for (int l = 0; l < lane->GetNumberOfLinks(); l++)
 				{
-					contact_point = CONTACT_POINT_END;
+					writer.WriteInt(lane->GetLinkByIdx(l)->GetType());
+					writer.WriteInt(lane->GetLinkByIdx(l)->GetId());
 				}
-				else
+				writer.WriteInt(lane->GetNumberOfWidths());
+				for (int l = 0; l < lane->GetNumberOfWidths(); l++)
 				{
-					LOG("Unsupported contact point: %s\n", contact_point_str.c_str());
+					writer.WriteDouble(lane->GetWidthByIndex(l)->GetSOffset());
+					writer.WritePolynomial(lane->GetWidthByIndex(l)->poly3_);
 				}
+			}
+		}
+	}
+
+	writer.WriteInt((int)junction_.size());
+	for (size_t i = 0; i < junction_.size(); i++)
+	{
+		Junction *j = junction_[i];
+		writer.WriteInt(j->GetId());
+		writer.WriteString(j->GetName());
+		writer.WriteInt(j->GetNumberOfConnections());
+		for (int k = 0; k < j->GetNumberOfConnections(); k++)
+		{
+			Connection *connection = j->GetConnectionByIdx(k);
+			writer.WriteInt(connection->GetIncomingRoad() ? 1 : 0);
+			writer.WriteInt(connection->GetIncomingRoad() ? connection->GetIncomingRoad()->GetId() : 0);
+			writer.WriteInt(connection->GetConnectingRoad() ? 1 : 0);
+			writer.WriteInt(connection->GetConnectingRoad() ? connection->GetConnectingRoad()->GetId() : 0);
+			writer.WriteInt(connection->GetContactPoint());
+			writer.WriteInt(connection->GetNumberOfLaneLinks());
+			for (int l = 0; l < connection->GetNumberOfLaneLinks(); l++)
+			{
+				writer.WriteInt(connection->GetLaneLink(l)->from_);
+				writer.WriteInt(connection->GetLaneLink(l)->to_);
+			}
+		}
+	}
+
+	// Bounding boxes take longer to calculate than parsing the XML, store them as well
+	writer.WriteInt(geometry_grid_.GetNumberOfBBoxes());
+	for (int i = 0; i < geometry_grid_.GetNumberOfBBoxes(); i++)
+	{
+		GeometryBBox *bbox = geometry_grid_.GetBBoxByIdx(i);
+		writer.WriteInt(bbox->road_idx);
+		writer.WriteInt(bbox->geom_idx);
+		writer.WriteDouble(bbox->x_min);
+		writer.WriteDouble(bbox->y_min);
+		writer.WriteDouble(bbox->x_max);
+		writer.WriteDouble(bbox->y_max);
+		writer.WriteDouble(bbox->x_center);
+		writer.WriteDouble(bbox->y_center);
+		writer.WriteDouble(bbox->radius);
+		writer.WriteDouble(bbox->x_start);
+		writer.WriteDouble(bbox->y_start);
+		writer.WriteDouble(bbox->h_start);
+		writer.WriteDouble(bbox->x_end);
+		writer.WriteDouble(bbox->y_end);
+		writer.WriteDouble(bbox->h_end);
+		writer.WriteInt(bbox->tangents_intersect);
+		writer.WriteDouble(bbox->x_tangent);
+		writer.WriteDouble(bbox->y_tangent);
+	}
+
+	// Write to a temporary file first, so that other processes never see a partly written cache
+	std::string tmp_filename = std::string(filename) + ".tmp";
+	FILE *file = fopen(tmp_filename.c_str(), "wb");
+	if (file == 0)
+	{
+		LOG("SaveBinaryCache: Failed to create %s\n", tmp_filename.c_str());
+		return -1;
+	}
+	size_t n_written = fwrite(writer.GetBuffer().data(), 1, writer.GetBuffer().size(), file);
+	fclose(file);
+
+	remove(filename);
+	if (n_written != writer.GetBuffer().size() || rename(tmp_filename.c_str(), filename) != 0)
+	{
+		LOG("SaveBinaryCache: Failed to write %s\n", filename);
+		remove(tmp_filename.c_str());
+		return -1;
+	}
+
+	return 0;
+}
+
+static Geometry *ReadCacheGeometry(CacheReader &reader, Arena &arena)
+{
+	int type = reader.ReadInt();
+	double s = reader.ReadDouble();
+	double x = reader.ReadDouble();
+	double y = reader.ReadDouble();
+	double hdg = reader.ReadDouble();
+	double length = reader.ReadDouble();
+
+	if (type == Geometry::GEOMETRY_TYPE_LINE)
+	{
+		return new (arena) Line(s, x, y, hdg, length);
+	}
+	else if (type == Geometry::GEOMETRY_TYPE_ARC)
+	{
+		return new (arena) Arc(s, x, y, hdg, length, reader.ReadDouble());
+	}
+	else if (type == Geometry::GEOMETRY_TYPE_SPIRAL)
+	{
+		double curv_start = reader.ReadDouble();
+		double curv_end = reader.ReadDouble();
+		Spiral *spiral = new (arena) Spiral(s, x, y, hdg, length, curv_start, curv_end);
+		spiral->SetCDot(reader.ReadDouble());
+		spiral->SetX0(reader.ReadDouble());
+		spiral->SetY0(reader.ReadDouble());
+		spiral->SetH0(reader.ReadDouble());
+		spiral->SetS0(reader.ReadDouble());
+		double table_s_start = reader.ReadDouble();
+		double table_step = reader.ReadDouble();
+		int n_nodes = reader.ReadCount(4 * sizeof(double));
+		std::vector<double> node(4 * n_nodes);
+		reader.Read(node.data(), node.size() * sizeof(double));
+		spiral->GetTable()->Set(table_s_start, table_step, spiral->GetCDot(), node.data(), n_nodes);
+		return spiral;
+	}
+	else if (type == Geometry::GEOMETRY_TYPE_POLY3)
+	{
+		Poly3 *poly3 = new (arena) Poly3(s, x, y, hdg, length, 0, 0, 0, 0);
+		reader.ReadPolynomial(poly3->poly3_);
+		poly3->SetUMax(reader.ReadDouble());
+		return poly3;
+	}
+	else if (type == Geometry::GEOMETRY_TYPE_PARAM_POLY3)
+	{
+		ParamPoly3 *pp3 = new (arena) ParamPoly3(s, x, y, hdg, length, 0, 0, 0, 0, 0, 0, 0, 0, ParamPoly3::P_RANGE_ARC_LENGTH);
+		reader.ReadPolynomial(pp3->poly3U_);
+		reader.ReadPolynomial(pp3->poly3V_);
+		return pp3;
+	}
+
+	return 0;
+}
+
+static Road *ReadCacheRoad(CacheReader &reader, Arena &arena)
+{
+	int id = reader.ReadInt();
+	std::string name = reader.ReadString();
+	Road *r = new (arena) Road(id, name);
+	r->SetLength(reader.ReadDouble());
+	r->SetJunction(reader.ReadInt());
+
+	int n = reader.ReadCount(2 * sizeof(double) + sizeof(int));
+	for (int i = 0; i < n; i++)
+	{
+		RoadTypeEntry *type = new (arena) RoadTypeEntry();
+		type->s_ = reader.ReadDouble();
+		type->road_type_ = (RoadType)reader.ReadInt();
+		type->speed_ = reader.ReadDouble();
+		r->AddRoadType(type);
+	}
+
+	n = reader.ReadCount(4 * sizeof(int));
+	for (int i = 0; i < n; i++)
+	{
+		LinkType type = (LinkType)reader.ReadInt();
+		RoadLink::ElementType element_type = (RoadLink::ElementType)reader.ReadInt();
+		int element_id = reader.ReadInt();
+		ContactPointType contact_point = (ContactPointType)reader.ReadInt();
+		r->AddLink(new (arena) RoadLink(type, element_type, element_id, contact_point));
+	}
+
+	n = reader.ReadCount(sizeof(int) + 5 * sizeof(double));
+	for (int i = 0; i < n && !reader.Error(); i++)
+	{
+		Geometry *geometry = ReadCacheGeometry(reader, arena);
+		if (geometry == 0)
+		{
+			delete r;
+			return 0;
+		}
+		r->AddGeometry(geometry);
+	}
+
+	n = reader.ReadCount(6 * sizeof(double));
+	for (int i = 0; i < n; i++)
+	{
+		Elevation *elevation = new (arena) Elevation(reader.ReadDouble(), 0, 0, 0, 0);
+		reader.ReadPolynomial(elevation->poly3_);
+		r->AddElevation(elevation);
+	}
+
+	n = reader.ReadCount(6 * sizeof(double));
+	for (int i = 0; i < n; i++)
+	{
+		double s = reader.ReadDouble();
+		Polynomial poly;
+		reader.ReadPolynomial(poly);
+		r->AddLaneOffset(new (arena) LaneOffset(s, poly.GetA(), poly.GetB(), poly.GetC(), poly.GetD()));
+	}
+
+	n = reader.ReadCount(sizeof(double) + sizeof(int));
+	for (int i = 0; i < n && !reader.Error(); i++)
+	{
+		LaneSection *lane_section = new (arena) LaneSection(reader.ReadDouble());
+		r->AddLaneSection(lane_section);
+
+		int n_lanes = reader.ReadCount(4 * sizeof(int));
+		for (int j = 0; j < n_lanes && !reader.Error(); j++)
+		{
+			int lane_id = reader.ReadInt();
+			Lane *lane = new (arena) Lane(lane_id, (Lane::LaneType)reader.ReadInt());
+			lane_section->AddLane(lane);
+
+			int n_links = reader.ReadCount(2 * sizeof(int));
+			for (int k = 0; k < n_links; k++)
+			{
+				LinkType type = (LinkType)reader.ReadInt();
+				lane->AddLink(new (arena) LaneLink(type, reader.ReadInt()));
+			}
+
+			int n_widths = reader.ReadCount(6 * sizeof(double));
+			for (int k = 0; k < n_widths; k++)
+			{
+				LaneWidth *width = new (arena) LaneWidth(reader.ReadDouble(), 0, 0, 0, 0);
+				reader.ReadPolynomial(width->poly3_);
+				lane->AddLaneWIdth(width);
+			}
+		}
+	}
+
+	return r;
+}
+
+int OpenDrive::LoadBinaryCache(const char *filename, std::vector<GeometryBBox> &bbox)
+{
+	MappedFile file;
+	unsigned long long source_hash, source_size;
+
+	if (file.Open(filename) != 0)
+	{
+		return -1;  // No cache
+	}
+
+	if (GetFileHash(odr_filename_.c_str(), &source_hash, &source_size) != 0)
+	{
+		return -1;
+	}
+
+	CacheWriter header;
+	WriteCacheHeader(header, source_hash, source_size);
+	if (file.GetSize() < header.GetBuffer().size() || memcmp(file.GetData(), header.GetBuffer().data(), header.GetBuffer().size()))
+	{
+		LOG("Binary cache %s is outdated or from another version, loading %s\n", filename, odr_filename_.c_str());
+		return -1;
+	}
+
+	CacheReader reader(file.GetData() + header.GetBuffer().size(), file.GetSize() - header.GetBuffer().size());
+	std::vector<Road*> roads;
+	std::vector<Junction*> junctions;
+	std::unordered_map<int, Road*> road_by_id;
+
+	for (size_t i = 0; i < road_.size(); i++)
+	{
+		road_by_id.insert(std::make_pair(road_[i]->GetId(), road_[i]));
+	}
 
-				Connection *connection = new Connection(incoming_road, connecting_road, contact_point);
+	int n_roads = reader.ReadCount(sizeof(int));
+	for (int i = 0; i < n_roads && !reader.Error(); i++)
+	{
+		Road *r = ReadCacheRoad(reader, arena_);
+		if (r == 0)
+		{
+			break;
+		}
+		roads.push_back(r);
+		road_by_id.insert(std::make_pair(r->GetId(), r));
+	}
+
+	int n_junctions = reader.ReadCount(sizeof(int));
+	for (int i = 0; i < n_junctions && !reader.Error(); i++)
+	{
+		int id = reader.ReadInt();
+		Junction *j = new (arena_) Junction(id, reader.ReadString());
+		junctions.push_back(j);
 
-				for (pugi::xml_node lane_link_node = connection_node.child("laneLink"); lane_link_node; lane_link_node = lane_link_node.next_sibling("laneLink"))
+		int n_connections = reader.ReadCount(6 * sizeof(int));
+		for (int k = 0; k < n_connections && !reader.Error(); k++)
+		{
+			Road *road[2] = { 0, 0 };
+			for (int l = 0; l < 2; l++)
+			{
+				bool valid = reader.ReadInt() != 0;
+				int road_id = reader.ReadInt();
+				if (valid && road_by_id.find(road_id) != road_by_id.end())
 				{
-					int from_id = atoi(lane_link_node.attribute("from").value());
-					int to_id = atoi(lane_link_node.attribute("to").value());
-					connection->AddJunctionLaneLink(from_id, to_id);
+					road[l] = road_by_id[road_id];
 				}
-				j->AddConnection(connection);
+			}
+			Connection *connection = new (arena_) Connection(road[0], road[1], (ContactPointType)reader.ReadInt());
+			j->AddConnection(connection);
+
+			int n_lane_links = reader.ReadCount(2 * sizeof(int));
+			for (int l = 0; l < n_lane_links; l++)
+			{
+				int from_id = reader.ReadInt();
+				connection->AddJunctionLaneLink(new (arena_) JunctionLaneLink(from_id, reader.ReadInt()));
 			}
 		}
-		junction_.push_back(j);
 	}
 
-	// CheckConnections();
+	int n_bboxes = reader.ReadCount(3 * sizeof(int) + 15 * sizeof(double));
+	bbox.resize(n_bboxes);
+	for (int i = 0; i < n_bboxes; i++)
+	{
+		bbox[i].road_idx = reader.ReadInt();
+		bbox[i].geom_idx = reader.ReadInt();
+		bbox[i].x_min = reader.ReadDouble();
+		bbox[i].y_min = reader.ReadDouble();
+		bbox[i].x_max = reader.ReadDouble();
+		bbox[i].y_max = reader.ReadDouble();
+		bbox[i].x_center = reader.ReadDouble();
+		bbox[i].y_center = reader.ReadDouble();
+		bbox[i].radius = reader.ReadDouble();
+		bbox[i].x_start = reader.ReadDouble();
+		bbox[i].y_start = reader.ReadDouble();
+		bbox[i].h_start = reader.ReadDouble();
+		bbox[i].x_end = reader.ReadDouble();
+		bbox[i].y_end = reader.ReadDouble();
+		bbox[i].h_end = reader.ReadDouble();
+		bbox[i].tangents_intersect = reader.ReadInt();
+		bbox[i].x_tangent = reader.ReadDouble();
+		bbox[i].y_tangent = reader.ReadDouble();
+	}
+
+	if (reader.Error() || !reader.AtEnd() || (int)roads.size() != n_roads)
+	{
+		LOG("Binary cache %s is corrupt, loading %s\n", filename, odr_filename_.c_str());
+		for (size_t i = 0; i < roads.size(); i++)
+		{
+			delete roads[i];
+		}
+		for (size_t i = 0; i < junctions.size(); i++)
+		{
+			delete junctions[i];
+		}
+		return -1;
+	}
 
-	return true;
+	for (size_t i = 0; i < roads.size(); i++)
+	{
+		road_idx_by_id_.insert(std::make_pair(roads[i]->GetId(), (int)road_.size()));
+		road_.push_back(roads[i]);
+	}
+	for (size_t i = 0; i < junctions.size(); i++)
+	{
+		junction_idx_by_id_.insert(std::make_pair(junctions[i]->GetId(), (int)junction_.size()));
+		junction_.push_back(junctions[i]);
+	}
+
+	return 0;
 }
 
-Connection::Connection(Road* incoming_road, Road *connecting_road, ContactPointType contact_point)
+Connection::Connection(Road* incoming_road, Road *connecting_road, ContactPointType contact_point) : tiled_od_(0)
 {
 	// Find corresponding road objects
 	incoming_road_ = incoming_road;
@@ -1798,9 +5697,22 @@ Connection::~Connection()
 	}
 }
 
-void Connection::AddJunctionLaneLink(int from, int to)
+Road *Connection::GetIncomingRoad()
+{
+	if (tiled_od_ && incoming_road_)
+	{
+		tiled_od_->LoadRoad(incoming_road_);
+	}
+	return incoming_road_;
+}
+
+Road *Connection::GetConnectingRoad()
 {
-	lane_link_.push_back(new JunctionLaneLink(from, to));
+	if (tiled_od_ && connecting_road_)
+	{
+		tiled_od_->LoadRoad(connecting_road_);
+	}
+	return connecting_road_;
 }
 
 int Connection::GetConnectingLaneId(int incoming_lane_id)
@@ -1952,268 +5864,481 @@ void Junction::Print()
 	}
 }
 
-bool RoadPath::CheckRoad(Road *checkRoad, RoadPath::PathNode *srcNode, Road *fromRoad)
+void OpenDrive::ClearRoadPathCache()
 {
-	Road* targetRoad = targetPos_->GetOpenDrive()->GetRoadById(targetPos_->GetTrackId());
-	
-	RoadLink* nextLink = 0;
+	road_path_cache_.clear();
+	road_path_cache_idx_.clear();
+}
+
+void OpenDrive::SetRoadPathCacheSize(int size)
+{
+	road_path_mutex_.Lock();
+	road_path_cache_size_ = MAX(size, 0);
+
+	while ((int)road_path_cache_.size() > road_path_cache_size_)
+	{
+		road_path_cache_idx_.erase(road_path_cache_.back().first);
+		road_path_cache_.pop_back();
+	}
+	road_path_mutex_.Unlock();
+}
+
+int OpenDrive::GetRoadPath(int start_road_idx, int target_road_idx, RoadPathEntry &entry)
+{
+	if (start_road_idx < 0 || start_road_idx >= (int)road_.size() || target_road_idx < 0 || target_road_idx >= (int)road_.size())
+	{
+		return -1;
+	}
+
+	// Copy the result while locked, since other threads may evict it from the cache
+	road_path_mutex_.Lock();
+
+	long long key = GetRoadPairKey(start_road_idx, target_road_idx);
+	std::unordered_map<long long, std::list<std::pair<long long, RoadPathEntry> >::iterator>::iterator it = road_path_cache_idx_.find(key);
+	if (it != road_path_cache_idx_.end())
+	{
+		// Move to front, as most recently used
+		road_path_cache_.splice(road_path_cache_.begin(), road_path_cache_, it->second);
+		entry = it->second->second;
+		road_path_mutex_.Unlock();
+		return 0;
+	}
+
+	road_path_cache_.push_front(std::make_pair(key, RoadPathEntry()));
+	FindRoadPaths(start_road_idx, target_road_idx, road_path_cache_.front().second);
+
+	if (road_path_cache_size_ > 0)
+	{
+		road_path_cache_idx_[key] = road_path_cache_.begin();
+	}
+
+	// Drop least recently used entries. Keep at least the new one, it's returned even if caching is disabled
+	while ((int)road_path_cache_.size() > MAX(road_path_cache_size_, 1))
+	{
+		road_path_cache_idx_.erase(road_path_cache_.back().first);
+		road_path_cache_.pop_back();
+	}
+
+	entry = road_path_cache_.front().second;
+	road_path_mutex_.Unlock();
+
+	return 0;
+}
+
+void OpenDrive::GetRoadEndSuccessors(int road_idx, int end, std::vector<std::pair<int, int> > &successors)
+{
+	// Find roads entered from the given end of the road, and at which end they are entered
+	successors.clear();
+	Road *road = road_[road_idx];
+	RoadLink *link = road->GetLink(end == 0 ? PREDECESSOR : SUCCESSOR);
 
-	if (srcNode->link->GetType() == RoadLink::ElementType::ELEMENT_TYPE_ROAD)
+	if (link == 0)
 	{
-		if (srcNode->link->GetContactPointType() == ContactPointType::CONTACT_POINT_END)
+		return;
+	}
+
+	if (link->GetElementType() == RoadLink::ELEMENT_TYPE_ROAD)
+	{
+		std::unordered_map<int, int>::iterator road_it = road_idx_by_id_.find(link->GetElementId());
+		if (road_it != road_idx_by_id_.end() &&
+			(link->GetContactPointType() == CONTACT_POINT_START || link->GetContactPointType() == CONTACT_POINT_END))
 		{
-			nextLink = checkRoad->GetLink(LinkType::PREDECESSOR);
+			successors.push_back(std::make_pair(road_it->second, link->GetContactPointType() == CONTACT_POINT_START ? 0 : 1));
 		}
-		else
+	}
+	else if (link->GetElementType() == RoadLink::ELEMENT_TYPE_JUNCTION)
+	{
+		std::unordered_map<int, int>::iterator junction_it = junction_idx_by_id_.find(link->GetElementId());
+		Junction *junction = junction_it != junction_idx_by_id_.end() ? junction_[junction_it->second] : 0;
+
+		for (int i = 0; junction && i < junction->GetNumberOfConnections(); i++)
 		{
-			nextLink = checkRoad->GetLink(LinkType::SUCCESSOR);
+			Connection *connection = junction->GetConnectionByIdx(i);
+			if (connection->GetIncomingRoadHeader() != road || connection->GetConnectingRoadHeader() == 0 ||
+				(connection->GetContactPoint() != CONTACT_POINT_START && connection->GetContactPoint() != CONTACT_POINT_END))
+			{
+				continue;
+			}
+			std::unordered_map<int, int>::iterator road_it = road_idx_by_id_.find(connection->GetConnectingRoadHeader()->GetId());
+			if (road_it != road_idx_by_id_.end())
+			{
+				successors.push_back(std::make_pair(road_it->second, connection->GetContactPoint() == CONTACT_POINT_START ? 0 : 1));
+			}
 		}
 	}
-	else if (srcNode->link->GetType() == RoadLink::ElementType::ELEMENT_TYPE_JUNCTION)
+}
+
+static void CalcRoadEndDistances(std::vector<std::vector<std::pair<int, double> > > &edges, int source, double *dist)
+{
+	// Dijkstra from source over the road end graph, dist must hold one value per node
+	std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int> >, std::greater<std::pair<double, int> > > open;
+
+	for (size_t i = 0; i < edges.size(); i++)
+	{
+		dist[i] = LARGE_NUMBER;
+	}
+	dist[source] = 0.0;
+	open.push(std::make_pair(0.0, source));
+
+	while (!open.empty())
 	{
-		if (checkRoad->GetLink(LinkType::SUCCESSOR) && 
-			checkRoad->GetLink(LinkType::SUCCESSOR)->GetElementId() == fromRoad->GetId())
+		std::pair<double, int> current = open.top();
+		open.pop();
+
+		if (current.first > dist[current.second])
 		{
-			nextLink = checkRoad->GetLink(LinkType::PREDECESSOR);
+			continue;
 		}
-		else if (checkRoad->GetLink(LinkType::PREDECESSOR) &&
-			checkRoad->GetLink(LinkType::PREDECESSOR)->GetElementId() == fromRoad->GetId())
+
+		for (size_t i = 0; i < edges[current.second].size(); i++)
 		{
-			nextLink = checkRoad->GetLink(LinkType::SUCCESSOR);
+			std::pair<int, double> &edge = edges[current.second][i];
+			if (current.first + edge.second < dist[edge.first])
+			{
+				dist[edge.first] = current.first + edge.second;
+				open.push(std::make_pair(dist[edge.first], edge.first));
+			}
 		}
 	}
+}
+
+int OpenDrive::ComputeLandmarks(int n_landmarks)
+{
+	int n_nodes = 2 * (int)road_.size();
+
+	landmark_.clear();
+	landmark_dist_from_.clear();
+	landmark_dist_to_.clear();
 
-	if (nextLink == 0)
+	if (n_landmarks <= 0)
 	{
-		// end of road
-		return false;
+		return 0;
+	}
+
+	if (n_nodes == 0)
+	{
+		LOG("OpenDrive::ComputeLandmarks Error: No roads");
+		return -1;
 	}
 
-	// Check if next node is already visited
-	for (size_t i = 0; i < visited_.size(); i++)
+	// Road end graph, same as searched by FindRoadPaths(). Node road_idx * 2 + end is leaving the road
+	// from that end, edges lead to the other end of each road entered and cost the length of that road.
+	std::vector<std::vector<std::pair<int, double> > > edges(n_nodes);
+	std::vector<std::vector<std::pair<int, double> > > reverse_edges(n_nodes);
+	std::vector<std::pair<int, int> > successors;
+
+	for (int i = 0; i < n_nodes; i++)
 	{
-		if (visited_[i]->link == nextLink)
+		GetRoadEndSuccessors(i / 2, i % 2, successors);
+		for (size_t j = 0; j < successors.size(); j++)
 		{
-			// Already visited, ignore and return
-			return false;
+			int node = 2 * successors[j].first + 1 - successors[j].second;
+			double length = road_[successors[j].first]->GetLength();
+			edges[i].push_back(std::make_pair(node, length));
+			reverse_edges[node].push_back(std::make_pair(i, length));
 		}
 	}
 
-	// Check if next node is already among unvisited
-	size_t i;
-	for (i = 0; i < unvisited_.size(); i++)
+	// Pick landmarks farthest first: each new landmark is the node farthest away, in any direction,
+	// from the ones already picked. Seed with distances from the first node.
+	std::vector<double> dist_from(n_nodes);
+	std::vector<double> dist_to(n_nodes);
+	std::vector<double> min_dist(n_nodes);
+
+	CalcRoadEndDistances(edges, 0, &dist_from[0]);
+	CalcRoadEndDistances(reverse_edges, 0, &dist_to[0]);
+	for (int i = 0; i < n_nodes; i++)
+	{
+		min_dist[i] = MIN(dist_from[i], dist_to[i]);
+	}
+
+	while ((int)landmark_.size() < n_landmarks)
 	{
-		if (unvisited_[i]->link == nextLink)
+		int landmark = -1;
+		for (int i = 0; i < n_nodes; i++)
 		{
-			// Consider it, i.e. calc distance and potentially store it (if less than old) 
-			if (srcNode->dist + checkRoad->GetLength() < unvisited_[i]->dist)
+			// Nodes not connected to any landmark give no bounds, skip them
+			if (min_dist[i] > SMALL_NUMBER && min_dist[i] < LARGE_NUMBER && (landmark < 0 || min_dist[i] > min_dist[landmark]))
 			{
-				unvisited_[i]->dist = srcNode->dist + checkRoad->GetLength();
+				landmark = i;
 			}
 		}
-	}
 
-	if (i == unvisited_.size())
-	{
-		// link not visited before, add it
-		PathNode *pNode = new PathNode;
-		pNode->dist = srcNode->dist + checkRoad->GetLength();
-		pNode->link = nextLink;
-		pNode->fromRoad = checkRoad;
-		pNode->previous = srcNode;
-		unvisited_.push_back(pNode);
+		if (landmark < 0)
+		{
+			break;  // network covered, no more useful landmarks
+		}
+
+		landmark_.push_back(landmark);
+		landmark_dist_from_.resize(landmark_.size() * n_nodes);
+		landmark_dist_to_.resize(landmark_.size() * n_nodes);
+		double *from = &landmark_dist_from_[(landmark_.size() - 1) * n_nodes];
+		double *to = &landmark_dist_to_[(landmark_.size() - 1) * n_nodes];
+		CalcRoadEndDistances(edges, landmark, from);
+		CalcRoadEndDistances(reverse_edges, landmark, to);
+
+		for (int i = 0; i < n_nodes; i++)
+		{
+			min_dist[i] = MIN(min_dist[i], MIN(from[i], to[i]));
+		}
 	}
 
-	return true;
+	return 0;
 }
 
-int RoadPath::Calculate(double &dist)
+double OpenDrive::GetLandmarkLowerBound(int from_node, int to_node)
 {
-	OpenDrive* odr = startPos_->GetOpenDrive();
-	RoadLink *link = 0;
-	Junction *junction = 0;
-	Road* startRoad = odr->GetRoadById(startPos_->GetTrackId());
-	Road* targetRoad = odr->GetRoadById(targetPos_->GetTrackId());
-	Road* pivotRoad = startRoad;
-	Road* nextRoad = startRoad;
-	bool found = false;
-	double tmpDist = 0;
-	size_t i;
-	
-	// This method will find and measure the length of the shortest path 
-	// between a start position and a target position
-	// The implementation is based on Dijkstra's algorithm
-	// https://en.wikipedia.org/wiki/Dijkstra%27s_algorithm
+	// Triangle inequality: d(u,v) >= d(l,v) - d(l,u) and d(u,v) >= d(u,l) - d(v,l). Nodes reachable from
+	// a landmark which can't reach v, or nodes which can't reach a landmark reachable from v, can't reach v.
+	int n_nodes = 2 * (int)road_.size();
+	double bound = 0.0;
 
-	// Look both forward and backwards from start position
-	for (i = 0; i < 2; i++)
+	for (size_t i = 0; i < landmark_.size(); i++)
 	{
-		if (i == 0)
+		double *from = &landmark_dist_from_[i * n_nodes];
+		double *to = &landmark_dist_to_[i * n_nodes];
+
+		if (from[from_node] < LARGE_NUMBER)
 		{
-			tmpDist = startPos_->GetS();  // distance to first road link is distance to start of road
-			link = pivotRoad->GetLink(LinkType::PREDECESSOR);  // Find link to previous road or junction
+			if (from[to_node] >= LARGE_NUMBER)
+			{
+				return LARGE_NUMBER;
+			}
+			bound = MAX(bound, from[to_node] - from[from_node]);
 		}
-		else
+
+		if (to[to_node] < LARGE_NUMBER)
 		{
-			tmpDist = pivotRoad->GetLength() - startPos_->GetS();  // distance to end of road
-			link = pivotRoad->GetLink(LinkType::SUCCESSOR);  // Find link to previous road or junction
+			if (to[from_node] >= LARGE_NUMBER)
+			{
+				return LARGE_NUMBER;
+			}
+			bound = MAX(bound, to[from_node] - to[to_node]);
 		}
+	}
 
-		// If only forward direction would be of interest, add something like:
-		// if (abs(startPos_->GetHRelative()) > M_PI_2 && abs(startPos_->GetHRelative()) < 3 * M_PI / 2)
-		// then choose predecessor, else successor 
+	return bound;
+}
 
-		if (link)
-		{
-			PathNode* pNode = new PathNode;
-			pNode->dist = tmpDist;
-			pNode->link = link;
-			pNode->fromRoad = pivotRoad;
-			pNode->previous = 0;
-			unvisited_.push_back(pNode);
-		}
+double OpenDrive::GetRoadDistanceLowerBound(int start_road_idx, double start_s, int target_road_idx, double target_s)
+{
+	if (start_road_idx < 0 || start_road_idx >= (int)road_.size() || target_road_idx < 0 || target_road_idx >= (int)road_.size())
+	{
+		return 0.0;
 	}
 
-	if (startRoad == targetRoad)
+	if (start_road_idx == target_road_idx)
 	{
-		// Special case: On same road, distance is equal to delta s
-		dist = abs(targetPos_->GetS() - startPos_->GetS());
-		return 0;
+		return fabs(target_s - start_s);
 	}
 
-	if (unvisited_.size() == 0)
+	if (landmark_.size() == 0)
 	{
-		// No links
-		dist = 0;
-		return -1;
+		return 0.0;
 	}
 
-	for (i = 0; i < 100 && !found && unvisited_.size() > 0; i++)
+	double target_length = road_[target_road_idx]->GetLength();
+	double start_dist[2] = { start_s, road_[start_road_idx]->GetLength() - start_s };
+	double target_dist[2] = { target_s, target_length - target_s };
+	double bound = LARGE_NUMBER;
+
+	for (int start_end = 0; start_end < 2; start_end++)
 	{
-		found = false;
-		
-		// Find unvisited PathNode with shortest distance
-		double minDist = LARGE_NUMBER;
-		int minIndex = 0;
-		for (size_t j = 0; j < unvisited_.size(); j++)
+		for (int target_end = 0; target_end < 2; target_end++)
 		{
-			if (unvisited_[j]->dist < minDist)
+			// Entering target road at one end means reaching the node of its other end
+			double dist = GetLandmarkLowerBound(2 * start_road_idx + start_end, 2 * target_road_idx + 1 - target_end);
+			if (dist < LARGE_NUMBER)
 			{
-				minIndex = (int)j;
-				minDist = unvisited_[j]->dist;
+				bound = MIN(bound, start_dist[start_end] + MAX(0.0, dist - target_length) + target_dist[target_end]);
 			}
 		}
+	}
+
+	return bound;
+}
+
+void OpenDrive::FindRoadPaths(int start_road_idx, int target_road_idx, RoadPathEntry &entry)
+{
+	// A* search where a node is a road and the end it is left from, 0 = start (predecessor link) and
+	// 1 = end (successor link). Entering a road at one end means leaving it from the other, so each
+	// step costs the length of the entered road. Nodes on the target road are goals, keyed by the end
+	// entered, and cost nothing more. Heuristic is the landmark bound (see ComputeLandmarks), without
+	// landmarks it's plain Dijkstra. Straight distance between road ends is no lower bound, since the
+	// reference lines of linked roads don't always meet, e.g. when a connecting road starts at a lane
+	// offset. Landmarks also tell which nodes can't reach the target at all.
+	typedef struct
+	{
+		int road_idx;
+		int end;
+		double dist;
+		int previous;
+	} SearchNode;
+
+	std::vector<std::pair<int, int> > next;
+
+	for (int start_end = 0; start_end < 2; start_end++)
+	{
+		std::vector<SearchNode> node;
+		std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int> >, std::greater<std::pair<double, int> > > open;
+		std::vector<double> best_dist(2 * road_.size(), LARGE_NUMBER);  // road_idx * 2 + end -> shortest distance found
+		int goal[2] = { -1, -1 };
+		bool goal_done[2] = { false, false };
+
+		for (int target_end = 0; target_end < 2 && landmark_.size() > 0; target_end++)
+		{
+			// Don't wait for a target end known to be unreachable
+			goal_done[target_end] = GetLandmarkLowerBound(2 * start_road_idx + start_end, 2 * target_road_idx + 1 - target_end) >= LARGE_NUMBER;
+		}
 
-		link = unvisited_[minIndex]->link;
-		tmpDist = unvisited_[minIndex]->dist;
-		pivotRoad = unvisited_[minIndex]->fromRoad;
+		SearchNode start = { start_road_idx, start_end, 0.0, -1 };
+		node.push_back(start);
+		open.push(std::make_pair(0.0, 0));
+		best_dist[2 * start_road_idx + start_end] = 0.0;
 
-		// - Inspect all unvisited neighbor nodes (links), measure edge (road) distance to that link
-		// - Note the total distance 
-		// - If not already in invisited list, put it there. 
-		// - Update distance to this link if shorter than previously registered value
-		if (link->GetElementType() == RoadLink::ElementType::ELEMENT_TYPE_ROAD)
+		while (!open.empty() && !(goal_done[0] && goal_done[1]))
 		{
-			// only one edge (road)
-			nextRoad = odr->GetRoadById(link->GetElementId());
+			int idx = open.top().second;
+			SearchNode current = node[idx];
+			open.pop();
 
-			if (nextRoad == targetRoad)
+			if (current.road_idx == target_road_idx && idx > 0)
 			{
-				// Special case: On same road, distance is equal to delta s, direction considered
-				if (link->GetContactPointType() == ContactPointType::CONTACT_POINT_START)
+				if (!goal_done[current.end])
 				{
-					tmpDist += targetPos_->GetS();
+					goal[current.end] = idx;
+					goal_done[current.end] = true;
 				}
-				else
-				{
-					tmpDist += nextRoad->GetLength() - targetPos_->GetS();
-				}
-				
-				found = true;
+				continue;
 			}
-			else
+
+			if (best_dist[2 * current.road_idx + current.end] < current.dist)
 			{
-				CheckRoad(nextRoad, unvisited_[minIndex], pivotRoad);
+				continue;  // shorter path to this node already processed
 			}
-		}
-		else if (link->GetElementType() == RoadLink::ElementType::ELEMENT_TYPE_JUNCTION)
-		{
-			// check all outgoing edges (connecting roads) from the link (junction)
-			junction = odr->GetJunctionById(link->GetElementId());
-			for (size_t j = 0; j < junction->GetNoConnectionsFromRoadId(pivotRoad->GetId()); j++)
+
+			GetRoadEndSuccessors(current.road_idx, current.end, next);
+
+			for (size_t i = 0; i < next.size(); i++)
 			{
-				Road * nextRoad = odr->GetRoadById(junction->GetConnectingRoadIdFromIncomingRoadId(pivotRoad->GetId(), (int)j));
-				if (nextRoad == 0)
+				SearchNode n = { next[i].first, next[i].second, current.dist, idx };
+
+				if (n.road_idx != target_road_idx)
 				{
-					return 0;
+					// Passing the road, leave it from the other end
+					n.end = 1 - n.end;
+					n.dist += road_[n.road_idx]->GetLength();
+
+					if (best_dist[2 * n.road_idx + n.end] <= n.dist)
+					{
+						continue;
+					}
+					best_dist[2 * n.road_idx + n.end] = n.dist;
 				}
 
-				if (nextRoad == targetRoad)
+				double estimate = n.dist;
+				if (n.road_idx != target_road_idx && landmark_.size() > 0)
 				{
-					// Special case: On same road, distance is equal to delta s
-					tmpDist += targetPos_->GetS();
-					found = true;
-				}
-				else
-				{ 
-					CheckRoad(nextRoad, unvisited_[minIndex], pivotRoad);
+					double h = LARGE_NUMBER;
+					for (int target_end = 0; target_end < 2; target_end++)
+					{
+						if (!goal_done[target_end])
+						{
+							h = MIN(h, GetLandmarkLowerBound(2 * n.road_idx + n.end, 2 * target_road_idx + 1 - target_end) - road_[target_road_idx]->GetLength());
+						}
+					}
+					if (h >= LARGE_NUMBER - road_[target_road_idx]->GetLength())
+					{
+						continue;  // no remaining target end reachable from here
+					}
+					estimate += MAX(h, 0.0);
 				}
+
+				node.push_back(n);
+				open.push(std::make_pair(estimate, (int)node.size() - 1));
 			}
 		}
-		
-		// Mark pivot link as visited (move it from unvisited to visited)
-		visited_.push_back(unvisited_[minIndex]);
-		unvisited_.erase(unvisited_.begin() + minIndex);
-	}
 
-	if (found)
-	{
-		// Find out whether the path goes forward or backwards from starting position
-		if (visited_.size() > 0)
+		for (int target_end = 0; target_end < 2; target_end++)
 		{
-			RoadPath::PathNode* node = visited_.back();
+			entry.road[start_end][target_end].clear();
+			entry.dist[start_end][target_end] = LARGE_NUMBER;
+			if (goal[target_end] < 0)
+			{
+				continue;
+			}
 
-			while (node)
+			entry.dist[start_end][target_end] = node[goal[target_end]].dist;
+			for (int i = node[goal[target_end]].previous; i > 0; i = node[i].previous)
 			{
-				if (node->previous == 0)
-				{
-					// This is the first node - inspect whether it is in front or behind start position
-					if ((node->link == startRoad->GetLink(LinkType::PREDECESSOR) && 
-						abs(startPos_->GetHRelative()) > M_PI_2 && abs(startPos_->GetHRelative()) < 3 * M_PI / 2) ||
-						((node->link == startRoad->GetLink(LinkType::SUCCESSOR) &&
-						abs(startPos_->GetHRelative()) < M_PI_2 || abs(startPos_->GetHRelative()) > 3 * M_PI / 2)))
-					{
-						direction_ = 1;
-					}
-					else
-					{
-						direction_ = -1;
-					}
-				}
-				node = node->previous;
+				entry.road[start_end][target_end].push_back(node[i].road_idx);
 			}
+			std::reverse(entry.road[start_end][target_end].begin(), entry.road[start_end][target_end].end());
 		}
 	}
+}
 
-	dist = direction_ * tmpDist;
+int RoadPath::Calculate(double &dist)
+{
+	OpenDrive* odr = startPos_->GetRoadNetwork();
+	int start_road_idx = odr->GetTrackIdxById(startPos_->GetTrackId());
+	int target_road_idx = odr->GetTrackIdxById(targetPos_->GetTrackId());
 
-	return found ? 0 : -1;
-}
+	path_.clear();
+	direction_ = 0;
+	dist = 0;
+
+	if (start_road_idx < 0 || target_road_idx < 0)
+	{
+		return -1;
+	}
 
+	if (start_road_idx == target_road_idx)
+	{
+		// Special case: On same road, distance is equal to delta s
+		dist = fabs(targetPos_->GetS() - startPos_->GetS());
+		return 0;
+	}
 
-RoadPath::~RoadPath()
-{
-	for (size_t i = 0; i < visited_.size(); i++)
+	RoadPathEntry entry;
+	odr->GetRoadPath(start_road_idx, target_road_idx, entry);
+
+	// Add distance from start position to the end of start road and from the end of target road to target position
+	double start_length = odr->GetRoadByIdx(start_road_idx)->GetLength();
+	double target_length = odr->GetRoadByIdx(target_road_idx)->GetLength();
+	double start_dist[2] = { startPos_->GetS(), start_length - startPos_->GetS() };
+	double target_dist[2] = { targetPos_->GetS(), target_length - targetPos_->GetS() };
+	double min_dist = LARGE_NUMBER;
+	int start_end = -1;
+	int target_end = -1;
+
+	for (int i = 0; i < 2; i++)
 	{
-		delete(visited_[i]);
+		for (int j = 0; j < 2; j++)
+		{
+			if (entry.dist[i][j] < LARGE_NUMBER && start_dist[i] + entry.dist[i][j] + target_dist[j] < min_dist)
+			{
+				min_dist = start_dist[i] + entry.dist[i][j] + target_dist[j];
+				start_end = i;
+				target_end = j;
+			}
+		}
 	}
-	visited_.clear();
 
-	for (size_t i = 0; i < unvisited_.size(); i++)
+	if (start_end < 0)
 	{
-		delete(unvisited_[i]);
+		return -1;
 	}
-	unvisited_.clear();
+
+	// Find out whether the path goes forward or backwards from starting position
+	double h_relative = fabs(startPos_->GetHRelative());
+	bool heading_forward = h_relative < M_PI_2 || h_relative > 3 * M_PI / 2;
+	direction_ = (start_end == 1) == heading_forward ? 1 : -1;
+
+	path_ = entry.road[start_end][target_end];
+	dist = direction_ * min_dist;
+
+	return 0;
 }
 
 OpenDrive::~OpenDrive()
@@ -2226,16 +6351,15 @@ OpenDrive::~OpenDrive()
 	{
 		delete(junction_[i]);
 	}
+	ClearRoadTiles();
 }
 
 int OpenDrive::GetTrackIdxById(int id)
 {
-	for (int i = 0; i<(int)road_.size(); i++)
+	std::unordered_map<int, int>::iterator it = road_idx_by_id_.find(id);
+	if (it != road_idx_by_id_.end())
 	{
-		if (road_[i]->GetId() == id)
-		{
-			return i;
-		}
+		return it->second;
 	}
 	LOG("OpenDrive::GetTrackIdxById Error: Road id %d not found\n", id);
 	return -1;
@@ -2251,10 +6375,22 @@ int OpenDrive::GetTrackIdByIdx(int idx)
 	return 0;
 }
 
-int OpenDrive::IsDirectlyConnected(int road1_id, int road2_id, double &angle)
+double OpenDrive::GetRoadEndHeading(Road *road, bool at_end)
 {
-	Road *road1 = GetRoadById(road1_id);
-	Road *road2 = GetRoadById(road2_id);
+	if (tiled_)
+	{
+		// Road data might not be loaded, use headings stored when the file was loaded
+		RoadTile *tile = &road_tile_[road_idx_by_id_[road->GetId()]];
+		return at_end ? tile->h_end : tile->h_start;
+	}
+
+	return GetRoadHeadingAtS(road, at_end ? road->GetLength() : 0);
+}
+
+int OpenDrive::CalcDirectlyConnected(Road *road1, Road *road2, double &angle)
+{
+	int road1_id = road1->GetId();
+	int road2_id = road2->GetId();
 	RoadLink *link;
 
 	// Look from road 1, both ends, for road 2 
@@ -2278,26 +6414,28 @@ int OpenDrive::IsDirectlyConnected(int road1_id, int road2_id, double &angle)
 				for (int j = 0; j < junction->GetNumberOfConnections(); j++)
 				{
 					Connection *connection = junction->GetConnectionByIdx(j);
-					Position test_pos1;
-					Position test_pos2;
+					double heading1, heading2, h_start, h_end;
 
-					double heading1, heading2;
+					if (connection->GetIncomingRoadHeader() == 0 || connection->GetConnectingRoadHeader() == 0)
+					{
+						continue;
+					}
 
 					// check case where road1 is incoming road
-					if (connection->GetIncomingRoad()->GetId() == road1_id && connection->GetConnectingRoad()->GetId() == road2_id)
+					if (connection->GetIncomingRoadHeader()->GetId() == road1_id && connection->GetConnectingRoadHeader()->GetId() == road2_id)
 					{
-						test_pos1.SetLanePos(road2_id, 0, 0, 0);
-						test_pos2.SetLanePos(road2_id, 0, road2->GetLength(), 0);
+						h_start = GetRoadEndHeading(road2, false);
+						h_end = GetRoadEndHeading(road2, true);
 
 						if (connection->GetContactPoint() == CONTACT_POINT_END)
 						{
-							heading1 = test_pos2.GetH() + M_PI;
-							heading2 = test_pos1.GetH() + M_PI;
+							heading1 = h_end + M_PI;
+							heading2 = h_start + M_PI;
 						}
 						else if(connection->GetContactPoint() == CONTACT_POINT_START)
 						{
-							heading1 = test_pos1.GetH();
-							heading2 = test_pos2.GetH();
+							heading1 = h_start;
+							heading2 = h_end;
 						}
 						else
 						{
@@ -2310,50 +6448,50 @@ int OpenDrive::IsDirectlyConnected(int road1_id, int road2_id, double &angle)
 						return i == 0 ? 1 : -1;
 					}
 					// then check other case where road1 is outgoing from connecting road (connecting road is a road within junction)
-					else if (connection->GetConnectingRoad()->GetId() == road2_id && 
-						((connection->GetContactPoint() == ContactPointType::CONTACT_POINT_START && connection->GetConnectingRoad()->GetLink(LinkType::SUCCESSOR)->GetElementId() == road1_id) ||
-						 (connection->GetContactPoint() == ContactPointType::CONTACT_POINT_END && connection->GetConnectingRoad()->GetLink(LinkType::PREDECESSOR)->GetElementId() == road1_id)) )
+					else if (connection->GetConnectingRoadHeader()->GetId() == road2_id && 
+						((connection->GetContactPoint() == ContactPointType::CONTACT_POINT_START && connection->GetConnectingRoadHeader()->GetLink(LinkType::SUCCESSOR)->GetElementId() == road1_id) ||
+						 (connection->GetContactPoint() == ContactPointType::CONTACT_POINT_END && connection->GetConnectingRoadHeader()->GetLink(LinkType::PREDECESSOR)->GetElementId() == road1_id)) )
 
 					{
 						if (connection->GetContactPoint() == CONTACT_POINT_START) // connecting road ends up connecting to road_1
 						{
-							test_pos1.SetLanePos(road2_id, 0, road2->GetLength(), 0);
-							test_pos2.SetLanePos(road2_id, 0, 0, 0);
+							h_start = GetRoadEndHeading(road2, true);
+							h_end = GetRoadEndHeading(road2, false);
 
-							if (connection->GetConnectingRoad()->GetLink(LinkType::SUCCESSOR)->GetContactPointType() == CONTACT_POINT_START)  // connecting to start of road_1
+							if (connection->GetConnectingRoadHeader()->GetLink(LinkType::SUCCESSOR)->GetContactPointType() == CONTACT_POINT_START)  // connecting to start of road_1
 							{
-								heading1 = test_pos2.GetH();
-								heading2 = test_pos1.GetH();
+								heading1 = h_end;
+								heading2 = h_start;
 							}
-							else if (connection->GetConnectingRoad()->GetLink(LinkType::SUCCESSOR)->GetContactPointType() == CONTACT_POINT_END)  // connecting to end of road_1
+							else if (connection->GetConnectingRoadHeader()->GetLink(LinkType::SUCCESSOR)->GetContactPointType() == CONTACT_POINT_END)  // connecting to end of road_1
 							{
-								heading1 = test_pos2.GetH() + M_PI;
-								heading2 = test_pos1.GetH() + M_PI;
+								heading1 = h_end + M_PI;
+								heading2 = h_start + M_PI;
 							}
 							else
 							{
-								LOG("Unexpected contact point %d", connection->GetConnectingRoad()->GetLink(LinkType::PREDECESSOR)->GetContactPointType());
+								LOG("Unexpected contact point %d", connection->GetConnectingRoadHeader()->GetLink(LinkType::PREDECESSOR)->GetContactPointType());
 								return 0;
 							}
 						}
 						else if (connection->GetContactPoint() == CONTACT_POINT_END) // connecting road start point connecting to road_1 
 						{
-							test_pos1.SetLanePos(road2_id, 0, 0, 0);
-							test_pos2.SetLanePos(road2_id, 0, road2->GetLength(), 0);
+							h_start = GetRoadEndHeading(road2, false);
+							h_end = GetRoadEndHeading(road2, true);
 
-							if (connection->GetConnectingRoad()->GetLink(LinkType::PREDECESSOR)->GetContactPointType() == CONTACT_POINT_START)  // connecting to start of road_1
+							if (connection->GetConnectingRoadHeader()->GetLink(LinkType::PREDECESSOR)->GetContactPointType() == CONTACT_POINT_START)  // connecting to start of road_1
 							{
-								heading1 = test_pos2.GetH() + M_PI;
-								heading2 = test_pos1.GetH() + M_PI;
+								heading1 = h_end + M_PI;
+								heading2 = h_start + M_PI;
 							}
-							else if (connection->GetConnectingRoad()->GetLink(LinkType::PREDECESSOR)->GetContactPointType() == CONTACT_POINT_END)  // connecting to end of road_1
+							else if (connection->GetConnectingRoadHeader()->GetLink(LinkType::PREDECESSOR)->GetContactPointType() == CONTACT_POINT_END)  // connecting to end of road_1
 							{
-								heading1 = test_pos2.GetH();
-								heading2 = test_pos1.GetH();
+								heading1 = h_end;
+								heading2 = h_start;
 							}
 							else
 							{
-								LOG("Unexpected contact point %d", connection->GetConnectingRoad()->GetLink(LinkType::PREDECESSOR)->GetContactPointType());
+								LOG("Unexpected contact point %d", connection->GetConnectingRoadHeader()->GetLink(LinkType::PREDECESSOR)->GetContactPointType());
 								return 0;
 							}
 						}
@@ -2363,16 +6501,94 @@ int OpenDrive::IsDirectlyConnected(int road1_id, int road2_id, double &angle)
 							return 0;
 						}
 
-						angle = GetAbsAngleDifference(heading1, heading2);
+						angle = GetAbsAngleDifference(heading1, heading2);
+
+						return i == 0 ? 1 : -1;
+					}
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+void OpenDrive::BuildConnectivityTable()
+{
+	road_connectivity_.clear();
+
+	for (size_t i = 0; i < road_.size(); i++)
+	{
+		Road *road1 = road_[i];
+
+		for (int j = 0; j < 2; j++)
+		{
+			RoadLink *link = road1->GetLink(j == 0 ? LinkType::SUCCESSOR : LinkType::PREDECESSOR);
+			std::vector<Road*> candidates;
+
+			if (link == 0)
+			{
+				continue;
+			}
+
+			// Collect roads that might be directly connected at this end
+			if (link->GetElementType() == RoadLink::ElementType::ELEMENT_TYPE_ROAD)
+			{
+				Road *road2 = FindRoadById(link->GetElementId());
+				if (road2)
+				{
+					candidates.push_back(road2);
+				}
+			}
+			else if (link->GetElementType() == RoadLink::ElementType::ELEMENT_TYPE_JUNCTION)
+			{
+				Junction *junction = GetJunctionById(link->GetElementId());
+				if (junction == 0)
+				{
+					continue;
+				}
+				for (int k = 0; k < junction->GetNumberOfConnections(); k++)
+				{
+					Road *connecting_road = junction->GetConnectionByIdx(k)->GetConnectingRoadHeader();
+					if (connecting_road)
+					{
+						candidates.push_back(connecting_road);
+					}
+				}
+			}
+
+			for (size_t k = 0; k < candidates.size(); k++)
+			{
+				long long key = GetRoadPairKey(road1->GetId(), candidates[k]->GetId());
+				if (road_connectivity_.find(key) != road_connectivity_.end())
+				{
+					continue;
+				}
 
-						return i == 0 ? 1 : -1;
-					}
+				RoadConnectivity connectivity;
+				connectivity.angle = 0;
+				connectivity.relation = CalcDirectlyConnected(road1, candidates[k], connectivity.angle);
+				if (connectivity.relation != 0)
+				{
+					road_connectivity_[key] = connectivity;
 				}
 			}
 		}
 	}
+}
+
+int OpenDrive::IsDirectlyConnected(int road1_id, int road2_id, double &angle)
+{
+	std::unordered_map<long long, RoadConnectivity>::iterator it = road_connectivity_.find(GetRoadPairKey(road1_id, road2_id));
+
+	if (it == road_connectivity_.end())
+	{
+		return 0;
+	}
 
-	return 0;
+	angle = it->second.angle;
+
+	return it->second.relation;
 }
 
 bool OpenDrive::IsIndirectlyConnected(int road1_id, int road2_id, int* &connecting_road_id, int* &connecting_lane_id, int lane1_id, int lane2_id)
@@ -2700,32 +6916,38 @@ void Position::Init()
 	lane_idx_ = -1;
 	elevation_idx_ = -1;
 	route_ = 0;
+	ResetProjectionStats();
+}
+
+Position::Position() : od_(GetOpenDrive())
+{
+	Init();
 }
 
-Position::Position()
+Position::Position(OpenDrive *od) : od_(od ? od : GetOpenDrive())
 {
 	Init();
 }
 
-Position::Position(int track_id, double s, double t)
+Position::Position(int track_id, double s, double t) : od_(GetOpenDrive())
 {
 	Init();
 	SetTrackPos(track_id, s, t);
 }
 
-Position::Position(int track_id, int lane_id, double s, double offset)
+Position::Position(int track_id, int lane_id, double s, double offset) : od_(GetOpenDrive())
 {
 	Init();
 	SetLanePos(track_id, lane_id, s, offset);
 }
 
-Position::Position(double x, double y, double z, double h, double p, double r)
+Position::Position(double x, double y, double z, double h, double p, double r) : od_(GetOpenDrive())
 {
 	Init();
 	SetInertiaPos(x, y, z, h, p, r);
 }
 
-Position::Position(double x, double y, double z, double h, double p, double r, bool calculateTrackPosition)
+Position::Position(double x, double y, double z, double h, double p, double r, bool calculateTrackPosition) : od_(GetOpenDrive())
 {
 	Init();
 	SetInertiaPos(x, y, z, h, p, r, calculateTrackPosition);
@@ -2751,13 +6973,17 @@ int LaneSection::GetClosestLaneIdx(double s, double t, double &offset)
 {
 	double min_offset = t;  // Initial offset relates to reference line
 	int candidate_lane_idx = -1;
+	LaneValueBuffer outer_offset(GetNumberOfLanes());
+	LaneValueBuffer width(GetNumberOfLanes());
+
+	GetLaneOffsets(s, outer_offset.Data(), width.Data());
 
 	for (int i = 0; i < GetNumberOfLanes(); i++)  // Search through all lanes
 	{
 		int lane_id = GetLaneIdByIdx(i);
-		double laneCenterOffset = SIGN(lane_id) * GetCenterOffset(s, lane_id);
+		double laneCenterOffset = SIGN(lane_id) * (outer_offset[i] - width[i] / 2);
 
-		if (GetLaneById(lane_id)->IsDriving() && (candidate_lane_idx == -1 || fabs(t - laneCenterOffset) < fabs(min_offset)))
+		if (GetLaneByIdx(i)->IsDriving() && (candidate_lane_idx == -1 || fabs(t - laneCenterOffset) < fabs(min_offset)))
 		{
 			min_offset = t - laneCenterOffset;
  			candidate_lane_idx = i;
@@ -2771,7 +6997,7 @@ int LaneSection::GetClosestLaneIdx(double s, double t, double &offset)
 
 int Position::GotoClosestDrivingLaneAtCurrentPosition()
 {
-	Road *road = GetOpenDrive()->GetRoadByIdx(track_idx_);
+	Road *road = od_->GetRoadByIdx(track_idx_);
 	if (road == 0)
 	{
 		LOG("No road %d", track_idx_);
@@ -2803,7 +7029,7 @@ int Position::GotoClosestDrivingLaneAtCurrentPosition()
 
 void Position::Track2Lane()
 {
-	Road *road = GetOpenDrive()->GetRoadByIdx(track_idx_);
+	Road *road = od_->GetRoadByIdx(track_idx_);
 	if (road == 0)
 	{
 		LOG("Position::Track2Lane Error: No road %d\n", track_idx_);
@@ -2843,7 +7069,7 @@ void Position::Track2Lane()
 	lane_section_idx_ = lane_section_idx;
 }
 
-double Position::GetDistToTrackGeom(double x3, double y3, double z3, double h, Road *road, Geometry *geom, bool &inside, double &sNorm)
+double Position::GetDistToTrackGeom(double x3, double y3, double z3, double h, GeometryBBox *bbox, bool &inside, double &sNorm)
 {
 	// Step 1: Approximate geometry with a line, and check distance roughly
 
@@ -2854,16 +7080,24 @@ double Position::GetDistToTrackGeom(double x3, double y3, double z3, double h, R
 	double dsMin = 0;
 	double z = 0;
 	double min_lane_dist;
+	double geom_s, geom_length;
+	OpenDrive *od = od_;
+	int road_idx = bbox->road_idx;
+	int geom_idx = bbox->geom_idx;
 
-	// Evaluate line endpoints to get a straight line in between
-	geom->EvaluateDS(0, &x1, &y1, &h1);
-	geom->EvaluateDS(geom->GetLength(), &x2, &y2, &h2);
+	if (od->GetGeometrySAndLength(road_idx, geom_idx, &geom_s, &geom_length) != 0)
+	{
+		LOG("Position::GetDistToTrackGeom Error: No geometry %d on road idx %d\n", geom_idx, road_idx);
+		return std::numeric_limits<double>::infinity();
+	}
 
-	// Apply lane offset
-	x1 += road->GetLaneOffset(0) * cos(h1 + M_PI_2);
-	y1 += road->GetLaneOffset(geom->GetLength()) * sin(h1 + M_PI_2);
-	x2 += road->GetLaneOffset(0) * cos(h2 + M_PI_2);
-	y2 += road->GetLaneOffset(geom->GetLength()) * sin(h2 + M_PI_2);
+	// Line endpoints, lane offset applied, to get a straight line in between
+	x1 = bbox->x_start;
+	y1 = bbox->y_start;
+	h1 = bbox->h_start;
+	x2 = bbox->x_end;
+	y2 = bbox->y_end;
+	h2 = bbox->h_end;
 
 	// Find vector from point perpendicular to line segment
 	double x4, y4;
@@ -2893,7 +7127,7 @@ double Position::GetDistToTrackGeom(double x3, double y3, double z3, double h, R
 		else
 		{
 			dist = d2;
-			dsMin = geom->GetLength();
+			dsMin = geom_length;
 			sNorm = 1;
 		}
 	}
@@ -2905,7 +7139,7 @@ double Position::GetDistToTrackGeom(double x3, double y3, double z3, double h, R
 	// But do this only for relevant geometries within reasonable short distance - 
 	// else just use approximate distance value as calculated above
 
-	if (dist < 50 + 0.5 * geom->GetLength())  // Extend search area for long geometries since they might bend from the straight line
+	if (dist < 50 + 0.5 * geom_length)  // Extend search area for long geometries since they might bend from the straight line
 	{
 		// Step 2: Find s value within given geometry segment
 		// If heading at start and end points of the geometry are practically equal let's approximate with a straight line
@@ -2913,7 +7147,7 @@ double Position::GetDistToTrackGeom(double x3, double y3, double z3, double h, R
 		{
 			// If small heading difference, treat segment as a straight line 
 			// Just use the normalized s value from calculation above, but clip at 0 and 1 to keep it inside geometry boundries
-			dsMin = CLAMP(sNorm, 0.0, 1.0) * geom->GetLength();
+			dsMin = CLAMP(sNorm, 0.0, 1.0) * geom_length;
 		}
 		else
 		{
@@ -2923,20 +7157,12 @@ double Position::GetDistToTrackGeom(double x3, double y3, double z3, double h, R
 			// 3. Find out angles between this line segment l1 and extended tangents t1 and t2
 			// 4. s value corresponds to the angle between l1 and t1 divided by angle between t2 and t1
 
-			double t1x1, t1y1, t1x2, t1y2, t2x1, t2y1, t2x2, t2y2, px, py, l1x, l1y;
-
-			// Define tangent vectors from geometry start- and end point respectivelly 
-			t1x1 = x1;
-			t1y1 = y1;
-			t1x2 = t1x1 + cos(h1 + M_PI_2);
-			t1y2 = t1y1 + sin(h1 + M_PI_2);
+			// Intersection of the tangents, defined from geometry start- and end point respectively, is precalculated
+			double px = bbox->x_tangent;
+			double py = bbox->y_tangent;
+			double l1x, l1y;
 
-			t2x1 = x2;
-			t2y1 = y2;
-			t2x2 = t2x1 + cos(h2 + M_PI_2);
-			t2y2 = t2y1 + sin(h2 + M_PI_2);
-
-			if (GetIntersectionOfTwoLineSegments(t1x1, t1y1, t1x2, t1y2, t2x1, t2y1, t2x2, t2y2, px, py) == 0)
+			if (bbox->tangents_intersect)
 			{
 				l1x = px - x3;
 				l1y = py - y3;
@@ -2972,7 +7198,7 @@ double Position::GetDistToTrackGeom(double x3, double y3, double z3, double h, R
 				{
 					inside = true;
 					sNorm = angle1 / angle2;
-					dsMin = geom->GetLength() * sNorm;
+					dsMin = geom_length * sNorm;
 				}
 				else
 				{
@@ -2985,21 +7211,21 @@ double Position::GetDistToTrackGeom(double x3, double y3, double z3, double h, R
 			}
 		}
 	
-		double sMin = geom->GetS() + dsMin;
+		double sMin = geom_s + dsMin;
 		double x, y;
 		double pitch = 0;
 
 
 		// Find out Z level
-		road->GetZAndPitchByS(sMin, &z, &pitch, &elevation_idx_);
+		od->GetZAndPitchByS(road_idx, sMin, &z, &pitch, &elevation_idx_);
 
 		// Step 3: Find exact position along road geometry at calculated s-value
 		// and calculated distance from this point on road to given point 
 
-		geom->EvaluateDS(dsMin, &x, &y, &h);
+		od->EvaluateGeometryDS(road_idx, geom_idx, dsMin, &x, &y, &h);
 		// Apply lane offset
-		x += road->GetLaneOffset(sMin) * cos(h + M_PI_2);
-		y += road->GetLaneOffset(sMin) * sin(h + M_PI_2);
+		x += od->GetLaneOffset(road_idx, sMin) * cos(h + M_PI_2);
+		y += od->GetLaneOffset(road_idx, sMin) * sin(h + M_PI_2);
 		dist = PointDistance2D(x3, y3, x, y);
 
 		// Check whether the point is left or right side of road
@@ -3009,27 +7235,7 @@ double Position::GetDistToTrackGeom(double x3, double y3, double z3, double h, R
 		// dist is now actually the lateral distance from reference lane, e.g. track coordinate t-value
 
 		// Finally calculate exakt distance, but only for inside points
-		LaneSection *lane_section = road->GetLaneSectionByS(sMin);
-		min_lane_dist = std::numeric_limits<double>::infinity();
-		if (lane_section != 0)
-		{
-			for (int i = 0; i < lane_section->GetNumberOfLanes(); i++)
-			{
-				if (lane_section->GetLaneByIdx(i)->IsDriving())
-				{
-					double lane_dist;
-					{
-						double signed_offset = dist * SIGN(side);
-						double signed_lane_center_offset = SIGN(lane_section->GetLaneIdByIdx(i)) * lane_section->GetCenterOffset(sMin, lane_section->GetLaneIdByIdx(i));
-						lane_dist = signed_offset - signed_lane_center_offset;
-						if (fabs(lane_dist) < fabs(min_lane_dist))
-						{
-							min_lane_dist = lane_dist;
-						}
-					}
-				}
-			}
-		}
+		min_lane_dist = od->GetDistToClosestDrivingLane(road_idx, sMin, dist * SIGN(side));
 	} 
 	else
 	{
@@ -3049,19 +7255,23 @@ void Position::XYZH2TrackPos(double x3, double y3, double z3, double h3, bool al
 	Geometry *geomMin = 0;
 	Road *road, *current_road = 0;
 	Road *roadMin = 0;
+	int prev_road_idx = -1;
 	bool inside = false;
 	bool directlyConnected = false;
 	bool directlyConnectedMin = false;
 	double weight = 0; // Add some resistance to switch from current road, applying a stronger bound to current road
 	double angle = 0;
 	bool search_done = false;
+	GeometryGrid *grid = od_->GetGeometryGrid();
+	std::vector<int> candidates;
+	std::vector<int> check_list;
 
-	if (GetOpenDrive()->GetNumOfRoads() == 0)
+	if (od_->GetNumOfRoads() == 0)
 	{
 		return;
 	}
 
-	if ((current_road = GetOpenDrive()->GetRoadByIdx(track_idx_)) != 0)
+	if ((current_road = od_->GetRoadByIdx(track_idx_)) != 0)
 	{
 		if ((current_geom = current_road->GetGeometry(geometry_idx_)) == 0)
 		{
@@ -3073,80 +7283,97 @@ void Position::XYZH2TrackPos(double x3, double y3, double z3, double h3, bool al
 	x_ = x3;
 	y_ = y3;
 
-	for (int i = -1; !search_done && i < GetOpenDrive()->GetNumOfRoads(); i++)
+	// Only geometries with a bounding box within a search radius are considered. Since the distance measure
+	// is never less than the distance to the bounding box, no geometry outside the radius can be closer than
+	// a match within the radius. If there is no such match, widen the search and try again.
+	for (double radius = XYZ_SEARCH_RADIUS; ; radius *= 4)
 	{
-		if (i == -1)
+		distMin = std::numeric_limits<double>::infinity();
+		sNormMin = 0;
+		geomMin = 0;
+		roadMin = 0;
+		prev_road_idx = -1;
+		directlyConnectedMin = false;
+
+		grid->Query(x3, y3, radius, candidates);
+
+		check_list.clear();
+		if (current_road)
 		{
-			// First check current road. IF the new point is ON this road, i.e. within drivable lanes, - then don't look further
-			if (current_road)
-			{
-				road = current_road;
-			}
-			else
+			// First check current road, starting with current segment. IF the new point is ON this road, 
+			// i.e. within drivable lanes, - then don't look further
+			check_list.push_back(grid->GetBBoxIdx(track_idx_, geometry_idx_));
+			for (int j = 0; j < current_road->GetNumberOfGeometries(); j++)
 			{
-				continue;  // Skip, no current road
+				if (j != geometry_idx_)
+				{
+					check_list.push_back(grid->GetBBoxIdx(track_idx_, j));
+				}
 			}
 		}
-		else
+		for (size_t i = 0; i < candidates.size(); i++)
 		{
-			if (current_road && i == track_idx_)
-			{
-				continue; // Skip, already checked this one
-			}
-			else
+			if (!current_road || grid->GetBBoxByIdx(candidates[i])->road_idx != track_idx_)  // current road already added
 			{
-				road = GetOpenDrive()->GetRoadByIdx(i);
+				check_list.push_back(candidates[i]);
 			}
 		}
 
-		weight = 0;
-		angle = 0;
-
-		// Add resistance to leave current road or directly connected ones 
-		// actual weights are totally unscientific... up to tuning
-		if (current_road && (road == current_road || GetOpenDrive()->IsDirectlyConnected(current_road->GetId(), road->GetId(), angle)))
-		{
-			weight = angle;
-			directlyConnected = true;
-		}
-		else
+		for (size_t i = 0; !search_done && i < check_list.size(); i++)
 		{
-			if (directlyConnectedMin) // if already found a directly connected position - add offset distance
+			if (check_list[i] < 0)
 			{
-				weight = 3;
+				continue;  // geometry missing in grid
 			}
+			GeometryBBox *bbox = grid->GetBBoxByIdx(check_list[i]);
+			bool on_current_road = current_road && bbox->road_idx == track_idx_;
 
-			weight += 5;  // For non connected roads add additional "penalty" threshold  
-			directlyConnected = false;
-		}
-		
-		for (int j = -1; j < road->GetNumberOfGeometries(); j++)
-		{
-			if (j == -1)
+			// Weights and bounding circle only need the road index and ID, so road data is not
+			// accessed (or loaded, in tiled mode) for geometries that are skipped
+			if (bbox->road_idx != prev_road_idx)
 			{
-				if (road == current_road)
+				weight = 0;
+				angle = 0;
+
+				// Add resistance to leave current road or directly connected ones 
+				// actual weights are totally unscientific... up to tuning
+				if (current_road && (on_current_road ||
+					od_->IsDirectlyConnected(current_road->GetId(), od_->GetTrackIdByIdx(bbox->road_idx), angle)))
 				{
-					// If current road, first check current segment
-					geom = road->GetGeometry(geometry_idx_);
+					weight = angle;
+					directlyConnected = true;
 				}
 				else
 				{
-					continue;  // no current road, skip
+					if (directlyConnectedMin) // if already found a directly connected position - add offset distance
+					{
+						weight = 3;
+					}
+
+					weight += 5;  // For non connected roads add additional "penalty" threshold  
+					directlyConnected = false;
 				}
+				prev_road_idx = bbox->road_idx;
 			}
-			else
+
+			if (!on_current_road && distMin - weight < std::numeric_limits<double>::infinity())
 			{
-				if (road == current_road && j == geometry_idx_)
-				{
-					continue; // Skip, already checked this one
-				}
-				else
+				// The distance measure is never less than the distance to the bounding circle. Skip the geometry
+				// if even that would not beat the best match so far. Current road is always evaluated, since
+				// it might end the search even when not closest.
+				double dx = x3 - bbox->x_center;
+				double dy = y3 - bbox->y_center;
+				double max_dist = distMin - weight + bbox->radius;
+
+				if (max_dist < 0 || dx * dx + dy * dy >= max_dist * max_dist)
 				{
-					geom = road->GetGeometry(j); 
+					continue;
 				}
 			}
-			
-			dist = GetDistToTrackGeom(x3, y3, z3, h3, road, geom, inside, sNorm);
+
+			road = od_->GetRoadByIdx(bbox->road_idx);
+			geom = road->GetGeometry(bbox->geom_idx);
+			dist = GetDistToTrackGeom(x3, y3, z3, h3, bbox, inside, sNorm);
 			
 			dist += weight + (inside ? 0 : 2);  // penalty for roads outside projection area
 
@@ -3160,16 +7387,20 @@ void Position::XYZH2TrackPos(double x3, double y3, double z3, double h3, bool al
 			}
 
 			// Special case - if point is on current road
-			if (road == current_road)
+			if (on_current_road)
 			{
 				if (dist < road->GetLaneWidthByS(sNormMin * geomMin->GetLength(), lane_id_) / 2.0)
 				{
 					// If inside drivable lanes boundry, stay on current road
 					search_done = true;
-					break;
 				}
 			}
 		}
+
+		if (search_done || distMin <= radius || (int)candidates.size() >= grid->GetNumberOfBBoxes())
+		{
+			break;
+		}
 	}
 
 	if (roadMin == 0)
@@ -3202,11 +7433,384 @@ void Position::XYZH2TrackPos(double x3, double y3, double z3, double h3, bool al
 
 	EvaluateRoadZPitchRoll(alignZPitchRoll);
 }
-	
+
+int Position::ProjectOnGeometry(int road_idx, int geom_idx, double x3, double y3, double &ds, double &t)
+{
+	// Newton iteration on the distance along the geometry heading from the geometry point at ds to (x3, y3).
+	// Returns 0 when converged within the geometry, -1 or +1 if the closest point is before start or after
+	// end of it, -2 on failure. t receives lateral distance from the reference line, lane offset not applied.
+	Geometry *geom = od_->GetGeometryByIdx(road_idx, geom_idx);
+	double x, y, h;
+
+	if (geom == 0)
+	{
+		return -2;
+	}
+
+	ds = CLAMP(ds, 0.0, geom->GetLength());
+
+	for (int i = 0; i < PROJECTION_MAX_ITERATIONS; i++)
+	{
+		od_->EvaluateGeometryDS(road_idx, geom_idx, ds, &x, &y, &h);
+
+		double along = (x3 - x) * cos(h) + (y3 - y) * sin(h);
+		t = (y3 - y) * cos(h) - (x3 - x) * sin(h);
+
+		if (fabs(along) < PROJECTION_TOLERANCE)
+		{
+			return 0;
+		}
+
+		// Derivative of the along distance with respect to ds is -(1 - t * curvature)
+		double derivative = 1 - t * geom->EvaluateCurvatureDS(ds);
+		if (derivative < PROJECTION_MIN_DERIVATIVE)
+		{
+			return -2;
+		}
+
+		double ds_next = ds + along / derivative;
+		if (ds_next < 0)
+		{
+			if (ds == 0)
+			{
+				return -1;
+			}
+			ds_next = 0;
+		}
+		else if (ds_next > geom->GetLength())
+		{
+			if (ds == geom->GetLength())
+			{
+				return 1;
+			}
+			ds_next = geom->GetLength();
+		}
+		ds = ds_next;
+	}
+
+	return -2;
+}
+
+int Position::ProjectOnRoad(int road_idx, int &geom_idx, double &ds, double x3, double y3, double z3, double &t, double &dist)
+{
+	// Project point on the road, starting from given geometry and moving to neighbouring ones as needed.
+	// Returns 0 if the point is within a driving lane, -1 or +1 if it is beyond start or end of the road,
+	// -2 otherwise. dist receives the distance to the center of the closest driving lane, including height.
+	Road *road = od_->GetRoadByIdx(road_idx);
+	int prev_step = 0;
+
+	if (road == 0)
+	{
+		return -2;
+	}
+
+	for (int i = 0; ; i++)
+	{
+		int ret = ProjectOnGeometry(road_idx, geom_idx, x3, y3, ds, t);
+
+		if (ret == 0 || ret == -prev_step)
+		{
+			// Found, or point is outside the corner between two geometries - then the shared endpoint is closest
+			break;
+		}
+		else if (ret == -2)
+		{
+			return -2;
+		}
+		else if ((ret == -1 && geom_idx == 0) || (ret == 1 && geom_idx == road->GetNumberOfGeometries() - 1))
+		{
+			return ret;
+		}
+		else if (i == PROJECTION_MAX_GEOMETRY_STEPS)
+		{
+			return -2;
+		}
+
+		geom_idx += ret;
+		ds = ret < 0 ? road->GetGeometry(geom_idx)->GetLength() : 0;
+		prev_step = ret;
+	}
+
+	double s = road->GetGeometry(geom_idx)->GetS() + ds;
+	LaneSection *lane_section = road->GetLaneSectionByS(s);
+	if (lane_section == 0)
+	{
+		return -2;
+	}
+
+	double offset;
+	t -= od_->GetLaneOffset(road_idx, s);
+	int lane_idx = lane_section->GetClosestLaneIdx(s, t, offset);
+	if (lane_idx < 0)
+	{
+		return -2;
+	}
+
+	double z = 0;  // not set if the road has no elevation profile
+	double pitch = 0;
+	od_->GetZAndPitchByS(road_idx, s, &z, &pitch, &elevation_idx_);
+	dist = fabs(offset) + fabs(z3 - z);
+
+	// Same criteria as in XYZH2TrackPos() for staying on the current road
+	if (dist >= lane_section->GetWidth(s, lane_section->GetLaneIdByIdx(lane_idx)) / 2.0)
+	{
+		return -2;
+	}
+
+	return 0;
+}
+
+void Position::XYZH2TrackPosIncremental(double x3, double y3, double z3, double h3, bool alignZPitchRoll)
+{
+	int road_idx = track_idx_;
+	int geom_idx = geometry_idx_;
+	double geom_s, geom_length;
+	double ds = 0;
+	double t = 0;
+	double dist = 0;
+	int ret = -2;
+
+	if (od_->GetGeometrySAndLength(track_idx_, geometry_idx_, &geom_s, &geom_length) == 0)
+	{
+		ds = s_ - geom_s;
+		ret = ProjectOnRoad(road_idx, geom_idx, ds, x3, y3, z3, t, dist);
+	}
+
+	if (ret == 0)
+	{
+		if (geom_idx == geometry_idx_)
+		{
+			projection_stats_.current_geometry++;
+		}
+		else
+		{
+			projection_stats_.same_road++;
+		}
+	}
+	else if (ret == -1 || ret == 1)
+	{
+		// Point is beyond the end of the road, look for it on the roads connected there
+		std::vector<std::pair<int, int> > successors;
+		double dist_min = std::numeric_limits<double>::infinity();
+
+		od_->GetRoadEndSuccessors(track_idx_, ret < 0 ? 0 : 1, successors);
+
+		for (size_t i = 0; i < successors.size(); i++)
+		{
+			Road *road = od_->GetRoadByIdx(successors[i].first);
+			if (road == 0 || road->GetNumberOfGeometries() == 0)
+			{
+				continue;
+			}
+
+			int candidate_geom_idx = successors[i].second == 0 ? 0 : road->GetNumberOfGeometries() - 1;
+			double candidate_ds = successors[i].second == 0 ? 0 : road->GetGeometry(candidate_geom_idx)->GetLength();
+			double candidate_t, candidate_dist;
+			double angle = 0;
+
+			if (ProjectOnRoad(successors[i].first, candidate_geom_idx, candidate_ds, x3, y3, z3, candidate_t, candidate_dist) != 0)
+			{
+				continue;
+			}
+
+			// Prefer the road with least heading change, like XYZH2TrackPos()
+			od_->IsDirectlyConnected(track_id_, road->GetId(), angle);
+			if (candidate_dist + angle < dist_min)
+			{
+				dist_min = candidate_dist + angle;
+				road_idx = successors[i].first;
+				geom_idx = candidate_geom_idx;
+				ds = candidate_ds;
+				t = candidate_t;
+				ret = 0;
+			}
+		}
+
+		if (ret == 0)
+		{
+			projection_stats_.connected_road++;
+		}
+	}
+
+	if (ret != 0)
+	{
+		projection_stats_.global++;
+		XYZH2TrackPos(x3, y3, z3, h3, alignZPitchRoll);
+		return;
+	}
+
+	Road *road = od_->GetRoadByIdx(road_idx);
+	double x, y;
+
+	x_ = x3;
+	y_ = y3;
+	od_->EvaluateGeometryDS(road_idx, geom_idx, ds, &x, &y, &h_road_);
+	SetHeading(h3);
+	SetTrackPos(road->GetId(), road->GetGeometry(geom_idx)->GetS() + ds, t, false);
+	EvaluateRoadZPitchRoll(alignZPitchRoll);
+}
+
+void Position::SetInertiaPosIncremental(double x, double y, double z, double h, double p, double r)
+{
+	x_ = x;
+	y_ = y;
+	z_ = z;
+	SetHeading(h);
+	p_ = p;
+	r_ = r;
+
+	XYZH2TrackPosIncremental(GetX(), GetY(), GetZ(), GetH(), false);
+}
+
+void Position::ResetProjectionStats()
+{
+	projection_stats_.current_geometry = 0;
+	projection_stats_.same_road = 0;
+	projection_stats_.connected_road = 0;
+	projection_stats_.global = 0;
+}
+
+// Input, output and progress of OpenDrive::XYZH2TrackPosBatch(), shared by its threads
+typedef struct
+{
+	OpenDrive *od;
+	int n;
+	const double *x;
+	const double *y;
+	const double *z;
+	const double *h;
+	int *road_id;
+	int *lane_id;
+	double *s;
+	double *t;
+	double *offset;
+	int next_point;  // first point of the next block to map
+	ProjectionStats stats;
+	SE_Mutex mutex;
+} ProjectionBatch;
+
+static void XYZH2TrackPosBatchThread(void *arg)
+{
+	ProjectionBatch *batch = (ProjectionBatch*)arg;
+
+	for (;;)
+	{
+		batch->mutex.Lock();
+		int first = batch->next_point;
+		batch->next_point += PROJECTION_BATCH_BLOCK_SIZE;
+		batch->mutex.Unlock();
+
+		if (first >= batch->n)
+		{
+			return;
+		}
+
+		// New position per block, so that the result does not depend on which thread mapped the previous block
+		Position pos(batch->od);
+		int last = MIN(first + PROJECTION_BATCH_BLOCK_SIZE, batch->n);
+
+		for (int i = first; i < last; i++)
+		{
+			if (batch->z)
+			{
+				pos.SetInertiaPosIncremental(batch->x[i], batch->y[i], batch->z[i], batch->h[i], 0, 0);
+			}
+			else
+			{
+				// Height not known, assume it follows the road
+				pos.XYZH2TrackPosIncremental(batch->x[i], batch->y[i], pos.GetZ(), batch->h[i], true);
+			}
+
+			batch->road_id[i] = pos.GetTrackId();
+			batch->lane_id[i] = pos.GetLaneId();
+			batch->s[i] = pos.GetS();
+			batch->t[i] = pos.GetT();
+			batch->offset[i] = pos.GetOffset();
+		}
+
+		ProjectionStats stats = pos.GetProjectionStats();
+		batch->mutex.Lock();
+		batch->stats.current_geometry += stats.current_geometry;
+		batch->stats.same_road += stats.same_road;
+		batch->stats.connected_road += stats.connected_road;
+		batch->stats.global += stats.global;
+		batch->mutex.Unlock();
+	}
+}
+
+int OpenDrive::XYZH2TrackPosBatch(int n, const double *x, const double *y, const double *z, const double *h,
+	int *road_id, int *lane_id, double *s, double *t, double *offset, int n_threads, ProjectionStats *stats)
+{
+	if (n < 0 || (n > 0 && (x == 0 || y == 0 || h == 0 || road_id == 0 || lane_id == 0 || s == 0 || t == 0 || offset == 0)))
+	{
+		LOG("XYZH2TrackPosBatch: Invalid arguments\n");
+		return -1;
+	}
+
+	ProjectionBatch batch;
+	batch.od = this;
+	batch.n = n;
+	batch.x = x;
+	batch.y = y;
+	batch.z = z;
+	batch.h = h;
+	batch.road_id = road_id;
+	batch.lane_id = lane_id;
+	batch.s = s;
+	batch.t = t;
+	batch.offset = offset;
+	batch.next_point = 0;
+	batch.stats.current_geometry = 0;
+	batch.stats.same_road = 0;
+	batch.stats.connected_road = 0;
+	batch.stats.global = 0;
+
+	if (n_threads <= 0)
+	{
+		n_threads = SE_Thread::GetNumberOfCores();
+	}
+	n_threads = MIN(n_threads, (n + PROJECTION_BATCH_BLOCK_SIZE - 1) / PROJECTION_BATCH_BLOCK_SIZE);
+
+	// Calling thread takes part in the work too
+	SE_Thread *thread = n_threads > 1 ? new SE_Thread[n_threads - 1] : 0;
+	for (int i = 0; i < n_threads - 1; i++)
+	{
+		thread[i].Start(XYZH2TrackPosBatchThread, &batch);
+	}
+	XYZH2TrackPosBatchThread(&batch);
+	for (int i = 0; i < n_threads - 1; i++)
+	{
+		thread[i].Wait();
+	}
+	delete[] thread;
+
+	if (stats)
+	{
+		*stats = batch.stats;
+	}
+
+	return 0;
+}
 
 bool Position::EvaluateRoadZPitchRoll(bool alignZPitchRoll)
 {
-	bool ret_value = GetRoadById(track_id_)->GetZAndPitchByS(s_, &z_road_, &p_road_, &elevation_idx_);
+	RoadTessellation *tessellation = od_->GetTessellation(track_idx_);
+	bool ret_value;
+
+	if (tessellation)
+	{
+		RoadSample sample;
+		if ((ret_value = tessellation->HasElevation()) == true)
+		{
+			tessellation->Evaluate(s_, &sample);
+			z_road_ = sample.z;
+			p_road_ = -sample.z_prim;
+		}
+	}
+	else
+	{
+		ret_value = od_->GetZAndPitchByS(track_idx_, s_, &z_road_, &p_road_, &elevation_idx_);
+	}
 
 	if (alignZPitchRoll)
 	{
@@ -3227,31 +7831,45 @@ bool Position::EvaluateRoadZPitchRoll(bool alignZPitchRoll)
 
 void Position::Track2XYZ()
 {
-	if (GetOpenDrive()->GetNumOfRoads() == 0)
+	if (od_->GetNumOfRoads() == 0)
 	{
 		return;
 	}
 
-	Road *road = GetOpenDrive()->GetRoadByIdx(track_idx_);
-	if (road == 0)
-	{
-		LOG("Position::Track2XYZ Error: No road %d\n", track_idx_);
-		return;
-	}
+	OpenDrive *od = od_;
+	RoadTessellation *tessellation = od->GetTessellation(track_idx_);
+	double lane_offset, lane_offset_prim;
 
-	Geometry *geometry = road->GetGeometry(geometry_idx_);
-	if (geometry == 0)
+	if (tessellation)
 	{
-		LOG("Position::Track2XYZ Error: No geometry %d\n", geometry_idx_);
-		return;
+		// Approximate mode, interpolate in road samples
+		RoadSample sample;
+		tessellation->Evaluate(s_, &sample);
+		x_ = sample.x;
+		y_ = sample.y;
+		h_road_ = sample.h;
+		lane_offset = sample.lane_offset;
+		lane_offset_prim = sample.lane_offset_prim;
 	}
+	else
+	{
+		double geom_s, geom_length;
+
+		if (od->GetGeometrySAndLength(track_idx_, geometry_idx_, &geom_s, &geom_length) != 0)
+		{
+			LOG("Position::Track2XYZ Error: No geometry %d on road idx %d\n", geometry_idx_, track_idx_);
+			return;
+		}
 
-	geometry->EvaluateDS(s_ - geometry->GetS(), &x_, &y_, &h_road_);
+		od->EvaluateGeometryDS(track_idx_, geometry_idx_, s_ - geom_s, &x_, &y_, &h_road_);
+		lane_offset = od->GetLaneOffset(track_idx_, s_);
+		lane_offset_prim = od->GetLaneOffsetPrim(track_idx_, s_);
+	}
 	
 	// Consider lateral t position, perpendicular to track heading
-	double x_local = (t_ + road->GetLaneOffset(s_)) * cos(h_road_ + M_PI_2);
-	double y_local = (t_ + road->GetLaneOffset(s_)) * sin(h_road_ + M_PI_2);
-	h_road_ += atan(road->GetLaneOffsetPrim(s_)) + h_offset_;
+	double x_local = (t_ + lane_offset) * cos(h_road_ + M_PI_2);
+	double y_local = (t_ + lane_offset) * sin(h_road_ + M_PI_2);
+	h_road_ += atan(lane_offset_prim) + h_offset_;
 	h_ = h_road_ + h_relative_;  // Update heading, taking relative heading into account
 	x_ += x_local;
 	y_ += y_local;
@@ -3262,18 +7880,13 @@ void Position::Track2XYZ()
 
 void Position::Lane2Track()
 {
-	Road *road = GetOpenDrive()->GetRoadByIdx(track_idx_);
+	double center_offset, center_offset_heading;
 	t_ = 0;
 
-	if (road != 0 && road->GetNumberOfLaneSections() > 0)
+	if (od_->GetCenterOffsetAndHeading(track_idx_, lane_section_idx_, s_, lane_id_, &center_offset, &center_offset_heading) == 0)
 	{
-		LaneSection *lane_section = road->GetLaneSectionByIdx(lane_section_idx_);
-
-		if (lane_section != 0)
-		{
-			t_ = offset_ + lane_section->GetCenterOffset(s_, lane_id_) * (lane_id_ < 0 ? -1 : 1);
-			h_offset_ = lane_section->GetCenterOffsetHeading(s_, lane_id_) * (lane_id_ < 0 ? -1 : 1);
-		}
+		t_ = offset_ + center_offset * (lane_id_ < 0 ? -1 : 1);
+		h_offset_ = center_offset_heading * (lane_id_ < 0 ? -1 : 1);
 	}
 }
 
@@ -3286,12 +7899,12 @@ int Position::SetLongitudinalTrackPos(int track_id, double s)
 {
 	Road *road;
 
-	if (GetOpenDrive()->GetNumOfRoads() == 0)
+	if (od_->GetNumOfRoads() == 0)
 	{
 		return -1;
 	}
 	
-	if ((road = GetOpenDrive()->GetRoadById(track_id)) == 0)
+	if ((road = od_->GetRoadById(track_id)) == 0)
 	{
 		LOG("Position::Set Error: track %d not found\n", track_id);
 		return -1;
@@ -3300,7 +7913,7 @@ int Position::SetLongitudinalTrackPos(int track_id, double s)
 	{
 		// update internal track and geometry indices
 		track_id_ = track_id;
-		track_idx_ = GetOpenDrive()->GetTrackIdxById(track_id);
+		track_idx_ = od_->GetTrackIdxById(track_id);
 		geometry_idx_ = 0;
 		elevation_idx_ = 0;
 		lane_section_idx_ = 0;
@@ -3321,24 +7934,8 @@ int Position::SetLongitudinalTrackPos(int track_id, double s)
 		s_ = s;
 	}
 
-	Geometry *geometry = road->GetGeometry(geometry_idx_);
-	// check if still on same geometry
-	if (s_ > geometry->GetS() + geometry->GetLength())
-	{
-		while (s_ > geometry->GetS() + geometry->GetLength() && geometry_idx_ < road->GetNumberOfGeometries() - 1)
-		{
-			// Move to next geometry
-			geometry = road->GetGeometry(++geometry_idx_);
-		}
-	}
-	else if (s_ < geometry->GetS())
-	{
-		while (s_ < geometry->GetS() && geometry_idx_ > 0)
-		{
-			// Move to previous geometry
-			geometry = road->GetGeometry(--geometry_idx_);
-		}
-	}
+	// check if still on same geometry, else look it up
+	geometry_idx_ = road->GetGeometryIdxByS(s_, geometry_idx_);
 
 	return 0;
 }
@@ -3443,7 +8040,7 @@ std::string OpenDrive::ElementType2Str(RoadLink::ElementType type)
 
 int Position::MoveToConnectingRoad(RoadLink *road_link, ContactPointType &contact_point_type, Junction::JunctionStrategyType strategy)
 {
-	Road *road = GetOpenDrive()->GetRoadByIdx(track_idx_);
+	Road *road = od_->GetRoadByIdx(track_idx_);
 	Road *next_road = 0;
 	LaneSection *lane_section;
 	Lane *lane;
@@ -3477,104 +8074,94 @@ int Position::MoveToConnectingRoad(RoadLink *road_link, ContactPointType &contac
 		return -1;
 	}
 	
-	if (road_link->GetElementType() == RoadLink::ELEMENT_TYPE_ROAD)
+	// Lanes to continue in, from the lane graph if available, else looked up in links and junction connections
+	LaneGraph *lane_graph = od_->GetLaneGraph();
+	int node_idx = -1;
+	int n_connections = 0;
+	LaneGraphEdge *edge = 0;
+	std::vector<LaneGraphEdge> found_edge;
+
+	if (lane_graph && road->GetLink(road_link->GetType()) == road_link)
 	{
-		LaneLink *lane_link = lane->GetLink(road_link->GetType());
-		if (lane_link != 0)
-		{
-			new_lane_id = lane->GetLink(road_link->GetType())->GetId();
-			if (new_lane_id == 0)
-			{
-				LOG("Road+ new lane id %d\n", new_lane_id);
-			}
-		}
-		else
-		{
-			//LOG("No lane link from rid %d lid %d to rid %d", GetTrackId(), GetLaneId(), road_link->GetElementId());
-		}
-		contact_point_type = road_link->GetContactPointType();
-		next_road = GetOpenDrive()->GetRoadById(road_link->GetElementId());
+		node_idx = lane_graph->GetNodeIdx(track_idx_, lane_section_idx_, lane_idx_);
 	}
-	else if (road_link->GetElementType() == RoadLink::ELEMENT_TYPE_JUNCTION)
+
+	if (node_idx >= 0)
+	{
+		n_connections = lane_graph->GetNumberOfEdges(node_idx, road_link->GetType());
+		edge = n_connections > 0 ? lane_graph->GetEdge(node_idx, road_link->GetType(), 0) : 0;
+	}
+	else
 	{
-		Junction *junction = GetOpenDrive()->GetJunctionById(road_link->GetElementId());
+		n_connections = LaneGraph::FindEdges(od_, road, lane, road_link, found_edge);
+		edge = n_connections > 0 ? &found_edge[0] : 0;
+	}
 
-		if (junction == 0)
-		{
-			LOG("Error: junction %d not existing\n", road_link->GetElementType());
-			return -1;
-		}
-	
-		int connection_idx = 0;
-		int n_connections = junction->GetNumberOfRoadConnections(road->GetId(), lane->GetId());
+	if (n_connections == 0)
+	{
+//		LOG("No connections from road id %d lane id %d", road->GetId(), lane->GetId());
+		return -1;
+	}
 
-		if (n_connections == 0)
-		{
-//			LOG("No connections from road id %d lane id %d in junction %d", road->GetId(), lane->GetId(), junction->GetId());
-			return -1;
-		}
-		else if (n_connections == 1)
-		{
-			connection_idx = 0;
-		}
-		else
+	int connection_idx = 0;
+	if (n_connections > 1)
+	{
+		// find valid connecting road, if multiple choices choose either most straight one OR by random
+		if (strategy == Junction::JunctionStrategyType::STRAIGHT)
 		{
-			// find valid connecting road, if multiple choices choose either most straight one OR by random
-			if (strategy == Junction::JunctionStrategyType::STRAIGHT)
+			// Find the straighest link
+			int best_road_index = 0;
+			double min_heading_diff = 1E10; // set huge number
+			for (int i = 0; i < n_connections; i++)
 			{
-				// Find the straighest link
-				int best_road_index = 0;
-				double min_heading_diff = 1E10; // set huge number
-				for (int i = 0; i < n_connections; i++)
+				next_road = od_->GetRoadByIdx(edge[i].road_idx);
+				if (next_road == 0)
 				{
-					LaneRoadLaneConnection lane_road_lane_connection = 
-						junction->GetRoadConnectionByIdx(road->GetId(), lane->GetId(), i);
-					next_road = GetOpenDrive()->GetRoadById(lane_road_lane_connection.GetConnectingRoadId()); 
+					continue;
+				}
 
-					Position test_pos;
-					if (lane_road_lane_connection.contact_point_ == CONTACT_POINT_START)
-					{
-						// Inspect heading at the connecting road
-						test_pos.SetLanePos(next_road->GetId(), new_lane_id, next_road->GetLength(), 0);
-					}
-					else if (lane_road_lane_connection.contact_point_ == CONTACT_POINT_END)
-					{
-						test_pos.SetLanePos(next_road->GetId(), new_lane_id, 0, 0);
-					}
-					else
-					{
-						LOG("Unexpected contact point type: %d", road_link->GetContactPointType());
-					}
+				Position test_pos(od_);
+				if (edge[i].contact_point == CONTACT_POINT_START)
+				{
+					// Inspect heading at the connecting road
+					test_pos.SetLanePos(next_road->GetId(), new_lane_id, next_road->GetLength(), 0);
+				}
+				else if (edge[i].contact_point == CONTACT_POINT_END)
+				{
+					test_pos.SetLanePos(next_road->GetId(), new_lane_id, 0, 0);
+				}
+				else
+				{
+					LOG("Unexpected contact point type: %d", road_link->GetContactPointType());
+				}
 
-					// Transform angle into a comparable format
+				// Transform angle into a comparable format
 
-					double heading_diff = GetAbsAngleDifference(test_pos.GetHRoad(), GetHRoad());
-					if (heading_diff > M_PI / 2)
-					{
-						heading_diff = fabs(heading_diff - M_PI);  // don't care of driving direction here
-					}
+				double heading_diff = GetAbsAngleDifference(test_pos.GetHRoad(), GetHRoad());
+				if (heading_diff > M_PI / 2)
+				{
+					heading_diff = fabs(heading_diff - M_PI);  // don't care of driving direction here
+				}
 
-					if (heading_diff < min_heading_diff)
-					{
-						min_heading_diff = heading_diff;
-						best_road_index = i;
-					}
+				if (heading_diff < min_heading_diff)
+				{
+					min_heading_diff = heading_diff;
+					best_road_index = i;
 				}
-				connection_idx = best_road_index;
-			}
-			else if (strategy == Junction::JunctionStrategyType::RANDOM)
-			{
-				connection_idx = (int)(n_connections * (double)mt_rand() / mt_rand.max());
 			}
+			connection_idx = best_road_index;
+		}
+		else if (strategy == Junction::JunctionStrategyType::RANDOM)
+		{
+			// Scale to [0, n_connections), same result on all platforms unlike std distributions
+			connection_idx = (int)(n_connections * (double)(random_() - random_.min()) / ((double)random_.max() - random_.min() + 1));
 		}
-
-		LaneRoadLaneConnection lane_road_lane_connection = junction->GetRoadConnectionByIdx(road->GetId(), lane->GetId(), connection_idx);
-		contact_point_type = lane_road_lane_connection.contact_point_;
-
-		new_lane_id = lane_road_lane_connection.GetConnectinglaneId();
-		next_road = GetOpenDrive()->GetRoadById(lane_road_lane_connection.GetConnectingRoadId());
 	}
 
+	contact_point_type = edge[connection_idx].contact_point;
+	new_lane_id = edge[connection_idx].lane_id;
+	next_road = od_->GetRoadByIdx(edge[connection_idx].road_idx);
+
 	if (next_road == 0)
 	{
 		LOG("No next road\n");
@@ -3619,7 +8206,7 @@ int Position::MoveToConnectingRoad(RoadLink *road_link, ContactPointType &contac
 	else if (road_link->GetContactPointType() == CONTACT_POINT_END)
 	{
 		// Find out and specify last lane section
-		SetLanePos(next_road->GetId(), new_lane_id, next_road->GetLength(), new_offset, GetRoadById(road_link->GetElementId())->GetNumberOfLaneSections()-1);
+		SetLanePos(next_road->GetId(), new_lane_id, next_road->GetLength(), new_offset, next_road->GetNumberOfLaneSections()-1);
 	}
 	else if (road_link->GetContactPointType() == CONTACT_POINT_NONE && road_link->GetElementType() == RoadLink::ELEMENT_TYPE_JUNCTION)
 	{
@@ -3652,7 +8239,7 @@ int Position::MoveAlongS(double ds, double dLaneOffset, Junction::JunctionStrate
 	int max_links = 8;  // limit lookahead through junctions/links 
 	ContactPointType contact_point_type;
 
-	if (GetOpenDrive()->GetNumOfRoads() == 0 || track_idx_ < 0)
+	if (od_->GetNumOfRoads() == 0 || track_idx_ < 0)
 	{
 		// No roads available or current track undefined
 		return 0;
@@ -3667,16 +8254,16 @@ int Position::MoveAlongS(double ds, double dLaneOffset, Junction::JunctionStrate
 	{
 		ds_signed = -SIGN(GetLaneId()) * ds; // adjust sign of ds according to lane direction - right lane is < 0 in road dir
 
-		if (s_ + ds_signed > GetOpenDrive()->GetRoadByIdx(track_idx_)->GetLength())
+		if (s_ + ds_signed > od_->GetRoadByIdx(track_idx_)->GetLength())
 		{
-			ds_signed = s_ + ds_signed - GetOpenDrive()->GetRoadByIdx(track_idx_)->GetLength();
-			link = GetOpenDrive()->GetRoadByIdx(track_idx_)->GetLink(SUCCESSOR);
-			s_stop = GetOpenDrive()->GetRoadByIdx(track_idx_)->GetLength();
+			ds_signed = s_ + ds_signed - od_->GetRoadByIdx(track_idx_)->GetLength();
+			link = od_->GetRoadByIdx(track_idx_)->GetLink(SUCCESSOR);
+			s_stop = od_->GetRoadByIdx(track_idx_)->GetLength();
 		}
 		else if (s_ + ds_signed < 0)
 		{
 			ds_signed = s_ + ds_signed;
-			link = GetOpenDrive()->GetRoadByIdx(track_idx_)->GetLink(PREDECESSOR);
+			link = od_->GetRoadByIdx(track_idx_)->GetLink(PREDECESSOR);
 			s_stop = 0;
 		}
 		else  // New position is within current track
@@ -3711,7 +8298,7 @@ void Position::SetLanePos(int track_id, int lane_id, double s, double offset, in
 		return;
 	}
 
-	Road *road = GetOpenDrive()->GetRoadById(track_id);
+	Road *road = od_->GetRoadById(track_id);
 	if (road == 0)
 	{
 		LOG("Position::Set Error: track %d not available\n", track_id);
@@ -3821,7 +8408,7 @@ void Position::SetHeadingRelativeRoadDirection(double heading)
 
 double Position::GetCurvature()
 {
-	Geometry *geom = GetOpenDrive()->GetGeometryByIdx(track_idx_, geometry_idx_);
+	Geometry *geom = od_->GetGeometryByIdx(track_idx_, geometry_idx_);
 	
 	if (geom)
 	{
@@ -3846,7 +8433,7 @@ double Position::GetHRelativeDrivingDirection()
 double Position::GetSpeedLimit()
 {
 	double speed_limit = 70 / 3.6;  // some default speed
-	Road *road = GetOpenDrive()->GetRoadByIdx(track_idx_);
+	Road *road = od_->GetRoadByIdx(track_idx_);
 	
 	if (road)
 	{
@@ -3855,7 +8442,7 @@ double Position::GetSpeedLimit()
 		if (speed_limit < SMALL_NUMBER)
 		{
 			// No speed limit defined, set a value depending on number of lanes
-			speed_limit = GetOpenDrive()->GetRoadByIdx(track_idx_)->GetNumberOfDrivingLanesSide(GetS(), SIGN(GetLaneId())) > 1 ? 120 / 3.6 : 60 / 3.6;
+			speed_limit = od_->GetRoadByIdx(track_idx_)->GetNumberOfDrivingLanesSide(GetS(), SIGN(GetLaneId())) > 1 ? 120 / 3.6 : 60 / 3.6;
 		}
 	}
 
@@ -3865,7 +8452,7 @@ double Position::GetSpeedLimit()
 double Position::GetDrivingDirection()
 {
 	double x, y, h;
-	Geometry *geom = GetOpenDrive()->GetGeometryByIdx(track_idx_, geometry_idx_);
+	Geometry *geom = od_->GetGeometryByIdx(track_idx_, geometry_idx_);
 
 	if (!geom)
 	{
@@ -3885,11 +8472,15 @@ double Position::GetDrivingDirection()
 
 void Position::CopyRMPos(Position *from)
 {
-	// Preserve route field
+	// Preserve route field, random stream and statistics
 	Route *tmp = route_;
+	std::minstd_rand random = random_;
+	ProjectionStats projection_stats = projection_stats_;
 	
 	*this = *from;
 	route_ = tmp;
+	random_ = random;
+	projection_stats_ = projection_stats;
 }
 
 
@@ -3947,53 +8538,23 @@ void Position::CalcRoutePosition()
 		return;
 	}
 
-	// Loop over waypoints - look for current track ID and sum the distance (route s) up to current position
-	double dist = 0;
-	for (size_t i = 0; i < route_->waypoint_.size(); i++)
-	{
-		int direction = route_->GetWayPointDirection((int)i);
-		if (direction == 0)
-		{
-			LOG("Unexpected lack of connection in route at waypoint %d", i);
-			return;
-		}
+	// Look up the segment of current road, all segments up to it need to be connected
+	int idx = route_->GetSegmentIdxByRoadId(GetTrackId());
+	int unconnected = route_->GetFirstUnconnectedSegmentIdx();
 
-		if (i == 0)
-		{
-			// Subtract initial s-value for the first waypoint
-			
-			if (direction > 0)  // route in waypoint road direction
-			{
-				dist = GetRoadById(route_->waypoint_[i]->GetTrackId())->GetLength() - route_->waypoint_[i]->s_;
-			}
-			else
-			{
-				// going towards road direction - remaining distance equals route s-value
-				dist = route_->waypoint_[i]->s_;
-			}
-		}
-		else
-		{
-			// Add length of intermediate waypoint road
-			dist += GetRoadById(route_->waypoint_[i]->GetTrackId())->GetLength();
-		}
+	if (unconnected >= 0 && (idx < 0 || unconnected <= idx))
+	{
+		LOG("Unexpected lack of connection in route at waypoint %d", unconnected);
+		return;
+	}
 
-		if (GetTrackId() == route_->waypoint_[i]->GetTrackId())
-		{
-			// current position is at the road of this waypoint - i.e. along the route
-			// remove remaming s from road
-			if (direction > 0)
-			{
-				dist -= GetRoadById(route_->waypoint_[i]->GetTrackId())->GetLength() - GetS();
-			}
-			else
-			{
-				dist -= GetS();
-			}
-			s_route_ = dist;
-			break;
-		}
+	if (idx < 0)
+	{
+		return;
 	}
+
+	RouteSegment *segment = route_->GetSegmentByIdx(idx);
+	s_route_ = segment->route_s + segment->direction * (GetS() - segment->entry_s);
 }
 
 void Position::SetRoute(Route *route)
@@ -4018,20 +8579,12 @@ bool Position::Delta(Position pos_b, PositionDiff &diff)
 		diff.dt = GetT() - pos_b.GetT();
 
 #if 0   // Change to 1 to print some info on stdout - e.g. for debugging
-		printf("Dist %.2f Path (reversed): %d", dist, pos_b.GetTrackId());
-		if (path->visited_.size() > 0)
+		printf("Dist %.2f Path: %d", dist, GetTrackId());
+		for (size_t i = 0; i < path->path_.size(); i++)
 		{
-			RoadPath::PathNode* node = path->visited_.back();
-
-			while (node)
-			{
-				if (node->fromRoad != 0)
-				{
-					printf(" <- %d", node->fromRoad->GetId());
-				}
-				node = node->previous;
-			}
+			printf(" -> %d", od_->GetRoadByIdx(path->path_[i])->GetId());
 		}
+		printf(" -> %d", pos_b.GetTrackId());
 		printf("\n");
 #endif
 	}
@@ -4047,6 +8600,11 @@ bool Position::Delta(Position pos_b, PositionDiff &diff)
 	return found;
 }
 
+double Position::GetRoadDistanceLowerBound(Position &pos_b)
+{
+	return od_->GetRoadDistanceLowerBound(track_idx_, GetS(), pos_b.track_idx_, pos_b.GetS());
+}
+
 bool Position::IsAheadOf(Position target_position)
 {
 	// Calculate diff vector from current to target
@@ -4172,10 +8730,25 @@ void Position::CalcProbeTarget(Position *target, RoadProbeInfo *data)
 
 int Position::GetProbeInfo(double lookahead_distance, RoadProbeInfo *data, LookAheadMode lookAheadMode)
 {
-	if (GetOpenDrive()->GetNumOfRoads() == 0)
+	return GetProbeInfo(&lookahead_distance, 1, data, lookAheadMode) == 1 ? 0 : -1;
+}
+
+int Position::GetProbeInfo(const double *lookahead_distance, int n, RoadProbeInfo *data, LookAheadMode lookAheadMode)
+{
+	if (od_->GetNumOfRoads() == 0 || n < 0)
 	{
 		return -1;
 	}
+
+	for (int i = 1; i < n; i++)
+	{
+		if (lookahead_distance[i] < lookahead_distance[i - 1])
+		{
+			LOG("GetProbeInfo: Lookahead distances not sorted\n");
+			return -1;
+		}
+	}
+
 	Position target(*this);  // Make a copy of current position
 
 	if (lookAheadMode == LOOKAHEADMODE_AT_ROAD_CENTER)
@@ -4190,14 +8763,21 @@ int Position::GetProbeInfo(double lookahead_distance, RoadProbeInfo *data, LookA
 		target.SetLanePos(target.GetTrackId(), target.GetLaneId(), target.GetS(), 0);
 	}
 
-	if (fabs(lookahead_distance) > SMALL_NUMBER && target.MoveAlongS(lookahead_distance, 0, Junction::STRAIGHT) != 0)
+	// Move the same target from one distance to the next, instead of from the pivot position each time
+	double distance = 0;
+	for (int i = 0; i < n; i++)
 	{
-		return -1;
-	}
+		if (fabs(lookahead_distance[i] - distance) > SMALL_NUMBER &&
+			target.MoveAlongS(lookahead_distance[i] - distance, 0, Junction::STRAIGHT) != 0)
+		{
+			return i;
+		}
+		distance = lookahead_distance[i];
 
-	CalcProbeTarget(&target, data);
+		CalcProbeTarget(&target, &data[i]);
+	}
 
-	return 0;
+	return n;
 }
 
 int Position::GetProbeInfo(Position *target_pos, RoadProbeInfo *data)
@@ -4264,54 +8844,27 @@ int Position::SetRouteS(Route *route, double route_s)
 		return -1;
 	}
 
-	OpenDrive *od = route->waypoint_[0]->GetOpenDrive();
-
-	double initial_s_offset = 0;
-
-	if (route->GetWayPointDirection(0) > 0)
-	{
-		initial_s_offset = route->waypoint_[0]->GetS();
-	}
-	else
-	{
-		initial_s_offset = od->GetRoadById(route->waypoint_[0]->GetTrackId())->GetLength() - route->waypoint_[0]->GetS();
-	}
-
-	double route_length = 0;
 	s_route_ = route_s;
 
 	// Find out what road and local s value
-	for (size_t i = 0; i < route->waypoint_.size(); i++)
+	int idx = route->GetSegmentIdxByRouteS(route_s);
+	if (idx < 0)
 	{
-		int track_id = route->waypoint_[i]->GetTrackId();
-		double road_length = route->waypoint_[i]->GetOpenDrive()->GetRoadById(track_id)->GetLength();
-		if (s_route_ < route_length + road_length - initial_s_offset)
-		{
-			// Found road segment
-			double local_s = 0;
-
-			int route_direction = route->GetWayPointDirection((int)i);
+		return -1;
+	}
 
-			if (route_direction == 0)
-			{
-				LOG("Unexpected lack of connection within route at waypoint %d", i);
-				return -1;
-			}
+	RouteSegment *segment = route->GetSegmentByIdx(idx);
+	if (segment->direction == 0)
+	{
+		LOG("Unexpected lack of connection within route at waypoint %d", idx);
+		return -1;
+	}
 
-			local_s = s_route_ - route_length + initial_s_offset;
-			if (route_direction < 0)  // along waypoint road direction
-			{
-				local_s = road_length - local_s;
-			}
+	double local_s = segment->entry_s + segment->direction * (route_s - segment->route_s);
 
-			SetLanePos(route->waypoint_[i]->GetTrackId(), route->waypoint_[i]->GetLaneId(), local_s, GetOffset());
-			return 0;
-		}
-		route_length += road_length - initial_s_offset;
-		initial_s_offset = 0;  // For all following road segments, calculate length from beginning
-	}
+	SetLanePos(segment->road_id, segment->lane_id, local_s, GetOffset());
 
-	return -1;
+	return 0;
 }
 
 int Route::AddWaypoint(Position *position)
@@ -4329,14 +8882,15 @@ int Route::AddWaypoint(Position *position)
 
 		if (prev_pos->GetTrackId() != position->GetTrackId())
 		{
-			if (position->GetOpenDrive()->IsIndirectlyConnected(prev_pos->GetTrackId(), position->GetTrackId(), 
+			if (position->GetRoadNetwork()->IsIndirectlyConnected(prev_pos->GetTrackId(), position->GetTrackId(), 
 				connecting_road_id_ptr, connecting_lane_id_ptr, prev_pos->GetLaneId(), position->GetLaneId()))
 			{
 				connected = true;
 				if (connecting_road_id != 0)
 				{
 					// Adding waypoint for junction connecting road
-					Position *connected_pos = new Position(connecting_road_id, connecting_lane_id, 0, 0);
+					Position *connected_pos = new Position(position->GetRoadNetwork());
+					connected_pos->SetLanePos(connecting_road_id, connecting_lane_id, 0, 0);
 					waypoint_.push_back(connected_pos);
 					LOG("Route::AddWaypoint Added connecting waypoint %d: %d, %d, %.2f\n",
 						(int)waypoint_.size() - 1, connecting_road_id, connecting_lane_id, 0.0);
@@ -4356,6 +8910,9 @@ int Route::AddWaypoint(Position *position)
 	waypoint_.push_back(position);
 	LOG("Route::AddWaypoint Added waypoint %d: %d, %d, %.2f\n", (int)waypoint_.size()-1, position->GetTrackId(), position->GetLaneId(), position->GetS());
 
+	// A new waypoint may change the direction of the previous one, rebuild all segments
+	BuildSegments();
+
 	return 0;
 }
 
@@ -4373,7 +8930,7 @@ int Route::GetWayPointDirection(int index)
 		return 0;
 	}
 
-	OpenDrive *od = waypoint_[index]->GetOpenDrive();
+	OpenDrive *od = waypoint_[index]->GetRoadNetwork();
 	Road *road = od->GetRoadById(waypoint_[index]->GetTrackId());
 	int connected = 0;
 	double angle;
@@ -4396,10 +8953,206 @@ int Route::GetWayPointDirection(int index)
 	return connected;
 }
 
-double Route::GetLength()
+void Route::BuildSegments()
 {
+	segment_.clear();
+	segment_index_.Clear();
+	curvature_.clear();
+	curvature_index_.Clear();
+	speed_.clear();
+	speed_index_.Clear();
+	length_ = 0.0;
+	first_unconnected_ = -1;
 
-	return 0.0;
+	for (size_t i = 0; i < waypoint_.size(); i++)
+	{
+		RouteSegment segment;
+		Road *road = waypoint_[i]->GetRoadNetwork()->GetRoadById(waypoint_[i]->GetTrackId());
+
+		segment.road_id = waypoint_[i]->GetTrackId();
+		segment.lane_id = waypoint_[i]->GetLaneId();
+		segment.road_length = road ? road->GetLength() : 0.0;
+		segment.direction = (road && waypoint_.size() > 1) ? GetWayPointDirection((int)i) : 0;
+		segment.route_s = length_;
+
+		if (i == 0)
+		{
+			// Route starts at the first waypoint
+			segment.entry_s = waypoint_[i]->GetS();
+			segment.length = segment.direction > 0 ? segment.road_length - segment.entry_s : segment.entry_s;
+		}
+		else
+		{
+			segment.entry_s = segment.direction < 0 ? segment.road_length : 0.0;
+			segment.length = segment.road_length;
+		}
+		segment.exit_s = segment.entry_s + (segment.direction < 0 ? -segment.length : segment.length);
+
+		if (segment.direction == 0 && first_unconnected_ < 0)
+		{
+			first_unconnected_ = (int)i;
+		}
+
+		segment_.push_back(segment);
+		segment_index_.Add(segment.route_s);
+		length_ += segment.length;
+
+		if (segment.direction != 0)
+		{
+			AddCurvatureEntries((int)i);
+			AddSpeedEntries((int)i);
+		}
+	}
+}
+
+RouteSegment *Route::GetSegmentByIdx(int idx)
+{
+	if (idx < 0 || idx >= (int)segment_.size())
+	{
+		return 0;
+	}
+
+	return &segment_[idx];
+}
+
+int Route::GetSegmentIdxByRouteS(double route_s, int hint)
+{
+	if (route_s >= length_)
+	{
+		return -1;
+	}
+
+	return segment_index_.Find(route_s, hint);
+}
+
+int Route::GetSegmentIdxByRoadId(int road_id)
+{
+	for (size_t i = 0; i < segment_.size(); i++)
+	{
+		if (segment_[i].road_id == road_id)
+		{
+			return (int)i;
+		}
+	}
+
+	return -1;
+}
+
+Road *Route::GetSegmentRoad(int segment_idx)
+{
+	return waypoint_[segment_idx]->GetRoadNetwork()->GetRoadById(segment_[segment_idx].road_id);
+}
+
+double Route::GetRoadS(RouteSegment *segment, double route_s)
+{
+	double s = segment->entry_s + segment->direction * (route_s - segment->route_s);
+
+	return CLAMP(s, 0.0, segment->road_length);
+}
+
+void Route::AddCurvatureEntries(int segment_idx)
+{
+	RouteSegment *segment = &segment_[segment_idx];
+	Road *road = GetSegmentRoad(segment_idx);
+	int n = road->GetNumberOfGeometries();
+
+	// Register route s where the route enters each geometry, in route order
+	for (int i = 0; i < n; i++)
+	{
+		int idx = segment->direction > 0 ? i : n - 1 - i;
+		Geometry *geom = road->GetGeometry(idx);
+		double s_start = geom->GetS();
+		double s_end = geom->GetS() + geom->GetLength();
+		double route_s;
+
+		if (segment->direction > 0)
+		{
+			if (s_end <= segment->entry_s || s_start >= segment->exit_s)
+			{
+				continue;
+			}
+			route_s = segment->route_s + MAX(s_start, segment->entry_s) - segment->entry_s;
+		}
+		else
+		{
+			if (s_start >= segment->entry_s || s_end <= segment->exit_s)
+			{
+				continue;
+			}
+			route_s = segment->route_s + segment->entry_s - MIN(s_end, segment->entry_s);
+		}
+
+		CurvatureEntry entry;
+		entry.segment_idx = segment_idx;
+		entry.geometry_idx = idx;
+		curvature_.push_back(entry);
+		curvature_index_.Add(route_s);
+	}
+}
+
+void Route::AddSpeedEntries(int segment_idx)
+{
+	RouteSegment *segment = &segment_[segment_idx];
+	Road *road = GetSegmentRoad(segment_idx);
+	int n = road->GetNumberOfRoadTypes();
+	std::vector<double> change_s;
+
+	// Route s of speed changes within the segment, in route order
+	change_s.push_back(segment->route_s);
+	for (int i = 0; i < n; i++)
+	{
+		int idx = segment->direction > 0 ? i : n - 1 - i;
+		double s = road->GetRoadTypeByIdx(idx)->s_;
+
+		if (s > MIN(segment->entry_s, segment->exit_s) && s < MAX(segment->entry_s, segment->exit_s))
+		{
+			change_s.push_back(segment->route_s + fabs(s - segment->entry_s));
+		}
+	}
+	change_s.push_back(segment->route_s + segment->length);
+
+	// Look up the speed in the middle of each interval, since type entries apply in road direction
+	for (size_t i = 0; i + 1 < change_s.size(); i++)
+	{
+		if (change_s[i + 1] - change_s[i] < SMALL_NUMBER)
+		{
+			continue;
+		}
+		speed_.push_back(road->GetSpeedByS(GetRoadS(segment, (change_s[i] + change_s[i + 1]) / 2)));
+		speed_index_.Add(change_s[i]);
+	}
+}
+
+double Route::GetCurvatureByRouteS(double route_s)
+{
+	// Clamp to the route, not only to the roads, since the route may start or end within a road
+	route_s = CLAMP(route_s, 0.0, length_);
+
+	int idx = curvature_index_.Find(route_s);
+
+	if (idx < 0)
+	{
+		return 0.0;
+	}
+
+	RouteSegment *segment = &segment_[curvature_[idx].segment_idx];
+	Geometry *geom = GetSegmentRoad(curvature_[idx].segment_idx)->GetGeometry(curvature_[idx].geometry_idx);
+	double ds = CLAMP(GetRoadS(segment, route_s) - geom->GetS(), 0.0, geom->GetLength());
+
+	// Curvature is defined in road direction, flip it when the route goes the other way
+	return segment->direction * geom->EvaluateCurvatureDS(ds);
+}
+
+double Route::GetSpeedLimitByRouteS(double route_s)
+{
+	int idx = speed_index_.Find(route_s);
+
+	if (idx < 0)
+	{
+		return 0.0;
+	}
+
+	return speed_[idx];
 }
 
 void Route::setName(std::string name)
@@ -17,11 +17,70 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <unordered_map>
+#include <random>
 #include "pugixml.hpp"
+#include "CommonMini.hpp"
 
 namespace roadmanager
 {
 
+	/**
+	Monotonic memory arena. Memory is handed out from a growing list of blocks and released all at once
+	by Clear() or when the arena is destroyed, never per allocation.
+	*/
+	class Arena
+	{
+	public:
+		Arena() : block_used_(0), block_size_(0), reserved_(0), used_(0) {}
+		~Arena() { Clear(); }
+
+		/**
+		Allocate memory, aligned for any type
+		@param size Number of bytes
+		@return Pointer to the memory, valid until Clear()
+		*/
+		void *Allocate(size_t size);
+
+		/**
+		Release all memory allocated from the arena
+		*/
+		void Clear();
+
+		/**
+		Number of bytes allocated from the arena, including alignment padding
+		*/
+		size_t GetUsed() { return used_; }
+
+		/**
+		Number of bytes reserved in blocks
+		*/
+		size_t GetReserved() { return reserved_; }
+
+	private:
+		Arena(const Arena&) = delete;
+		Arena &operator=(const Arena&) = delete;
+
+		std::vector<char*> block_;
+		size_t block_used_;  // bytes used in the current block
+		size_t block_size_;  // size of the current block
+		size_t reserved_;
+		size_t used_;
+	};
+
+	/**
+	Base of all road network objects. They must be allocated in an arena, e.g. new (arena) Lane(id, type),
+	typically the one of the OpenDrive they belong to. Deleting an object runs its destructor but leaves
+	the memory to the arena.
+	*/
+	class ArenaObject
+	{
+	public:
+		static void *operator new(size_t size, Arena &arena) { return arena.Allocate(size); }
+		static void operator delete(void *, Arena &) {}
+		static void operator delete(void *) {}
+	};
+
 	class Polynomial
 	{
 	public:
@@ -36,10 +95,20 @@ namespace roadmanager
 		double GetB() { return b_; }
 		double GetC() { return c_; }
 		double GetD() { return d_; }
+		double GetPScale() { return p_scale_; }
 		double Evaluate(double s);
 		double EvaluatePrim(double s);
 		double EvaluatePrimPrim(double s);
 
+		/**
+		Evaluate the polynomial for an array of s values
+		@param s Array of n s values
+		@param n Number of values
+		@param result Array of n resulting values
+		*/
+		void EvaluateBatch(const double *s, int n, double *result);
+		void EvaluatePrimBatch(const double *s, int n, double *result);
+
 	private:
 		double a_;
 		double b_;
@@ -48,8 +117,30 @@ namespace roadmanager
 		double p_scale_;
 	};
 
+	/**
+	Sorted start s-values of consecutive road records, e.g. geometries, lane sections or lane widths.
+	Used to find the record covering a given s by binary search instead of stepping through the list.
+	*/
+	class SIndex
+	{
+	public:
+		void Add(double s) { s_.push_back(s); }
+		void Clear() { s_.clear(); }
+		int GetSize() { return (int)s_.size(); }
+
+		/**
+		Find the last record starting at or before given s. Any s before the first record maps to the first one.
+		@param s distance along the road (or lane section for lane widths)
+		@param hint index to check first, typically the one found last time. -1 means no hint.
+		@return index of the record, -1 if the list is empty
+		*/
+		int Find(double s, int hint = -1);
+
+	private:
+		std::vector<double> s_;
+	};
 
-	class Geometry
+	class Geometry : public ArenaObject
 	{
 	public:
 		enum GeometryType
@@ -77,6 +168,19 @@ namespace roadmanager
 		virtual void Print();
 		virtual void EvaluateDS(double ds, double *x, double *y, double *h);
 
+		/**
+		Evaluate position and heading for an array of ds values, same result as calling EvaluateDS() for each value.
+		This base implementation does exactly that and is used as reference, see OdrCheck. Geometry types with simple
+		math override it with loops where per geometry values are computed once. Lines and polynomials are plain
+		arithmetic the compiler can vectorize, arcs still call cos() and sin() per point.
+		@param ds Array of n distances from start of geometry
+		@param n Number of values
+		@param x Array of n resulting x coordinates
+		@param y Array of n resulting y coordinates
+		@param h Array of n resulting headings
+		*/
+		virtual void EvaluateDSBatch(const double *ds, int n, double *x, double *y, double *h);
+
 	private:
 		double s_;
 		double x_;
@@ -95,6 +199,7 @@ namespace roadmanager
 
 		void Print();
 		void EvaluateDS(double ds, double *x, double *y, double *h);
+		void EvaluateDSBatch(const double *ds, int n, double *x, double *y, double *h);
 		double EvaluateCurvatureDS(double ds) { (void)ds; return 0; }
 	};
 
@@ -107,15 +212,68 @@ namespace roadmanager
 		~Arc() {}
 
 		double EvaluateCurvatureDS(double ds) { (void)ds; return curvature_; }
+		double GetCurvature() { return curvature_; }
 		double GetRadius() { return std::fabs(1.0 / curvature_); }
 		void Print();
 		void EvaluateDS(double ds, double *x, double *y, double *h);
+		void EvaluateDSBatch(const double *ds, int n, double *x, double *y, double *h);
 
 	private:
 		double curvature_;
 	};
 
 
+	/**
+	Precomputed samples of the standard spiral (curvature 0 at s = 0, see odrSpiral) over an interval of s.
+	Each node holds position and tangent, and curvature follows from s, so the spiral can be evaluated by
+	quintic Hermite interpolation instead of computing Fresnel integrals for each point.
+	*/
+	class SpiralTable
+	{
+	public:
+		SpiralTable() : s_start_(0.0), step_(0.0), c_dot_(0.0) {}
+
+		/**
+		Sample the spiral with a node distance that keeps the interpolation error below given tolerance
+		@param s_start Start of interval, run-length along standard spiral
+		@param s_end End of interval
+		@param c_dot First derivative of curvature
+		@param tolerance Max position error, in meters
+		@param max_nodes Max number of nodes, if more are needed no table is created
+		@return 0 if table was created, else -1
+		*/
+		int Build(double s_start, double s_end, double c_dot, double tolerance, int max_nodes);
+		void Clear() { node_.clear(); }
+		bool IsEmpty() { return node_.empty(); }
+		int GetNumberOfNodes() { return (int)node_.size() / 4; }
+		double GetSStart() { return s_start_; }
+		double GetStep() { return step_; }
+		const double *GetNodes() { return node_.data(); }
+
+		/**
+		Same as odrSpiral(), for s within the table interval
+		*/
+		void Evaluate(double s, double *x, double *y, double *t) { Interpolate(node_.data(), GetNumberOfNodes(), s_start_, step_, c_dot_, s, x, y, t); }
+
+		/**
+		Restore a table created earlier, e.g. from a binary cache
+		@param node Nodes, 4 values each: x, y, cos(t), sin(t)
+		*/
+		void Set(double s_start, double step, double c_dot, const double *node, int n_nodes);
+
+		/**
+		Interpolate in table data, also used by the compiled road network which keeps its own copy of the nodes
+		@param node Nodes, 4 values each: x, y, cos(t), sin(t)
+		*/
+		static void Interpolate(const double *node, int n_nodes, double s_start, double step, double c_dot, double s, double *x, double *y, double *t);
+
+	private:
+		double s_start_;
+		double step_;
+		double c_dot_;
+		std::vector<double> node_;
+	};
+
 	class Spiral : public Geometry
 	{
 	public:
@@ -138,9 +296,18 @@ namespace roadmanager
 		void SetCDot(double c_dot) { c_dot_ = c_dot; }
 		void Print();
 		void EvaluateDS(double ds, double *x, double *y, double *h);
+		void EvaluateDSBatch(const double *ds, int n, double *x, double *y, double *h);
 		double EvaluateCurvatureDS(double ds);
 
+		/**
+		Create the table used to evaluate the spiral. Call when all parameters are set, else odrSpiral() is used.
+		*/
+		void BuildTable();
+		SpiralTable *GetTable() { return &table_; }
+
 	private:
+		void EvaluateStandardSpiral(double s, double *x, double *y, double *t);
+
 		double curv_start_;
 		double curv_end_;
 		double c_dot_;
@@ -148,6 +315,7 @@ namespace roadmanager
 		double y0_; // 0 if spiral starts with curvature = 0
 		double h0_; // 0 if spiral starts with curvature = 0
 		double s0_; // 0 if spiral starts with curvature = 0
+		SpiralTable table_;
 	};
 
 
@@ -166,6 +334,7 @@ namespace roadmanager
 		double GetUMax() { return umax_; }
 		void Print();
 		void EvaluateDS(double ds, double *x, double *y, double *h);
+		void EvaluateDSBatch(const double *ds, int n, double *x, double *y, double *h);
 		double EvaluateCurvatureDS(double ds);
 
 		Polynomial poly3_;
@@ -197,6 +366,7 @@ namespace roadmanager
 
 		void Print();
 		void EvaluateDS(double ds, double *x, double *y, double *h);
+		void EvaluateDSBatch(const double *ds, int n, double *x, double *y, double *h);
 		double EvaluateCurvatureDS(double ds);
 
 		Polynomial poly3U_;
@@ -204,7 +374,7 @@ namespace roadmanager
 	};
 
 
-	class Elevation
+	class Elevation : public ArenaObject
 	{
 	public:
 		Elevation(double s, double a, double b, double c, double d) : s_(s), length_(0)
@@ -233,7 +403,7 @@ namespace roadmanager
 	} LinkType;
 
 
-	class LaneLink
+	class LaneLink : public ArenaObject
 	{
 	public:
 		LaneLink(LinkType type, int id) : type_(type), id_(id) {}
@@ -247,7 +417,7 @@ namespace roadmanager
 		int id_;
 	};
 
-	class LaneWidth
+	class LaneWidth : public ArenaObject
 	{
 	public:
 		LaneWidth(double s_offset, double a, double b, double c, double d) : s_offset_(s_offset)
@@ -264,7 +434,7 @@ namespace roadmanager
 		double s_offset_;
 	};
 
-	class LaneOffset
+	class LaneOffset : public ArenaObject
 	{
 	public:
 		LaneOffset() {}
@@ -283,6 +453,7 @@ namespace roadmanager
 		double GetLength() { return length_; }
 		double GetLaneOffset(double s);
 		double GetLaneOffsetPrim(double s);
+		Polynomial GetPolynomial() { return polynomial_; }
 		void Print();
 
 	private:
@@ -291,7 +462,7 @@ namespace roadmanager
 		double length_;
 	};
 
-	class Lane
+	class Lane : public ArenaObject
 	{
 	public:
 		enum LanePosition
@@ -327,14 +498,19 @@ namespace roadmanager
 		};
 
 		Lane(int id, Lane::LaneType type) : id_(id), type_(type), level_(1), offset_from_ref_(0) {}
+		~Lane();
 		void AddLink(LaneLink *lane_link) { link_.push_back(lane_link); }
 		int GetId() { return id_; }
+		LaneType GetLaneType() { return type_; }
 		LaneWidth *GetWidthByIndex(int index) { return lane_width_[index]; }
+		int GetNumberOfWidths() { return (int)lane_width_.size(); }
 		LaneWidth *GetWidthByS(double s);
 		LaneLink *GetLink(LinkType type);
+		LaneLink *GetLinkByIdx(int idx) { return link_[idx]; }
+		int GetNumberOfLinks() { return (int)link_.size(); }
 		void SetOffsetFromRef(double offset) { offset_from_ref_ = offset; }
 		double GetOffsetFromRef() { return offset_from_ref_; }
-		void AddLaneWIdth(LaneWidth *lane_width) { lane_width_.push_back(lane_width); }
+		void AddLaneWIdth(LaneWidth *lane_width) { lane_width_.push_back(lane_width); width_index_.Add(lane_width->GetSOffset()); }
 		int IsDriving();
 		void Print();
 
@@ -345,12 +521,14 @@ namespace roadmanager
 		double offset_from_ref_;
 		std::vector<LaneLink*> link_;
 		std::vector<LaneWidth*> lane_width_;
+		SIndex width_index_;
 	};
 
-	class LaneSection
+	class LaneSection : public ArenaObject
 	{
 	public:
 		LaneSection(double s) : s_(s), length_(0) {}
+		~LaneSection();
 		void AddLane(Lane *lane);
 		double GetS() { return s_; }
 		Lane* GetLaneByIdx(int idx);
@@ -362,6 +540,15 @@ namespace roadmanager
 		double GetWidth(double s, int lane_id);
 		int GetClosestLaneIdx(double s, double t, double &offset);
 
+		/**
+		Get lateral position of all lane boundaries in one pass, instead of summing the inner lane widths for
+		each lane. Center offset of a lane is outer_offset - width / 2, as in GetCenterOffset().
+		@param s distance along the road segment
+		@param outer_offset Receives outer boundary offset per lane, same as GetOuterOffset(), in lane index order
+		@param width Receives lane width per lane, in lane index order
+		*/
+		void GetLaneOffsets(double s, double *outer_offset, double *width);
+
 		/**
 		Get lateral position of lane center, from road reference lane (lane id=0)
 		Example: If lane id 1 is 5 m wide and lane id 2 is 4 m wide, then 
@@ -398,7 +585,7 @@ namespace roadmanager
 		CONTACT_POINT_NONE,  // No contact point for element type junction
 	};
 
-	class RoadLink
+	class RoadLink : public ArenaObject
 	{
 	public:
 		typedef enum 
@@ -444,14 +631,14 @@ namespace roadmanager
 		ROADTYPE_BICYCLE
 	};
 
-	typedef struct
+	struct RoadTypeEntry : public ArenaObject
 	{
 		double s_;
 		RoadType road_type_;
 		double speed_;  // m/s
-	} RoadTypeEntry;
+	};
 
-	class Road
+	class Road : public ArenaObject
 	{
 	public:
 
@@ -459,6 +646,18 @@ namespace roadmanager
 		~Road();
 
 		void Print();
+
+		/**
+		Delete geometries, elevation, lane offsets and lane sections, keeping only what's needed to
+		connect the road to the rest of the network: id, name, length, junction, links and road types.
+		Used for unloading roads in tiled mode, see OpenDrive::SetTiledLoading().
+		*/
+		void ClearContent();
+
+		/**
+		Approximate amount of memory used by the road, in bytes
+		*/
+		size_t GetMemoryUsage();
 		void SetId(int id) { id_ = id; }
 		int GetId() { return id_; }
 		void SetName(std::string name) { name_ = name; }
@@ -508,18 +707,37 @@ namespace roadmanager
 		void SetJunction(int junction) { junction_ = junction; }
 		int GetJunction() { return junction_; }
 		void AddLink(RoadLink *link) { link_.push_back(link); }
-		void AddRoadType(RoadTypeEntry *type) { type_.push_back(type); }
+		void AddRoadType(RoadTypeEntry *type) { type_.push_back(type); type_index_.Add(type->s_); }
 		RoadLink *GetLink(LinkType type);
+		RoadLink *GetLinkByIdx(int idx) { return link_[idx]; }
+		int GetNumberOfLinks() { return (int)link_.size(); }
+		RoadTypeEntry *GetRoadTypeByIdx(int idx) { return type_[idx]; }
+		int GetNumberOfRoadTypes() { return (int)type_.size(); }
 		void AddLine(Line *line);
 		void AddArc(Arc *arc);
 		void AddSpiral(Spiral *spiral);
 		void AddPoly3(Poly3 *poly3);
 		void AddParamPoly3(ParamPoly3 *param_poly3);
+
+		/**
+		Add a geometry as is, without any of the preparations done by AddSpiral() and AddPoly3().
+		Used when restoring roads from a binary cache, where those results are stored.
+		*/
+		void AddGeometry(Geometry *geometry);
 		void AddElevation(Elevation *elevation);
 		void AddLaneSection(LaneSection *lane_section);
 		void AddLaneOffset(LaneOffset *lane_offset);
 		Elevation *GetElevation(int idx);
+
+		/**
+		Retrieve the index of the geometry at specified s-value
+		@param s distance along the road segment
+		@param start_at geometry index to check first, e.g. the one found last time
+		*/
+		int GetGeometryIdxByS(double s, int start_at = 0) { return geometry_index_.Find(s, start_at); }
 		int GetNumberOfElevations() { return (int)elevation_profile_.size(); }
+		LaneOffset *GetLaneOffsetByIdx(int idx) { return lane_offset_[idx]; }
+		int GetNumberOfLaneOffsets() { return (int)lane_offset_.size(); }
 		double GetLaneOffset(double s);
 		double GetLaneOffsetPrim(double s);
 		int GetNumberOfLanes(double s);
@@ -539,6 +757,11 @@ namespace roadmanager
 		std::vector<Elevation*> elevation_profile_;
 		std::vector<LaneSection*> lane_section_;
 		std::vector<LaneOffset*> lane_offset_;
+		SIndex type_index_;
+		SIndex geometry_index_;
+		SIndex elevation_index_;
+		SIndex lane_section_index_;
+		SIndex lane_offset_index_;
 	};
 
 	class LaneRoadLaneConnection
@@ -562,7 +785,7 @@ namespace roadmanager
 		int connecting_lane_id_;
 	};
 
-	class JunctionLaneLink
+	class JunctionLaneLink : public ArenaObject
 	{
 	public:
 		JunctionLaneLink(int from, int to) : from_(from), to_(to) {}
@@ -571,7 +794,9 @@ namespace roadmanager
 		void Print() { printf("JunctionLaneLink: from %d to %d\n", from_, to_); }
 	};
 
-	class Connection
+	class OpenDrive;
+
+	class Connection : public ArenaObject
 	{
 	public:
 		Connection(Road *incoming_road, Road *connecting_road, ContactPointType contact_point);
@@ -579,20 +804,32 @@ namespace roadmanager
 		int GetNumberOfLaneLinks() { return (int)lane_link_.size(); }
 		JunctionLaneLink *GetLaneLink(int idx) { return lane_link_[idx]; }
 		int GetConnectingLaneId(int incoming_lane_id);
-		Road *GetIncomingRoad() { return incoming_road_; }
-		Road *GetConnectingRoad() { return connecting_road_; }
+		Road *GetIncomingRoad();
+		Road *GetConnectingRoad();
 		ContactPointType GetContactPoint() { return contact_point_; }
-		void AddJunctionLaneLink(int from, int to);
+		void AddJunctionLaneLink(JunctionLaneLink *lane_link) { lane_link_.push_back(lane_link); }
 		void Print();
 
+		/**
+		Make the connection load road data when the roads are retrieved, see OpenDrive::SetTiledLoading()
+		*/
+		void SetTiledNetwork(OpenDrive *od) { tiled_od_ = od; }
+
+		/**
+		Get incoming and connecting roads without loading their content, only header data (id, length, links) is guaranteed
+		*/
+		Road *GetIncomingRoadHeader() { return incoming_road_; }
+		Road *GetConnectingRoadHeader() { return connecting_road_; }
+
 	private:
+		OpenDrive *tiled_od_;
 		Road *incoming_road_;
 		Road *connecting_road_;
 		ContactPointType contact_point_;
 		std::vector<JunctionLaneLink*> lane_link_;
 	};
 
-	class Junction
+	class Junction : public ArenaObject
 	{
 	public:
 		typedef enum
@@ -620,10 +857,496 @@ namespace roadmanager
 		std::string name_;
 	};
 
+	// Bounding box of a road geometry, widened by lane offset and lane widths so that any
+	// point on the road surface along the geometry is inside the box. Also keeps a bounding circle
+	// and the geometry data needed for a first distance estimate, see Position::GetDistToTrackGeom()
+	typedef struct
+	{
+		int road_idx;
+		int geom_idx;
+		double x_min;
+		double y_min;
+		double x_max;
+		double y_max;
+		double x_center;  // bounding circle, covering the same area as the box
+		double y_center;
+		double radius;
+		double x_start;  // geometry start point, lane offset applied
+		double y_start;
+		double h_start;
+		double x_end;  // geometry end point, lane offset applied
+		double y_end;
+		double h_end;
+		int tangents_intersect;  // 1 if the endpoint normals intersect, see GetIntersectionOfTwoLineSegments()
+		double x_tangent;  // intersection point of the endpoint normals
+		double y_tangent;
+	} GeometryBBox;
+
+	// Number of world to road mappings resolved by each step of Position::XYZH2TrackPosIncremental()
+	typedef struct
+	{
+		long long current_geometry;  // found on the geometry of the previous position
+		long long same_road;         // found on another geometry of the previous road
+		long long connected_road;    // found on a road directly connected to the previous one
+		long long global;            // fell back to searching the whole road network
+	} ProjectionStats;
+
+	// Part of a lane inside a query region, see OpenDrive::GetLaneSegmentsInCircle()
+	typedef struct
+	{
+		int road_id;
+		int lane_id;
+		double s_start;
+		double s_end;
+	} RoadLaneSegment;
+
+	// Relation between two directly connected roads, see OpenDrive::IsDirectlyConnected()
+	typedef struct
+	{
+		int relation;  // -1 predecessor, +1 successor
+		double angle;
+	} RoadConnectivity;
+
+	/**
+	Uniform grid over the bounding boxes of all road geometries, used to find candidate geometries
+	close to a world position without looking at the whole road network
+	*/
+	class GeometryGrid
+	{
+	public:
+		GeometryGrid() : cell_size_(50.0) {}
+
+		void Clear();
+		void Add(GeometryBBox &bbox);
+		int GetNumberOfBBoxes() { return (int)bbox_.size(); }
+		GeometryBBox *GetBBoxByIdx(int idx) { return &bbox_[idx]; }
+
+		/**
+		Retrieve index of the bounding box of specified geometry. Boxes are added road by road, in geometry order.
+		@param road_idx index of the road
+		@param geom_idx index of the geometry within the road
+		@return Index of the box, -1 if not found
+		*/
+		int GetBBoxIdx(int road_idx, int geom_idx);
+
+		/**
+		Find all geometry bounding boxes within specified distance from a point
+		@param x X coordinate of the point
+		@param y Y coordinate of the point
+		@param radius Max distance from point to bounding box
+		@param result Indices of found boxes, sorted by road index then geometry index
+		*/
+		void Query(double x, double y, double radius, std::vector<int> &result);
+
+		/**
+		Find all geometry bounding boxes overlapping an axis aligned box
+		@param x_min Lower X coordinate of the box
+		@param y_min Lower Y coordinate of the box
+		@param x_max Upper X coordinate of the box
+		@param y_max Upper Y coordinate of the box
+		@param result Indices of found boxes, sorted by road index then geometry index
+		*/
+		void QueryBox(double x_min, double y_min, double x_max, double y_max, std::vector<int> &result);
+
+	private:
+		long long GetCellKey(int i, int j) { return (long long)(((unsigned long long)(unsigned int)i << 32) | (unsigned int)j); }
+		int GetCellIdx(double v) { return (int)floor(v / cell_size_); }
+
+		double cell_size_;
+		std::vector<GeometryBBox> bbox_;
+		std::vector<int> road_first_bbox_;  // index of the first box of each road
+		std::unordered_map<long long, std::vector<int> > cell_;
+	};
+
+	class OpenDrive;
+
+	// Road reference line sample, see RoadTessellation
+	typedef struct
+	{
+		double s;
+		double x;  // reference line, before lane offset
+		double y;
+		double h;  // heading of reference line
+		double cos_h;
+		double sin_h;
+		double lane_offset;
+		double lane_offset_prim;
+		double z;
+		double z_prim;
+	} RoadSample;
+
+	/**
+	Adaptively sampled table of a road, s -> (x, y, h, lane offset, z), used for fast approximate
+	evaluation of road coordinates. Samples are placed so that interpolation between them stays
+	within a given position error.
+	*/
+	class RoadTessellation
+	{
+	public:
+		RoadTessellation() : max_error_(0.0), elevation_(false) {}
+
+		/**
+		Sample the road
+		@param road The road
+		@param tolerance Max position error, in meters
+		@return 0 on success, -1 if the road has no geometry
+		*/
+		int Build(Road *road, double tolerance);
+
+		/**
+		Interpolate road data at given s
+		@param s Distance along the road
+		@param sample Resulting road data
+		*/
+		void Evaluate(double s, RoadSample *sample);
+
+		/**
+		Largest difference between interpolated and exact position found when checking the table,
+		including the effect of heading errors at TESSELLATION_HEADING_ARM meters from the reference line
+		*/
+		double GetMaxError() { return max_error_; }
+		int GetNumberOfSamples() { return (int)sample_.size(); }
+		bool HasElevation() { return elevation_; }
+
+	private:
+		double GetError(Road *road, double s);
+		void Subdivide(Road *road, RoadSample &s0, RoadSample &s1, double tolerance, int depth);
+
+		std::vector<RoadSample> sample_;
+		double max_error_;
+		bool elevation_;
+	};
+
+	/**
+	Road surface height sampled on a regular grid of nodes, used to look up road height and normal at a world
+	position without mapping it to road coordinates. Heights are interpolated bilinearly between the four
+	nodes of the cell containing the position. The grid covers the lanes of all roads, plus a margin of
+	a cell or so, and is stored in blocks so that memory follows road area. The road surface is assumed
+	flat across the road, since lateral shape and superelevation are not supported.
+	*/
+	class HeightGrid
+	{
+	public:
+		HeightGrid() : resolution_(0.0), max_error_(0.0), n_nodes_(0), n_ambiguous_(0) {}
+
+		void Clear();
+
+		/**
+		Sample the surface of all roads
+		@param od The road network
+		@param resolution Distance between grid nodes, in meters
+		@return 0 on success, -1 on error
+		*/
+		int Build(OpenDrive *od, double resolution);
+
+		/**
+		Interpolate road height and normal at a world position
+		@param x X coordinate
+		@param y Y coordinate
+		@param z Receives road height
+		@param normal_x If not 0, receives X component of the road surface normal
+		@param normal_y If not 0, receives Y component of the road surface normal
+		@param normal_z If not 0, receives Z component of the road surface normal
+		@return 0 on success, -1 if position is not covered by the grid, or close to where roads of different heights overlap
+		*/
+		int GetHeight(double x, double y, double *z, double *normal_x = 0, double *normal_y = 0, double *normal_z = 0);
+
+		bool IsValid() { return resolution_ > 0; }
+		double GetResolution() { return resolution_; }
+
+		/**
+		Largest difference between interpolated and exact road height found when checking the grid
+		*/
+		double GetMaxError() { return max_error_; }
+		int GetNumberOfNodes() { return n_nodes_; }
+
+		/**
+		Number of nodes left out since roads of different heights overlap there, e.g. at bridges
+		*/
+		int GetNumberOfAmbiguousNodes() { return n_ambiguous_; }
+
+	private:
+		typedef struct
+		{
+			std::vector<float> z;
+			std::vector<unsigned char> state;  // see HeightGrid::SetNode()
+		} Block;
+
+		long long GetBlockKey(int bi, int bj) { return (long long)(((unsigned long long)(unsigned int)bi << 32) | (unsigned int)bj); }
+		void SetNode(int i, int j, double z, bool on_road);
+		Block *GetBlock(int i, int j);
+		void AddRoad(Road *road);
+		double GetRoadError(Road *road);
+
+		double resolution_;
+		double max_error_;
+		int n_nodes_;
+		int n_ambiguous_;
+		std::unordered_map<long long, Block> block_;
+	};
+
+	/**
+	Compiled, read-only form of a road network. Road data is copied into contiguous arrays, with the
+	type specific geometry parameters grouped per geometry type, and geometries are evaluated through
+	a switch on type instead of virtual calls. Road, geometry, lane section and elevation indices are
+	the same as in the OpenDrive object model, which is still used for loading and modifications.
+
+	When built with RM_COMPACT_STORAGE, record values are stored in single precision and geometry
+	coordinates relative to the start of the road. Identical lane width sequences are always shared.
+	*/
+	class CompiledOpenDrive
+	{
+	public:
+#ifdef RM_COMPACT_STORAGE
+		typedef float Real;
+#else
+		typedef double Real;
+#endif
+
+		typedef struct
+		{
+			Real s;
+			Real x;  // relative to the origin of the road, see RoadRecord
+			Real y;
+			Real hdg;
+			Real length;
+			Geometry::GeometryType type;
+			int param_idx;  // index into the parameter array of the geometry type
+		} GeometryRecord;
+
+		typedef struct
+		{
+			Real curv_start;
+			Real curv_end;
+			Real c_dot;
+			Real x0;
+			Real y0;
+			Real h0;
+			Real s0;
+			int first_node;  // spiral table, see SpiralTable. n_nodes = 0 means no table
+			int n_nodes;
+			Real table_s_start;
+			Real table_step;
+		} SpiralParams;
+
+		typedef struct
+		{
+			Real a;
+			Real b;
+			Real c;
+			Real d;
+			Real umax;
+		} Poly3Params;
+
+		typedef struct
+		{
+			Real aU;
+			Real bU;
+			Real cU;
+			Real dU;
+			Real aV;
+			Real bV;
+			Real cV;
+			Real dV;
+			Real p_scale;
+		} ParamPoly3Params;
+
+		// Cubic polynomial starting at s, used for elevation, lane offset and lane width records
+		typedef struct
+		{
+			Real s;
+			Real a;
+			Real b;
+			Real c;
+			Real d;
+		} PolyRecord;
+
+		typedef struct
+		{
+			int id;
+			bool driving;
+			int first_width;  // lanes with identical widths share the same records
+			int n_widths;
+		} LaneRecord;
+
+		typedef struct
+		{
+			Real s;
+			Real length;
+			int first_lane;
+			int n_lanes;
+			int min_lane_id;
+			int first_lane_slot;  // lane index by lane ID, see lane_slot_
+			int n_lane_slots;
+		} LaneSectionRecord;
+
+		typedef struct
+		{
+			double x0;  // origin of geometry coordinates, start of the road in compact storage, else 0
+			double y0;
+			Real length;
+			int first_geometry;
+			int n_geometries;
+			int first_elevation;
+			int n_elevations;
+			int first_lane_offset;
+			int n_lane_offsets;
+			int first_lane_section;
+			int n_lane_sections;
+		} RoadRecord;
+
+		CompiledOpenDrive() : n_shared_widths_(0), valid_(false) {}
+
+		/**
+		Copy the road network into the compiled form, replacing any earlier content
+		@param od The road network
+		*/
+		void Build(OpenDrive *od);
+		void Clear();
+		bool IsValid() { return valid_; }
+		int GetNumberOfRoads() { return (int)road_.size(); }
+		RoadRecord *GetRoad(int road_idx) { return &road_[road_idx]; }
+		GeometryRecord *GetGeometry(int road_idx, int geom_idx) { return &geometry_[road_[road_idx].first_geometry + geom_idx]; }
+		LaneSectionRecord *GetLaneSection(int road_idx, int lane_section_idx) { return &lane_section_[road_[road_idx].first_lane_section + lane_section_idx]; }
+		LaneRecord *GetLaneByIdx(LaneSectionRecord *lane_section, int lane_idx) { return &lane_[lane_section->first_lane + lane_idx]; }
+		LaneRecord *GetLaneById(LaneSectionRecord *lane_section, int lane_id);
+		int GetLaneSectionIdxByS(int road_idx, double s);
+
+		void EvaluateGeometryDS(RoadRecord *road, GeometryRecord *geom, double ds, double *x, double *y, double *h);
+		double GetLaneOffset(int road_idx, double s);
+		double GetLaneOffsetPrim(int road_idx, double s);
+		bool GetZAndPitchByS(int road_idx, double s, double *z, double *pitch, int *index);
+		double GetWidth(LaneSectionRecord *lane_section, double s, int lane_id);
+		double GetOuterOffset(LaneSectionRecord *lane_section, double s, int lane_id);
+		void GetLaneOffsets(LaneSectionRecord *lane_section, double s, double *outer_offset, double *width);
+		double GetCenterOffset(LaneSectionRecord *lane_section, double s, int lane_id);
+		double GetOuterOffsetHeading(LaneSectionRecord *lane_section, double s, int lane_id);
+		double GetCenterOffsetHeading(LaneSectionRecord *lane_section, double s, int lane_id);
+
+		/**
+		Total size of the compiled arrays, in bytes
+		*/
+		size_t GetMemoryUsage();
+
+		/**
+		Number of lane width records saved by sharing identical lane width sequences
+		*/
+		int GetNumberOfSharedWidths() { return n_shared_widths_; }
+
+	private:
+		PolyRecord *GetLaneWidthByS(LaneRecord *lane, double ds);
+		void EvaluateStandardSpiral(SpiralParams *sp, double s, double *x, double *y, double *t);
+
+		std::vector<RoadRecord> road_;
+		std::vector<GeometryRecord> geometry_;
+		std::vector<Real> arc_curvature_;
+		std::vector<SpiralParams> spiral_;
+		std::vector<double> spiral_node_;
+		std::vector<Poly3Params> poly3_;
+		std::vector<ParamPoly3Params> param_poly3_;
+		std::vector<PolyRecord> elevation_;
+		std::vector<PolyRecord> lane_offset_;
+		std::vector<LaneSectionRecord> lane_section_;
+		std::vector<LaneRecord> lane_;
+		std::vector<int> lane_slot_;  // per lane section, index of lane with ID (min_lane_id + i), -1 if missing
+		std::vector<PolyRecord> lane_width_;
+		int n_shared_widths_;
+		bool valid_;
+	};
+
+	// Connection from the end of a lane to a lane of the next road, see LaneGraph
+	typedef struct
+	{
+		int road_idx;  // next road, -1 if missing
+		int lane_id;  // lane on the next road, 0 if the lane has no link
+		ContactPointType contact_point;  // end of the next road where the lane enters
+		int node_idx;  // node of the next lane at the contact point, -1 if not known
+	} LaneGraphEdge;
+
+	typedef struct
+	{
+		int road_idx;
+		int lane_section_idx;
+		int lane_id;
+		int first_edge[2];  // per link type, SUCCESSOR and PREDECESSOR
+		int n_edges[2];
+	} LaneGraphNode;
+
+	/**
+	Lane level topology of a road network. There is one node per lane of each lane section, with edges
+	to the lanes that follow at either end of the road, via direct road links or junction connections.
+	Built once when the road network is compiled, so that moving along the road network does not need
+	to search links and junction connections.
+	*/
+	class LaneGraph
+	{
+	public:
+		LaneGraph() : valid_(false) {}
+
+		/**
+		Build the graph from the object model of a road network, replacing any earlier content
+		*/
+		void Build(OpenDrive *od);
+		void Clear();
+		bool IsValid() { return valid_; }
+
+		/**
+		Find edges out of a lane, in the order of the road link or junction connections
+		@param od The road network
+		@param road The road
+		@param lane A lane of the road
+		@param road_link Successor or predecessor link of the road, i.e. which end of the road to leave from
+		@param edges Edges are appended here, with node_idx set to -1
+		@return Number of edges found
+		*/
+		static int FindEdges(OpenDrive *od, Road *road, Lane *lane, RoadLink *road_link, std::vector<LaneGraphEdge> &edges);
+
+		/**
+		Get index of the node representing a lane
+		@return Node index, -1 if out of range
+		*/
+		int GetNodeIdx(int road_idx, int lane_section_idx, int lane_idx);
+		int GetNumberOfNodes() { return (int)node_.size(); }
+		LaneGraphNode *GetNode(int node_idx) { return &node_[node_idx]; }
+		int GetNumberOfEdges(int node_idx, LinkType link_type) { return node_[node_idx].n_edges[link_type == SUCCESSOR ? 0 : 1]; }
+		LaneGraphEdge *GetEdge(int node_idx, LinkType link_type, int idx)
+		{
+			return &edge_[node_[node_idx].first_edge[link_type == SUCCESSOR ? 0 : 1] + idx];
+		}
+
+	private:
+		std::vector<LaneGraphNode> node_;
+		std::vector<LaneGraphEdge> edge_;
+		std::vector<int> road_first_lane_section_;  // index into lane_section_first_node_ per road
+		std::vector<int> lane_section_first_node_;  // one extra at the end, so that lane count = next - first
+		bool valid_;
+	};
+
+	// Tiled loading, see OpenDrive::SetTiledLoading()
+	typedef struct
+	{
+		int file_idx;  // OpenDRIVE file containing the road
+		long offset;  // byte offset of the road element in the file
+		long size;  // size of the road element in bytes
+		bool loaded;
+		size_t memory;  // approximate memory used when loaded
+		double h_start;  // heading at start of reference line, including lane offset
+		double h_end;
+		unsigned long long last_used;
+		Arena *arena;  // holds the road content while loaded
+	} RoadTile;
+
+	// Shortest paths from either end of a road to either end of another road, see OpenDrive::GetRoadPath()
+	typedef struct
+	{
+		double dist[2][2];  // [end of start road][end of target road], 0 = start, 1 = end. LARGE_NUMBER if no path
+		std::vector<int> road[2][2];  // indices of the roads in between, in order
+	} RoadPathEntry;
+
 	class OpenDrive
 	{
 	public:
-		OpenDrive() {};
+		OpenDrive();
 		OpenDrive(const char *filename);
 		~OpenDrive();
 
@@ -634,6 +1357,62 @@ namespace roadmanager
 		*/
 		bool LoadOpenDriveFile(const char *filename, bool replace = true);
 
+		/**
+		Save the loaded road network in binary form. LoadOpenDriveFile() will then read the network from
+		this file instead of parsing the XML, as long as the OpenDRIVE file is unchanged.
+		Not supported in tiled mode, since road content is not kept in memory.
+		@param filename Cache file, normally GetBinaryCacheFilename(OpenDRIVE filename)
+		@return 0 on success, -1 on error
+		*/
+		int SaveBinaryCache(const char *filename);
+
+		/**
+		Enable or disable use of binary caches in LoadOpenDriveFile(). Enabled by default.
+		*/
+		void SetBinaryCacheEnabled(bool enabled) { binary_cache_enabled_ = enabled; }
+
+		/**
+		Check whether the last LoadOpenDriveFile() call read the road network from a binary cache
+		*/
+		bool IsLoadedFromBinaryCache() { return loaded_from_cache_; }
+
+		/**
+		Name of the binary cache belonging to an OpenDRIVE file, i.e. the same name with ".bin" appended
+		*/
+		static std::string GetBinaryCacheFilename(std::string odr_filename) { return odr_filename + ".bin"; }
+
+		/**
+		Enable tiled loading for subsequent LoadOpenDriveFile() calls. Then only road ids, links, bounding
+		boxes and where to find each road in the file are kept in memory. The file is scanned for roads and
+		junctions and parsed one element at a time, and the binary cache is not used, so that the whole
+		network is never in memory at once. Road data is loaded from the file
+		when a road is first accessed through GetRoadById() or GetRoadByIdx(), and unloaded again by
+		EvictRoads(). The compiled form and approximate mode are not available in tiled mode. Roads may be
+		loaded from several threads, but EvictRoads() must not run while other threads use road data.
+		@param memory_budget Approximate max memory used by loaded roads, in bytes. 0 disables tiled loading.
+		*/
+		void SetTiledLoading(size_t memory_budget) { tile_memory_budget_ = memory_budget; }
+		bool IsTiled() { return tiled_; }
+
+		/**
+		Unload roads far from all entities, when loaded roads use more memory than the budget. Roads are
+		unloaded in order of distance to closest entity, never closer than TILE_KEEP_DIST. Don't keep
+		pointers to road data (geometries, lane sections, lanes...) across calls to this function.
+		@param x X coordinates of the entities
+		@param y Y coordinates of the entities
+		@param n_points Number of entities
+		@return Number of unloaded roads
+		*/
+		int EvictRoads(const double *x, const double *y, int n_points);
+		int GetNumberOfLoadedRoads();
+
+		/**
+		In tiled mode, make sure the road data is loaded. Only needed for road pointers not retrieved by
+		GetRoadById() or GetRoadByIdx(), e.g. connecting roads of junctions.
+		*/
+		void LoadRoad(Road *road);
+		size_t GetLoadedRoadMemory() { return tile_memory_; }
+
 		/**
 		Get the filename of currently loaded OpenDRIVE file
 		*/
@@ -667,6 +1446,7 @@ namespace roadmanager
 		@param road1_id Id of the first road
 		@param road2_id Id of the second road
 		@param angle if connected, the angle between road 2 and road 1 is returned here
+		Looked up in the connectivity table that is built when the OpenDRIVE file is loaded
 		@return 0 if not connected, -1 if road 2 is the predecessor of road 1, +1 if road 2 is the successor of road 1
 		*/
 		int IsDirectlyConnected(int road1_id, int road2_id, double &angle);
@@ -685,14 +1465,249 @@ namespace roadmanager
 		std::string ContactPointType2Str(ContactPointType type);
 		std::string ElementType2Str(RoadLink::ElementType type);
 
+		/**
+		Retrieve the grid of geometry bounding boxes, built when the OpenDRIVE file is loaded
+		*/
+		GeometryGrid *GetGeometryGrid() { return &geometry_grid_; }
+
+		/**
+		Build the compiled form and the lane graph of the road network, see CompiledOpenDrive and LaneGraph.
+		Done when an OpenDRIVE file is loaded, call again after modifying roads through the object model.
+		*/
+		void Compile();
+
+		/**
+		Retrieve the compiled form of the road network
+		@return Pointer to the compiled network, 0 if not compiled
+		*/
+		CompiledOpenDrive *GetCompiled() { return compiled_.IsValid() ? &compiled_ : 0; }
+
+		/**
+		Retrieve the lane level topology, built with the compiled form
+		@return Pointer to the graph, 0 if not available (e.g. in tiled mode)
+		*/
+		LaneGraph *GetLaneGraph() { return lane_graph_.IsValid() ? &lane_graph_ : 0; }
+
+		/**
+		Find the shortest paths along the road links between the ends of two roads. A path ends where the
+		target road is first entered, it never passes the target road to reach its other end. The length of
+		the start and target roads is not included. Results are kept in a cache of recently used road pairs.
+		Safe to call from several threads.
+		@param start_road_idx Index of the road to start from
+		@param target_road_idx Index of the road to reach
+		@param entry Paths found are copied here
+		@return 0 on success, -1 if any index is invalid
+		*/
+		int GetRoadPath(int start_road_idx, int target_road_idx, RoadPathEntry &entry);
+
+		/**
+		Set max number of road pairs in the path cache, see GetRoadPath(). 0 disables the cache.
+		*/
+		void SetRoadPathCacheSize(int size);
+		int GetRoadPathCacheSize() { return road_path_cache_size_; }
+
+		/**
+		Precompute road distances to and from a number of landmark road ends, spread over the network. The
+		tables give lower bounds of road distances, which guide and prune the searches of GetRoadPath() and
+		allow quick rejection tests, see GetRoadDistanceLowerBound(). Tables are removed when roads are loaded, call
+		again after loading. Compile() keeps them, since it does not change roads or links.
+		@param n_landmarks Number of landmarks, 0 removes the tables
+		@return 0 on success, -1 on error
+		*/
+		int ComputeLandmarks(int n_landmarks);
+		int GetNumberOfLandmarks() { return (int)landmark_.size(); }
+
+		/**
+		Lower bound of the distance along the road network between two road positions, in any direction
+		@param start_road_idx Index of the start road
+		@param start_s Distance along the start road
+		@param target_road_idx Index of the target road
+		@param target_s Distance along the target road
+		@return Lower bound, LARGE_NUMBER if target can't be reached. 0 if unknown, e.g. no landmarks computed.
+		*/
+		double GetRoadDistanceLowerBound(int start_road_idx, double start_s, int target_road_idx, double target_s);
+
+		/**
+		Find roads entered when leaving a road at one of its ends, directly or via junction connecting roads
+		@param road_idx Index of the road
+		@param end 0 for start, 1 for end of the road
+		@param successors Receives pairs of road index and the end (0 start, 1 end) at which it is entered
+		*/
+		void GetRoadEndSuccessors(int road_idx, int end, std::vector<std::pair<int, int> > &successors);
+
+		/**
+		Map a set of world positions to road coordinates, e.g. samples of a recorded trajectory. Points are split
+		into blocks of consecutive points, spread over a number of threads. Within a block each point is mapped
+		starting from the previous one, see Position::XYZH2TrackPosIncremental(). Results do not depend on the
+		number of threads.
+		@param n Number of points
+		@param x X coordinate per point
+		@param y Y coordinate per point
+		@param z Z coordinate per point, or 0 if not known. Then height of the road is assumed.
+		@param h Heading per point
+		@param road_id Receives road ID per point, -1 if not found
+		@param lane_id Receives lane ID per point
+		@param s Receives distance along the road per point
+		@param t Receives lateral distance from reference line per point
+		@param offset Receives lateral offset from lane center per point
+		@param n_threads Number of threads, 0 for one per processor core
+		@param stats If not 0, receives number of points resolved by each step of the search
+		@return 0 on success, -1 on error
+		*/
+		int XYZH2TrackPosBatch(int n, const double *x, const double *y, const double *z, const double *h,
+			int *road_id, int *lane_id, double *s, double *t, double *offset, int n_threads = 0, ProjectionStats *stats = 0);
+
+		/**
+		Find the parts of all lanes within a circle, e.g. lanes within some distance from a vehicle. Only roads
+		with a geometry bounding box reaching the circle are examined, see GeometryGrid. Lanes are sampled
+		along s in steps of at most 1 m, finer for small circles and for lanes close to the circle, and the
+		ends of each part are refined in between samples. Lane parts shorter than 2 cm along s might be missed,
+		assuming lane borders move at most 3 m sideways per m along s.
+		@param x X coordinate of the circle center
+		@param y Y coordinate of the circle center
+		@param radius Radius of the circle
+		@param segments Receives one entry per lane part, ordered by road then by start s
+		@param include_non_driving If true lanes of any type are included, else only driving lanes
+		@return Number of lane parts found, -1 on error
+		*/
+		int GetLaneSegmentsInCircle(double x, double y, double radius, std::vector<RoadLaneSegment> &segments,
+			bool include_non_driving = false);
+
+		/**
+		Find the parts of all lanes within an axis aligned box, see GetLaneSegmentsInCircle()
+		@param x_min Lower X coordinate of the box
+		@param y_min Lower Y coordinate of the box
+		@param x_max Upper X coordinate of the box
+		@param y_max Upper Y coordinate of the box
+		@param segments Receives one entry per lane part, ordered by road then by start s
+		@param include_non_driving If true lanes of any type are included, else only driving lanes
+		@return Number of lane parts found, -1 on error
+		*/
+		int GetLaneSegmentsInBox(double x_min, double y_min, double x_max, double y_max, std::vector<RoadLaneSegment> &segments,
+			bool include_non_driving = false);
+
+		/**
+		Road evaluation by road, geometry and lane section index. Uses the compiled form when available,
+		else the object model.
+		*/
+		int EvaluateGeometryDS(int road_idx, int geom_idx, double ds, double *x, double *y, double *h);
+		int GetGeometrySAndLength(int road_idx, int geom_idx, double *s, double *length);
+		double GetLaneOffset(int road_idx, double s);
+		double GetLaneOffsetPrim(int road_idx, double s);
+		bool GetZAndPitchByS(int road_idx, double s, double *z, double *pitch, int *index);
+		int GetCenterOffsetAndHeading(int road_idx, int lane_section_idx, double s, int lane_id, double *offset, double *heading);
+
+		/**
+		Find the driving lane closest to a lateral position
+		@param road_idx Index of the road
+		@param s Distance along the road
+		@param t Lateral position, relative reference line
+		@return Signed lateral distance from lane center to t, infinity if no driving lane
+		*/
+		double GetDistToClosestDrivingLane(int road_idx, double s, double t);
+
+		/**
+		Enable fast approximate evaluation of road coordinates. Each road is sampled into a RoadTessellation
+		table, which Position then interpolates instead of evaluating the road geometry. Tables are rebuilt
+		whenever an OpenDRIVE file is loaded.
+		@param tolerance Max position error, in meters, e.g. 0.01. 0 disables approximate mode.
+		@return Largest error found in the created tables, in meters
+		*/
+		double SetTessellationTolerance(double tolerance);
+		double GetTessellationTolerance() { return tessellation_tolerance_; }
+
+		/**
+		Retrieve the sampled table of a road
+		@param road_idx Index of the road
+		@return Pointer to the table, 0 if approximate mode is not enabled
+		*/
+		RoadTessellation *GetTessellation(int road_idx);
+
+		/**
+		Enable a grid of road surface heights, see HeightGrid. The grid is rebuilt whenever an OpenDRIVE file is
+		loaded. Not available in tiled mode.
+		@param resolution Distance between grid nodes, in meters, e.g. 0.5. 0 removes the grid.
+		@return Largest height error found in the created grid, in meters
+		*/
+		double SetHeightGridResolution(double resolution);
+		double GetHeightGridResolution() { return height_grid_resolution_; }
+
+		/**
+		Retrieve the grid of road surface heights
+		@return Pointer to the grid, 0 if not enabled
+		*/
+		HeightGrid *GetHeightGrid() { return height_grid_.IsValid() ? &height_grid_ : 0; }
+
+		/**
+		Look up road height and surface normal for a set of world positions, e.g. wheel contact points, without
+		mapping them to road coordinates. Requires the height grid, see SetHeightGridResolution().
+		@param n Number of points
+		@param x X coordinate per point
+		@param y Y coordinate per point
+		@param z Receives road height per point, 0 where not found
+		@param normal_x If not 0, receives X component of the road surface normal per point
+		@param normal_y If not 0, receives Y component of the road surface normal per point
+		@param normal_z If not 0, receives Z component of the road surface normal per point
+		@param found If not 0, receives 1 per point found in the grid, else 0
+		@return Number of points found in the grid, -1 on error, e.g. grid not enabled
+		*/
+		int GetRoadHeightBatch(int n, const double *x, const double *y, double *z, double *normal_x, double *normal_y,
+			double *normal_z, int *found = 0);
 
 		void Print();
 	
 	private:
-		pugi::xml_node root_node_;
+		Road *FindRoadById(int id);
+		Road *ParseRoad(pugi::xml_node road_node, Arena &content_arena);
+		void ParseJunction(pugi::xml_node junction_node);
+		void ParseRoadContent(Road *r, pugi::xml_node road_node, Arena &arena);
+		void LoadTiledOpenDriveFile(const char *filename);
+		int LoadRoadContent(int road_idx);
+		double GetRoadEndHeading(Road *road, bool at_end);
+		void CalcRoadBBoxes(Road *road, int road_idx, std::vector<GeometryBBox> &bbox);
+		void FindRoadPaths(int start_road_idx, int target_road_idx, RoadPathEntry &entry);
+		void ClearRoadPathCache();
+		double GetLandmarkLowerBound(int from_node, int to_node);
+		int LoadBinaryCache(const char *filename, std::vector<GeometryBBox> &bbox);
+		void ClearRoadTiles();
+		void FinishLoading(std::vector<GeometryBBox> *bbox = 0);
+		void BuildGeometryGrid(std::vector<GeometryBBox> *bbox = 0);
+		void BuildConnectivityTable();
+		double BuildTessellation();
+		double BuildHeightGrid();
+		int CalcDirectlyConnected(Road *road1, Road *road2, double &angle);
+		long long GetRoadPairKey(int road1_id, int road2_id) { return (long long)(((unsigned long long)(unsigned int)road1_id << 32) | (unsigned int)road2_id); }
+
+		Arena arena_;  // owns roads, junctions and their content, except road content in tiled mode
 		std::vector<Road*> road_;
 		std::vector<Junction*> junction_;
+		std::unordered_map<int, int> road_idx_by_id_;  // road ID -> index into road_
+		std::unordered_map<int, int> junction_idx_by_id_;  // junction ID -> index into junction_
 		std::string odr_filename_;
+		bool binary_cache_enabled_;
+		bool loaded_from_cache_;
+		bool tiled_;
+		size_t tile_memory_budget_;
+		size_t tile_memory_;  // memory used by loaded roads
+		unsigned long long tile_counter_;  // incremented for each road access, used to find least recently used roads
+		std::vector<RoadTile> road_tile_;  // one per road in tiled mode, else empty
+		std::vector<std::string> tile_filename_;
+		GeometryGrid geometry_grid_;
+		std::unordered_map<long long, RoadConnectivity> road_connectivity_;  // road ID pair -> relation and angle
+		CompiledOpenDrive compiled_;
+		LaneGraph lane_graph_;
+		std::list<std::pair<long long, RoadPathEntry> > road_path_cache_;  // most recently used first
+		std::unordered_map<long long, std::list<std::pair<long long, RoadPathEntry> >::iterator> road_path_cache_idx_;
+		int road_path_cache_size_;
+		SE_Mutex road_path_mutex_;  // protects path cache and road end points
+		SE_Mutex tile_mutex_;  // protects loading and unloading of road tiles
+		std::vector<int> landmark_;  // road end node, road_idx * 2 + end
+		std::vector<double> landmark_dist_from_;  // distance from landmark to node, landmark_idx * n_nodes + node
+		std::vector<double> landmark_dist_to_;  // distance from node to landmark, same layout
+		double tessellation_tolerance_;
+		std::vector<RoadTessellation> tessellation_;  // one per road, empty if approximate mode is disabled
+		double height_grid_resolution_;
+		HeightGrid height_grid_;
 	};
 
 	typedef struct
@@ -735,6 +1750,13 @@ namespace roadmanager
 		};
 
 		explicit Position();
+
+		/**
+		Create a position on the given road network. All other constructors use the default network of the
+		process, see GetOpenDrive().
+		@param od Road network, 0 for the default one
+		*/
+		explicit Position(OpenDrive *od);
 		explicit Position(int track_id, double s, double t);
 		explicit Position(int track_id, int lane_id, double s, double offset);
 		explicit Position(double x, double y, double z, double h, double p, double r);
@@ -742,8 +1764,37 @@ namespace roadmanager
 		~Position();
 		
 		void Init();
+
+		/**
+		Load a road network into the default OpenDrive instance, shared by all positions not given a
+		network of their own
+		*/
 		static bool LoadOpenDrive(const char *filename);
+
+		/**
+		Retrieve the default OpenDrive instance, see LoadOpenDrive()
+		*/
 		static OpenDrive* GetOpenDrive();
+
+		/**
+		Retrieve the road network this position refers to
+		*/
+		OpenDrive *GetRoadNetwork() const { return od_; }
+
+		/**
+		Move the position to another road network. Road coordinates are kept, call SetTrackPos() or
+		SetInertiaPos() to update.
+		@param od Road network, 0 for the default one
+		*/
+		void SetRoadNetwork(OpenDrive *od) { od_ = od ? od : GetOpenDrive(); }
+
+		/**
+		Seed the random number stream used by junction strategy RANDOM, see MoveAlongS(). Each position has
+		its own stream, so the outcome doesn't depend on other positions or on thread scheduling. A copy of
+		a position continues the stream independently. Default seed is 1.
+		@param seed Any value
+		*/
+		void SetRandomSeed(unsigned int seed) { random_.seed(seed); }
 		int GotoClosestDrivingLaneAtCurrentPosition();
 		void SetTrackPos(int track_id, double s, double t, bool calculateXYZ = true);
 		void ForceLaneId(int lane_id);
@@ -753,6 +1804,31 @@ namespace roadmanager
 		void SetHeadingRelative(double heading);
 		void SetHeadingRelativeRoadDirection(double heading);
 		void XYZH2TrackPos(double x, double y, double z, double h, bool copyZAndPitch = true);
+
+		/**
+		Map a world position to road coordinates, starting from current road position. Intended for positions
+		moving a short distance between updates, e.g. reported every frame by an external simulator. The point
+		is projected on the current geometry, then neighbouring geometries of the road, then on directly connected
+		roads. Only if it is not within the driving lanes of any of those, the whole road network is searched as
+		in XYZH2TrackPos().
+		@param x X coordinate
+		@param y Y coordinate
+		@param z Z coordinate
+		@param h Heading
+		@param copyZAndPitch Set z and pitch from the road, as in XYZH2TrackPos()
+		*/
+		void XYZH2TrackPosIncremental(double x, double y, double z, double h, bool copyZAndPitch = true);
+
+		/**
+		Like SetInertiaPos(), but map to road coordinates using XYZH2TrackPosIncremental()
+		*/
+		void SetInertiaPosIncremental(double x, double y, double z, double h, double p, double r);
+
+		/**
+		Retrieve how many calls of XYZH2TrackPosIncremental() were resolved by each step of the search
+		*/
+		ProjectionStats GetProjectionStats() { return projection_stats_; }
+		void ResetProjectionStats();
 		int MoveToConnectingRoad(RoadLink *road_link, ContactPointType &contact_point_type, Junction::JunctionStrategyType strategy = Junction::RANDOM);
 		double FindDistToPos(Position *pos, RoadLink *link, Road *road, int &call_count, int level_count, bool &found);
 
@@ -772,7 +1848,7 @@ namespace roadmanager
 		Retrieve the S-value of the current route position. Note: This is the S along the
 		complete route, not the actual individual roads.
 		*/
-		double GetRouteS() { return s_; }
+		double GetRouteS() { return s_route_; }
 
 		/**
 		Move current position forward, or backwards, ds meters along the route
@@ -813,6 +1889,14 @@ namespace roadmanager
 		*/
 		bool Delta(Position pos_b, PositionDiff &diff);
 
+		/**
+		Quick lower bound of the distance along the road network to another position, see
+		OpenDrive::GetRoadDistanceLowerBound(). Useful to reject far away positions before calling Delta().
+		@param pos_b The position to measure to
+		@return Lower bound of abs(ds) of Delta(), LARGE_NUMBER if not reachable
+		*/
+		double GetRoadDistanceLowerBound(Position &pos_b);
+
 		/**
 		Is the current position ahead of the one specified in argument
 		This method is more efficient than getRelativeDistance
@@ -830,6 +1914,17 @@ namespace roadmanager
 		*/
 		int GetProbeInfo(double lookahead_distance, RoadProbeInfo *data, LookAheadMode lookAheadMode);
 
+		/**
+		Get information suitable for driver modeling of a number of points along the road ahead, e.g. preview points
+		of a driver model. The road is traversed once, moving from one point to the next.
+		@param lookahead_distance Distances, along the road, to the points. Sorted in increasing order.
+		@param n Number of points
+		@param data Array of n structs to fill in calculated values, see typdef for details
+		@param lookAheadMode Measurement strategy: Along reference lane, lane center or current lane offset. See roadmanager::Position::LookAheadMode enum
+		@return Number of points filled in, starting from the first. Less than n if the road ends before the last point. -1 on error.
+		*/
+		int GetProbeInfo(const double *lookahead_distance, int n, RoadProbeInfo *data, LookAheadMode lookAheadMode);
+
 		/**
 		Get information suitable for driver modeling of a point at a specified distance from object along the road ahead
 		@param target_pos The target position
@@ -881,7 +1976,7 @@ namespace roadmanager
 		Retrieve a road segment specified by road ID
 		@param id road ID as specified in the OpenDRIVE file
 		*/
-		Road *GetRoadById(int id) { return GetOpenDrive()->GetRoadById(id);	}
+		Road *GetRoadById(int id) { return od_->GetRoadById(id);	}
 
 		/**
 		Retrieve the s value (distance along the road segment)
@@ -989,11 +2084,17 @@ namespace roadmanager
 		void XYZ2Track(bool alignZAndPitch = false);
 		int SetLongitudinalTrackPos(int track_id, double s);
 		bool EvaluateRoadZPitchRoll(bool alignZPitchRoll);
-		double GetDistToTrackGeom(double x3, double y3, double z3, double h, Road *road, Geometry *geom, bool &inside, double &sNorm);
+		double GetDistToTrackGeom(double x3, double y3, double z3, double h, GeometryBBox *bbox, bool &inside, double &sNorm);
+		int ProjectOnGeometry(int road_idx, int geom_idx, double x3, double y3, double &ds, double &t);
+		int ProjectOnRoad(int road_idx, int &geom_idx, double &ds, double x3, double y3, double z3, double &t, double &dist);
 
 		// route reference
 		Route  *route_;			// if pointer set, the position corresponds to a point along (s) the route
 
+		OpenDrive *od_;  // road network
+		std::minstd_rand random_;  // for junction strategy RANDOM
+		ProjectionStats projection_stats_;
+
 		// track reference
 		int     track_id_;
 		double  s_;				// longitudinal point/distance along the track
@@ -1025,26 +2126,106 @@ namespace roadmanager
 	};
 
 
+	// The part of a route running along the road of one waypoint
+	typedef struct
+	{
+		int road_id;
+		int lane_id;        // lane of the waypoint
+		int direction;      // 1 along road s, -1 against road s, 0 if not connected to neighbouring waypoint
+		double road_length;
+		double route_s;     // route s where the segment starts
+		double length;      // length of the segment along the route
+		double entry_s;     // road s where the route enters the road
+		double exit_s;      // road s where the route leaves the road
+	} RouteSegment;
+
 	// A route is a sequence of positions, at least one per road along the route
 	class Route
 	{
 	public:
-		explicit Route() {}
+		explicit Route() : length_(0.0), first_unconnected_(-1) {}
 
 		/**
 		Adds a waypoint to the route. One waypoint per road. At most one junction between waypoints.
+		The segment table and profiles are rebuilt, see BuildSegments()
 		@param position A regular position created with road, lane or world coordinates
 		@return Non zero return value indicates error of some kind
 		*/
 		int AddWaypoint(Position *position);
 		int GetWayPointDirection(int index);
 
+		/**
+		Build the table of route segments, one per waypoint, and the curvature and speed limit profiles
+		along the route. Called by AddWaypoint(), only needed if waypoint_ is modified directly.
+		*/
+		void BuildSegments();
+
+		int GetNumberOfSegments() { return (int)segment_.size(); }
+		RouteSegment *GetSegmentByIdx(int idx);
+
+		/**
+		Find the route segment at given distance along the route
+		@param route_s Distance along the route, from the first waypoint
+		@param hint Segment index to check first, typically the one found last time. -1 means no hint.
+		@return Segment index, -1 if route_s is beyond the end of the route or the route has no segments
+		*/
+		int GetSegmentIdxByRouteS(double route_s, int hint = -1);
+
+		/**
+		Find the first route segment along given road
+		@param road_id Id of the road
+		@return Segment index, -1 if the road is not part of the route
+		*/
+		int GetSegmentIdxByRoadId(int road_id);
+
+		/**
+		Index of the first segment not connected to its neighbour, i.e. where the route is broken
+		@return Segment index, -1 if all segments are connected
+		*/
+		int GetFirstUnconnectedSegmentIdx() { return first_unconnected_; }
+
+		/**
+		Curvature of the road reference line at given distance along the route. Positive values
+		means turning left in the route direction. Values outside the route are clamped to its ends.
+		@param route_s Distance along the route, from the first waypoint
+		@return Curvature (1/m)
+		*/
+		double GetCurvatureByRouteS(double route_s);
+
+		/**
+		Speed limit of the road at given distance along the route, see Road::GetSpeedByS()
+		@param route_s Distance along the route, from the first waypoint
+		@return Speed limit (m/s), 0 if the road has no type entries
+		*/
+		double GetSpeedLimitByRouteS(double route_s);
+
 		void setName(std::string name);
 		std::string getName();
-		double GetLength();
+		double GetLength() { return length_; }
 
 		std::vector<Position*> waypoint_;
 		std::string name;
+
+	private:
+		typedef struct
+		{
+			int segment_idx;
+			int geometry_idx;
+		} CurvatureEntry;
+
+		Road *GetSegmentRoad(int segment_idx);
+		double GetRoadS(RouteSegment *segment, double route_s);
+		void AddCurvatureEntries(int segment_idx);
+		void AddSpeedEntries(int segment_idx);
+
+		std::vector<RouteSegment> segment_;
+		SIndex segment_index_;
+		std::vector<CurvatureEntry> curvature_;
+		SIndex curvature_index_;
+		std::vector<double> speed_;
+		SIndex speed_index_;
+		double length_;
+		int first_unconnected_;
 	};
 
 	// A Road Path is a linked list of road links (road connections or junctions)
@@ -1053,37 +2234,24 @@ namespace roadmanager
 	class RoadPath
 	{
 	public:
-
-		typedef struct PathNode
-		{
-			RoadLink *link;
-			double dist;
-			Road* fromRoad;
-			PathNode* previous;
-		} PathNode;
-
-		std::vector<PathNode*> visited_;
-		std::vector<PathNode*> unvisited_;
 		Position *startPos_;
 		Position *targetPos_;
-		int direction_;  // direction of path from starting pos. 0==not set, 1==forward, 2==backward
+		int direction_;  // direction of path from starting pos. 0==not set, 1==forward, -1==backward
+		std::vector<int> path_;  // indices of the roads in between start and target road, in order
 
-		RoadPath(Position* startPos, Position* targetPos) : startPos_(startPos), targetPos_(targetPos) {};
-		~RoadPath();
+		RoadPath(Position* startPos, Position* targetPos) : startPos_(startPos), targetPos_(targetPos), direction_(0) {};
 
 		/**
 		Calculate shortest path between starting position and target position, 
-		using Dijkstra's algorithm https://en.wikipedia.org/wiki/Dijkstra%27s_algorithm
+		using the A* algorithm https://en.wikipedia.org/wiki/A*_search_algorithm
 		it also calculates the length of the path, or distance between the positions
 		positive distance means that the shortest path was found in forward direction
 		negative distance means that the shortest path goes in opposite direction from the heading of the starting position
+		Paths between road ends are cached in the OpenDrive, see OpenDrive::GetRoadPath()
 		@param dist A reference parameter into which the calculated path distance is stored
 		@return 0 on success, -1 on failure e.g. path not found
 		*/
 		int Calculate(double &dist);
-	
-	private:
-		bool CheckRoad(Road* checkRoad, RoadPath::PathNode* srcNode, Road* fromRoad);
 	};
 
 
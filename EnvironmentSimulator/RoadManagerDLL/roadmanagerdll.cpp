@@ -19,6 +19,22 @@ using namespace roadmanager;
 static roadmanager::OpenDrive *odrManager = 0;
 static std::vector<Position> position;
 
+static void CopyProbeInfo(roadmanager::RoadProbeInfo *s_data, RM_RoadProbeInfo *r_data)
+{
+	r_data->road_lane_info.pos[0] = (float)s_data->road_lane_info.pos[0];
+	r_data->road_lane_info.pos[1] = (float)s_data->road_lane_info.pos[1];
+	r_data->road_lane_info.pos[2] = (float)s_data->road_lane_info.pos[2];
+	r_data->road_lane_info.curvature = (float)s_data->road_lane_info.curvature;
+	r_data->road_lane_info.heading = (float)s_data->road_lane_info.heading;
+	r_data->road_lane_info.pitch = (float)s_data->road_lane_info.pitch;
+	r_data->road_lane_info.roll = (float)s_data->road_lane_info.roll;
+	r_data->road_lane_info.speed_limit = (float)s_data->road_lane_info.speed_limit;
+	r_data->relative_pos[0] = (float)s_data->relative_pos[0];
+	r_data->relative_pos[1] = (float)s_data->relative_pos[1];
+	r_data->relative_pos[2] = (float)s_data->relative_pos[2];
+	r_data->relative_h = (float)s_data->relative_h;
+}
+
 static int GetProbeInfo(int index, float lookahead_distance, RM_RoadProbeInfo *r_data, int lookAheadMode)
 {
 	roadmanager::RoadProbeInfo s_data;
@@ -41,18 +57,7 @@ static int GetProbeInfo(int index, float lookahead_distance, RM_RoadProbeInfo *r
 	else
 	{
 		// Copy data
-		r_data->road_lane_info.pos[0] = (float)s_data.road_lane_info.pos[0];
-		r_data->road_lane_info.pos[1] = (float)s_data.road_lane_info.pos[1];
-		r_data->road_lane_info.pos[2] = (float)s_data.road_lane_info.pos[2];
-		r_data->road_lane_info.curvature = (float)s_data.road_lane_info.curvature;
-		r_data->road_lane_info.heading = (float)s_data.road_lane_info.heading;
-		r_data->road_lane_info.pitch = (float)s_data.road_lane_info.pitch;
-		r_data->road_lane_info.roll = (float)s_data.road_lane_info.roll;
-		r_data->road_lane_info.speed_limit = (float)s_data.road_lane_info.speed_limit;
-		r_data->relative_pos[0] = (float)s_data.relative_pos[0];
-		r_data->relative_pos[1] = (float)s_data.relative_pos[1];
-		r_data->relative_pos[2] = (float)s_data.relative_pos[2];
-		r_data->relative_h = (float)s_data.relative_h;
+		CopyProbeInfo(&s_data, r_data);
 
 		return 0;
 	}
@@ -270,9 +275,25 @@ extern "C"
 		else
 		{
 			roadmanager::Position *pos = &position[handle];
-			pos->SetInertiaPos(x, y, z, h, p, r);
+			pos->SetInertiaPosIncremental(x, y, z, h, p, r);
+		}
+
+		return 0;
+	}
+
+	RM_DLL_API int RM_GetProjectionStats(int handle, RM_ProjectionStats *stats)
+	{
+		if (odrManager == 0 || handle >= position.size())
+		{
+			return -1;
 		}
 
+		roadmanager::ProjectionStats projection_stats = position[handle].GetProjectionStats();
+		stats->current_geometry = projection_stats.current_geometry;
+		stats->same_road = projection_stats.same_road;
+		stats->connected_road = projection_stats.connected_road;
+		stats->global = projection_stats.global;
+
 		return 0;
 	}
 
@@ -306,6 +327,93 @@ extern "C"
 		return 0;
 	}
 
+	RM_DLL_API int RM_WorldXYHToRoadBatch(int n, float *x, float *y, float *h, int *roadId, int *laneId, float *laneOffset, float *s, float *t, int nThreads)
+	{
+		if (odrManager == 0 || n < 0 || (n > 0 && (x == 0 || y == 0 || h == 0 || roadId == 0)))
+		{
+			return -1;
+		}
+
+		std::vector<double> x_d(x, x + n);
+		std::vector<double> y_d(y, y + n);
+		std::vector<double> h_d(h, h + n);
+		std::vector<double> s_d(n);
+		std::vector<double> t_d(n);
+		std::vector<double> offset_d(n);
+		std::vector<int> lane_id_d(laneId ? 0 : n);
+
+		if (odrManager->XYZH2TrackPosBatch(n, x_d.data(), y_d.data(), 0, h_d.data(), roadId, laneId ? laneId : lane_id_d.data(),
+			s_d.data(), t_d.data(), offset_d.data(), nThreads) != 0)
+		{
+			return -1;
+		}
+
+		for (int i = 0; i < n; i++)
+		{
+			if (laneOffset)
+			{
+				laneOffset[i] = (float)offset_d[i];
+			}
+			if (s)
+			{
+				s[i] = (float)s_d[i];
+			}
+			if (t)
+			{
+				t[i] = (float)t_d[i];
+			}
+		}
+
+		return 0;
+	}
+
+	RM_DLL_API float RM_SetHeightGridResolution(float resolution)
+	{
+		if (odrManager == 0)
+		{
+			return -1;
+		}
+
+		return (float)odrManager->SetHeightGridResolution(resolution);
+	}
+
+	RM_DLL_API int RM_GetRoadHeightBatch(int n, float *x, float *y, float *z, float *normalX, float *normalY, float *normalZ, int *found)
+	{
+		if (odrManager == 0 || n < 0 || (n > 0 && (x == 0 || y == 0 || z == 0)))
+		{
+			return -1;
+		}
+
+		std::vector<double> x_d(x, x + n);
+		std::vector<double> y_d(y, y + n);
+		std::vector<double> z_d(n);
+		std::vector<double> normal_x_d(n);
+		std::vector<double> normal_y_d(n);
+		std::vector<double> normal_z_d(n);
+
+		int n_found = odrManager->GetRoadHeightBatch(n, x_d.data(), y_d.data(), z_d.data(), normal_x_d.data(), normal_y_d.data(),
+			normal_z_d.data(), found);
+
+		for (int i = 0; n_found >= 0 && i < n; i++)
+		{
+			z[i] = (float)z_d[i];
+			if (normalX)
+			{
+				normalX[i] = (float)normal_x_d[i];
+			}
+			if (normalY)
+			{
+				normalY[i] = (float)normal_y_d[i];
+			}
+			if (normalZ)
+			{
+				normalZ[i] = (float)normal_z_d[i];
+			}
+		}
+
+		return n_found;
+	}
+
 	RM_DLL_API int RM_PositionMoveForward(int handle, float dist, int strategy)
 	{
 		if (odrManager == 0 || handle >= position.size())
@@ -381,6 +489,27 @@ extern "C"
 		return 0;
 	}
 
+	RM_DLL_API int RM_GetProbeInfoAtDistances(int handle, float *lookahead_distances, int n, RM_RoadProbeInfo *data, int lookAheadMode)
+	{
+		if (odrManager == 0 || handle < 0 || handle >= position.size() || n < 0 ||
+			(n > 0 && (lookahead_distances == 0 || data == 0)))
+		{
+			return -1;
+		}
+
+		std::vector<double> distance(lookahead_distances, lookahead_distances + n);
+		std::vector<roadmanager::RoadProbeInfo> s_data(n);
+
+		int n_filled = position[handle].GetProbeInfo(distance.data(), n, s_data.data(), (roadmanager::Position::LookAheadMode)lookAheadMode);
+
+		for (int i = 0; i < n_filled; i++)
+		{
+			CopyProbeInfo(&s_data[i], &data[i]);
+		}
+
+		return n_filled;
+	}
+
 	RM_DLL_API bool RM_SubtractAFromB(int handleA, int handleB, RM_PositionDiff *pos_diff)
 	{
 		if (odrManager == 0 || handleA >= position.size() || handleB >= position.size())
@@ -399,4 +528,24 @@ extern "C"
 
 		return result;
 	}
+
+	RM_DLL_API int RM_ComputeLandmarks(int nLandmarks)
+	{
+		if (odrManager == 0)
+		{
+			return -1;
+		}
+
+		return odrManager->ComputeLandmarks(nLandmarks);
+	}
+
+	RM_DLL_API float RM_GetRoadDistanceLowerBound(int handleA, int handleB)
+	{
+		if (odrManager == 0 || handleA < 0 || handleA >= position.size() || handleB < 0 || handleB >= position.size())
+		{
+			return -1;
+		}
+
+		return (float)position[handleA].GetRoadDistanceLowerBound(position[handleB]);
+	}
 }
@@ -58,6 +58,14 @@ typedef struct
 	int dLaneId;			// delta laneId (increasing left and decreasing to the right)
 } RM_PositionDiff;
 
+typedef struct
+{
+	long long current_geometry;  // world positions found on the geometry of the previous position
+	long long same_road;         // found on another geometry of the previous road
+	long long connected_road;    // found on a road directly connected to the previous one
+	long long global;            // found by searching the whole road network
+} RM_ProjectionStats;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -144,7 +152,8 @@ extern "C"
 	RM_DLL_API int RM_SetS(int handle, float s);
 
 	/**
-	Set position from world coordinates, road coordinates being calculated
+	Set position from world coordinates, road coordinates being calculated. The search starts from the
+	current road position, see RM_GetProjectionStats.
 	@param handle Handle to the position object
 	@param x cartesian coordinate x value
 	@param y cartesian coordinate y value
@@ -156,6 +165,14 @@ extern "C"
 	*/
 	RM_DLL_API int RM_SetWorldPosition(int handle, float x, float y, float z, float h, float p, float r);
 
+	/**
+	Get statistics of how road coordinates were found by RM_SetWorldPosition
+	@param handle Handle to the position object
+	@param stats Struct including all result values, see RM_ProjectionStats typedef
+	@return 0 if successful, -1 if not
+	*/
+	RM_DLL_API int RM_GetProjectionStats(int handle, RM_ProjectionStats *stats);
+
 	/**
 	Set position from world X, Y and heading coordinates; Z, pitch and road coordinates being calculated
 	@param handle Handle to the position object
@@ -166,6 +183,46 @@ extern "C"
 	*/
 	RM_DLL_API int RM_SetWorldXYHPosition(int handle, float x, float y, float h);
 
+	/**
+	Map a set of world X, Y and heading coordinates to road coordinates, e.g. samples of a recorded trajectory.
+	The work is spread over a number of threads. Consecutive points are mapped incrementally, starting from the
+	previous result, so ordered samples are mapped much faster than unordered ones. Position objects are not affected.
+	@param n Number of points
+	@param x Array of cartesian coordinate x values
+	@param y Array of cartesian coordinate y values
+	@param h Array of rotation heading values
+	@param roadId Array receiving road ID per point, -1 if not found
+	@param laneId Array receiving lane ID per point, or 0
+	@param laneOffset Array receiving lateral offset from lane center per point, or 0
+	@param s Array receiving distance along the road per point, or 0
+	@param t Array receiving lateral distance from road reference line per point, or 0
+	@param nThreads Number of threads, 0 for one per processor core
+	@return 0 if successful, -1 if not, e.g. a required array is missing
+	*/
+	RM_DLL_API int RM_WorldXYHToRoadBatch(int n, float *x, float *y, float *h, int *roadId, int *laneId, float *laneOffset, float *s, float *t, int nThreads);
+
+	/**
+	Enable a grid of road surface heights, for fast height lookups with RM_GetRoadHeightBatch
+	@param resolution Distance between grid nodes (meter), e.g. 0.5. 0 removes the grid.
+	@return Largest height error found in the grid (meter), -1 if not successful
+	*/
+	RM_DLL_API float RM_SetHeightGridResolution(float resolution);
+
+	/**
+	Look up road height and surface normal for a set of world X, Y coordinates, e.g. wheel contact points,
+	without mapping them to road coordinates. Requires the height grid, see RM_SetHeightGridResolution.
+	@param n Number of points
+	@param x Array of cartesian coordinate x values
+	@param y Array of cartesian coordinate y values
+	@param z Array receiving road height per point, 0 where not found
+	@param normalX Array receiving X component of the road surface normal per point, or 0
+	@param normalY Array receiving Y component of the road surface normal per point, or 0
+	@param normalZ Array receiving Z component of the road surface normal per point, or 0
+	@param found Array receiving 1 per point found in the grid, else 0, or 0
+	@return Number of points found in the grid, -1 if not successful, e.g. x, y or z is missing
+	*/
+	RM_DLL_API int RM_GetRoadHeightBatch(int n, float *x, float *y, float *z, float *normalX, float *normalY, float *normalZ, int *found);
+
 	/**
 	Move position forward along the road. Choose way randomly though any junctions.
 	@param handle Handle to the position object
@@ -210,6 +267,18 @@ extern "C"
 	*/
 	RM_DLL_API int RM_GetProbeInfo(int handle, float lookahead_distance, RM_RoadProbeInfo *data, int lookAheadMode);
 
+	/**
+	As RM_GetProbeInfo for a number of points, e.g. preview points of a driver model. The road is traversed once,
+	moving from one point to the next, instead of once per point.
+	@param handle Handle to the position object from which to measure
+	@param lookahead_distances Array of distances, along the road, to the probes. Sorted in increasing order.
+	@param n Number of probes
+	@param data Array of n structs receiving the result values, see RM_RoadProbeInfo typedef
+	@param lookAheadMode Measurement strategy: Along reference lane, lane center or current lane offset. See roadmanager::Position::LookAheadMode enum
+	@return Number of probes filled in, starting from the first. Less than n if the road ends before the last probe. -1 if not successful.
+	*/
+	RM_DLL_API int RM_GetProbeInfoAtDistances(int handle, float *lookahead_distances, int n, RM_RoadProbeInfo *data, int lookAheadMode);
+
 	/**
 	Find out the difference between two position objects, i.e. delta distance (long and lat) and delta laneId
 	@param handleA Handle to the position object from which to measure
@@ -219,6 +288,24 @@ extern "C"
 	*/
 	RM_DLL_API bool RM_SubtractAFromB(int handleA, int handleB, RM_PositionDiff *pos_diff);
 
+	/**
+	Precompute road distance tables from a number of landmark roads, which speed up RM_SubtractAFromB on large
+	road networks and enable RM_GetRoadDistanceLowerBound. Call after RM_Init, tables are removed when loading.
+	@param nLandmarks Number of landmarks, e.g. 8. 0 removes the tables.
+	@return 0 if successful, -1 if not
+	*/
+	RM_DLL_API int RM_ComputeLandmarks(int nLandmarks);
+
+	/**
+	Get a lower bound of the distance along the road network between two position objects, e.g. to skip
+	RM_SubtractAFromB for pairs that are certainly farther apart than some distance. Requires RM_ComputeLandmarks
+	for positions on different roads.
+	@param handleA Handle to the position object from which to measure
+	@param handleB Handle to the position object to which the distance is measured
+	@return Lower bound (meter), 0 if unknown, a very large value if there is no path, -1 if not successful
+	*/
+	RM_DLL_API float RM_GetRoadDistanceLowerBound(int handleA, int handleB);
+
 
 #ifdef __cplusplus
 }
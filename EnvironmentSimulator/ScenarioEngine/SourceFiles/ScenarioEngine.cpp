@@ -15,12 +15,12 @@
 
 using namespace scenarioengine;
 
-ScenarioEngine::ScenarioEngine(std::string oscFilename, double headstart_time, RequestControlMode control_mode_first_vehicle)
+ScenarioEngine::ScenarioEngine(std::string oscFilename, double headstart_time, RequestControlMode control_mode_first_vehicle) : random_seed_(DEFAULT_RANDOM_SEED)
 {
 	InitScenario(oscFilename, headstart_time, control_mode_first_vehicle);
 }
 
-ScenarioEngine::ScenarioEngine(const pugi::xml_document &xml_doc, double headstart_time, RequestControlMode control_mode_first_vehicle)
+ScenarioEngine::ScenarioEngine(const pugi::xml_document &xml_doc, double headstart_time, RequestControlMode control_mode_first_vehicle) : random_seed_(DEFAULT_RANDOM_SEED)
 {
 	InitScenario(xml_doc, headstart_time, control_mode_first_vehicle);
 }
@@ -354,6 +354,18 @@ void ScenarioEngine::step(double deltaSimTime, bool initial)
 	}
 
 	stepObjects(deltaSimTime);
+
+	if (odrManager->IsTiled())
+	{
+		// Unload road data far from all entities, if over the memory budget
+		std::vector<double> x, y;
+		for (size_t i = 0; i < entities.object_.size(); i++)
+		{
+			x.push_back(entities.object_[i]->pos_.GetX());
+			y.push_back(entities.object_[i]->pos_.GetY());
+		}
+		odrManager->EvictRoads(x.data(), y.data(), (int)x.size());
+	}
 }
 
 void ScenarioEngine::printSimulationTime()
@@ -444,6 +456,7 @@ void ScenarioEngine::parseScenario(RequestControlMode control_mode_first_vehicle
 		entities.object_[0]->SetControl(RequestControl2ObjectControl(control_mode_first_vehicle));
 	}
 	ResolveHybridVehicles();
+	SetRandomSeed(random_seed_);
 	scenarioReader->parseInit(init);
 	scenarioReader->parseStoryBoard(storyBoard);
 
@@ -487,6 +500,21 @@ void ScenarioEngine::parseScenario(RequestControlMode control_mode_first_vehicle
 	storyBoard.Print();
 }
 
+void ScenarioEngine::SetRandomSeed(unsigned int seed)
+{
+	random_seed_ = seed;
+
+	for (size_t i = 0; i < entities.object_.size(); i++)
+	{
+		// Mix seed and entity id (SplitMix64 finalizer), so that nearby seeds and ids give unrelated streams
+		unsigned long long x = ((unsigned long long)seed << 32) | (unsigned int)entities.object_[i]->id_;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+		x = x ^ (x >> 31);
+		entities.object_[i]->pos_.SetRandomSeed((unsigned int)(x >> 32));
+	}
+}
+
 void ScenarioEngine::stepObjects(double dt)
 {
 	for (size_t i = 0; i < entities.object_.size(); i++)
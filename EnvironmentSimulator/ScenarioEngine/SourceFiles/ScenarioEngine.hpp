@@ -30,6 +30,7 @@
 namespace scenarioengine
 {
 	#define DEFAULT_HEADSTART_TIME 1.0
+	#define DEFAULT_RANDOM_SEED 0
 
 	class ScenarioEngine
 	{
@@ -49,7 +50,7 @@ namespace scenarioengine
 
 		ScenarioEngine(std::string oscFilename, double headstart_time = DEFAULT_HEADSTART_TIME, RequestControlMode control_mode_first_vehicle = CONTROL_BY_OSC);
 		ScenarioEngine(const pugi::xml_document &xml_doc, double headstart_time = DEFAULT_HEADSTART_TIME, RequestControlMode control_mode_first_vehicle = CONTROL_BY_OSC);
-		ScenarioEngine() {};
+		ScenarioEngine() : random_seed_(DEFAULT_RANDOM_SEED) {};
 		~ScenarioEngine();
 
 		void InitScenario(std::string oscFilename, double headstart_time, RequestControlMode control_mode_first_vehicle = CONTROL_BY_OSC);
@@ -70,6 +71,15 @@ namespace scenarioengine
 		double getSimulationTime() { return simulationTime; }
 		bool GetQuitFlag() { return quit_flag; }
 
+		/**
+		Seed the random number streams of all entities, e.g. used for random junction selection. Each entity
+		gets a stream of its own, derived from the seed and the entity id, so results are reproducible
+		regardless of in which order or thread entities are stepped.
+		@param seed Any value, same seed gives same result
+		*/
+		void SetRandomSeed(unsigned int seed);
+		unsigned int GetRandomSeed() { return random_seed_; }
+
 	private:
 		// OpenSCENARIO parameters
 		Catalogs catalogs;
@@ -88,6 +98,8 @@ namespace scenarioengine
 		// execution control flags
 		bool quit_flag;
 
+		unsigned int random_seed_;
+
 		void parseScenario(RequestControlMode control_mode_first_vehicle = CONTROL_BY_OSC);
 		void ResolveHybridVehicles();
 	};
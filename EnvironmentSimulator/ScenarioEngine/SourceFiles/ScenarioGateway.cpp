@@ -193,8 +193,8 @@ void ScenarioGateway::reportObject(int id, std::string name, int model_id, int c
 	}
 	else
 	{
-		// Update status
-		obj_state->state_.pos.SetInertiaPos(x, y, z, h, p, r);
+		// Update status. Reported positions normally move a short distance, so start search from the previous one.
+		obj_state->state_.pos.SetInertiaPosIncremental(x, y, z, h, p, r);
 		updateObjectInfo(obj_state, timestamp, speed, wheel_angle, wheel_rot);
 	}
 }
@@ -23,6 +23,7 @@ static ScenarioPlayer *player = 0;
 static char **argv = 0;
 static int argc = 0;
 static std::vector<std::string> args_v;
+static unsigned int seed = DEFAULT_RANDOM_SEED;
 
 static void resetScenario(void)
 {
@@ -89,6 +90,23 @@ static void copyStateFromScenarioGateway(SE_ScenarioObjectState *state, ObjectSt
 
 }
 
+static void CopyRoadInfo(roadmanager::RoadProbeInfo *s_data, SE_RoadInfo *r_data)
+{
+	r_data->local_pos_x = (float)s_data->relative_pos[0];
+	r_data->local_pos_y = (float)s_data->relative_pos[1];
+	r_data->local_pos_z = (float)s_data->relative_pos[2];
+	r_data->global_pos_x = (float)s_data->road_lane_info.pos[0];
+	r_data->global_pos_y = (float)s_data->road_lane_info.pos[1];
+	r_data->global_pos_z = (float)s_data->road_lane_info.pos[2];
+	r_data->angle = (float)s_data->relative_h;
+	r_data->curvature = (float)s_data->road_lane_info.curvature;
+	r_data->road_heading = (float)s_data->road_lane_info.heading;
+	r_data->road_pitch = (float)s_data->road_lane_info.pitch;
+	r_data->road_roll = (float)s_data->road_lane_info.roll;
+	r_data->trail_heading = r_data->road_heading;
+	r_data->speed_limit = (float)s_data->road_lane_info.speed_limit;
+}
+
 static int GetRoadInfoAtDistance(int object_id, float lookahead_distance, SE_RoadInfo *r_data, int lookAheadMode)
 {
 	roadmanager::RoadProbeInfo s_data;
@@ -113,19 +131,7 @@ static int GetRoadInfoAtDistance(int object_id, float lookahead_distance, SE_Roa
 	else
 	{
 		// Copy data
-		r_data->local_pos_x = (float)s_data.relative_pos[0];
-		r_data->local_pos_y = (float)s_data.relative_pos[1];
-		r_data->local_pos_z = (float)s_data.relative_pos[2];
-		r_data->global_pos_x = (float)s_data.road_lane_info.pos[0];
-		r_data->global_pos_y = (float)s_data.road_lane_info.pos[1];
-		r_data->global_pos_z = (float)s_data.road_lane_info.pos[2];
-		r_data->angle = (float)s_data.relative_h;
-		r_data->curvature = (float)s_data.road_lane_info.curvature;
-		r_data->road_heading = (float)s_data.road_lane_info.heading;
-		r_data->road_pitch = (float)s_data.road_lane_info.pitch;
-		r_data->road_roll = (float)s_data.road_lane_info.roll;
-		r_data->trail_heading = r_data->road_heading;
-		r_data->speed_limit = (float)s_data.road_lane_info.speed_limit;
+		CopyRoadInfo(&s_data, r_data);
 
 		return 0;
 	}
@@ -198,6 +204,11 @@ static int GetRoadInfoAlongGhostTrail(int object_id, float lookahead_distance, S
 
 extern "C"
 {
+	SE_DLL_API void SE_SetSeed(unsigned int seed_value)
+	{
+		seed = seed_value;
+	}
+
 	SE_DLL_API int SE_Init(const char *oscFilename, int control, int use_viewer, int threads, int record, float headstart_time)
 	{
 		resetScenario();
@@ -248,6 +259,7 @@ extern "C"
 		}
 
 		AddArgument(std::string("--ghost_headstart " + std::to_string((long double)headstart_time)).c_str());
+		AddArgument(std::string("--seed " + std::to_string((unsigned long long)seed)).c_str());
 
 		ConvertArguments();
 
@@ -364,6 +376,22 @@ extern "C"
 		return 0;
 	}
 
+	SE_DLL_API int SE_GetObjectProjectionStats(int index, SE_ProjectionStats *stats)
+	{
+		if (player == 0 || index < 0 || index >= player->scenarioGateway->getNumberOfObjects())
+		{
+			return -1;
+		}
+
+		roadmanager::ProjectionStats projection_stats = player->scenarioGateway->getObjectStatePtrByIdx(index)->state_.pos.GetProjectionStats();
+		stats->current_geometry = projection_stats.current_geometry;
+		stats->same_road = projection_stats.same_road;
+		stats->connected_road = projection_stats.connected_road;
+		stats->global = projection_stats.global;
+
+		return 0;
+	}
+
 	SE_DLL_API int SE_GetObjectGhostState(int index, SE_ScenarioObjectState *state)
 	{
 		if (player)
@@ -461,6 +489,28 @@ extern "C"
 		return 0;
 	}
 
+	SE_DLL_API int SE_GetRoadInfoAtDistances(int object_id, float *lookahead_distances, int n, SE_RoadInfo *data, int lookAheadMode)
+	{
+		if (player == 0 || object_id < 0 || object_id >= player->scenarioGateway->getNumberOfObjects() || n < 0 ||
+			(n > 0 && (lookahead_distances == 0 || data == 0)))
+		{
+			return -1;
+		}
+
+		roadmanager::Position *pos = &player->scenarioGateway->getObjectStatePtrByIdx(object_id)->state_.pos;
+		std::vector<double> distance(lookahead_distances, lookahead_distances + n);
+		std::vector<roadmanager::RoadProbeInfo> s_data(n);
+
+		int n_filled = pos->GetProbeInfo(distance.data(), n, s_data.data(), (roadmanager::Position::LookAheadMode)lookAheadMode);
+
+		for (int i = 0; i < n_filled; i++)
+		{
+			CopyRoadInfo(&s_data[i], &data[i]);
+		}
+
+		return n_filled;
+	}
+
 	SE_DLL_API int SE_GetRoadInfoAlongGhostTrail(int object_id, float lookahead_distance, SE_RoadInfo *data, float *speed_ghost)
 	{
 		if (player == 0 || object_id >= player->scenarioGateway->getNumberOfObjects())
@@ -58,11 +58,26 @@ typedef struct
 	float speed_limit;		// speed limit given by OpenDRIVE type entry
 } SE_RoadInfo;
 
+typedef struct
+{
+	long long current_geometry;  // world positions found on the geometry of the previous position
+	long long same_road;         // found on another geometry of the previous road
+	long long connected_road;    // found on a road directly connected to the previous one
+	long long global;            // found by searching the whole road network
+} SE_ProjectionStats;
+
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
+	/**
+	Set seed of the random number streams, e.g. used for random junction selection, for following calls to SE_Init.
+	Same seed gives same result. Default is 0.
+	@param seed Any value
+	*/
+	SE_DLL_API void SE_SetSeed(unsigned int seed);
+
 	/**
 	Initialize the scenario engine
 	@param oscFilename Path to the OpenSCEANRIO file
@@ -106,6 +121,15 @@ extern "C"
 	SE_DLL_API int SE_GetObjectGhostState(int index, SE_ScenarioObjectState *state);
 	SE_DLL_API int SE_GetObjectStates(int *nObjects, SE_ScenarioObjectState* state);
 
+	/**
+	Get statistics of how road coordinates were found for world positions reported by SE_ReportObjectPos.
+	The search starts from the previous road position of the object.
+	@param index Index of the object
+	@param stats Struct including all result values, see SE_ProjectionStats typedef
+	@return 0 if successful, -1 if not
+	*/
+	SE_DLL_API int SE_GetObjectProjectionStats(int index, SE_ProjectionStats *stats);
+
 	/**
 	Create an ideal object sensor and attach to specified vehicle
 	@param object_id Handle to the object to which the sensor should be attached
@@ -139,6 +163,18 @@ extern "C"
 	*/
 	SE_DLL_API int SE_GetRoadInfoAtDistance(int object_id, float lookahead_distance, SE_RoadInfo *data, int lookAheadMode);
 
+	/**
+	As SE_GetRoadInfoAtDistance for a number of points, e.g. preview points of a driver model. The road is traversed
+	once, moving from one point to the next, instead of once per point.
+	@param object_id Handle to the position object from which to measure
+	@param lookahead_distances Array of distances, along the road, to the points. Sorted in increasing order.
+	@param n Number of points
+	@param data Array of n structs receiving the result values, see typedef for details
+	@param lookAheadMode Measurement strategy: Along 0=lane center, 1=road center (ref line) or 2=current lane offset. See roadmanager::Position::LookAheadMode enum
+	@return Number of points filled in, starting from the first. Less than n if the road ends before the last point. -1 if not successful.
+	*/
+	SE_DLL_API int SE_GetRoadInfoAtDistances(int object_id, float *lookahead_distances, int n, SE_RoadInfo *data, int lookAheadMode);
+
 	/**
 	Get information suitable for driver modeling of a ghost vehicle driving ahead of the ego vehicle
 	@param object_id Handle to the position object from which to measure (the actual externally controlled Ego vehicle, not ghost)